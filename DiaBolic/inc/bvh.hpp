@@ -0,0 +1,118 @@
+#pragma once
+
+#include "culling.hpp"
+
+#include <future>
+
+// Dynamic bounding volume hierarchy over scene objects.
+// Objects are inserted as proxies with stable handles. Moving an object refits its ancestors in place, which slowly
+// degrades the tree, so Maintain() periodically rebuilds it on a background thread and swaps the result in.
+class Bvh
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    struct Stats
+    {
+        uint32_t proxyCount = 0;
+        uint32_t nodeCount = 0;
+        uint32_t refitsSinceRebuild = 0;
+        uint32_t rebuildCount = 0;
+        uint32_t nodesVisited = 0; // by the last query
+    };
+
+    Bvh() = default;
+    ~Bvh();
+
+    Bvh(const Bvh& other) = delete;
+    Bvh& operator=(const Bvh& other) = delete;
+    Bvh(Bvh&& other) = default;
+    Bvh& operator=(Bvh&& other) = default;
+
+    // Returns a handle that stays valid until the proxy is removed.
+    [[nodiscard]] uint32_t Insert(const Culling::Bounds& bounds, uint32_t userData);
+    void Remove(uint32_t proxy);
+    // Refits the proxy's leaf and its ancestors to the new bounds.
+    void Update(uint32_t proxy, const Culling::Bounds& bounds);
+
+    // Writes the userData of every proxy that intersects the frustum to visible.
+    // Subtrees outside the frustum are skipped, subtrees fully inside are added without further tests.
+    void Query(const Culling::Frustum& frustum, std::vector<uint32_t>& visible);
+
+    // Kicks off a background rebuild once enough refits have piled up, and swaps in a finished one.
+    void Maintain();
+    // Rebuilds on the calling thread.
+    void Rebuild();
+
+    void SetRebuildThreshold(float refitsPerProxy) { _rebuildThreshold = refitsPerProxy; }
+
+    [[nodiscard]] const Stats& GetStats() const { return _stats; }
+    // Heap bytes held by the tree and proxies, capacity included. Not counting a rebuild in progress.
+    [[nodiscard]] size_t GetMemoryUsage() const;
+
+private:
+    struct Box
+    {
+        DirectX::XMFLOAT3 min;
+        DirectX::XMFLOAT3 max;
+    };
+
+    struct Node
+    {
+        Box box;
+        uint32_t parent = INVALID_INDEX;
+        uint32_t left = INVALID_INDEX;  // INVALID_INDEX for leaves
+        uint32_t right = INVALID_INDEX;
+        uint32_t proxy = INVALID_INDEX; // only set for leaves
+    };
+
+    struct Proxy
+    {
+        Box box;
+        uint32_t node = INVALID_INDEX;
+        uint32_t userData = 0;
+        bool alive = false;
+    };
+
+    struct Tree
+    {
+        std::vector<Node> nodes;
+        std::vector<uint32_t> freeNodes;
+        uint32_t root = INVALID_INDEX;
+
+        uint32_t AllocateNode();
+        void FreeNode(uint32_t index);
+        void InsertLeaf(uint32_t leaf);
+        void RemoveLeaf(uint32_t leaf);
+        void RefitFrom(uint32_t index);
+    };
+
+    struct LeafInput
+    {
+        Box box;
+        uint32_t proxy;
+    };
+
+    struct BuildResult
+    {
+        Tree tree;
+        std::vector<std::pair<uint32_t, uint32_t>> proxyNodes; // proxy, leaf node
+    };
+
+    static BuildResult Build(std::vector<LeafInput> leaves);
+    static uint32_t BuildRecursive(Tree& tree, std::vector<LeafInput>& leaves, size_t begin, size_t end, uint32_t parent,
+                                   std::vector<std::pair<uint32_t, uint32_t>>& proxyNodes);
+
+    void ApplyBuild(BuildResult&& result);
+    void MarkChanged(uint32_t proxy);
+
+    Tree _tree;
+    std::vector<Proxy> _proxies;
+    std::vector<uint32_t> _freeProxies;
+
+    std::future<BuildResult> _pendingBuild;
+    std::vector<uint32_t> _changedDuringBuild;
+
+    float _rebuildThreshold = 0.5f;
+    Stats _stats;
+};
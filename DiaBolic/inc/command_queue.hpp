@@ -8,6 +8,8 @@ public:
 
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> GetCommandList();
 	uint64_t ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList);
+	// Executes the lists in order with a single submission and fence signal.
+	uint64_t ExecuteCommandLists(const std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>& commandLists);
 
 	uint64_t Signal();
 	bool IsFenceComplete(uint64_t fenceValue);
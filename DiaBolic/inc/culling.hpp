@@ -0,0 +1,50 @@
+#pragma once
+
+namespace Culling
+{
+    // Axis aligned box as center and half extents.
+    struct Bounds
+    {
+        DirectX::XMFLOAT3 center = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+        DirectX::XMFLOAT3 extents = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+    };
+
+    // Planes point inwards and are normalized: a point is inside when dot(plane.xyz, p) + plane.w >= 0.
+    struct Frustum
+    {
+        std::array<DirectX::XMFLOAT4, 6> planes;
+    };
+
+    // Extracts the planes from a row-vector view-projection matrix with a [0, 1] depth range.
+    [[nodiscard]] Frustum ExtractFrustum(const DirectX::XMMATRIX& viewProjection);
+
+    [[nodiscard]] Bounds ComputeBounds(const std::vector<DirectX::XMFLOAT3>& positions);
+
+    // Box that encloses bounds after transforming it by transform.
+    [[nodiscard]] Bounds TransformBounds(const Bounds& bounds, const DirectX::XMMATRIX& transform);
+
+    // World space boxes stored per component, padded to a multiple of 8 so the SIMD paths never read past the end.
+    class BoundsSoA
+    {
+    public:
+        void Clear();
+        void Reserve(size_t count);
+        void Add(const Bounds& bounds);
+        void Set(size_t index, const Bounds& bounds);
+
+        [[nodiscard]] size_t GetCount() const { return _count; }
+        [[nodiscard]] Bounds Get(size_t index) const;
+        // Heap bytes held by the arrays, capacity included.
+        [[nodiscard]] size_t GetMemoryUsage() const;
+
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+
+    private:
+        size_t _count = 0;
+    };
+
+    // Writes the indices of the boxes that intersect the frustum to visible, in increasing order.
+    // Tests 8 boxes per instruction with AVX2, 4 with SSE, and falls back to scalar code otherwise.
+    void CullFrustum(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+class Mesh;
+struct Material;
+
+struct DrawPacket
+{
+    const Mesh* mesh = nullptr;
+    const Material* material = nullptr;
+    DirectX::XMFLOAT4X4 transform;
+    uint32_t pipeline = 0;
+};
+
+// Flat list of the draws for a frame, sorted on a 64-bit key so that draws sharing state end up next to each other.
+// Key layout, most significant first: pipeline (8 bits) | material (16 bits) | mesh (16 bits) | depth (24 bits).
+class DrawList
+{
+public:
+    void Clear();
+    void Add(const DrawPacket& packet, float viewDepth);
+    void Sort();
+
+    [[nodiscard]] size_t GetCount() const { return _packets.size(); }
+    // Only valid after Sort().
+    [[nodiscard]] const DrawPacket& GetSorted(size_t index) const { return _packets[_sortEntries[index].packetIndex]; }
+    // Number of sorted packets from first on that share pipeline, material and mesh, and can be drawn as instances.
+    [[nodiscard]] uint32_t GetInstanceCount(size_t first) const;
+
+    // Largest ids the key has room for, larger ones would collide with others.
+    static constexpr uint32_t MAX_PIPELINE_ID = 0xFF;
+    static constexpr uint32_t MAX_MATERIAL_ID = 0xFFFF;
+    static constexpr uint32_t MAX_MESH_ID = 0xFFFF;
+
+    [[nodiscard]] static uint64_t MakeSortKey(uint32_t pipeline, uint32_t materialId, uint32_t meshId, float viewDepth);
+
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t packetIndex;
+    };
+
+    std::vector<DrawPacket> _packets;
+    std::vector<SortEntry> _sortEntries;
+    std::vector<SortEntry> _sortScratch;
+};
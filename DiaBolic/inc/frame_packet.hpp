@@ -0,0 +1,43 @@
+#pragma once
+
+#include "draw_list.hpp"
+#include "scene.hpp"
+#include "task_graph.hpp"
+
+// Everything the render thread needs to draw a frame, built by the main thread from the simulation's state.
+// Read only once submitted, the main thread meanwhile builds the next frame into another packet.
+struct FramePacket
+{
+    struct CullStats
+    {
+        uint32_t objectCount = 0;
+        uint32_t transformsScanned = 0;
+        uint32_t transformsTouched = 0;
+
+        uint32_t frustumVisibleCount = 0;
+        uint32_t visibleCount = 0;
+        uint32_t bvhNodesVisited = 0;
+        float cullMilliseconds = 0.0f;
+
+        uint32_t occluderCount = 0;
+        uint32_t occluderTriangleCount = 0;
+        uint32_t occludedCount = 0;
+        float occlusionMilliseconds = 0.0f;
+    };
+
+    uint64_t frameNumber = 0;
+    float deltaTime = 0.0f;
+    float simulationMilliseconds = 0.0f;
+    TaskGraph::Stats simulationGraphStats;
+
+    DirectX::XMFLOAT4X4 view;
+    DirectX::XMFLOAT4X4 projection;
+    DirectX::XMFLOAT3 cameraPosition;
+
+    // Sorted by the time it is submitted, the packets carry their own world transform.
+    DrawList drawList;
+    bool indirectDraws = false;
+
+    CullStats cullStats;
+    Scene::Stats sceneStats;
+};
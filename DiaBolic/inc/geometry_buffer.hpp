@@ -0,0 +1,71 @@
+#pragma once
+
+#include "gpu_allocator.hpp"
+
+class Renderer;
+
+// Every mesh's vertices and indices in one buffer per vertex stream and one index buffer, each with a single view.
+// A mesh is a range of vertices, the same in every stream, and a range of indices. Indices stay relative to the mesh's
+// first vertex: the vertex shader adds RenderResources::vertexOffset, SV_VertexID doesn't include BaseVertexLocation.
+// All draws share the index buffer, so it is bound once per pass and indirect commands don't carry one.
+// The capacity is fixed when it's created, running out is an error.
+class GeometryBuffer
+{
+public:
+    struct Allocation
+    {
+        uint32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+
+        Util::TlsfAllocator::Allocation vertices;
+        Util::TlsfAllocator::Allocation indices;
+    };
+
+    struct Stats
+    {
+        uint32_t meshCount = 0;
+        Util::TlsfAllocator::Stats vertices; // in vertices, not bytes
+        Util::TlsfAllocator::Stats indices; // in indices
+        uint64_t bytes = 0; // of all buffers together
+    };
+
+    GeometryBuffer(Renderer& renderer, uint32_t vertexCapacity, uint32_t indexCapacity);
+    ~GeometryBuffer();
+
+    GeometryBuffer(const GeometryBuffer& other) = delete;
+    GeometryBuffer& operator=(const GeometryBuffer& other) = delete;
+
+    // Reserves a mesh's ranges and records the copies into them on a copy command list. Streams left empty are zeroed.
+    // The data goes through intermediate, free it once the command list executed. Safe to call from any thread.
+    [[nodiscard]] Allocation Upload(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList,
+        const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<DirectX::XMFLOAT3>& normals,
+        const std::vector<DirectX::XMFLOAT2>& uvs, const std::vector<uint16_t>& indices, GpuAllocation& intermediate);
+    // Only once the GPU is done with the mesh.
+    void Free(Allocation& allocation);
+
+    [[nodiscard]] uint32_t GetPositionSrvIndex() const { return _positionSrvIndex; }
+    [[nodiscard]] uint32_t GetNormalSrvIndex() const { return _normalSrvIndex; }
+    [[nodiscard]] uint32_t GetUVSrvIndex() const { return _uvSrvIndex; }
+    [[nodiscard]] const D3D12_INDEX_BUFFER_VIEW& GetIndexBufferView() const { return _indexBufferView; }
+
+    [[nodiscard]] Stats GetStats() const;
+
+private:
+    GpuAllocator& _allocator;
+
+    GpuAllocation _positions;
+    GpuAllocation _normals;
+    GpuAllocation _uvs;
+    GpuAllocation _indices;
+
+    uint32_t _positionSrvIndex = 0;
+    uint32_t _normalSrvIndex = 0;
+    uint32_t _uvSrvIndex = 0;
+    D3D12_INDEX_BUFFER_VIEW _indexBufferView{};
+
+    mutable std::mutex _mutex;
+    Util::TlsfAllocator _vertexAllocator;
+    Util::TlsfAllocator _indexAllocator;
+};
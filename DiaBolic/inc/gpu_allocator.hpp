@@ -0,0 +1,103 @@
+#pragma once
+
+#include "utility/tlsf_allocator.hpp"
+
+// Piece of GPU memory from the GpuAllocator. Buffers are a range of a big buffer shared with other allocations,
+// textures are placed resources of their own.
+struct GpuAllocation
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+    uint64_t offset = 0; // into resource, always 0 for textures
+    uint64_t size = 0;
+
+    // Buffers only, at offset.
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+    void* cpuAddress = nullptr; // upload buffers only, mapped for as long as they live
+
+    uint32_t pool = 0;
+    uint32_t heap = 0; // index in the pool
+    Util::TlsfAllocator::Allocation range;
+
+    [[nodiscard]] bool IsValid() const { return range.IsValid(); }
+};
+
+// Suballocates buffers and textures from large ID3D12Heaps instead of giving every one a committed resource, which
+// takes a heap of its own rounded up to 64KB. Every kind of resource has its own pool of heaps, so this also works on
+// resource heap tier 1. A pool's heaps are split with a TlsfAllocator each, a new heap is added when none has room.
+// Buffers are packed at 256 bytes into one buffer covering the whole heap, textures are placed resources, at 4KB
+// alignment when they're small enough.
+// Safe to call from any thread. Only free allocations the GPU is done with.
+class GpuAllocator
+{
+public:
+    enum class Pool : uint32_t
+    {
+        Buffers, // default heap
+        UploadBuffers,
+        Textures,
+        RenderTargets, // render target and depth stencil textures
+        Count,
+    };
+
+    struct PoolStats
+    {
+        uint32_t heapCount = 0;
+        Util::TlsfAllocator::Stats memory; // all heaps together, largestFreeBlock of the heap that has the largest
+        uint64_t committedBytes = 0; // the same resources as committed resources
+    };
+
+    static constexpr uint64_t BUFFER_ALIGNMENT = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+
+    GpuAllocator(const Microsoft::WRL::ComPtr<ID3D12Device2>& device);
+    ~GpuAllocator();
+
+    GpuAllocator(const GpuAllocator& other) = delete;
+    GpuAllocator& operator=(const GpuAllocator& other) = delete;
+
+    // Default heap buffers start in D3D12_RESOURCE_STATE_COMMON and allow unordered access, upload buffers are in
+    // D3D12_RESOURCE_STATE_GENERIC_READ. alignment is a multiple of BUFFER_ALIGNMENT, not necessarily a power of two.
+    [[nodiscard]] GpuAllocation AllocateBuffer(uint64_t size, uint64_t alignment = BUFFER_ALIGNMENT, D3D12_HEAP_TYPE heapType = D3D12_HEAP_TYPE_DEFAULT);
+    [[nodiscard]] GpuAllocation CreateTexture(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue = nullptr);
+    // Leaves allocation invalid. Heaps that end up empty are released, apart from the last one of each pool.
+    void Free(GpuAllocation& allocation);
+
+    [[nodiscard]] PoolStats GetStats(Pool pool) const;
+    [[nodiscard]] static const char* GetPoolName(Pool pool);
+
+private:
+    struct Heap
+    {
+        Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+        Microsoft::WRL::ComPtr<ID3D12Resource> buffer; // buffer pools, covers the whole heap
+        uint8_t* mappedData = nullptr;
+        std::unique_ptr<Util::TlsfAllocator> allocator;
+    };
+
+    struct PoolDesc
+    {
+        D3D12_HEAP_TYPE heapType;
+        D3D12_HEAP_FLAGS heapFlags;
+        uint64_t heapSize;
+        uint64_t granularity; // smallest alignment in the pool
+        uint64_t heapAlignment;
+    };
+
+    struct PoolState
+    {
+        std::vector<std::unique_ptr<Heap>> heaps; // empty slots are reused
+        uint64_t committedBytes = 0;
+    };
+
+    static const PoolDesc& GetPoolDesc(Pool pool);
+
+    // Under _mutex. Tries every heap of the pool, then adds one of at least size, createdHeap says whether it did.
+    GpuAllocation Allocate(Pool pool, uint64_t size, uint64_t alignment, bool& createdHeap);
+    // Under _mutex. Releases the heap when it ends up empty and releaseEmptyHeap is set or it isn't the pool's last.
+    void Release(const GpuAllocation& allocation, bool releaseEmptyHeap);
+    uint32_t CreateHeap(Pool pool, uint64_t minimumSize);
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> _device;
+
+    mutable std::mutex _mutex;
+    PoolState _pools[static_cast<uint32_t>(Pool::Count)];
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "utility/indirect_draw_layout.hpp"
+
+// Argument buffer layout for ExecuteIndirect draws, see utility/indirect_draw_layout.hpp. This half describes it to D3D12.
+namespace IndirectDraw
+{
+    constexpr uint32_t ARGUMENT_COUNT = 2;
+
+    // Argument descriptions in the order PackCommand() writes them.
+    [[nodiscard]] std::array<D3D12_INDIRECT_ARGUMENT_DESC, ARGUMENT_COUNT> MakeArgumentDescs(const Layout& layout);
+
+    [[nodiscard]] Microsoft::WRL::ComPtr<ID3D12CommandSignature> CreateCommandSignature(
+        const Microsoft::WRL::ComPtr<ID3D12Device2>& device, const Microsoft::WRL::ComPtr<ID3D12RootSignature>& rootSignature, const Layout& layout);
+}
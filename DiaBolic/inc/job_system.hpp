@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <thread>
+
+// Runs jobs on a worker thread per core. Every worker owns a queue it pushes to and pops from at the back, idle workers
+// steal from the front of the others. Threads outside the pool share one more queue.
+// Waiting on a counter or a future runs other jobs instead of blocking, so a job can wait on jobs it started without
+// tying up a worker.
+// Low priority jobs, like shader compiles and pipeline builds, sit in a queue of their own that only idle workers take
+// from. A thread waiting on something only helps out with them when it is running one itself, so a wait in the middle
+// of a frame never ends up compiling shaders.
+class JobSystem
+{
+public:
+    enum class Priority
+    {
+        Normal,
+        Low,
+    };
+
+    // Counts the jobs started with it that haven't finished yet.
+    class Counter
+    {
+    public:
+        [[nodiscard]] bool IsDone() const { return _count.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+        std::atomic<uint32_t> _count = 0;
+    };
+
+    struct Stats
+    {
+        uint64_t jobsRun = 0;
+        uint64_t jobsStolen = 0;
+        uint64_t lowPriorityJobsRun = 0;
+    };
+
+    // Started on first use, runs until the program exits.
+    [[nodiscard]] static JobSystem& Get();
+
+    JobSystem(const JobSystem& other) = delete;
+    JobSystem& operator=(const JobSystem& other) = delete;
+
+    // job must not throw, use Async when it can.
+    void Run(std::function<void()> job, Counter* counter = nullptr, Priority priority = Priority::Normal);
+
+    // Exceptions end up in the future.
+    template<typename Function>
+    [[nodiscard]] auto Async(Function&& function, Priority priority = Priority::Normal) -> std::future<std::invoke_result_t<std::decay_t<Function>>>;
+
+    // Calls body(begin, end) for chunks of at most grainSize covering [0, count) and returns once all of them ran.
+    // The calling thread takes the first chunk. body must not throw.
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+    // Waiting on a low priority job from outside one spins until an idle worker got to it.
+    void Wait(const Counter& counter);
+    template<typename T>
+    decltype(auto) Wait(std::future<T>& future);
+
+    [[nodiscard]] uint32_t GetWorkerCount() const { return static_cast<uint32_t>(_workers.size()); }
+    [[nodiscard]] Stats GetStats() const;
+
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        Counter* counter = nullptr;
+        Priority priority = Priority::Normal;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    JobSystem();
+    ~JobSystem();
+
+    void WorkerLoop(std::stop_token stopToken, uint32_t queueIndex);
+    // Runs one job from the thread's own queue, or one stolen from another. Inside a low priority job it also takes low
+    // priority ones, so they can wait on each other. Returns false when there was none.
+    bool RunOneJob();
+    // Idle workers only.
+    bool RunLowPriorityJob();
+    void Execute(Job& job);
+    bool PopJob(uint32_t queueIndex, Job& job);
+    bool StealJob(uint32_t thiefIndex, Job& job);
+    bool PopLowPriorityJob(Job& job);
+
+    std::vector<std::unique_ptr<Queue>> _queues; // one per worker, the last one for threads outside the pool
+    Queue _lowPriorityQueue; // shared, oldest first
+    std::atomic<uint32_t> _queuedJobs = 0; // of both priorities
+    std::atomic<uint64_t> _jobsRun = 0;
+    std::atomic<uint64_t> _jobsStolen = 0;
+    std::atomic<uint64_t> _lowPriorityJobsRun = 0;
+
+    std::mutex _sleepMutex;
+    std::condition_variable_any _wakeUp;
+    std::vector<std::jthread> _workers; // last, so the threads stop before the queues go away
+};
+
+template<typename Function>
+auto JobSystem::Async(Function&& function, Priority priority) -> std::future<std::invoke_result_t<std::decay_t<Function>>>
+{
+    using Result = std::invoke_result_t<std::decay_t<Function>>;
+
+    // std::function needs a copyable target, so the task is shared.
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+    std::future<Result> result = task->get_future();
+    Run([task]() { (*task)(); }, nullptr, priority);
+    return result;
+}
+
+template<typename T>
+decltype(auto) JobSystem::Wait(std::future<T>& future)
+{
+    while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        if(!RunOneJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+    return future.get();
+}
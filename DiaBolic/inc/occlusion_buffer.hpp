@@ -0,0 +1,47 @@
+#pragma once
+
+#include "culling.hpp"
+
+namespace Culling
+{
+    // Low resolution CPU depth buffer for software occlusion culling.
+    // Occluder triangles are rasterized with SIMD at pixel centers and write the farthest depth they reach inside the
+    // pixel. Depth is z/w with 0 at the near plane, so a box is hidden when every pixel it touches holds a depth nearer
+    // than the box's nearest point. Only uses DirectXMath and is single threaded, so results are deterministic and it
+    // runs without a device.
+    class OcclusionBuffer
+    {
+    public:
+        static constexpr uint32_t WIDTH = 256;
+        static constexpr uint32_t HEIGHT = 128;
+        static constexpr uint32_t TILE_SIZE = 8;
+        static constexpr uint32_t TILES_X = WIDTH / TILE_SIZE;
+        static constexpr uint32_t TILES_Y = HEIGHT / TILE_SIZE;
+
+        OcclusionBuffer();
+
+        void Clear();
+
+        // worldViewProjection transforms the object space positions to clip space, row-vector convention.
+        // Triangles crossing the near plane are skipped, which only makes the buffer less aggressive.
+        void RasterizeOccluder(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint16_t>& indices,
+                               const DirectX::XMMATRIX& worldViewProjection);
+
+        // Builds the per tile farthest depth, call after the last occluder and before testing.
+        void Finalize();
+
+        // Returns false only if the world space box is hidden behind the rasterized occluders.
+        [[nodiscard]] bool IsVisible(const Bounds& bounds, const DirectX::XMMATRIX& viewProjection) const;
+
+        [[nodiscard]] float GetDepth(uint32_t x, uint32_t y) const { return _depth[y * WIDTH + x]; }
+        [[nodiscard]] uint32_t GetTriangleCount() const { return _triangleCount; }
+
+    private:
+        void RasterizeTriangle(const DirectX::XMFLOAT3& v0, const DirectX::XMFLOAT3& v1, const DirectX::XMFLOAT3& v2);
+
+        std::vector<float> _depth;
+        std::array<float, TILES_X * TILES_Y> _tileMaxDepth{};
+        std::vector<DirectX::XMFLOAT4> _clipVertices; // scratch
+        uint32_t _triangleCount = 0;
+    };
+}
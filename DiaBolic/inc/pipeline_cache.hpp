@@ -0,0 +1,56 @@
+#pragma once
+
+#include "utility/pipeline_store.hpp"
+
+// Creates every pipeline state through one place, keyed by Util::HashGraphicsPipelineDesc and shared through a
+// Util::PipelineStore.
+// Equal descriptions share one pipeline state, and driver compiled pipelines are kept in an ID3D12PipelineLibrary on disk
+// so the next launch loads them instead of compiling again. Safe to call from any thread.
+// A pipeline state is only kept in memory while someone owns it, every one handed out has to be given back with
+// ReleaseGraphicsPipeline() once it is replaced, so reloaded pipelines don't pile up.
+class PipelineCache
+{
+public:
+    struct Stats
+    {
+        uint32_t memoryHits = 0;
+        uint32_t libraryHits = 0;
+        uint32_t compiles = 0;
+        uint32_t pipelineCount = 0; // owned right now
+    };
+
+    PipelineCache(const Microsoft::WRL::ComPtr<ID3D12Device2>& device);
+
+    PipelineCache(const PipelineCache& other) = delete;
+    PipelineCache& operator=(const PipelineCache& other) = delete;
+
+    // Root signatures have to be created here, the hash of their serialized blob is stored on them and is part of the
+    // pipeline key.
+    [[nodiscard]] Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRootSignature(const void* serialized, size_t size);
+
+    // Every call makes the caller an owner of the pipeline state.
+    [[nodiscard]] Microsoft::WRL::ComPtr<ID3D12PipelineState> GetGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+    // The cache lets go of the pipeline state once its last owner released it. Frames in flight may still use it, keep
+    // the caller's reference alive with Renderer::DeferRelease.
+    void ReleaseGraphicsPipeline(ID3D12PipelineState* pipelineState);
+
+    // Writes the library to disk if pipelines were added since it was loaded.
+    void Save();
+
+    [[nodiscard]] Stats GetStats() const;
+
+private:
+    void OpenLibrary();
+
+    Microsoft::WRL::ComPtr<ID3D12Device2> _device;
+
+    mutable std::mutex _mutex;
+    Util::PipelineStore<Microsoft::WRL::ComPtr<ID3D12PipelineState>> _pipelines;
+
+    // Null when the driver doesn't support pipeline libraries, pipelines are then only shared in memory.
+    Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> _library;
+    std::vector<uint8_t> _libraryData; // the library reads from this, keep it alive as long as the library
+    bool _libraryChanged = false;
+
+    Stats _stats;
+};
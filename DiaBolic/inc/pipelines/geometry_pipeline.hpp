@@ -1,6 +1,16 @@
 #pragma once
 
 #include "resources.hpp"
+#include "scene.hpp"
+#include "draw_list.hpp"
+#include "frame_packet.hpp"
+#include "indirect_draw.hpp"
+#include "utility/shader_permutations.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
 
 class Renderer;
 struct Camera;
@@ -8,19 +18,102 @@ struct Camera;
 class GeometryPipeline
 {
 public:
+	struct DrawStats
+	{
+		uint32_t drawCount = 0;
+		uint32_t instanceCount = 0;
+		uint32_t pipelineChanges = 0;
+		uint32_t indexBufferChanges = 0;
+		uint32_t stateChangesAvoided = 0;
+		uint32_t indirectExecutions = 0;
+		uint32_t rootConstantDwords = 0;
+
+		uint32_t fallbackDraws = 0;
+		uint32_t skippedDraws = 0; // no built variant could draw them
+		uint32_t pendingPipelines = 0;
+		uint32_t fallbackFrames = 0; // since startup
+	};
+
 	GeometryPipeline(Renderer& renderer, std::shared_ptr<Camera>& camera);
 	~GeometryPipeline();
 
-	void PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList);
+	// Simulation graph, after the camera and Update(): culls the scene from the camera and collects the visible draws
+	// into the packet. Sorting them is a stage of its own.
+	void BuildFramePacket(FramePacket& packet);
+	// Render graph: records the packet's draws. Everything it touches besides the packet is only used by this pass.
+	void PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const FramePacket& packet);
+	// Simulation graph, propagates the scene's transforms.
 	void Update(float deltaTime);
+
+	// Records every pipeline's draws with a single ExecuteIndirect instead of one API call per draw.
+	void SetIndirectDraws(bool enabled) { _useIndirectDraws = enabled; }
+	bool GetIndirectDraws() const { return _useIndirectDraws; }
+
+	// Rejects objects hidden behind large occluders with a CPU rasterized depth buffer before submission.
+	void SetOcclusionCulling(bool enabled) { _useOcclusionCulling = enabled; }
+	bool GetOcclusionCulling() const { return _useOcclusionCulling; }
+
+	// Of the last recorded frame, render thread only.
+	const DrawStats& GetDrawStats() const { return _drawStats; }
+	// Main thread only.
+	Scene& GetScene() { return _scene; }
 private:
 	Renderer& _renderer;
 	std::shared_ptr<Camera> _camera;
 
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> _pipelineState{};
+	Util::ShaderPermutations _shaderPermutations;
+	// Indexed by variant, the DrawPacket pipeline. Null until a draw first needs it and its build finishes.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> _pipelineStates;
+
+	// Variants are built on a worker thread, draws use the closest built variant until theirs is done. The base variant
+	// can draw any opaque material, just untextured, and the alpha tested one any cutout, so both are built up front.
+	static constexpr uint32_t FALLBACK_VARIANT = 0;
+	// The shader only clips in textured variants, a cutout's stand-in needs both features or it draws solid.
+	static constexpr uint32_t CUTOUT_FEATURES = MaterialFeature::TEXTURED | MaterialFeature::ALPHA_TESTED;
+	static constexpr uint32_t ALPHA_TESTED_FALLBACK_VARIANT = CUTOUT_FEATURES;
+	// Draws without any built variant that can stand in are skipped.
+	static constexpr uint32_t NO_VARIANT = UINT32_MAX;
+	struct PendingPipeline
+	{
+		std::future<Microsoft::WRL::ComPtr<ID3D12PipelineState>> pipelineState{};
+		std::chrono::high_resolution_clock::time_point requestTime{};
+		bool requested = false;
+	};
+	std::vector<PendingPipeline> _pendingPipelines; // by variant
+	std::vector<uint32_t> _drawVariants; // by variant, the one its draws use this frame
+	uint32_t _fallbackFrames = 0;
+	// Dwords of RenderResources the variant's shaders read, from reflection.
+	std::vector<std::atomic<uint32_t>> _rootConstantCounts;
+
+	struct IndirectCommand
+	{
+		IndirectDraw::Layout layout{};
+		Microsoft::WRL::ComPtr<ID3D12CommandSignature> signature{};
+	};
+	std::map<uint32_t, IndirectCommand> _indirectCommands; // by root constant count
+	std::vector<uint8_t> _indirectArguments;
+	bool _useIndirectDraws = false;
 
 	std::vector<Model> _models;
+	Scene _scene;
+	Culling::OcclusionBuffer _occlusionBuffer;
+	bool _useOcclusionCulling = true;
+	DrawStats _drawStats;
 
-	void CreatePipeline();
+	// Starts building the variants this frame's draws use for the first time and picks what every variant draws with.
+	void RequestPipelines(const DrawList& drawList);
+	// Takes the variants whose build finished since the last frame.
+	void ApplyFinishedPipelines();
+	// The built variant with the most of variant's features and none it lacks, NO_VARIANT if there is none.
+	uint32_t FindStandIn(uint32_t variant) const;
+	void ApplyPipeline(uint32_t variant, Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState);
+	// Compiles the shaders as they are on disk, called from worker threads and the shader watcher thread.
+	// Throws when the shaders' root constants don't match RenderResources.
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> BuildPipelineState(uint32_t variant);
+	const IndirectCommand& GetIndirectCommand(uint32_t rootConstantCount);
 	void InitializeAssets();
+
+	void RecordDraws(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const DrawList& drawList);
+	void RecordIndirectDraws(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const DrawList& drawList);
+	RenderResources WriteInstances(const DrawList& drawList, size_t first, uint32_t instanceCount);
 };
\ No newline at end of file
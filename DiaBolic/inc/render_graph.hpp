@@ -0,0 +1,73 @@
+#pragma once
+
+#include "utility/render_graph_compiler.hpp"
+
+#include <functional>
+
+// The frame's passes and the resources they read and write. Util::RenderGraphCompiler works out every barrier and where
+// the transient textures go from those declarations, this puts the result on the device: it creates the heaps and the
+// placed transient textures and records the barriers into each pass's command list.
+// Passes run in the order they were added. Compiling needs no device, Dump() shows the result headless.
+class RenderGraph
+{
+public:
+    using ResourceId = Util::RenderGraphCompiler::ResourceId;
+    using PassId = Util::RenderGraphCompiler::PassId;
+    using Stats = Util::RenderGraphCompiler::Stats;
+
+    using AllocationInfoFunction = std::function<D3D12_RESOURCE_ALLOCATION_INFO(const D3D12_RESOURCE_DESC&)>;
+
+    RenderGraph() = default;
+    ~RenderGraph() = default;
+
+    RenderGraph(const RenderGraph& other) = delete;
+    RenderGraph& operator=(const RenderGraph& other) = delete;
+
+    // A resource that lives outside the graph, like the back buffer. Left in finalState at the end of the frame.
+    ResourceId ImportResource(std::string name, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState);
+    // A texture only used within the frame. Its contents don't survive the frame, the first pass using it has to write it.
+    ResourceId CreateTexture(std::string name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clearValue = nullptr);
+
+    // Passes with the same commandList record into one command list, see Util::RenderGraphCompiler::AddPass().
+    PassId AddPass(std::string name, uint32_t commandList);
+    void Read(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state);
+    void Write(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state);
+
+    // Works out the barriers and where the transient textures are placed, once every pass is declared.
+    // getAllocationInfo sizes the textures, the device's GetResourceAllocationInfo or EstimateAllocationInfo without one.
+    void Compile(const AllocationInfoFunction& getAllocationInfo = EstimateAllocationInfo);
+    // Creates the heaps and the placed transient textures, after Compile().
+    void CreateTransientResources(ID3D12Device* device);
+
+    // Imported resources can change every frame, the back buffer does.
+    void SetImportedResource(ResourceId resource, ID3D12Resource* d3dResource);
+    [[nodiscard]] ID3D12Resource* GetResource(ResourceId resource) const;
+
+    // Records the barriers due before the pass in one call, then discards the transients the pass activates.
+    // GetPassCount() records the barriers that end the frame. Safe to call for different passes at the same time.
+    void RecordBarriers(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, uint32_t pass) const;
+
+    [[nodiscard]] uint32_t GetPassCount() const { return _compiler.GetPassCount(); }
+    [[nodiscard]] const Stats& GetStats() const { return _compiler.GetStats(); }
+    // Every pass with its barriers, the heap layout and the stats.
+    [[nodiscard]] std::string Dump() const;
+
+    // Sizes a texture from its format and dimensions with 64KB alignment, close to what drivers report.
+    [[nodiscard]] static D3D12_RESOURCE_ALLOCATION_INFO EstimateAllocationInfo(const D3D12_RESOURCE_DESC& desc);
+
+private:
+    struct Resource
+    {
+        ID3D12Resource* importedResource = nullptr;
+
+        // Transient.
+        D3D12_RESOURCE_DESC desc{};
+        D3D12_CLEAR_VALUE clearValue{};
+        bool hasClearValue = false;
+        Microsoft::WRL::ComPtr<ID3D12Resource> transientResource;
+    };
+
+    Util::RenderGraphCompiler _compiler;
+    std::vector<Resource> _resources; // by ResourceId
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> _heaps; // as the compiler laid them out
+};
@@ -1,11 +1,24 @@
 #pragma once
 
+#include "render_graph.hpp"
+#include "task_graph.hpp"
+
+#include <condition_variable>
+#include <thread>
+
 class Application;
 class GeometryPipeline;
 class UIPipeline;
 class CommandQueue;
 class DescriptorHeap;
+class UploadHeap;
+class GpuAllocator;
+class GeometryBuffer;
+class ResidencyManager;
+class ShaderHotReload;
+class PipelineCache;
 struct Camera;
+struct FramePacket;
 
 class Renderer
 {
@@ -13,11 +26,20 @@ public:
 	Renderer(std::shared_ptr<Application> app);
 	~Renderer();
     
+    // Simulates a frame and hands it to the render thread as a frame packet, so the next frame can be simulated while
+    // this one is recorded and submitted. Waits when the render thread is still busy with the previous packet.
+    // The simulation runs as a task graph: camera and transform propagation at the same time, then culling and sorting.
     void Update(float deltaTime, GLFWwindow* window);
-	void Render();
 
     // Getters
     CommandQueue& GetCopyCommandQueue() { return *_copyCommandQueue; }
+    UploadHeap& GetUploadHeap() { return *_uploadHeap; }
+    GpuAllocator& GetGpuAllocator() { return *_gpuAllocator; }
+    GeometryBuffer& GetGeometryBuffer() { return *_geometryBuffer; }
+    ResidencyManager& GetResidencyManager() { return *_residencyManager; }
+    ShaderHotReload& GetShaderHotReload() { return *_shaderHotReload; }
+    PipelineCache& GetPipelineCache() { return *_pipelineCache; }
+    D3D12_GPU_VIRTUAL_ADDRESS GetViewResourcesAddress() const { return _viewResourcesAddress; }
     Microsoft::WRL::ComPtr<ID3D12Device2>& GetDevice() { return _device; }
     Microsoft::WRL::ComPtr<ID3D12RootSignature>& GetBindlessRootSignature() { return _bindlessRootSignature; }
     float GetAspectRatio() { return _aspectRatio; }
@@ -27,16 +49,54 @@ public:
 	[[nodiscard]] uint32_t CreateUav(const D3D12_UNORDERED_ACCESS_VIEW_DESC& uavCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const;
 	[[nodiscard]] uint32_t CreateRtv(const D3D12_RENDER_TARGET_VIEW_DESC& rtvCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const;
 	[[nodiscard]] uint32_t CreateDsv(const D3D12_DEPTH_STENCIL_VIEW_DESC& dsvCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const;
+    // Hands an index from CreateSrv() back for reuse, once the GPU has finished every frame submitted so far.
+    void RetireSrv(uint32_t srvIndex);
+    // Rewrites an SRV created before, a null resource makes it a null view. Only while the GPU isn't using it.
+    void UpdateSrv(uint32_t srvIndex, const D3D12_SHADER_RESOURCE_VIEW_DESC& srvCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const;
     
+    // Keeps the object alive until the GPU has finished every frame submitted so far, including the one being recorded.
+    void DeferRelease(Microsoft::WRL::ComPtr<IUnknown> object);
+    // Calls release on the render thread once the GPU has finished the same frames, for memory that isn't a COM object.
+    // Runs when the renderer shuts down at the latest.
+    void DeferRelease(std::function<void()> release);
+
     void Flush();
     
 private:
+    // Records a pass into its own command list, at the same time as the other passes.
+    using RecordFunction = std::function<void(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>&, const FramePacket&)>;
+    struct RenderPass
+    {
+        std::string name;
+        RecordFunction record;
+    };
+
+    // GLFW can only be read on the main thread, the camera task works from this.
+    struct CameraInput
+    {
+        double cursorPosX = 0.0;
+        double cursorPosY = 0.0;
+        bool rotate = false;
+        bool fast = false;
+        bool forward = false;
+        bool back = false;
+        bool left = false;
+        bool right = false;
+        bool down = false;
+        bool up = false;
+    };
+
     std::shared_ptr<Application> _app;
     std::shared_ptr<Camera> _camera;
     DirectX::XMFLOAT2 _previousMousePos = DirectX::XMFLOAT2(0.0f, 0.0f);
 
+    // Before the pipelines, so they outlive the meshes and textures the pipelines own.
+    std::unique_ptr<GpuAllocator> _gpuAllocator;
+    std::unique_ptr<GeometryBuffer> _geometryBuffer;
+    std::unique_ptr<ResidencyManager> _residencyManager;
     std::unique_ptr<GeometryPipeline> _geometryPipeline;
     std::unique_ptr<UIPipeline> _uiPipeline;
+    std::unique_ptr<ShaderHotReload> _shaderHotReload;
 
     UINT _width;
     UINT _height;
@@ -52,22 +112,62 @@ private:
     std::unique_ptr<CommandQueue> _directCommandQueue;
     std::unique_ptr<CommandQueue> _copyCommandQueue;
 
+    std::unique_ptr<PipelineCache> _pipelineCache;
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> _bindlessRootSignature{};
 
     Microsoft::WRL::ComPtr<ID3D12Resource> _renderTargets[FRAME_COUNT];
 	uint32_t _renderTargetIndex[FRAME_COUNT];
-    Microsoft::WRL::ComPtr<ID3D12Resource> _depthTarget;
 	uint32_t _depthTargetIndex;
 
 	std::unique_ptr<DescriptorHeap> _rtvHeap;
 	std::unique_ptr<DescriptorHeap> _dsvHeap;
 	std::unique_ptr<DescriptorHeap> _srvHeap;
+    mutable std::mutex _srvMutex;
+    mutable std::vector<uint32_t> _retiredSrvIndices; // the GPU is done with them
 	std::unique_ptr<DescriptorHeap> _samplerHeap;
 
+    std::unique_ptr<UploadHeap> _uploadHeap;
+    D3D12_GPU_VIRTUAL_ADDRESS _viewResourcesAddress = 0;
+
     UINT _frameIndex;
     uint64_t _fenceValues[FRAME_COUNT] = {};
+
+    struct DeferredRelease
+    {
+        uint64_t fenceValue;
+        std::function<void()> release;
+    };
+    std::mutex _releaseMutex;
+    std::vector<std::function<void()>> _releasesThisFrame;
+    std::queue<DeferredRelease> _deferredReleases;
+
+    // The render thread draws one packet while the other waits for it. The simulation fills a packet of its own, which
+    // is swapped in once a slot is free, so it doesn't have to wait for the render thread before it starts.
+    static constexpr uint32_t FRAME_PACKET_COUNT = 2;
+    static constexpr uint32_t NO_PACKET = UINT32_MAX;
+    std::unique_ptr<FramePacket> _framePackets[FRAME_PACKET_COUNT];
+    std::unique_ptr<FramePacket> _simulationPacket; // main thread only
+    uint64_t _frameNumber = 0;
+    std::mutex _packetMutex;
+    std::condition_variable_any _packetCondition;
+    uint32_t _submittedPacket = NO_PACKET; // waiting for the render thread
+    uint32_t _renderingPacket = NO_PACKET;
+    std::jthread _renderThread;
+
+    TaskGraph _simulationGraph; // main thread only
+    TaskGraph _renderTasks; // render thread only
+    std::vector<RenderPass> _renderPasses; // by render graph pass
+
+    RenderGraph _renderGraph;
+    RenderGraph::ResourceId _backBuffer = 0;
+    RenderGraph::ResourceId _depthBuffer = 0;
+
     const float clearColor[4] = { 255.0f / 255.0f, 182.0f / 255.0f, 193.0f / 255.0f, 1.0f }; // pink :)
     bool _useWarpDevice;
+    float _statsTimer = 0.0f;
+    float _recordMilliseconds = 0.0f;
+    bool _indirectKeyDown = false;
+    bool _occlusionKeyDown = false;
 
 	void InitializeCore();
 	void InitializeCommandQueues();
@@ -75,8 +175,27 @@ private:
     void InitializeSwapchainResources();
 
 	void CreateRenderTargets();
-	void CreateDepthTarget();
+	void CreateRenderGraph();
 	void CreateBindlessRootSignature();
 
 	void SetDescriptorHeaps(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList) const;
+
+    CameraInput ReadCameraInput(GLFWwindow* window) const;
+    void UpdateCamera(const CameraInput& input, float deltaTime, FramePacket& packet);
+    // Waits for a free slot and hands the simulation's packet to the render thread.
+    void SubmitFramePacket();
+    void RenderLoop(std::stop_token stopToken);
+
+    // Passes become nodes of the task graph recording the frame, add them before the render thread starts and declare
+    // what they use on the render graph.
+    RenderGraph::PassId AddRenderPass(std::string name, RecordFunction record);
+    // Render thread only, like everything it calls.
+    void Render(const FramePacket& packet);
+    // Binds the heaps and targets every pass draws with.
+    void BeginPass(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList) const;
+    void UpdateViewResources(const FramePacket& packet);
+    void ReleaseCompletedObjects();
+    // A descriptor slot in the SRV heap, retired ones first.
+    [[nodiscard]] uint32_t AllocateSrvIndex() const;
+    void LogStats(const FramePacket& packet) const;
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "gpu_allocator.hpp"
+#include "utility/residency_policy.hpp"
+
+#include <future>
+
+class Renderer;
+struct Texture;
+struct FramePacket;
+
+// Keeps the textures in video memory within a budget. Textures the frames stop drawing are evicted, least recently
+// used first, and loaded from their file again once a frame draws them. An evicted texture draws as a null view until
+// it is back, materials only know it by its Texture.
+// The geometry buffer counts against the budget but is never evicted, it holds every mesh.
+class ResidencyManager
+{
+public:
+    struct Stats
+    {
+        Util::ResidencyPolicy::Stats policy;
+        // What the adapter gives this process, for everything and not just what is tracked here.
+        uint64_t localBudget = 0;
+        uint64_t localUsage = 0;
+        uint32_t loadingRestores = 0; // decoding or copying
+    };
+
+    // The budget is clamped to what the adapter gives this process.
+    ResidencyManager(Renderer& renderer, uint64_t budget);
+    ~ResidencyManager();
+
+    ResidencyManager(const ResidencyManager& other) = delete;
+    ResidencyManager& operator=(const ResidencyManager& other) = delete;
+
+    // Of a loaded texture, until it is destroyed.
+    void Track(Texture& texture);
+    void Untrack(Texture& texture);
+    // Memory that is never evicted but should count against the budget.
+    void AddPinned(uint64_t size);
+
+    // Render thread, before the frame's passes record. Marks the textures the packet draws with as used, then evicts
+    // and starts restores. A restore is decoded on the job system and copied on the copy queue, the texture is swapped
+    // in by the first Update() after the copy is done. Never waits on either.
+    void Update(const FramePacket& packet);
+    // Waits for every restore still loading, at shutdown.
+    void FinishRestores();
+
+    void SetBudget(uint64_t budget);
+    [[nodiscard]] Stats GetStats() const;
+
+private:
+    struct PendingRestore
+    {
+        Texture* texture = nullptr; // null once it was evicted or untracked again, the copy is thrown away
+        Util::ResidencyPolicy::ResourceId resource = Util::ResidencyPolicy::NO_RESOURCE;
+
+        // The job fills the list and the allocations, they are only touched here once it is done.
+        std::future<void> load;
+        Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList;
+        GpuAllocation allocation;
+        GpuAllocation intermediate;
+        uint64_t fenceValue = 0; // copy queue, 0 until executed
+    };
+
+    // Under _mutex. Executes the restores that are decoded and swaps in the ones that are copied. wait blocks until
+    // all of them are, only for FinishRestores().
+    void ProcessRestores(bool wait);
+
+    Renderer& _renderer;
+    Microsoft::WRL::ComPtr<IDXGIAdapter3> _adapter;
+
+    mutable std::mutex _mutex;
+    Util::ResidencyPolicy _policy;
+    std::vector<Texture*> _textures; // by resource id, null for pinned memory
+    std::vector<std::unique_ptr<PendingRestore>> _pendingRestores; // the jobs keep a pointer
+};
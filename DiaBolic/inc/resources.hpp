@@ -1,6 +1,9 @@
 #pragma once
 
 #include "../../assets/shaders/constant_buffers.hlsli"
+#include "culling.hpp"
+#include "geometry_buffer.hpp"
+#include "utility/residency_policy.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -8,57 +11,71 @@
 
 class Renderer;
 class Model;
+class ResidencyManager;
 struct Camera;
 
-struct Buffer
-{
-    Microsoft::WRL::ComPtr<ID3D12Resource> resource = NULL;
-
-    uint32_t srvIndex = 0;
-    uint32_t uavIndex = 0;
-    uint32_t cbvIndex = 0;
-};
-
 class Mesh
 {
 public:
     Mesh(Renderer& renderer, std::vector<DirectX::XMFLOAT3> positions, std::vector<DirectX::XMFLOAT3> normals, std::vector<DirectX::XMFLOAT2> uvs, std::vector<uint16_t> indices, unsigned int materialIndex);
-    ~Mesh() { }
+    ~Mesh();
 
-    uint32_t const& GetPositionBufferSRVIndex() { return _positionBuffer.srvIndex; }
-    uint32_t const& GetNormalBufferSRVIndex() { return _normalBuffer.srvIndex; }
-    uint32_t const& GetUVBufferSRVIndex() { return _uvBuffer.srvIndex; }
+    Mesh(const Mesh& other) = delete;
+    Mesh& operator=(const Mesh& other) = delete;
 
-    D3D12_INDEX_BUFFER_VIEW const& GetIndexBufferView() const { return _indexBufferView; }
-    uint32_t const& GetIndexCount() const { return _indexCount; }
+    // Where the mesh is in the renderer's GeometryBuffer, its indices are relative to the vertex offset.
+    uint32_t GetVertexOffset() const { return _geometry.vertexOffset; }
+    uint32_t GetFirstIndex() const { return _geometry.firstIndex; }
+    uint32_t const& GetIndexCount() const { return _geometry.indexCount; }
     uint32_t const& GetMaterialIndex() const { return _materialIndex; }
+    uint32_t GetId() const { return _id; }
+    Culling::Bounds const& GetBounds() const { return _bounds; }
+
+    // CPU copy of the geometry for software occlusion, empty for meshes too detailed to be an occluder.
+    bool IsOccluder() const { return !_occluderIndices.empty(); }
+    std::vector<DirectX::XMFLOAT3> const& GetOccluderPositions() const { return _occluderPositions; }
+    std::vector<uint16_t> const& GetOccluderIndices() const { return _occluderIndices; }
 
 private:
-    Buffer _positionBuffer;
-    Buffer _normalBuffer;
-    Buffer _uvBuffer;
-    Buffer _indexBuffer;
+    Renderer* _renderer = nullptr;
+    GeometryBuffer::Allocation _geometry;
 
-    D3D12_INDEX_BUFFER_VIEW _indexBufferView{};
-    DXGI_FORMAT _indexType = DXGI_FORMAT_R16_UINT;
+    Culling::Bounds _bounds{}; // object space
+    std::vector<DirectX::XMFLOAT3> _occluderPositions;
+    std::vector<uint16_t> _occluderIndices;
 
+    uint32_t _id = 0; // unique over all models, used for draw sorting
     uint32_t _materialIndex = 0;
-    uint32_t _indexCount = 0;
-    uint32_t _vertexCount = 0;
 };
 
 struct Texture
 {
     Texture(Renderer& renderer, std::string path);
     Texture(Renderer& renderer, aiTexture textureData);
-    ~Texture() { }
+    ~Texture();
+
+    Texture(const Texture& other) = delete;
+    Texture& operator=(const Texture& other) = delete;
+
+    // Called by the ResidencyManager. An evicted texture's srvIndex is a null view until the texture is loaded from its
+    // file again. Restore() takes the loaded copy once it executed, the view moves to a fresh index because frames in
+    // flight may still read the null one.
+    void Evict(Renderer& renderer);
+    void Restore(Renderer& renderer, GpuAllocation loaded);
+    bool IsResident() const { return allocation.IsValid(); }
 
-    Microsoft::WRL::ComPtr<ID3D12Resource> resource = NULL;
+    GpuAllocation allocation;
+    GpuAllocator* allocator = nullptr;
 
     uint32_t srvIndex = 0;
     uint32_t uavIndex = 0;
 
     std::string name = "";
+    std::string path = "";
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+
+    ResidencyManager* residencyManager = nullptr;
+    Util::ResidencyPolicy::ResourceId residencyId = Util::ResidencyPolicy::NO_RESOURCE;
 
     // TODO: get this somewhere.. or not
     int width = 0;
@@ -66,8 +83,17 @@ struct Texture
     int channels = 0;
 };
 
+// Shader features a material needs, they pick the geometry shader permutation.
+namespace MaterialFeature
+{
+    constexpr uint32_t TEXTURED = 1u << 0;
+    constexpr uint32_t ALPHA_TESTED = 1u << 1;
+}
+
 struct Material
 {
+    uint32_t id = 0; // unique over all models, used for draw sorting
+
     DirectX::XMFLOAT4 baseColorFactor = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);  // 16
     bool useBaseTexture = false;                                    // 4
 
@@ -87,6 +113,11 @@ struct Material
     bool isUnlit = false;  // 4
     bool recieveShadows = true;
 
+    bool alphaTested = false;
+    float alphaCutoff = 0.5f;
+
+    uint32_t shaderFeatures = 0; // MaterialFeature bits
+
     std::shared_ptr<Texture> baseColorTexture = nullptr;
     std::shared_ptr<Texture> emissiveTexture = nullptr;
     std::shared_ptr<Texture> normalTexture = nullptr;
@@ -94,49 +125,28 @@ struct Material
     std::shared_ptr<Texture> metallicRoughnessTexture = nullptr;
 };
 
-class Node
+class Model
 {
 public:
-    void Draw(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const std::shared_ptr<Camera> camera);
-
-    void SetMesh(std::shared_ptr<Mesh>& mesh) { _mesh = mesh; };
-    void SetMaterial(std::shared_ptr<Material>& material) { _material = material; }
-    void SetParent(std::shared_ptr<Node>& node) { _parent = node; }
-    void SetTransform(DirectX::XMMATRIX transform) { _transform = transform; }
-    void AddChild(std::shared_ptr<Node>& node) { _children.emplace_back(node); }
-
-    std::shared_ptr<Mesh> const& GetMesh() const { return _mesh; }
-    std::shared_ptr<Material> const& GetMaterial() const { return _material; }
-    DirectX::XMMATRIX const& GetTransform() const 
-    { 
-        if(_parent)
-        {
-            return _parent->GetTransform() * _transform;
-        }
-        return _transform; 
-    }
-
-private:
-    std::shared_ptr<Mesh> _mesh = nullptr;
-    std::shared_ptr<Material> _material = nullptr;
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
 
-    // TODO: Handle transforms differently?
-    DirectX::XMMATRIX _transform = DirectX::XMMatrixIdentity();
+    // Node of the model's hierarchy, flattened so parents come before their children.
+    struct Node
+    {
+        DirectX::XMFLOAT4X4 transform; // relative to the parent
+        uint32_t parent = NO_PARENT;
+        const Mesh* mesh = nullptr;
+        const Material* material = nullptr;
+    };
 
-    std::shared_ptr<Node> _parent = nullptr;
-    std::vector<std::shared_ptr<Node>> _children;
-};
-
-class Model
-{
-public:
     Model(Renderer& renderer, const std::string& fileName);
 
-    void Draw(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const std::shared_ptr<Camera> camera);
+    // Place the model in the world with Scene::Instantiate.
+    const std::vector<Node>& GetNodes() const { return _nodes; }
 
 private:
     void LoadModel(Renderer& renderer, const std::string& filePath);
-    void ProcessNode(Renderer& renderer, const aiScene& scene, aiNode& node, std::shared_ptr<Node> parentNode);
+    void ProcessNode(Renderer& renderer, const aiScene& scene, aiNode& node, uint32_t parentIndex);
     void ProcessMesh(Renderer& renderer, aiMesh& mesh);
     void ProcessMaterial(Renderer& renderer, aiMaterial& material);
     std::shared_ptr<Texture> LoadMaterialTexture(Renderer& renderer, aiMaterial& material, aiTextureType type);
@@ -144,7 +154,7 @@ private:
     std::vector<std::shared_ptr<Mesh>> _meshes;
     std::vector<std::shared_ptr<Material>> _materials;
     std::vector<std::shared_ptr<Texture>> _texturesLoaded; // TODO: move this to separate resource manager. this just exists to keep track of loaded textures
-    std::shared_ptr<Node> _rootNode;
+    std::vector<Node> _nodes;
 
     std::string _directory = "";
-};
\ No newline at end of file
+};
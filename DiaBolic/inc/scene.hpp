@@ -0,0 +1,107 @@
+#pragma once
+
+#include "culling.hpp"
+#include "bvh.hpp"
+#include "occlusion_buffer.hpp"
+#include "transform_hierarchy.hpp"
+
+#include <set>
+
+class Mesh;
+struct Material;
+class Model;
+class DrawList;
+
+// Every object in the world, stored as component arrays indexed by a dense entity slot.
+// Slots follow the transform hierarchy's order, so parents come before their children and every per frame pass is a
+// linear scan. Entities are referred to by generational handles that stay valid while slots move around underneath.
+// Slots of destroyed entities are reused by new ones that can go there without breaking that order.
+class Scene
+{
+public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    struct Entity
+    {
+        uint32_t index = INVALID_INDEX;
+        uint32_t generation = 0;
+
+        bool operator==(const Entity& other) const = default;
+    };
+
+    struct Stats
+    {
+        uint32_t entityCount = 0;
+        uint32_t slotCount = 0; // free ones included
+        size_t memoryBytes = 0; // of the component arrays and the BVH, capacity included
+        size_t bvhBytes = 0; // part of memoryBytes
+        size_t bytesPerEntity = 0;
+        float updateMilliseconds = 0.0f;
+    };
+
+    Scene() = default;
+
+    Scene(const Scene& other) = delete;
+    Scene& operator=(const Scene& other) = delete;
+
+    // parent has to be alive, or a default Entity for a root.
+    [[nodiscard]] Entity Create(const DirectX::XMMATRIX& local, Entity parent = Entity{ INVALID_INDEX, 0 }, const Mesh* mesh = nullptr, const Material* material = nullptr);
+    // Destroys the entity and all of its descendants.
+    void Destroy(Entity entity);
+    [[nodiscard]] bool IsAlive(Entity entity) const;
+
+    // Creates an entity per node of the model, returns the one of its root node.
+    Entity Instantiate(const Model& model, Entity parent = Entity{ INVALID_INDEX, 0 });
+
+    void SetLocalTransform(Entity entity, const DirectX::XMMATRIX& local);
+    [[nodiscard]] const DirectX::XMFLOAT4X4& GetWorldTransform(Entity entity) const;
+
+    // Resolves the world transforms and bounds of changed entities, and swaps in finished background BVH rebuilds or
+    // starts new ones when the tree has degraded.
+    void Update();
+
+    // Finds the entities inside the frustum. Large scenes walk the BVH, small ones test every box with CullFrustum.
+    void CullFrustum(const Culling::Frustum& frustum);
+    // Rasterizes the visible entities that cover the most screen space, returns how many were drawn.
+    uint32_t RasterizeOccluders(Culling::OcclusionBuffer& occlusionBuffer, const DirectX::XMMATRIX& viewProjection);
+    // Drops visible entities hidden in the occlusion buffer, returns how many were dropped.
+    uint32_t CullOccluded(const Culling::OcclusionBuffer& occlusionBuffer, const DirectX::XMMATRIX& viewProjection);
+    // Adds the entities that survived culling to the draw list.
+    void CollectDraws(DrawList& drawList, const DirectX::XMMATRIX& view) const;
+
+    [[nodiscard]] size_t GetRenderableCount() const { return _renderableCount; }
+    [[nodiscard]] size_t GetVisibleCount() const { return _visible.size(); }
+    [[nodiscard]] const Stats& GetStats() const { return _stats; }
+    [[nodiscard]] const Bvh::Stats& GetBvhStats() const { return _bvh.GetStats(); }
+    [[nodiscard]] const TransformHierarchy::Stats& GetTransformStats() const { return _transforms.GetStats(); }
+
+private:
+    struct Handle
+    {
+        uint32_t slot = INVALID_INDEX;
+        uint32_t generation = 0;
+    };
+
+    void UpdateWorldBounds(uint32_t firstSlot, uint32_t slotCount);
+
+    // Handle index to slot, with a generation to catch stale handles.
+    std::vector<Handle> _handles;
+    std::vector<uint32_t> _freeHandles;
+
+    // Components, indexed by slot.
+    TransformHierarchy _transforms;
+    std::vector<const Mesh*> _meshes;
+    std::vector<const Material*> _materials;
+    std::vector<uint32_t> _bvhProxies;
+    std::vector<uint32_t> _handleOfSlot; // INVALID_INDEX once destroyed
+    Culling::BoundsSoA _worldBounds;
+    std::set<uint32_t> _freeSlots; // sorted, so a new entity can take the first one after its parent
+
+    Bvh _bvh; // userData is the slot
+    size_t _renderableCount = 0;
+
+    std::vector<uint32_t> _visible; // slots that survived culling this frame
+    std::vector<std::pair<float, uint32_t>> _occluderCandidates; // scratch
+
+    Stats _stats;
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <thread>
+
+class Renderer;
+
+// Watches the shader directory and rebuilds the pipelines whose shaders, or anything they include, changed on disk.
+// Rebuilds happen on the watcher thread, the new pipeline states are swapped in by ApplyPendingReloads() between frames
+// and the old ones are released once the GPU is done with them.
+class ShaderHotReload
+{
+public:
+    // Builds a new pipeline state from the shaders as they are on disk now, throws when it can't.
+    using BuildFunction = std::function<Microsoft::WRL::ComPtr<ID3D12PipelineState>()>;
+
+    ShaderHotReload(Renderer& renderer);
+    ~ShaderHotReload();
+
+    ShaderHotReload(const ShaderHotReload& other) = delete;
+    ShaderHotReload& operator=(const ShaderHotReload& other) = delete;
+
+    // target is overwritten on reload, so it has to outlive this object or the registration.
+    void Register(std::vector<std::wstring> shaderPaths, Microsoft::WRL::ComPtr<ID3D12PipelineState>& target, BuildFunction build);
+
+    // Swaps in the pipeline states rebuilt since the last call. Call at a frame boundary, before recording.
+    void ApplyPendingReloads();
+
+private:
+    struct Pipeline
+    {
+        std::vector<std::wstring> shaderPaths;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState>* target;
+        BuildFunction build;
+    };
+
+    struct Reload
+    {
+        size_t pipeline;
+        Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+    };
+
+    void WatchLoop(std::stop_token stopToken);
+    // Files that were added or written since the last scan.
+    std::vector<std::filesystem::path> ScanForChanges();
+    // Maps every file the pipeline's shaders include to the pipeline, call with _mutex held.
+    void UpdateDependencies(size_t pipeline);
+
+    Renderer& _renderer;
+    std::filesystem::path _directory;
+
+    std::mutex _mutex;
+    std::vector<Pipeline> _pipelines;
+    std::map<std::filesystem::path, std::vector<size_t>> _dependents; // file to the pipelines that include it
+    std::vector<Reload> _pendingReloads;
+
+    std::map<std::filesystem::path, std::filesystem::file_time_type> _writeTimes; // watcher thread only
+
+    std::condition_variable_any _wakeUp;
+    std::jthread _watcher; // last, so it stops before the rest is destroyed
+};
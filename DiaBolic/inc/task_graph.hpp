@@ -0,0 +1,70 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <chrono>
+#include <exception>
+#include <initializer_list>
+
+// The stages of a frame and what each of them waits for, declared again every frame. Tasks whose dependencies are done
+// run on the job system at the same time, the thread calling Execute() helps out until all of them finished.
+// Every task is timed, the chain of dependent tasks that took longest is the critical path: the graph can't finish
+// sooner than that however many threads it gets.
+class TaskGraph
+{
+public:
+    using TaskId = uint32_t;
+
+    struct Stats
+    {
+        uint32_t taskCount = 0;
+        float milliseconds = 0.0f; // from the start of Execute() until the last task finished
+        float workMilliseconds = 0.0f; // all tasks added up
+        float criticalPathMilliseconds = 0.0f;
+        std::string criticalPath; // task names, first to last
+    };
+
+    TaskGraph() = default;
+
+    TaskGraph(const TaskGraph& other) = delete;
+    TaskGraph& operator=(const TaskGraph& other) = delete;
+
+    // A task can only depend on tasks added before it, so the graph never has cycles.
+    TaskId AddTask(std::string name, std::function<void()> function, std::initializer_list<TaskId> dependencies = {});
+    TaskId AddTask(std::string name, std::function<void()> function, const std::vector<TaskId>& dependencies);
+
+    // Runs every task once. When tasks throw, the tasks depending on them are skipped and the first exception is
+    // rethrown once the rest finished.
+    void Execute();
+    // Removes all tasks, the graph is declared from scratch for the next frame.
+    void Clear();
+
+    // Of the last Execute().
+    [[nodiscard]] const Stats& GetStats() const { return _stats; }
+
+private:
+    static constexpr TaskId NO_TASK = UINT32_MAX;
+
+    struct Task
+    {
+        std::string name;
+        std::function<void()> function;
+        std::vector<TaskId> dependencies;
+        std::vector<TaskId> dependents;
+        std::atomic<uint32_t> remainingDependencies = 0;
+        std::atomic<bool> failed = false; // it or one of its dependencies threw
+        std::chrono::high_resolution_clock::time_point start{};
+        std::chrono::high_resolution_clock::time_point end{};
+    };
+
+    void RunTask(TaskId id);
+    void MeasureCriticalPath(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end);
+
+    std::vector<std::unique_ptr<Task>> _tasks; // by id, tasks hold atomics so they can't move
+    JobSystem::Counter _counter;
+
+    std::mutex _exceptionMutex;
+    std::exception_ptr _exception;
+
+    Stats _stats;
+};
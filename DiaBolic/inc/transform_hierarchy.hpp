@@ -0,0 +1,63 @@
+#pragma once
+
+// Scene graph transforms flattened into arrays.
+// Parents are always stored before their children, so world matrices are resolved in one linear pass without
+// recursion or pointer chasing. Matrices use DirectXMath's row-vector convention: world = local * parent world.
+// Changing a local matrix marks it dirty, and only dirty nodes and their descendants are recomputed.
+class TransformHierarchy
+{
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    // Run of consecutive nodes whose world matrix changed.
+    struct Range
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    struct Stats
+    {
+        uint32_t nodesScanned = 0; // dirty flags checked by the last update
+        uint32_t nodesTouched = 0; // world matrices recomputed by the last update
+    };
+
+    void Clear();
+    void Reserve(size_t count);
+
+    // parent has to be added before its children, which keeps the arrays topologically sorted.
+    [[nodiscard]] uint32_t Add(const DirectX::XMMATRIX& local, uint32_t parent = NO_PARENT);
+    // Gives a node that is no longer used a new local matrix and parent, which still has to come before it.
+    void Reuse(uint32_t index, const DirectX::XMMATRIX& local, uint32_t parent = NO_PARENT);
+
+    void SetLocal(uint32_t index, const DirectX::XMMATRIX& local);
+
+    // Recomputes the world matrices of dirty nodes and their descendants, returns whether any changed.
+    // Costs nothing when no local matrix changed since the last call.
+    bool UpdateWorld();
+
+    // World matrices changed by the last UpdateWorld(), sorted and merged into runs, for limiting uploads and refits.
+    [[nodiscard]] const std::vector<Range>& GetChangedRanges() const { return _changedRanges; }
+    [[nodiscard]] const Stats& GetStats() const { return _stats; }
+
+    [[nodiscard]] size_t GetCount() const { return _parents.size(); }
+    [[nodiscard]] uint32_t GetParent(uint32_t index) const { return _parents[index]; }
+    [[nodiscard]] const DirectX::XMFLOAT4X4& GetLocal(uint32_t index) const { return _local[index]; }
+    // Only valid after UpdateWorld().
+    [[nodiscard]] const DirectX::XMFLOAT4X4& GetWorld(uint32_t index) const { return _world[index]; }
+    // Heap bytes held by the arrays, capacity included.
+    [[nodiscard]] size_t GetMemoryUsage() const;
+
+private:
+    void MarkDirty(uint32_t index);
+
+    std::vector<uint32_t> _parents;
+    std::vector<DirectX::XMFLOAT4X4> _local;
+    std::vector<DirectX::XMFLOAT4X4> _world;
+    std::vector<uint8_t> _dirty;
+
+    // Nothing before this index is dirty, NO_PARENT when nothing is.
+    uint32_t _firstDirty = NO_PARENT;
+    std::vector<Range> _changedRanges;
+    Stats _stats;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+
+class Renderer;
+
+// Piece of the upload buffer handed out for the current frame.
+struct UploadAllocation
+{
+    void* cpuAddress = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0;
+
+    // Byte offset into the whole upload buffer, use together with UploadHeap::GetSrvIndex() for bindless access.
+    uint32_t offset = 0;
+    uint32_t size = 0;
+};
+
+// Linear allocator over a persistently mapped upload buffer.
+// The buffer is split in FRAME_COUNT partitions, a partition is reset once its frame's fence has retired.
+// Allocate and Write can be called from several threads at once, passes record in parallel.
+class UploadHeap
+{
+public:
+    struct Stats
+    {
+        uint64_t bytesAllocated = 0;
+        uint64_t bytesWritten = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    UploadHeap(Renderer& renderer, uint32_t frameSize);
+    ~UploadHeap();
+
+    UploadHeap(const UploadHeap& other) = delete;
+    UploadHeap& operator=(const UploadHeap& other) = delete;
+
+    // Only call this after the fence of frameIndex has been waited on.
+    void BeginFrame(uint32_t frameIndex);
+    // Fences the streaming stores, call before executing the command list that reads this frame's data.
+    void EndFrame();
+    // Streaming stores are only fenced for the thread that fences them. Threads other than the one calling EndFrame()
+    // call this once they're done writing.
+    void FenceWrites() const;
+
+    [[nodiscard]] UploadAllocation Allocate(uint32_t size, uint32_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    // Copies data into an allocation with streaming stores, upload memory is write-combined so never read it back.
+    void Write(const UploadAllocation& allocation, const void* data, size_t size, uint32_t byteOffset = 0);
+
+    template<typename T>
+    [[nodiscard]] UploadAllocation Push(const T& data, uint32_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT)
+    {
+        UploadAllocation allocation = Allocate(static_cast<uint32_t>(sizeof(T)), alignment);
+        Write(allocation, &data, sizeof(T));
+        return allocation;
+    }
+
+    [[nodiscard]] ID3D12Resource* GetResource() const { return _resource.Get(); }
+    // Raw (ByteAddressBuffer) view over the whole buffer.
+    [[nodiscard]] uint32_t GetSrvIndex() const { return _srvIndex; }
+    [[nodiscard]] uint32_t GetFrameSize() const { return _frameSize; }
+
+    // Stats of the last frame that called EndFrame().
+    [[nodiscard]] const Stats& GetLastFrameStats() const { return _lastFrameStats; }
+
+private:
+    Microsoft::WRL::ComPtr<ID3D12Resource> _resource;
+    uint8_t* _mappedData = nullptr;
+    D3D12_GPU_VIRTUAL_ADDRESS _gpuAddress = 0;
+    uint32_t _srvIndex = 0;
+
+    uint32_t _frameSize = 0;
+    uint32_t _frameStart = 0;
+    std::atomic<uint32_t> _currentOffset = 0;
+
+    // This frame's Stats.
+    std::atomic<uint64_t> _bytesAllocated = 0;
+    std::atomic<uint64_t> _bytesWritten = 0;
+    std::atomic<uint32_t> _allocationCount = 0;
+    Stats _lastFrameStats{};
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <type_traits>
+
+namespace Util
+{
+    constexpr uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+    constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+    // 64 bit FNV-1a, pass the previous result as hash to continue hashing.
+    inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    uint64_t HashValue(const T& value, uint64_t hash = FNV_OFFSET_BASIS)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Only hash plain data.");
+        return HashBytes(&value, sizeof(T), hash);
+    }
+
+    inline uint64_t HashString(std::wstring_view string, uint64_t hash = FNV_OFFSET_BASIS)
+    {
+        // Include the length so consecutive strings can't run into each other.
+        hash = HashValue(string.size(), hash);
+        return HashBytes(string.data(), string.size() * sizeof(wchar_t), hash);
+    }
+}
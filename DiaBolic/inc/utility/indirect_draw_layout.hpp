@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// The device independent half of IndirectDraw: where a command's arguments go in the argument buffer and packing them.
+// Every command sets a block of root constants, then draws indexed instanced from the index buffer bound beforehand.
+namespace IndirectDraw
+{
+    // Same layout as D3D12_DRAW_INDEXED_ARGUMENTS, indirect_draw.cpp checks that they match.
+    struct DrawIndexedArguments
+    {
+        uint32_t indexCountPerInstance = 0;
+        uint32_t instanceCount = 0;
+        uint32_t startIndexLocation = 0;
+        int32_t baseVertexLocation = 0;
+        uint32_t startInstanceLocation = 0;
+    };
+
+    struct Layout
+    {
+        uint32_t rootParameterIndex = 0;
+        uint32_t rootConstantCount = 0;
+
+        uint32_t constantsOffset = 0;
+        uint32_t drawArgumentsOffset = 0;
+        uint32_t byteStride = 0;
+    };
+
+    [[nodiscard]] Layout MakeLayout(uint32_t rootParameterIndex, uint32_t rootConstantCount);
+
+    // Writes one command of layout.byteStride bytes to destination, padding included.
+    void PackCommand(const Layout& layout, uint8_t* destination, const void* rootConstants, const DrawIndexedArguments& drawArguments);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace Util
+{
+    // Hashes everything that affects the compiled pipeline: shader bytecode by content, every fixed function state and the
+    // input layout by value, so equal descriptions built in different places hash the same. Pointers, padding and state
+    // the description disables (render targets past NumRenderTargets, blend targets past the first without independent
+    // blending, CachedPSO) are left out. The root signature can't be read back from the object, pass a hash of its
+    // serialized blob.
+    [[nodiscard]] uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash);
+
+    [[nodiscard]] uint64_t HashShaderBytecode(const D3D12_SHADER_BYTECODE& bytecode, uint64_t hash);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+namespace Util
+{
+    // The bookkeeping behind PipelineCache without the device: one shared object per description hash, handed out to
+    // any number of owners and forgotten once the last of them gave it back. A replaced pipeline is released by its
+    // owner after the new one was acquired, so a reload that hashes the same keeps the object alive.
+    // Pointer is a smart pointer, ComPtr in the renderer. Not thread safe, PipelineCache locks around it.
+    template<typename Pointer>
+    class PipelineStore
+    {
+    public:
+        using Object = typename std::pointer_traits<Pointer>::element_type;
+
+        // Adds an owner to the object stored under key, null when there is none.
+        [[nodiscard]] Pointer Acquire(uint64_t key);
+
+        // Stores object under key with one owner. When another object got stored under key first, that one gets the
+        // owner and is returned instead, inserted tells which happened.
+        Pointer Insert(uint64_t key, Pointer object, bool& inserted);
+
+        // Takes one owner away, true once it was the last and the store let go of the object.
+        bool Release(const Object* object);
+
+        // 0 when nothing is stored under key.
+        [[nodiscard]] uint32_t GetOwners(uint64_t key) const;
+        [[nodiscard]] size_t GetCount() const { return _entries.size(); }
+
+        // Walks everything, for tests: both lookups agree and every stored object has an owner.
+        [[nodiscard]] bool Validate() const;
+
+    private:
+        struct Entry
+        {
+            Pointer object;
+            uint32_t owners = 0;
+        };
+
+        std::unordered_map<uint64_t, Entry> _entries;
+        std::unordered_map<const Object*, uint64_t> _keys;
+    };
+}
+
+template<typename Pointer>
+Pointer Util::PipelineStore<Pointer>::Acquire(uint64_t key)
+{
+    const auto entry = _entries.find(key);
+    if(entry == _entries.end())
+    {
+        return nullptr;
+    }
+    entry->second.owners++;
+    return entry->second.object;
+}
+
+template<typename Pointer>
+Pointer Util::PipelineStore<Pointer>::Insert(uint64_t key, Pointer object, bool& inserted)
+{
+    assert(object && "Storing a null pipeline.");
+
+    const Object* address = std::to_address(object);
+    const auto [entry, emplaced] = _entries.try_emplace(key, Entry{ .object = std::move(object) });
+    entry->second.owners++;
+    if(emplaced)
+    {
+        _keys[address] = key;
+    }
+    inserted = emplaced;
+    return entry->second.object;
+}
+
+template<typename Pointer>
+bool Util::PipelineStore<Pointer>::Release(const Object* object)
+{
+    const auto key = _keys.find(object);
+    assert(key != _keys.end() && "Pipeline wasn't created through the pipeline cache.");
+    if(key == _keys.end())
+    {
+        return false;
+    }
+
+    const auto entry = _entries.find(key->second);
+    assert(entry->second.owners > 0 && "Pipeline released more often than it was handed out.");
+    if(--entry->second.owners > 0)
+    {
+        return false;
+    }
+    _entries.erase(entry);
+    _keys.erase(key);
+    return true;
+}
+
+template<typename Pointer>
+uint32_t Util::PipelineStore<Pointer>::GetOwners(uint64_t key) const
+{
+    const auto entry = _entries.find(key);
+    return entry != _entries.end() ? entry->second.owners : 0u;
+}
+
+template<typename Pointer>
+bool Util::PipelineStore<Pointer>::Validate() const
+{
+    if(_keys.size() != _entries.size())
+    {
+        return false;
+    }
+    for(const auto& [address, key] : _keys)
+    {
+        const auto entry = _entries.find(key);
+        if(entry == _entries.end() || std::to_address(entry->second.object) != address || entry->second.owners == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
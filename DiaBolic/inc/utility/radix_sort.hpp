@@ -0,0 +1,126 @@
+#pragma once
+
+#include "job_system.hpp"
+
+#include <algorithm>
+
+namespace Util
+{
+    // Inputs smaller than this are sorted on the calling thread.
+    constexpr size_t RADIX_SORT_PARALLEL_THRESHOLD = 1u << 14;
+
+    // Stable LSD radix sort on 64-bit keys, 8 bits per pass.
+    // Passes over key bytes that are the same for every element are skipped.
+    // Large inputs are split in chunks that histogram and scatter in parallel on the job system.
+    template<typename T, typename KeyFunc>
+    void RadixSort(std::vector<T>& data, std::vector<T>& scratch, KeyFunc getKey)
+    {
+        const size_t count = data.size();
+        scratch.resize(count);
+        if (count < 2)
+        {
+            return;
+        }
+
+        uint64_t andMask = ~0ull;
+        uint64_t orMask = 0ull;
+        for (const T& element : data)
+        {
+            const uint64_t key = getKey(element);
+            andMask &= key;
+            orMask |= key;
+        }
+        const uint64_t varyingBits = andMask ^ orMask;
+
+        std::array<uint32_t, 8> shifts{};
+        uint32_t passCount = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            if ((varyingBits >> shift) & 0xFF)
+            {
+                shifts[passCount++] = shift;
+            }
+        }
+
+        const uint32_t chunkCount = count >= RADIX_SORT_PARALLEL_THRESHOLD
+            ? std::clamp(JobSystem::Get().GetWorkerCount() + 1u, 1u, 16u)
+            : 1u;
+        const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+        std::vector<std::array<size_t, 256>> histograms(chunkCount);
+        T* source = data.data();
+        T* destination = scratch.data();
+
+        auto histogram = [&](uint32_t chunk, uint32_t shift)
+        {
+            auto& counts = histograms[chunk];
+            counts.fill(0);
+
+            const size_t begin = std::min(count, chunk * chunkSize);
+            const size_t end = std::min(count, begin + chunkSize);
+            for (size_t i = begin; i < end; ++i)
+            {
+                counts[(getKey(source[i]) >> shift) & 0xFF]++;
+            }
+        };
+
+        // Turns the per-chunk counts into scatter offsets, digit major so the sort stays stable.
+        auto computeOffsets = [&]()
+        {
+            size_t offset = 0;
+            for (uint32_t digit = 0; digit < 256; ++digit)
+            {
+                for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+                {
+                    const size_t digitCount = histograms[chunk][digit];
+                    histograms[chunk][digit] = offset;
+                    offset += digitCount;
+                }
+            }
+        };
+
+        auto scatter = [&](uint32_t chunk, uint32_t shift)
+        {
+            auto& offsets = histograms[chunk];
+
+            const size_t begin = std::min(count, chunk * chunkSize);
+            const size_t end = std::min(count, begin + chunkSize);
+            for (size_t i = begin; i < end; ++i)
+            {
+                destination[offsets[(getKey(source[i]) >> shift) & 0xFF]++] = source[i];
+            }
+        };
+
+        // Runs phase on every chunk, in parallel when there is more than one.
+        auto forEachChunk = [&](auto&& phase, uint32_t shift)
+        {
+            if (chunkCount == 1)
+            {
+                phase(0, shift);
+                return;
+            }
+            JobSystem::Get().ParallelFor(chunkCount, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t chunk = begin; chunk < end; ++chunk)
+                {
+                    phase(static_cast<uint32_t>(chunk), shift);
+                }
+            });
+        };
+
+        // Every pass has two phases: histogram, then scatter, with the offsets computed in between.
+        for (uint32_t pass = 0; pass < passCount; ++pass)
+        {
+            forEachChunk(histogram, shifts[pass]);
+            computeOffsets();
+            forEachChunk(scatter, shifts[pass]);
+            std::swap(source, destination);
+        }
+
+        // An odd number of passes leaves the result in the scratch buffer.
+        if (source != data.data())
+        {
+            data.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+    // The device independent half of RenderGraph: the frame's passes, the resources they read and write, and the
+    // barriers and transient texture placement that follow from those declarations. Transitions before a pass are issued
+    // in one batch, transitions with idle passes in between are split when both ends record into the same command list,
+    // consecutive reads share one combined read state. Transient textures only live for the passes that use them, so
+    // textures whose lifetimes don't overlap share memory.
+    // States are D3D12_RESOURCE_STATES bits in plain integers, so this builds and runs without D3D12.
+    class RenderGraphCompiler
+    {
+    public:
+        using ResourceId = uint32_t;
+        using PassId = uint32_t;
+        using States = uint32_t;
+
+        // Same values as D3D12_RESOURCE_STATES, render_graph.cpp checks that they match.
+        static constexpr States STATE_COMMON = 0x0;
+        static constexpr States STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1;
+        static constexpr States STATE_INDEX_BUFFER = 0x2;
+        static constexpr States STATE_RENDER_TARGET = 0x4;
+        static constexpr States STATE_UNORDERED_ACCESS = 0x8;
+        static constexpr States STATE_DEPTH_WRITE = 0x10;
+        static constexpr States STATE_DEPTH_READ = 0x20;
+        static constexpr States STATE_NON_PIXEL_SHADER_RESOURCE = 0x40;
+        static constexpr States STATE_PIXEL_SHADER_RESOURCE = 0x80;
+        static constexpr States STATE_STREAM_OUT = 0x100;
+        static constexpr States STATE_INDIRECT_ARGUMENT = 0x200;
+        static constexpr States STATE_COPY_DEST = 0x400;
+        static constexpr States STATE_COPY_SOURCE = 0x800;
+        static constexpr States STATE_RESOLVE_DEST = 0x1000;
+        static constexpr States STATE_RESOLVE_SOURCE = 0x2000;
+        static constexpr States STATE_GENERIC_READ = 0xac3;
+
+        // D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, the least a heap is aligned to.
+        static constexpr uint64_t DEFAULT_HEAP_ALIGNMENT = 64 * 1024;
+
+        struct Barrier
+        {
+            enum class Type : uint8_t
+            {
+                Transition,
+                Aliasing,
+                Uav,
+            };
+
+            // The halves of a split transition.
+            enum class Split : uint8_t
+            {
+                None,
+                Begin,
+                End,
+            };
+
+            Type type = Type::Transition;
+            ResourceId resource = 0;
+            States before = STATE_COMMON;
+            States after = STATE_COMMON;
+            Split split = Split::None;
+        };
+
+        struct Access
+        {
+            ResourceId resource;
+            States state; // reads of the pass combined
+            bool write;
+        };
+
+        struct Stats
+        {
+            uint32_t passCount = 0;
+            uint32_t transientCount = 0;
+
+            uint32_t transitionCount = 0;
+            uint32_t splitTransitionCount = 0;
+            uint32_t aliasingBarrierCount = 0;
+            uint32_t uavBarrierCount = 0;
+            uint32_t barrierCalls = 0; // ResourceBarrier calls a frame, one per pass that needs barriers
+            uint32_t unbatchedBarrierCalls = 0; // the same barriers with one call each
+
+            uint64_t transientBytes = 0; // every transient texture in its own allocation
+            uint64_t heapBytes = 0; // what the aliased heaps take
+        };
+
+        // Tier 1 hardware can't put render targets and depth buffers in a heap with other textures.
+        enum class HeapClass : uint8_t
+        {
+            RenderTargets,
+            Textures,
+        };
+
+        struct Heap
+        {
+            HeapClass heapClass = HeapClass::Textures;
+            uint64_t size = 0;
+            uint64_t alignment = DEFAULT_HEAP_ALIGNMENT;
+        };
+
+        // Where a transient texture lives.
+        struct Placement
+        {
+            uint32_t heap = 0;
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        // What a transient texture takes in a heap, alignment is a power of two.
+        struct Allocation
+        {
+            uint64_t size = 0;
+            uint64_t alignment = DEFAULT_HEAP_ALIGNMENT;
+        };
+        using AllocationFunction = std::function<Allocation(ResourceId)>;
+
+        RenderGraphCompiler() = default;
+
+        RenderGraphCompiler(const RenderGraphCompiler& other) = delete;
+        RenderGraphCompiler& operator=(const RenderGraphCompiler& other) = delete;
+
+        // A resource that lives outside the graph, like the back buffer. Left in finalState at the end of the frame.
+        ResourceId ImportResource(std::string name, States initialState, States finalState);
+        // A texture only used within the frame. Its contents don't survive the frame, the first pass using it has to write
+        // it. renderTarget when it allows render target or depth stencil use.
+        ResourceId CreateTexture(std::string name, bool renderTarget);
+
+        // Passes with the same commandList record into one command list. They have to be added one after the other, the
+        // lists execute in the order of their passes and the barriers ending the frame get a list of their own.
+        PassId AddPass(std::string name, uint32_t commandList);
+        void Read(PassId pass, ResourceId resource, States state);
+        void Write(PassId pass, ResourceId resource, States state);
+
+        // Works out the barriers and where the transient textures are placed, once every pass is declared.
+        void Compile(const AllocationFunction& getAllocation);
+
+        [[nodiscard]] uint32_t GetPassCount() const { return static_cast<uint32_t>(_passes.size()); }
+        [[nodiscard]] uint32_t GetResourceCount() const { return static_cast<uint32_t>(_resources.size()); }
+        [[nodiscard]] const std::string& GetPassName(PassId pass) const { return _passes[pass].name; }
+        [[nodiscard]] uint32_t GetCommandList(PassId pass) const { return _passes[pass].commandList; }
+        [[nodiscard]] const std::vector<Access>& GetAccesses(PassId pass) const { return _passes[pass].accesses; }
+        [[nodiscard]] const std::string& GetName(ResourceId resource) const { return _resources[resource].name; }
+        [[nodiscard]] bool IsTransient(ResourceId resource) const { return _resources[resource].transient; }
+        // Not used by any pass, transients like that get no memory.
+        [[nodiscard]] bool IsUsed(ResourceId resource) const { return _resources[resource].firstPass != NO_PASS; }
+
+        // After Compile(). GetPassCount() has the barriers that end the frame.
+        [[nodiscard]] const std::vector<Barrier>& GetBarriers(uint32_t pass) const { return _barriers[pass]; }
+        // Transient render targets and depth buffers that start sharing memory at the pass, to discard after its barriers.
+        [[nodiscard]] const std::vector<ResourceId>& GetDiscards(PassId pass) const { return _discards[pass]; }
+        [[nodiscard]] const std::vector<Heap>& GetHeaps() const { return _heaps; }
+        [[nodiscard]] Placement GetPlacement(ResourceId resource) const;
+        // Transients are created in it, it is the state every frame leaves them in.
+        [[nodiscard]] States GetInitialState(ResourceId resource) const { return _resources[resource].initialState; }
+        [[nodiscard]] const Stats& GetStats() const { return _stats; }
+
+    private:
+        static constexpr uint32_t NO_PASS = UINT32_MAX;
+
+        struct Pass
+        {
+            std::string name;
+            uint32_t commandList = 0;
+            std::vector<Access> accesses;
+        };
+
+        struct Resource
+        {
+            std::string name;
+            bool transient = false;
+            bool renderTarget = false;
+
+            States initialState = STATE_COMMON; // at the start of the frame
+            States finalState = STATE_COMMON; // imported only
+            uint32_t firstPass = NO_PASS;
+            uint32_t lastPass = NO_PASS;
+
+            // Transient.
+            uint32_t heap = 0;
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            bool aliased = false; // shares memory with another transient
+        };
+
+        void AddAccess(PassId pass, ResourceId resource, States state, bool write);
+        void CompileBarriers(ResourceId resource);
+        void PlaceTransients(const AllocationFunction& getAllocation);
+        // Split when earliestPass comes before pass and both record into the same command list, the transition then only
+        // has to finish by pass.
+        void AddTransition(ResourceId resource, States before, States after, uint32_t earliestPass, uint32_t pass);
+
+        std::vector<Pass> _passes;
+        std::vector<Resource> _resources;
+        std::vector<Heap> _heaps;
+
+        std::vector<std::vector<Barrier>> _barriers; // by pass, one more for the end of the frame
+        std::vector<std::vector<ResourceId>> _discards; // by pass
+        Stats _stats;
+    };
+}
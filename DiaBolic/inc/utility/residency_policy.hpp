@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+
+namespace Util
+{
+    // Decides which resources stay in video memory under a budget, the least recently used ones are evicted first.
+    // It only keeps the books: the caller evicts and restores the resources it is told to and reports which ones every
+    // frame uses, so it can be driven by a simulated access trace on the CPU just as well as by the renderer.
+    // Resident resources are kept in a list ordered by the frame they were last used in, using one moves it to the front
+    // and eviction takes them from the back, so every call is constant time.
+    class ResidencyPolicy
+    {
+    public:
+        using ResourceId = uint32_t;
+        static constexpr ResourceId NO_RESOURCE = UINT32_MAX;
+
+        struct Decisions
+        {
+            std::vector<ResourceId> evict; // carry these out first, they make room for the restores
+            std::vector<ResourceId> restore;
+        };
+
+        struct Stats
+        {
+            uint64_t budget = 0;
+            uint64_t residentBytes = 0; // pinned ones included
+            uint64_t pinnedBytes = 0;
+            uint64_t evictedBytes = 0;
+            uint32_t residentCount = 0;
+            uint32_t evictedCount = 0;
+            uint32_t waitingCount = 0; // used while evicted and not restored yet
+            uint64_t evictions = 0; // since startup
+            uint64_t restores = 0;
+            uint64_t overBudgetFrames = 0; // couldn't evict enough, everything left was in use
+        };
+
+        // The GPU may still read a resource used in one of the last framesInFlight frames, those are never evicted. At
+        // least 1, the frame being decided on is about to use what it restores.
+        // Restores in a frame stop at restoreBytesPerFrame, but there is always at least one.
+        ResidencyPolicy(uint64_t budget, uint32_t framesInFlight, uint64_t restoreBytesPerFrame = UINT64_MAX);
+
+        ResidencyPolicy(const ResidencyPolicy& other) = delete;
+        ResidencyPolicy& operator=(const ResidencyPolicy& other) = delete;
+
+        // Resources start out resident and used in the current frame. Pinned ones are never evicted, but count against
+        // the budget.
+        ResourceId Add(uint64_t size, bool pinned = false);
+        void Remove(ResourceId resource);
+
+        // Starts a frame. Report what it uses with MarkUsed(), then call Update() before it is drawn.
+        void BeginFrame() { ++_frame; }
+        // Evicted resources are restored by the next Update().
+        void MarkUsed(ResourceId resource);
+        // Restores what this frame wants back and evicts the least recently used resources until it is within budget.
+        // Valid until the next call.
+        const Decisions& Update();
+
+        void SetBudget(uint64_t budget) { _budget = budget; }
+        [[nodiscard]] uint64_t GetBudget() const { return _budget; }
+        [[nodiscard]] uint64_t GetFrame() const { return _frame; }
+        [[nodiscard]] bool IsResident(ResourceId resource) const;
+        [[nodiscard]] Stats GetStats() const;
+
+        // Walks every resource and checks that the list, its order and the counters agree. Linear, for tests.
+        [[nodiscard]] bool Validate() const;
+
+    private:
+        struct Entry
+        {
+            uint64_t size = 0;
+            uint64_t lastUsed = 0; // frame
+            ResourceId previous = NO_RESOURCE; // towards more recently used
+            ResourceId next = NO_RESOURCE;
+            bool alive = false;
+            bool resident = false;
+            bool pinned = false; // resident, but not in the list
+            bool waiting = false; // in _waiting
+        };
+
+        uint64_t _budget;
+        uint32_t _framesInFlight;
+        uint64_t _restoreBytesPerFrame;
+        uint64_t _frame = 0;
+
+        std::vector<Entry> _entries; // by id
+        std::vector<ResourceId> _freeIds;
+        ResourceId _mostRecent = NO_RESOURCE;
+        ResourceId _leastRecent = NO_RESOURCE;
+        std::vector<ResourceId> _waiting;
+        Decisions _decisions;
+
+        uint64_t _residentBytes = 0;
+        uint64_t _pinnedBytes = 0;
+        uint64_t _evictedBytes = 0;
+        uint32_t _residentCount = 0;
+        uint32_t _evictedCount = 0;
+        uint64_t _evictions = 0;
+        uint64_t _restores = 0;
+        uint64_t _overBudgetFrames = 0;
+
+        // Makes it the most recently used.
+        void PushFront(ResourceId resource);
+        void Unlink(ResourceId resource);
+    };
+}
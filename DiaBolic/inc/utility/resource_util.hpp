@@ -1,5 +1,8 @@
 #pragma once
 
+class GpuAllocator;
+struct GpuAllocation;
+
 namespace Util
 {
 	void CreateCube(std::vector<DirectX::XMFLOAT3>& vertices,
@@ -7,15 +10,16 @@ namespace Util
 		std::vector<DirectX::XMFLOAT2>& uvs,
 		std::vector<uint16_t>& indices, float size);
 
-	void LoadBufferResource(Microsoft::WRL::ComPtr<ID3D12Device> device,
+	// Copies bufferData into a default heap buffer from the allocator, through an upload buffer from the allocator.
+	// Free the intermediate once the command list executed.
+	void LoadBufferResource(GpuAllocator& allocator,
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
-		ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource, 
-		size_t numElements, size_t elementSize, const void* bufferData, 
-		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
+		GpuAllocation& destination, GpuAllocation& intermediate,
+		size_t numElements, size_t elementSize, const void* bufferData);
 
-	void LoadTextureFromFile(Microsoft::WRL::ComPtr<ID3D12Device> device, 
+	void LoadTextureFromFile(GpuAllocator& allocator,
 		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
-		ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource,
+		GpuAllocation& destination, GpuAllocation& intermediate,
 		const std::wstring& filePath, DXGI_FORMAT& format);
 	
 	void TransitionResource(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList, 
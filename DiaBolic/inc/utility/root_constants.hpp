@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+struct ID3D12ShaderReflection;
+
+namespace Util
+{
+    // Layout checks for structs that are declared once in an .hlsli, compiled as both C++ and HLSL and pushed as root
+    // constants. The shader side comes from reflection, the C++ side from offsetof/sizeof, so a member that changes
+    // size or moves on one side only is caught when the shader loads instead of reading garbage.
+    namespace RootConstants
+    {
+        struct Field
+        {
+            std::string_view name;
+            uint32_t offset = 0;
+            uint32_t size = 0;
+            bool used = true; // read by the shader, always true on the C++ side
+        };
+
+        // Members of the constant buffer bound at b<registerIndex>, in space 0. Empty when the shader doesn't bind it.
+        // The names point into the reflection object.
+        [[nodiscard]] std::vector<Field> Reflect(ID3D12ShaderReflection* reflection, uint32_t registerIndex);
+
+        // Every shader member has to match a C++ member by name, offset and size, and the other way around. A shader that
+        // doesn't bind the struct at all passes.
+        // Logs each mismatch and returns false if there was any.
+        [[nodiscard]] bool Validate(std::span<const Field> shaderFields, std::span<const Field> cpuFields, std::string_view shaderName);
+
+        // Dwords from the start of the struct up to the last member the shader reads, all a draw has to push.
+        [[nodiscard]] uint32_t GetUsedDwordCount(std::span<const Field> shaderFields);
+    }
+}
+
+// Field of a C++ struct, for the table passed to Util::RootConstants::Validate().
+#define ROOT_CONSTANT_FIELD(type, member) Util::RootConstants::Field{ #member, offsetof(type, member), sizeof(type::member) }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <filesystem>
+
+namespace Util
+{
+    // Compiled shaders on disk, so unchanged shaders skip DXC on the next launch.
+    // The key covers the source and every file it includes, all compilation arguments and the compiler version, so any
+    // edit, flag change or DXC update misses and recompiles.
+    namespace ShaderCache
+    {
+        struct Entry
+        {
+            std::vector<uint8_t> shader;
+            std::vector<uint8_t> rootSignature;
+            std::vector<uint8_t> reflection;
+        };
+
+        // compilerVersion identifies the DXC build, see ShaderCompiler::GetCompilerVersion.
+        [[nodiscard]] uint64_t ComputeKey(const std::wstring_view shaderPath, const std::wstring_view includeDirectory,
+                                          const std::vector<LPCWSTR>& compilationArguments, const bool extractRootSignature,
+                                          const uint64_t compilerVersion);
+
+        // The shader and every file it includes, directly or not. Paths are canonical.
+        [[nodiscard]] std::vector<std::filesystem::path> GetSourceFiles(const std::wstring_view shaderPath, const std::wstring_view includeDirectory);
+
+        // Returns false when there is no valid entry for key.
+        [[nodiscard]] bool Load(uint64_t key, Entry& entry);
+        // Failing to write only logs, the shader is just compiled again next time.
+        void Store(uint64_t key, const void* shader, size_t shaderSize, const void* rootSignature, size_t rootSignatureSize,
+                   const void* reflection, size_t reflectionSize);
+    }
+}
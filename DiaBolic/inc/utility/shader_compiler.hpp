@@ -1,11 +1,15 @@
 #pragma once
 
+#include <d3d12shader.h>
+#include <future>
+
 namespace Util
 {
     struct Shader
     {
         Microsoft::WRL::ComPtr<IDxcBlob> shaderBlob{};
         Microsoft::WRL::ComPtr<IDxcBlob> rootSignatureBlob{};
+        Microsoft::WRL::ComPtr<IDxcBlob> reflectionBlob{};
     };
 
     enum class ShaderTypes : uint8_t
@@ -18,8 +22,35 @@ namespace Util
 
     namespace ShaderCompiler
     {
+        // Compiles on the calling thread, safe to call from any thread. defines are passed to DXC as is, eg. L"TEXTURED=1".
+        // The shader pack and the shader cache are checked first, DXC only runs when neither has the shader.
         [[nodiscard]] Shader Compile(const ShaderTypes& shaderType, const std::wstring_view shaderPath,
-                                     const std::wstring_view entryPoint, const bool extractRootSignature = false);
+                                     const std::wstring_view entryPoint, const bool extractRootSignature = false,
+                                     const std::vector<std::wstring>& defines = {});
+
+        // Queues the compilation on the job system at low priority, request every shader up front and wait on them together.
+        [[nodiscard]] std::future<Shader> CompileAsync(const ShaderTypes shaderType, std::wstring shaderPath,
+                                                       std::wstring entryPoint, const bool extractRootSignature = false,
+                                                       std::vector<std::wstring> defines = {});
+
+        // Null when the shader came without reflection data.
+        [[nodiscard]] Microsoft::WRL::ComPtr<ID3D12ShaderReflection> CreateReflection(const Shader& shader);
+
+        // The keys the shader is stored under in the shader pack, for the ShaderBake tool.
+        struct PackKeys
+        {
+            uint64_t key = 0;
+            uint64_t sourceKey = 0;
+        };
+        [[nodiscard]] PackKeys GetPackKeys(const ShaderTypes shaderType, const std::wstring_view shaderPath, const std::wstring_view entryPoint,
+                                           const bool extractRootSignature = false, const std::vector<std::wstring>& defines = {});
+
+        // Hash of the DXC version and commit, part of the shader cache and pack keys so another compiler build misses.
+        // Read from dxcompiler.dll's version resource, so shader pack and cache hits never create a compiler.
+        [[nodiscard]] uint64_t GetCompilerVersion();
+
+        // Where the shaders live, also the -I directory for their includes.
+        [[nodiscard]] const std::wstring& GetShaderDirectory();
     }
 }
 
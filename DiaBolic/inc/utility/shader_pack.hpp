@@ -0,0 +1,32 @@
+#pragma once
+
+#include "utility/shader_cache.hpp"
+
+namespace Util
+{
+    // Shaders compiled ahead of time by the ShaderBake tool, packed into one archive. It is either embedded in the
+    // executable (DIABOLIC_EMBED_SHADERS) or loaded from shader_pack.bin next to it.
+    // Shaders are looked up by their compilation key: the shader path, every compilation argument and the compiler
+    // version, but not the source, so a shipped build without shader sources still finds them. The source key each shader was baked from is
+    // stored alongside, so a development build can tell when the shader was edited since.
+    namespace ShaderPack
+    {
+        struct PackedShader
+        {
+            uint64_t key = 0;
+            uint64_t sourceKey = 0;
+            ShaderCache::Entry entry;
+        };
+
+        [[nodiscard]] uint64_t ComputeKey(const std::wstring_view shaderPath, const std::vector<LPCWSTR>& compilationArguments,
+                                          const bool extractRootSignature, const uint64_t compilerVersion);
+
+        // Call once at startup, before compiling any shader. Returns false when there is no valid pack.
+        bool Open();
+
+        // Returns false when the pack doesn't have the shader. Safe to call from any thread after Open.
+        [[nodiscard]] bool Find(uint64_t key, uint64_t& sourceKey, ShaderCache::Entry& entry);
+
+        [[nodiscard]] bool Write(const std::filesystem::path& path, const std::vector<PackedShader>& shaders);
+    }
+}
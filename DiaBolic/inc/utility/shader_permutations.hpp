@@ -0,0 +1,31 @@
+#pragma once
+
+#include "utility/shader_compiler.hpp"
+
+namespace Util
+{
+    // The compile time variants of a shader. The shader declares its features as preprocessor switches and a variant is
+    // picked with a bitmask, bit i enabling features[i]: every feature is defined as 1 or 0 so the shader can use #if.
+    // Nothing is compiled up front, variants are only compiled when they are requested.
+    class ShaderPermutations
+    {
+    public:
+        // The variant mask has to fit the 8 pipeline bits of the draw sort key.
+        static constexpr uint32_t MAX_FEATURES = 8;
+
+        ShaderPermutations(std::wstring shaderPath, std::vector<std::wstring> features);
+
+        [[nodiscard]] std::future<Shader> CompileAsync(const ShaderTypes shaderType, std::wstring entryPoint, uint32_t variant) const;
+
+        [[nodiscard]] std::vector<std::wstring> GetDefines(uint32_t variant) const;
+        // Enabled features joined by '|', for logging.
+        [[nodiscard]] std::string Describe(uint32_t variant) const;
+
+        [[nodiscard]] const std::wstring& GetShaderPath() const { return _shaderPath; }
+        [[nodiscard]] uint32_t GetVariantCount() const { return 1u << _features.size(); }
+
+    private:
+        std::wstring _shaderPath;
+        std::vector<std::wstring> _features;
+    };
+}
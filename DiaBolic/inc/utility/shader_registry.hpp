@@ -0,0 +1,33 @@
+#pragma once
+
+#include "utility/shader_compiler.hpp"
+
+namespace Util
+{
+    // Every shader program the renderer compiles, with its entry points and permutation features. The ShaderBake tool
+    // compiles all of them at build time; shaders not listed here still work, they are just compiled at runtime.
+    namespace ShaderRegistry
+    {
+        enum class Program : uint8_t
+        {
+            Geometry,
+            Count,
+        };
+
+        struct Stage
+        {
+            ShaderTypes type;
+            std::wstring entryPoint;
+        };
+
+        struct ProgramDesc
+        {
+            std::wstring shaderPath;
+            // Passed to ShaderPermutations, so every variant of the program gets baked.
+            std::vector<std::wstring> features;
+            std::vector<Stage> stages;
+        };
+
+        [[nodiscard]] const ProgramDesc& GetProgram(Program program);
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+
+namespace Util
+{
+    // Two-level segregated fit allocator over a range of bytes. It only hands out offsets, what the range is (a D3D12
+    // heap, a buffer, nothing at all when fuzzing it on the CPU) is up to the caller.
+    // Free blocks are binned by size, the first level by power of two and the second level splits every power of two in
+    // SECOND_LEVEL_COUNT steps. Two bitmaps find a bin with a block that fits in constant time, freeing merges a block
+    // with its free neighbours right away. Nothing is ever allocated on the CPU apart from the block records.
+    class TlsfAllocator
+    {
+    public:
+        static constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+        struct Allocation
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0; // as asked for
+            uint32_t block = NO_BLOCK;
+
+            [[nodiscard]] bool IsValid() const { return block != NO_BLOCK; }
+        };
+
+        struct Stats
+        {
+            uint64_t size = 0;
+            uint64_t usedBytes = 0; // handed out, rounded to the granularity and with alignment padding
+            uint64_t requestedBytes = 0; // as asked for, the rest of usedBytes is wasted
+            uint64_t freeBytes = 0;
+            uint64_t largestFreeBlock = 0;
+            uint32_t allocationCount = 0;
+            uint32_t freeBlockCount = 0;
+
+            // 0 when all free memory is one block, towards 1 the more it is scattered in small blocks.
+            [[nodiscard]] float Fragmentation() const
+            {
+                return freeBytes > 0 ? 1.0f - static_cast<float>(largestFreeBlock) / static_cast<float>(freeBytes) : 0.0f;
+            }
+        };
+
+        // Offsets and block sizes are multiples of granularity, a power of two.
+        TlsfAllocator(uint64_t size, uint64_t granularity);
+
+        TlsfAllocator(const TlsfAllocator& other) = delete;
+        TlsfAllocator& operator=(const TlsfAllocator& other) = delete;
+
+        // Invalid when no free block fits. alignment is a multiple of the granularity but doesn't have to be a power of
+        // two, structured buffers align to their stride.
+        [[nodiscard]] Allocation Allocate(uint64_t size, uint64_t alignment);
+        void Free(const Allocation& allocation);
+
+        [[nodiscard]] Stats GetStats() const;
+        [[nodiscard]] uint64_t GetSize() const { return _size; }
+        [[nodiscard]] bool IsEmpty() const { return _allocationCount == 0; }
+
+        // Walks every block and checks that blocks, bins, bitmaps and counters agree. Linear, for tests and fuzzing.
+        [[nodiscard]] bool Validate() const;
+
+    private:
+        static constexpr uint32_t SECOND_LEVEL_BITS = 5;
+        static constexpr uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+        // Sizes below SECOND_LEVEL_COUNT granules all share first level 0, one bin per size.
+        static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+
+        struct Block
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+            uint32_t previousPhysical = NO_BLOCK;
+            uint32_t nextPhysical = NO_BLOCK;
+            uint32_t previousFree = NO_BLOCK; // in its bin
+            uint32_t nextFree = NO_BLOCK;
+            bool free = false;
+        };
+
+        struct Bin
+        {
+            uint32_t firstLevel;
+            uint32_t secondLevel;
+        };
+
+        // The bin a block of size belongs in.
+        [[nodiscard]] Bin GetBin(uint64_t size) const;
+        // The first bin of which every block is at least size.
+        [[nodiscard]] Bin GetSearchBin(uint64_t size) const;
+        // A free block that fits size at alignment, NO_BLOCK when there's none.
+        [[nodiscard]] uint32_t FindFreeBlock(uint64_t size, uint64_t alignment) const;
+
+        void InsertFree(uint32_t block);
+        void RemoveFree(uint32_t block);
+        // Cuts block after frontSize bytes, returns the back part.
+        uint32_t Split(uint32_t block, uint64_t frontSize);
+        // Adds next, the block right after block, to block.
+        void Merge(uint32_t block, uint32_t next);
+        uint32_t NewBlock();
+
+        uint64_t _size = 0;
+        uint64_t _granularity = 0;
+        uint32_t _granularityShift = 0;
+
+        // Block 0 always starts at offset 0, blocks merge into the one before them.
+        std::vector<Block> _blocks;
+        std::vector<uint32_t> _unusedBlocks;
+
+        uint64_t _firstLevelBitmap = 0;
+        std::array<uint32_t, FIRST_LEVEL_COUNT> _secondLevelBitmaps{};
+        std::array<std::array<uint32_t, SECOND_LEVEL_COUNT>, FIRST_LEVEL_COUNT> _freeLists{};
+
+        uint64_t _usedBytes = 0;
+        uint64_t _requestedBytes = 0;
+        uint32_t _allocationCount = 0;
+        uint32_t _freeBlockCount = 0;
+    };
+}
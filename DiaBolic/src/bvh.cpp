@@ -0,0 +1,493 @@
+#include "bvh.hpp"
+
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr uint32_t ALL_PLANES = 0x3F;
+
+    template<typename BoxType>
+    BoxType Merge(const BoxType& a, const BoxType& b)
+    {
+        BoxType result;
+        result.min = XMFLOAT3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z));
+        result.max = XMFLOAT3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z));
+        return result;
+    }
+
+    template<typename BoxType>
+    float SurfaceArea(const BoxType& box)
+    {
+        const float x = box.max.x - box.min.x;
+        const float y = box.max.y - box.min.y;
+        const float z = box.max.z - box.min.z;
+        return 2.0f * (x * y + y * z + z * x);
+    }
+}
+
+Bvh::~Bvh()
+{
+    if(_pendingBuild.valid())
+    {
+        _pendingBuild.wait();
+    }
+}
+
+uint32_t Bvh::Tree::AllocateNode()
+{
+    if(!freeNodes.empty())
+    {
+        const uint32_t index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = Node{};
+        return index;
+    }
+
+    nodes.emplace_back();
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void Bvh::Tree::FreeNode(uint32_t index)
+{
+    freeNodes.push_back(index);
+}
+
+void Bvh::Tree::InsertLeaf(uint32_t leaf)
+{
+    if(root == INVALID_INDEX)
+    {
+        root = leaf;
+        nodes[leaf].parent = INVALID_INDEX;
+        return;
+    }
+
+    // Walk down to the sibling that adds the least surface area, see Catto's "Dynamic Bounding Volume Hierarchies".
+    const Box leafBox = nodes[leaf].box;
+    uint32_t index = root;
+    while(nodes[index].left != INVALID_INDEX)
+    {
+        const Node& node = nodes[index];
+        const float area = SurfaceArea(node.box);
+        const float combinedArea = SurfaceArea(Merge(node.box, leafBox));
+
+        // Cost of pairing with this node, and the cost every child pays for growing this node.
+        const float cost = 2.0f * combinedArea;
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto childCost = [&](uint32_t child)
+        {
+            float childArea = SurfaceArea(Merge(leafBox, nodes[child].box));
+            if(nodes[child].left != INVALID_INDEX)
+            {
+                childArea -= SurfaceArea(nodes[child].box);
+            }
+            return childArea + inheritanceCost;
+        };
+
+        const float leftCost = childCost(node.left);
+        const float rightCost = childCost(node.right);
+        if(cost < leftCost && cost < rightCost)
+        {
+            break;
+        }
+
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    const uint32_t sibling = index;
+    const uint32_t oldParent = nodes[sibling].parent;
+    const uint32_t newParent = AllocateNode();
+
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = Merge(leafBox, nodes[sibling].box);
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+
+    if(oldParent != INVALID_INDEX)
+    {
+        if(nodes[oldParent].left == sibling)
+        {
+            nodes[oldParent].left = newParent;
+        }
+        else
+        {
+            nodes[oldParent].right = newParent;
+        }
+    }
+    else
+    {
+        root = newParent;
+    }
+
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    RefitFrom(oldParent);
+}
+
+void Bvh::Tree::RemoveLeaf(uint32_t leaf)
+{
+    if(leaf == root)
+    {
+        root = INVALID_INDEX;
+        return;
+    }
+
+    // The sibling takes the place of the parent.
+    const uint32_t parent = nodes[leaf].parent;
+    const uint32_t grandParent = nodes[parent].parent;
+    const uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    nodes[sibling].parent = grandParent;
+    if(grandParent != INVALID_INDEX)
+    {
+        if(nodes[grandParent].left == parent)
+        {
+            nodes[grandParent].left = sibling;
+        }
+        else
+        {
+            nodes[grandParent].right = sibling;
+        }
+        RefitFrom(grandParent);
+    }
+    else
+    {
+        root = sibling;
+    }
+
+    FreeNode(parent);
+}
+
+void Bvh::Tree::RefitFrom(uint32_t index)
+{
+    while(index != INVALID_INDEX)
+    {
+        Node& node = nodes[index];
+        node.box = Merge(nodes[node.left].box, nodes[node.right].box);
+        index = node.parent;
+    }
+}
+
+uint32_t Bvh::Insert(const Culling::Bounds& bounds, uint32_t userData)
+{
+    uint32_t proxyIndex;
+    if(!_freeProxies.empty())
+    {
+        proxyIndex = _freeProxies.back();
+        _freeProxies.pop_back();
+    }
+    else
+    {
+        proxyIndex = static_cast<uint32_t>(_proxies.size());
+        _proxies.emplace_back();
+    }
+
+    Proxy& proxy = _proxies[proxyIndex];
+    proxy.box.min = XMFLOAT3(bounds.center.x - bounds.extents.x, bounds.center.y - bounds.extents.y, bounds.center.z - bounds.extents.z);
+    proxy.box.max = XMFLOAT3(bounds.center.x + bounds.extents.x, bounds.center.y + bounds.extents.y, bounds.center.z + bounds.extents.z);
+    proxy.userData = userData;
+    proxy.alive = true;
+
+    proxy.node = _tree.AllocateNode();
+    _tree.nodes[proxy.node].box = proxy.box;
+    _tree.nodes[proxy.node].proxy = proxyIndex;
+    _tree.InsertLeaf(proxy.node);
+
+    MarkChanged(proxyIndex);
+    _stats.proxyCount++;
+
+    return proxyIndex;
+}
+
+void Bvh::Remove(uint32_t proxyIndex)
+{
+    Proxy& proxy = _proxies[proxyIndex];
+    assert(proxy.alive && "Removing a proxy twice.");
+
+    _tree.RemoveLeaf(proxy.node);
+    _tree.FreeNode(proxy.node);
+
+    proxy.node = INVALID_INDEX;
+    proxy.alive = false;
+    _freeProxies.push_back(proxyIndex);
+
+    MarkChanged(proxyIndex);
+    _stats.proxyCount--;
+}
+
+void Bvh::Update(uint32_t proxyIndex, const Culling::Bounds& bounds)
+{
+    Proxy& proxy = _proxies[proxyIndex];
+    proxy.box.min = XMFLOAT3(bounds.center.x - bounds.extents.x, bounds.center.y - bounds.extents.y, bounds.center.z - bounds.extents.z);
+    proxy.box.max = XMFLOAT3(bounds.center.x + bounds.extents.x, bounds.center.y + bounds.extents.y, bounds.center.z + bounds.extents.z);
+
+    _tree.nodes[proxy.node].box = proxy.box;
+    _tree.RefitFrom(_tree.nodes[proxy.node].parent);
+
+    MarkChanged(proxyIndex);
+    _stats.refitsSinceRebuild++;
+}
+
+void Bvh::Query(const Culling::Frustum& frustum, std::vector<uint32_t>& visible)
+{
+    visible.clear();
+    _stats.nodesVisited = 0;
+    if(_tree.root == INVALID_INDEX)
+    {
+        return;
+    }
+
+    // Every entry carries the planes its parent still straddled, a node inside all of them needs no more tests.
+    struct StackEntry
+    {
+        uint32_t node;
+        uint32_t planeMask;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({ _tree.root, ALL_PLANES });
+
+    while(!stack.empty())
+    {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        _stats.nodesVisited++;
+
+        const Node& node = _tree.nodes[entry.node];
+        uint32_t planeMask = entry.planeMask;
+        bool outside = false;
+        if(planeMask != 0)
+        {
+            const float cx = (node.box.min.x + node.box.max.x) * 0.5f, ex = (node.box.max.x - node.box.min.x) * 0.5f;
+            const float cy = (node.box.min.y + node.box.max.y) * 0.5f, ey = (node.box.max.y - node.box.min.y) * 0.5f;
+            const float cz = (node.box.min.z + node.box.max.z) * 0.5f, ez = (node.box.max.z - node.box.min.z) * 0.5f;
+
+            for(uint32_t p = 0; p < 6; ++p)
+            {
+                if((planeMask & (1u << p)) == 0)
+                {
+                    continue;
+                }
+
+                const XMFLOAT4& plane = frustum.planes[p];
+                const float distance = cx * plane.x + cy * plane.y + cz * plane.z + plane.w;
+                const float radius = ex * std::abs(plane.x) + ey * std::abs(plane.y) + ez * std::abs(plane.z);
+                if(distance + radius < 0.0f)
+                {
+                    outside = true;
+                    break;
+                }
+                if(distance - radius >= 0.0f)
+                {
+                    planeMask &= ~(1u << p);
+                }
+            }
+        }
+
+        if(outside)
+        {
+            continue;
+        }
+
+        if(node.left == INVALID_INDEX)
+        {
+            visible.push_back(_proxies[node.proxy].userData);
+        }
+        else
+        {
+            stack.push_back({ node.left, planeMask });
+            stack.push_back({ node.right, planeMask });
+        }
+    }
+}
+
+void Bvh::Maintain()
+{
+    if(_pendingBuild.valid())
+    {
+        if(_pendingBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            ApplyBuild(_pendingBuild.get());
+        }
+        return;
+    }
+
+    const float refitsPerProxy = _stats.proxyCount > 0 ? static_cast<float>(_stats.refitsSinceRebuild) / _stats.proxyCount : 0.0f;
+    if(refitsPerProxy < _rebuildThreshold)
+    {
+        return;
+    }
+
+    // Build from a snapshot of the leaves, changes made in the meantime are replayed on the result.
+    std::vector<LeafInput> leaves;
+    leaves.reserve(_stats.proxyCount);
+    for(uint32_t i = 0; i < _proxies.size(); ++i)
+    {
+        if(_proxies[i].alive)
+        {
+            leaves.push_back({ _proxies[i].box, i });
+        }
+    }
+
+    _changedDuringBuild.clear();
+    _stats.refitsSinceRebuild = 0;
+    _pendingBuild = JobSystem::Get().Async([leaves = std::move(leaves)]() mutable { return Build(std::move(leaves)); });
+}
+
+void Bvh::Rebuild()
+{
+    if(_pendingBuild.valid())
+    {
+        JobSystem::Get().Wait(_pendingBuild);
+    }
+
+    std::vector<LeafInput> leaves;
+    leaves.reserve(_stats.proxyCount);
+    for(uint32_t i = 0; i < _proxies.size(); ++i)
+    {
+        if(_proxies[i].alive)
+        {
+            leaves.push_back({ _proxies[i].box, i });
+        }
+    }
+
+    _changedDuringBuild.clear();
+    _stats.refitsSinceRebuild = 0;
+    ApplyBuild(Build(std::move(leaves)));
+}
+
+size_t Bvh::GetMemoryUsage() const
+{
+    return _tree.nodes.capacity() * sizeof(Node) + (_tree.freeNodes.capacity() + _freeProxies.capacity() +
+        _changedDuringBuild.capacity()) * sizeof(uint32_t) + _proxies.capacity() * sizeof(Proxy);
+}
+
+Bvh::BuildResult Bvh::Build(std::vector<LeafInput> leaves)
+{
+    BuildResult result;
+    if(leaves.empty())
+    {
+        return result;
+    }
+
+    result.tree.nodes.reserve(leaves.size() * 2 - 1);
+    result.proxyNodes.reserve(leaves.size());
+    result.tree.root = BuildRecursive(result.tree, leaves, 0, leaves.size(), INVALID_INDEX, result.proxyNodes);
+
+    return result;
+}
+
+uint32_t Bvh::BuildRecursive(Tree& tree, std::vector<LeafInput>& leaves, size_t begin, size_t end, uint32_t parent,
+                             std::vector<std::pair<uint32_t, uint32_t>>& proxyNodes)
+{
+    const uint32_t index = tree.AllocateNode();
+    tree.nodes[index].parent = parent;
+
+    if(end - begin == 1)
+    {
+        tree.nodes[index].box = leaves[begin].box;
+        tree.nodes[index].proxy = leaves[begin].proxy;
+        proxyNodes.emplace_back(leaves[begin].proxy, index);
+        return index;
+    }
+
+    // Median split along the axis where the leaf centers are spread out the most.
+    XMFLOAT3 centerMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    XMFLOAT3 centerMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for(size_t i = begin; i < end; ++i)
+    {
+        const Box& box = leaves[i].box;
+        const XMFLOAT3 center((box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f, (box.min.z + box.max.z) * 0.5f);
+        centerMin = XMFLOAT3(std::min(centerMin.x, center.x), std::min(centerMin.y, center.y), std::min(centerMin.z, center.z));
+        centerMax = XMFLOAT3(std::max(centerMax.x, center.x), std::max(centerMax.y, center.y), std::max(centerMax.z, center.z));
+    }
+
+    const float spreadX = centerMax.x - centerMin.x;
+    const float spreadY = centerMax.y - centerMin.y;
+    const float spreadZ = centerMax.z - centerMin.z;
+    const int axis = (spreadX >= spreadY && spreadX >= spreadZ) ? 0 : (spreadY >= spreadZ ? 1 : 2);
+
+    auto center = [axis](const LeafInput& leaf)
+    {
+        switch(axis)
+        {
+        case 0: return leaf.box.min.x + leaf.box.max.x;
+        case 1: return leaf.box.min.y + leaf.box.max.y;
+        default: return leaf.box.min.z + leaf.box.max.z;
+        }
+    };
+
+    const size_t middle = begin + (end - begin) / 2;
+    std::nth_element(leaves.begin() + begin, leaves.begin() + middle, leaves.begin() + end,
+        [&](const LeafInput& a, const LeafInput& b) { return center(a) < center(b); });
+
+    const uint32_t left = BuildRecursive(tree, leaves, begin, middle, index, proxyNodes);
+    const uint32_t right = BuildRecursive(tree, leaves, middle, end, index, proxyNodes);
+
+    Node& node = tree.nodes[index];
+    node.left = left;
+    node.right = right;
+    node.box = Merge(tree.nodes[left].box, tree.nodes[right].box);
+
+    return index;
+}
+
+void Bvh::ApplyBuild(BuildResult&& result)
+{
+    _tree = std::move(result.tree);
+
+    for(Proxy& proxy : _proxies)
+    {
+        proxy.node = INVALID_INDEX;
+    }
+    for(const auto& [proxyIndex, node] : result.proxyNodes)
+    {
+        _proxies[proxyIndex].node = node;
+    }
+
+    // Replay what happened to the live tree while the new one was being built.
+    for(const uint32_t proxyIndex : _changedDuringBuild)
+    {
+        Proxy& proxy = _proxies[proxyIndex];
+        const bool inTree = proxy.node != INVALID_INDEX;
+
+        if(proxy.alive && inTree)
+        {
+            _tree.nodes[proxy.node].box = proxy.box;
+            _tree.RefitFrom(_tree.nodes[proxy.node].parent);
+        }
+        else if(proxy.alive)
+        {
+            proxy.node = _tree.AllocateNode();
+            _tree.nodes[proxy.node].box = proxy.box;
+            _tree.nodes[proxy.node].proxy = proxyIndex;
+            _tree.InsertLeaf(proxy.node);
+        }
+        else if(inTree)
+        {
+            _tree.RemoveLeaf(proxy.node);
+            _tree.FreeNode(proxy.node);
+            proxy.node = INVALID_INDEX;
+        }
+    }
+    _changedDuringBuild.clear();
+
+    _stats.nodeCount = static_cast<uint32_t>(_tree.nodes.size() - _tree.freeNodes.size());
+    _stats.rebuildCount++;
+}
+
+void Bvh::MarkChanged(uint32_t proxyIndex)
+{
+    if(_pendingBuild.valid())
+    {
+        _changedDuringBuild.push_back(proxyIndex);
+    }
+    _stats.nodeCount = static_cast<uint32_t>(_tree.nodes.size() - _tree.freeNodes.size());
+}
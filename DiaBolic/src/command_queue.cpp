@@ -114,26 +114,38 @@ Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> CommandQueue::GetCommandList(
 // Returns the fence value to wait for for this command list.
 uint64_t CommandQueue::ExecuteCommandList(Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList)
 {
-    commandList->Close();
+    return ExecuteCommandLists({ commandList });
+}
 
-    ID3D12CommandAllocator* commandAllocator;
-    UINT dataSize = sizeof(commandAllocator);
-    ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
+uint64_t CommandQueue::ExecuteCommandLists(const std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>>& commandLists)
+{
+    std::vector<ID3D12CommandList*> ppCommandLists;
+    std::vector<ID3D12CommandAllocator*> commandAllocators;
+    for (const auto& commandList : commandLists)
+    {
+        commandList->Close();
 
-    ID3D12CommandList* const ppCommandLists[] = {
-        commandList.Get()
-    };
+        ID3D12CommandAllocator* commandAllocator;
+        UINT dataSize = sizeof(commandAllocator);
+        ThrowIfFailed(commandList->GetPrivateData(__uuidof(ID3D12CommandAllocator), &dataSize, &commandAllocator));
 
-    _commandQueue->ExecuteCommandLists(1, ppCommandLists);
+        ppCommandLists.push_back(commandList.Get());
+        commandAllocators.push_back(commandAllocator);
+    }
+
+    _commandQueue->ExecuteCommandLists(static_cast<UINT>(ppCommandLists.size()), ppCommandLists.data());
     uint64_t fenceValue = Signal();
 
-    _commandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocator });
-    _commandListQueue.push(commandList);
+    for (size_t i = 0; i < commandLists.size(); ++i)
+    {
+        _commandAllocatorQueue.emplace(CommandAllocatorEntry{ fenceValue, commandAllocators[i] });
+        _commandListQueue.push(commandLists[i]);
 
-    // The ownership of the command allocator has been transferred to the ComPtr
-    // in the command allocator queue. It is safe to release the reference 
-    // in this temporary COM pointer here.
-    commandAllocator->Release();
+        // The ownership of the command allocator has been transferred to the ComPtr
+        // in the command allocator queue. It is safe to release the reference 
+        // in this temporary COM pointer here.
+        commandAllocators[i]->Release();
+    }
 
     return fenceValue;
 }
@@ -0,0 +1,240 @@
+#include "culling.hpp"
+
+#include <bit>
+#include <cmath>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr size_t SIMD_PADDING = 8;
+
+    XMFLOAT4 NormalizePlane(XMVECTOR plane)
+    {
+        XMFLOAT4 result;
+        XMStoreFloat4(&result, XMPlaneNormalize(plane));
+        return result;
+    }
+
+    // Writes base + index of every set bit in mask.
+    inline uint32_t* CompactMask(uint32_t mask, uint32_t base, uint32_t* out)
+    {
+        while(mask != 0)
+        {
+            *out++ = base + static_cast<uint32_t>(std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+        return out;
+    }
+
+    uint32_t ValidMask(size_t count, size_t first, uint32_t width)
+    {
+        const size_t remaining = count - first;
+        return remaining >= width ? (1u << width) - 1u : (1u << remaining) - 1u;
+    }
+}
+
+Culling::Frustum Culling::ExtractFrustum(const XMMATRIX& viewProjection)
+{
+    // Clip = v * M, so the planes are combinations of the matrix columns.
+    const XMMATRIX columns = XMMatrixTranspose(viewProjection);
+
+    Frustum frustum;
+    frustum.planes[0] = NormalizePlane(XMVectorAdd(columns.r[3], columns.r[0]));      // left
+    frustum.planes[1] = NormalizePlane(XMVectorSubtract(columns.r[3], columns.r[0])); // right
+    frustum.planes[2] = NormalizePlane(XMVectorAdd(columns.r[3], columns.r[1]));      // bottom
+    frustum.planes[3] = NormalizePlane(XMVectorSubtract(columns.r[3], columns.r[1])); // top
+    frustum.planes[4] = NormalizePlane(columns.r[2]);                                 // near
+    frustum.planes[5] = NormalizePlane(XMVectorSubtract(columns.r[3], columns.r[2])); // far
+
+    return frustum;
+}
+
+Culling::Bounds Culling::ComputeBounds(const std::vector<XMFLOAT3>& positions)
+{
+    if(positions.empty())
+    {
+        return Bounds{};
+    }
+
+    XMVECTOR minimum = XMLoadFloat3(&positions[0]);
+    XMVECTOR maximum = minimum;
+    for(const XMFLOAT3& position : positions)
+    {
+        const XMVECTOR p = XMLoadFloat3(&position);
+        minimum = XMVectorMin(minimum, p);
+        maximum = XMVectorMax(maximum, p);
+    }
+
+    Bounds bounds;
+    XMStoreFloat3(&bounds.center, XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f));
+    XMStoreFloat3(&bounds.extents, XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f));
+    return bounds;
+}
+
+Culling::Bounds Culling::TransformBounds(const Bounds& bounds, const XMMATRIX& transform)
+{
+    const XMVECTOR center = XMVector3Transform(XMLoadFloat3(&bounds.center), transform);
+
+    // Project the extents on every axis of the transform's absolute 3x3 part.
+    const XMVECTOR extents = XMLoadFloat3(&bounds.extents);
+    const XMVECTOR worldExtents = XMVectorAdd(XMVectorAdd(
+        XMVectorMultiply(XMVectorSplatX(extents), XMVectorAbs(transform.r[0])),
+        XMVectorMultiply(XMVectorSplatY(extents), XMVectorAbs(transform.r[1]))),
+        XMVectorMultiply(XMVectorSplatZ(extents), XMVectorAbs(transform.r[2])));
+
+    Bounds result;
+    XMStoreFloat3(&result.center, center);
+    XMStoreFloat3(&result.extents, worldExtents);
+    return result;
+}
+
+void Culling::BoundsSoA::Clear()
+{
+    _count = 0;
+    centerX.clear(); centerY.clear(); centerZ.clear();
+    extentX.clear(); extentY.clear(); extentZ.clear();
+}
+
+void Culling::BoundsSoA::Reserve(size_t count)
+{
+    const size_t padded = (count + SIMD_PADDING - 1) & ~(SIMD_PADDING - 1);
+    centerX.reserve(padded); centerY.reserve(padded); centerZ.reserve(padded);
+    extentX.reserve(padded); extentY.reserve(padded); extentZ.reserve(padded);
+}
+
+void Culling::BoundsSoA::Add(const Bounds& bounds)
+{
+    const size_t padded = (_count + 1 + SIMD_PADDING - 1) & ~(SIMD_PADDING - 1);
+    if(centerX.size() < padded)
+    {
+        centerX.resize(padded); centerY.resize(padded); centerZ.resize(padded);
+        extentX.resize(padded); extentY.resize(padded); extentZ.resize(padded);
+    }
+
+    Set(_count++, bounds);
+}
+
+void Culling::BoundsSoA::Set(size_t index, const Bounds& bounds)
+{
+    centerX[index] = bounds.center.x;
+    centerY[index] = bounds.center.y;
+    centerZ[index] = bounds.center.z;
+    extentX[index] = bounds.extents.x;
+    extentY[index] = bounds.extents.y;
+    extentZ[index] = bounds.extents.z;
+}
+
+Culling::Bounds Culling::BoundsSoA::Get(size_t index) const
+{
+    return Bounds{
+        .center = XMFLOAT3(centerX[index], centerY[index], centerZ[index]),
+        .extents = XMFLOAT3(extentX[index], extentY[index], extentZ[index]),
+    };
+}
+
+size_t Culling::BoundsSoA::GetMemoryUsage() const
+{
+    return (centerX.capacity() + centerY.capacity() + centerZ.capacity() + extentX.capacity() + extentY.capacity() +
+        extentZ.capacity()) * sizeof(float);
+}
+
+void Culling::CullFrustum(const Frustum& frustum, const BoundsSoA& bounds, std::vector<uint32_t>& visible)
+{
+    const size_t count = bounds.GetCount();
+    visible.resize(count);
+    uint32_t* out = visible.data();
+
+    const float* cx = bounds.centerX.data();
+    const float* cy = bounds.centerY.data();
+    const float* cz = bounds.centerZ.data();
+    const float* ex = bounds.extentX.data();
+    const float* ey = bounds.extentY.data();
+    const float* ez = bounds.extentZ.data();
+
+    // A box is outside a plane when its center distance plus its projected radius is negative.
+#if defined(__AVX2__)
+    __m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for(size_t p = 0; p < 6; ++p)
+    {
+        const XMFLOAT4& plane = frustum.planes[p];
+        px[p] = _mm256_set1_ps(plane.x); ax[p] = _mm256_set1_ps(std::abs(plane.x));
+        py[p] = _mm256_set1_ps(plane.y); ay[p] = _mm256_set1_ps(std::abs(plane.y));
+        pz[p] = _mm256_set1_ps(plane.z); az[p] = _mm256_set1_ps(std::abs(plane.z));
+        pw[p] = _mm256_set1_ps(plane.w);
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    for(size_t i = 0; i < count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+        const __m256 sx = _mm256_loadu_ps(ex + i), sy = _mm256_loadu_ps(ey + i), sz = _mm256_loadu_ps(ez + i);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(size_t p = 0; p < 6; ++p)
+        {
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, px[p]), _mm256_mul_ps(y, py[p])),
+                                                  _mm256_add_ps(_mm256_mul_ps(z, pz[p]), pw[p]));
+            const __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, ax[p]), _mm256_mul_ps(sy, ay[p])),
+                                                _mm256_mul_ps(sz, az[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside)) & ValidMask(count, i, 8);
+        out = CompactMask(mask, static_cast<uint32_t>(i), out);
+    }
+#elif defined(_M_X64) || defined(__SSE2__)
+    __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+    for(size_t p = 0; p < 6; ++p)
+    {
+        const XMFLOAT4& plane = frustum.planes[p];
+        px[p] = _mm_set1_ps(plane.x); ax[p] = _mm_set1_ps(std::abs(plane.x));
+        py[p] = _mm_set1_ps(plane.y); ay[p] = _mm_set1_ps(std::abs(plane.y));
+        pz[p] = _mm_set1_ps(plane.z); az[p] = _mm_set1_ps(std::abs(plane.z));
+        pw[p] = _mm_set1_ps(plane.w);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    for(size_t i = 0; i < count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        const __m128 sx = _mm_loadu_ps(ex + i), sy = _mm_loadu_ps(ey + i), sz = _mm_loadu_ps(ez + i);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(size_t p = 0; p < 6; ++p)
+        {
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, px[p]), _mm_mul_ps(y, py[p])),
+                                               _mm_add_ps(_mm_mul_ps(z, pz[p]), pw[p]));
+            const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, ax[p]), _mm_mul_ps(sy, ay[p])),
+                                             _mm_mul_ps(sz, az[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        const uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside)) & ValidMask(count, i, 4);
+        out = CompactMask(mask, static_cast<uint32_t>(i), out);
+    }
+#else
+    for(size_t i = 0; i < count; ++i)
+    {
+        bool inside = true;
+        for(const XMFLOAT4& plane : frustum.planes)
+        {
+            const float distance = cx[i] * plane.x + cy[i] * plane.y + cz[i] * plane.z + plane.w;
+            const float radius = ex[i] * std::abs(plane.x) + ey[i] * std::abs(plane.y) + ez[i] * std::abs(plane.z);
+            if(distance + radius < 0.0f)
+            {
+                inside = false;
+                break;
+            }
+        }
+
+        if(inside)
+        {
+            *out++ = static_cast<uint32_t>(i);
+        }
+    }
+#endif
+
+    visible.resize(static_cast<size_t>(out - visible.data()));
+}
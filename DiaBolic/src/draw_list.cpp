@@ -0,0 +1,57 @@
+#include "draw_list.hpp"
+
+#include "resources.hpp"
+#include "utility/radix_sort.hpp"
+
+#include <bit>
+
+void DrawList::Clear()
+{
+    _packets.clear();
+    _sortEntries.clear();
+}
+
+void DrawList::Add(const DrawPacket& packet, float viewDepth)
+{
+    const uint64_t key = MakeSortKey(packet.pipeline, packet.material->id, packet.mesh->GetId(), viewDepth);
+
+    _sortEntries.push_back(SortEntry{ key, static_cast<uint32_t>(_packets.size()) });
+    _packets.push_back(packet);
+}
+
+void DrawList::Sort()
+{
+    Util::RadixSort(_sortEntries, _sortScratch, [](const SortEntry& entry) { return entry.key; });
+}
+
+uint32_t DrawList::GetInstanceCount(size_t first) const
+{
+    const DrawPacket& firstPacket = GetSorted(first);
+
+    size_t last = first + 1;
+    while(last < _sortEntries.size())
+    {
+        const DrawPacket& packet = GetSorted(last);
+        if(packet.pipeline != firstPacket.pipeline || packet.material != firstPacket.material || packet.mesh != firstPacket.mesh)
+        {
+            break;
+        }
+        ++last;
+    }
+
+    return static_cast<uint32_t>(last - first);
+}
+
+uint64_t DrawList::MakeSortKey(uint32_t pipeline, uint32_t materialId, uint32_t meshId, float viewDepth)
+{
+    // Positive floats keep their order when compared as integers, the top 24 bits of the magnitude are enough
+    // for a front to back order. Anything behind the camera sorts first.
+    const uint32_t depthBits = viewDepth > 0.0f ? (std::bit_cast<uint32_t>(viewDepth) >> 7) : 0u;
+
+    // Larger ids would share a key with others. Masked, they only cost batching, never spill into another field.
+    assert(pipeline <= MAX_PIPELINE_ID && materialId <= MAX_MATERIAL_ID && meshId <= MAX_MESH_ID && "Id doesn't fit in the sort key.");
+    return (static_cast<uint64_t>(pipeline & MAX_PIPELINE_ID) << 56)
+        | (static_cast<uint64_t>(materialId & MAX_MATERIAL_ID) << 40)
+        | (static_cast<uint64_t>(meshId & MAX_MESH_ID) << 24)
+        | static_cast<uint64_t>(depthBits & 0xFFFFFF);
+}
@@ -0,0 +1,163 @@
+#include "geometry_buffer.hpp"
+
+#include "utility/log.hpp"
+
+#include "renderer.hpp"
+
+#include <numeric>
+
+using namespace Microsoft::WRL;
+using namespace DirectX;
+
+namespace
+{
+    // A structured buffer view over the whole stream, it has to start at a whole element.
+    GpuAllocation AllocateStream(GpuAllocator& allocator, uint32_t capacity, uint32_t stride)
+    {
+        return allocator.AllocateBuffer(static_cast<uint64_t>(capacity) * stride, std::lcm(GpuAllocator::BUFFER_ALIGNMENT, static_cast<uint64_t>(stride)));
+    }
+
+    uint32_t CreateStreamSrv(Renderer& renderer, const GpuAllocation& stream, uint32_t capacity, uint32_t stride)
+    {
+        const D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
+            .Format = DXGI_FORMAT_UNKNOWN,
+            .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
+            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+            .Buffer = {
+                .FirstElement = stream.offset / stride,
+                .NumElements = capacity,
+                .StructureByteStride = stride,
+            },
+        };
+        return renderer.CreateSrv(srvDesc, stream.resource);
+    }
+
+    // Copies one stream of a mesh from the intermediate, or zeroes it when the mesh doesn't have it.
+    template<typename T>
+    void CopyStream(const ComPtr<ID3D12GraphicsCommandList2>& commandList, const GpuAllocation& stream, uint32_t first, uint32_t count,
+        const std::vector<T>& data, const GpuAllocation& intermediate, uint64_t& intermediateOffset)
+    {
+        const uint64_t size = static_cast<uint64_t>(count) * sizeof(T);
+        uint8_t* destination = static_cast<uint8_t*>(intermediate.cpuAddress) + intermediateOffset;
+        if(data.empty())
+        {
+            std::memset(destination, 0, size);
+        }
+        else
+        {
+            std::memcpy(destination, data.data(), size);
+        }
+
+        commandList->CopyBufferRegion(stream.resource.Get(), stream.offset + static_cast<uint64_t>(first) * sizeof(T),
+            intermediate.resource.Get(), intermediate.offset + intermediateOffset, size);
+        intermediateOffset += (size + 3) & ~3ull;
+    }
+}
+
+GeometryBuffer::GeometryBuffer(Renderer& renderer, uint32_t vertexCapacity, uint32_t indexCapacity) :
+    _allocator(renderer.GetGpuAllocator()),
+    _vertexAllocator(vertexCapacity, 1),
+    _indexAllocator(indexCapacity, 1)
+{
+    _positions = AllocateStream(_allocator, vertexCapacity, sizeof(XMFLOAT3));
+    _normals = AllocateStream(_allocator, vertexCapacity, sizeof(XMFLOAT3));
+    _uvs = AllocateStream(_allocator, vertexCapacity, sizeof(XMFLOAT2));
+    _indices = _allocator.AllocateBuffer(static_cast<uint64_t>(indexCapacity) * sizeof(uint16_t));
+
+    _positionSrvIndex = CreateStreamSrv(renderer, _positions, vertexCapacity, sizeof(XMFLOAT3));
+    _normalSrvIndex = CreateStreamSrv(renderer, _normals, vertexCapacity, sizeof(XMFLOAT3));
+    _uvSrvIndex = CreateStreamSrv(renderer, _uvs, vertexCapacity, sizeof(XMFLOAT2));
+
+    _indexBufferView = {
+        .BufferLocation = _indices.gpuAddress,
+        .SizeInBytes = static_cast<UINT>(_indices.size),
+        .Format = DXGI_FORMAT_R16_UINT,
+    };
+}
+
+GeometryBuffer::~GeometryBuffer()
+{
+    _allocator.Free(_positions);
+    _allocator.Free(_normals);
+    _allocator.Free(_uvs);
+    _allocator.Free(_indices);
+}
+
+GeometryBuffer::Allocation GeometryBuffer::Upload(const ComPtr<ID3D12GraphicsCommandList2>& commandList,
+    const std::vector<XMFLOAT3>& positions, const std::vector<XMFLOAT3>& normals,
+    const std::vector<XMFLOAT2>& uvs, const std::vector<uint16_t>& indices, GpuAllocation& intermediate)
+{
+    assert((normals.empty() || normals.size() == positions.size()) && (uvs.empty() || uvs.size() == positions.size()) && "Streams differ in length.");
+
+    // Nothing to draw, the mesh gets empty ranges.
+    Allocation allocation;
+    if(positions.empty() || indices.empty())
+    {
+        return allocation;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        allocation.vertices = _vertexAllocator.Allocate(positions.size(), 1);
+        allocation.indices = _indexAllocator.Allocate(indices.size(), 1);
+    }
+    if(!allocation.vertices.IsValid() || !allocation.indices.IsValid())
+    {
+        dblog::error("[GEOMETRY_BUFFER] No room for {} vertices and {} indices.", positions.size(), indices.size());
+        Free(allocation);
+        throw std::exception();
+    }
+
+    allocation.vertexOffset = static_cast<uint32_t>(allocation.vertices.offset);
+    allocation.vertexCount = static_cast<uint32_t>(positions.size());
+    allocation.firstIndex = static_cast<uint32_t>(allocation.indices.offset);
+    allocation.indexCount = static_cast<uint32_t>(indices.size());
+
+    // All streams of the mesh in one upload, one after the other.
+    const uint64_t vertexBytes = static_cast<uint64_t>(allocation.vertexCount) * (2 * sizeof(XMFLOAT3) + sizeof(XMFLOAT2));
+    const uint64_t indexBytes = (static_cast<uint64_t>(allocation.indexCount) * sizeof(uint16_t) + 3) & ~3ull;
+    try
+    {
+        intermediate = _allocator.AllocateBuffer(vertexBytes + indexBytes, GpuAllocator::BUFFER_ALIGNMENT, D3D12_HEAP_TYPE_UPLOAD);
+    }
+    catch(...)
+    {
+        // The mesh never gets its ranges.
+        Free(allocation);
+        throw;
+    }
+
+    uint64_t intermediateOffset = 0;
+    CopyStream(commandList, _positions, allocation.vertexOffset, allocation.vertexCount, positions, intermediate, intermediateOffset);
+    CopyStream(commandList, _normals, allocation.vertexOffset, allocation.vertexCount, normals, intermediate, intermediateOffset);
+    CopyStream(commandList, _uvs, allocation.vertexOffset, allocation.vertexCount, uvs, intermediate, intermediateOffset);
+    CopyStream(commandList, _indices, allocation.firstIndex, allocation.indexCount, indices, intermediate, intermediateOffset);
+
+    return allocation;
+}
+
+void GeometryBuffer::Free(Allocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(allocation.vertices.IsValid())
+    {
+        _vertexAllocator.Free(allocation.vertices);
+    }
+    if(allocation.indices.IsValid())
+    {
+        _indexAllocator.Free(allocation.indices);
+    }
+    allocation = {};
+}
+
+GeometryBuffer::Stats GeometryBuffer::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Util::TlsfAllocator::Stats vertices = _vertexAllocator.GetStats();
+    return Stats{
+        .meshCount = vertices.allocationCount,
+        .vertices = vertices,
+        .indices = _indexAllocator.GetStats(),
+        .bytes = _positions.size + _normals.size + _uvs.size + _indices.size,
+    };
+}
@@ -0,0 +1,243 @@
+#include "gpu_allocator.hpp"
+
+#include "utility/dx12_helpers.hpp"
+#include "utility/log.hpp"
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+GpuAllocator::GpuAllocator(const ComPtr<ID3D12Device2>& device) :
+    _device(device)
+{
+
+}
+
+GpuAllocator::~GpuAllocator()
+{
+    for(uint32_t pool = 0; pool < static_cast<uint32_t>(Pool::Count); ++pool)
+    {
+        const PoolStats stats = GetStats(static_cast<Pool>(pool));
+        if(stats.memory.allocationCount > 0)
+        {
+            dblog::error("[GPU_ALLOCATOR] {} allocations of {} bytes still alive in the {} pool.",
+                stats.memory.allocationCount, stats.memory.requestedBytes, GetPoolName(static_cast<Pool>(pool)));
+        }
+    }
+}
+
+GpuAllocation GpuAllocator::AllocateBuffer(uint64_t size, uint64_t alignment, D3D12_HEAP_TYPE heapType)
+{
+    assert((heapType == D3D12_HEAP_TYPE_DEFAULT || heapType == D3D12_HEAP_TYPE_UPLOAD) && "Only default and upload buffers are pooled.");
+    assert(alignment % BUFFER_ALIGNMENT == 0 && "Buffers are aligned to at least BUFFER_ALIGNMENT.");
+
+    const Pool pool = heapType == D3D12_HEAP_TYPE_UPLOAD ? Pool::UploadBuffers : Pool::Buffers;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    bool createdHeap = false;
+    GpuAllocation allocation = Allocate(pool, size, alignment, createdHeap);
+
+    const Heap& heap = *_pools[allocation.pool].heaps[allocation.heap];
+    allocation.resource = heap.buffer;
+    allocation.offset = allocation.range.offset;
+    allocation.gpuAddress = heap.buffer->GetGPUVirtualAddress() + allocation.offset;
+    allocation.cpuAddress = heap.mappedData ? heap.mappedData + allocation.offset : nullptr;
+    return allocation;
+}
+
+GpuAllocation GpuAllocator::CreateTexture(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, const D3D12_CLEAR_VALUE* clearValue)
+{
+    const bool renderTarget = (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+    const Pool pool = renderTarget ? Pool::RenderTargets : Pool::Textures;
+
+    // Small textures can be placed at 4KB, the device says whether this one is small enough.
+    D3D12_RESOURCE_DESC placedDesc = desc;
+    D3D12_RESOURCE_ALLOCATION_INFO info{};
+    if(!renderTarget && desc.SampleDesc.Count <= 1)
+    {
+        placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        info = _device->GetResourceAllocationInfo(0, 1, &placedDesc);
+    }
+    if(info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+    {
+        placedDesc.Alignment = 0;
+        info = _device->GetResourceAllocationInfo(0, 1, &placedDesc);
+    }
+    if(info.SizeInBytes == UINT64_MAX)
+    {
+        dblog::error("[GPU_ALLOCATOR] Invalid texture description.");
+        throw std::exception();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    bool createdHeap = false;
+    GpuAllocation allocation = Allocate(pool, info.SizeInBytes, info.Alignment, createdHeap);
+
+    const Heap& heap = *_pools[allocation.pool].heaps[allocation.heap];
+    const HRESULT result = _device->CreatePlacedResource(heap.heap.Get(), allocation.range.offset, &placedDesc, initialState, clearValue,
+        IID_PPV_ARGS(&allocation.resource));
+    if(FAILED(result))
+    {
+        // A heap made just for this texture would otherwise stay around empty, it may be a large one.
+        Release(allocation, createdHeap);
+        Util::ThrowIfFailed(result);
+    }
+    return allocation;
+}
+
+void GpuAllocator::Free(GpuAllocation& allocation)
+{
+    if(!allocation.IsValid())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Release(allocation, false);
+    allocation = {};
+}
+
+GpuAllocator::PoolStats GpuAllocator::GetStats(Pool pool) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const PoolState& state = _pools[static_cast<uint32_t>(pool)];
+
+    PoolStats stats{ .committedBytes = state.committedBytes };
+    for(const auto& heap : state.heaps)
+    {
+        if(!heap)
+        {
+            continue;
+        }
+
+        const Util::TlsfAllocator::Stats heapStats = heap->allocator->GetStats();
+        ++stats.heapCount;
+        stats.memory.size += heapStats.size;
+        stats.memory.usedBytes += heapStats.usedBytes;
+        stats.memory.requestedBytes += heapStats.requestedBytes;
+        stats.memory.freeBytes += heapStats.freeBytes;
+        stats.memory.largestFreeBlock = std::max(stats.memory.largestFreeBlock, heapStats.largestFreeBlock);
+        stats.memory.allocationCount += heapStats.allocationCount;
+        stats.memory.freeBlockCount += heapStats.freeBlockCount;
+    }
+    return stats;
+}
+
+const char* GpuAllocator::GetPoolName(Pool pool)
+{
+    switch(pool)
+    {
+    case Pool::Buffers: return "buffer";
+    case Pool::UploadBuffers: return "upload buffer";
+    case Pool::Textures: return "texture";
+    case Pool::RenderTargets: return "render target";
+    default: return "unknown";
+    }
+}
+
+const GpuAllocator::PoolDesc& GpuAllocator::GetPoolDesc(Pool pool)
+{
+    // Render targets can be multisampled, those need 4MB alignment and so does their heap.
+    static const PoolDesc descs[] = {
+        { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, 32u << 20, BUFFER_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT },
+        { D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS, 16u << 20, BUFFER_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT },
+        { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES, 64u << 20, D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT },
+        { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES, 64u << 20, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT },
+    };
+    static_assert(std::size(descs) == static_cast<size_t>(Pool::Count));
+    return descs[static_cast<uint32_t>(pool)];
+}
+
+GpuAllocation GpuAllocator::Allocate(Pool pool, uint64_t size, uint64_t alignment, bool& createdHeap)
+{
+    const PoolDesc& desc = GetPoolDesc(pool);
+    PoolState& state = _pools[static_cast<uint32_t>(pool)];
+
+    GpuAllocation allocation{ .size = size, .pool = static_cast<uint32_t>(pool) };
+    for(uint32_t heap = 0; heap < state.heaps.size() && !allocation.IsValid(); ++heap)
+    {
+        if(state.heaps[heap])
+        {
+            allocation.range = state.heaps[heap]->allocator->Allocate(size, alignment);
+            allocation.heap = heap;
+        }
+    }
+
+    // Resources larger than a heap get a heap of their own.
+    if(!allocation.IsValid())
+    {
+        allocation.heap = CreateHeap(pool, AlignUp(size, std::max(alignment, desc.granularity)));
+        allocation.range = state.heaps[allocation.heap]->allocator->Allocate(size, alignment);
+        createdHeap = true;
+        assert(allocation.IsValid() && "A new heap is always large enough.");
+    }
+
+    state.committedBytes += AlignUp(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+    return allocation;
+}
+
+void GpuAllocator::Release(const GpuAllocation& allocation, bool releaseEmptyHeap)
+{
+    PoolState& pool = _pools[allocation.pool];
+    std::unique_ptr<Heap>& heap = pool.heaps[allocation.heap];
+    heap->allocator->Free(allocation.range);
+    pool.committedBytes -= AlignUp(allocation.size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+    // Keep one heap around so a pool doesn't create and release a heap over and over.
+    if(heap->allocator->IsEmpty())
+    {
+        const auto heapCount = std::count_if(pool.heaps.begin(), pool.heaps.end(), [](const std::unique_ptr<Heap>& other) { return other != nullptr; });
+        if(releaseEmptyHeap || heapCount > 1)
+        {
+            heap.reset();
+        }
+    }
+}
+
+uint32_t GpuAllocator::CreateHeap(Pool pool, uint64_t minimumSize)
+{
+    const PoolDesc& desc = GetPoolDesc(pool);
+    PoolState& state = _pools[static_cast<uint32_t>(pool)];
+
+    auto heap = std::make_unique<Heap>();
+    const uint64_t size = AlignUp(std::max(minimumSize, desc.heapSize), desc.heapAlignment);
+
+    const CD3DX12_HEAP_DESC heapDesc(size, desc.heapType, desc.heapAlignment, desc.heapFlags);
+    Util::ThrowIfFailed(_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap->heap)));
+
+    if(desc.heapFlags == D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS)
+    {
+        const bool upload = desc.heapType == D3D12_HEAP_TYPE_UPLOAD;
+        const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size,
+            upload ? D3D12_RESOURCE_FLAG_NONE : D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        Util::ThrowIfFailed(_device->CreatePlacedResource(heap->heap.Get(), 0, &bufferDesc,
+            upload ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&heap->buffer)));
+        heap->buffer->SetName(upload ? L"Upload Buffer Pool" : L"Buffer Pool");
+
+        if(upload)
+        {
+            // We do not intend to read from this resource on the CPU.
+            const CD3DX12_RANGE readRange(0, 0);
+            Util::ThrowIfFailed(heap->buffer->Map(0, &readRange, reinterpret_cast<void**>(&heap->mappedData)));
+        }
+    }
+
+    heap->allocator = std::make_unique<Util::TlsfAllocator>(size, desc.granularity);
+    dblog::info("[GPU_ALLOCATOR] Created a {} byte heap for the {} pool.", size, GetPoolName(pool));
+
+    // Fill an empty slot first, so allocations keep their index.
+    auto slot = std::find(state.heaps.begin(), state.heaps.end(), nullptr);
+    if(slot != state.heaps.end())
+    {
+        *slot = std::move(heap);
+        return static_cast<uint32_t>(slot - state.heaps.begin());
+    }
+    state.heaps.push_back(std::move(heap));
+    return static_cast<uint32_t>(state.heaps.size() - 1);
+}
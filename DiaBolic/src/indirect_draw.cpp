@@ -0,0 +1,44 @@
+#include "indirect_draw.hpp"
+
+#include "utility/dx12_helpers.hpp"
+
+// PackCommand() writes the D3D12 struct's bytes.
+static_assert(sizeof(IndirectDraw::DrawIndexedArguments) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+static_assert(offsetof(IndirectDraw::DrawIndexedArguments, indexCountPerInstance) == offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, IndexCountPerInstance));
+static_assert(offsetof(IndirectDraw::DrawIndexedArguments, instanceCount) == offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, InstanceCount));
+static_assert(offsetof(IndirectDraw::DrawIndexedArguments, startIndexLocation) == offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, StartIndexLocation));
+static_assert(offsetof(IndirectDraw::DrawIndexedArguments, baseVertexLocation) == offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, BaseVertexLocation));
+static_assert(offsetof(IndirectDraw::DrawIndexedArguments, startInstanceLocation) == offsetof(D3D12_DRAW_INDEXED_ARGUMENTS, StartInstanceLocation));
+
+std::array<D3D12_INDIRECT_ARGUMENT_DESC, IndirectDraw::ARGUMENT_COUNT> IndirectDraw::MakeArgumentDescs(const Layout& layout)
+{
+    std::array<D3D12_INDIRECT_ARGUMENT_DESC, ARGUMENT_COUNT> arguments{};
+
+    arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+    arguments[0].Constant.RootParameterIndex = layout.rootParameterIndex;
+    arguments[0].Constant.DestOffsetIn32BitValues = 0;
+    arguments[0].Constant.Num32BitValuesToSet = layout.rootConstantCount;
+
+    arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+    return arguments;
+}
+
+Microsoft::WRL::ComPtr<ID3D12CommandSignature> IndirectDraw::CreateCommandSignature(
+    const Microsoft::WRL::ComPtr<ID3D12Device2>& device, const Microsoft::WRL::ComPtr<ID3D12RootSignature>& rootSignature, const Layout& layout)
+{
+    const auto arguments = MakeArgumentDescs(layout);
+
+    const D3D12_COMMAND_SIGNATURE_DESC desc = {
+        .ByteStride = layout.byteStride,
+        .NumArgumentDescs = static_cast<UINT>(arguments.size()),
+        .pArgumentDescs = arguments.data(),
+        .NodeMask = 0u,
+    };
+
+    // Root signature is required since the commands change root constants.
+    Microsoft::WRL::ComPtr<ID3D12CommandSignature> commandSignature;
+    Util::ThrowIfFailed(device->CreateCommandSignature(&desc, rootSignature.Get(), IID_PPV_ARGS(&commandSignature)));
+
+    return commandSignature;
+}
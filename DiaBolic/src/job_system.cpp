@@ -0,0 +1,206 @@
+#include "job_system.hpp"
+
+#include "utility/log.hpp"
+
+namespace
+{
+    // The queue the thread pushes to and pops from. Threads outside the pool get the shared one.
+    thread_local uint32_t threadQueueIndex = UINT32_MAX;
+    // Low priority jobs the thread is in the middle of, nested when one waits on another.
+    thread_local uint32_t lowPriorityDepth = 0;
+}
+
+JobSystem& JobSystem::Get()
+{
+    static JobSystem jobSystem{};
+    return jobSystem;
+}
+
+JobSystem::JobSystem()
+{
+    // Leave a core for the main thread, it helps out whenever it waits. hardware_concurrency() is 0 when unknown.
+    const uint32_t workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1u;
+    for(uint32_t i = 0; i < workerCount + 1; ++i)
+    {
+        _queues.push_back(std::make_unique<Queue>());
+    }
+    for(uint32_t i = 0; i < workerCount; ++i)
+    {
+        _workers.emplace_back([this, i](std::stop_token stopToken) { WorkerLoop(stopToken, i); });
+    }
+    dblog::info("[JOB_SYSTEM] Started {} worker threads.", workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+    for(auto& worker : _workers)
+    {
+        worker.request_stop();
+    }
+}
+
+void JobSystem::Run(std::function<void()> job, Counter* counter, Priority priority)
+{
+    if(counter)
+    {
+        counter->_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const uint32_t queueIndex = threadQueueIndex != UINT32_MAX ? threadQueueIndex : static_cast<uint32_t>(_queues.size() - 1);
+    Queue& queue = priority == Priority::Low ? _lowPriorityQueue : *_queues[queueIndex];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(Job{ std::move(job), counter, priority });
+    }
+    _queuedJobs.fetch_add(1, std::memory_order_release);
+
+    {
+        // A worker that just found nothing to do may be about to sleep, taking the lock makes sure it sees the job.
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wakeUp.notify_one();
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+    if(count == 0)
+    {
+        return;
+    }
+    grainSize = std::max<size_t>(grainSize, 1);
+
+    Counter counter;
+    for(size_t begin = grainSize; begin < count; begin += grainSize)
+    {
+        const size_t end = std::min(begin + grainSize, count);
+        Run([&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    body(0, std::min(grainSize, count));
+    Wait(counter);
+}
+
+void JobSystem::Wait(const Counter& counter)
+{
+    while(!counter.IsDone())
+    {
+        if(!RunOneJob())
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+JobSystem::Stats JobSystem::GetStats() const
+{
+    return Stats{
+        .jobsRun = _jobsRun.load(std::memory_order_relaxed),
+        .jobsStolen = _jobsStolen.load(std::memory_order_relaxed),
+        .lowPriorityJobsRun = _lowPriorityJobsRun.load(std::memory_order_relaxed),
+    };
+}
+
+void JobSystem::WorkerLoop(std::stop_token stopToken, uint32_t queueIndex)
+{
+    threadQueueIndex = queueIndex;
+
+    while(!stopToken.stop_requested())
+    {
+        if(RunOneJob() || RunLowPriorityJob())
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wakeUp.wait(lock, stopToken, [this] { return _queuedJobs.load(std::memory_order_acquire) > 0; });
+    }
+}
+
+bool JobSystem::RunOneJob()
+{
+    const uint32_t queueIndex = threadQueueIndex != UINT32_MAX ? threadQueueIndex : static_cast<uint32_t>(_queues.size() - 1);
+
+    Job job;
+    if(!PopJob(queueIndex, job) && !StealJob(queueIndex, job) && (lowPriorityDepth == 0 || !PopLowPriorityJob(job)))
+    {
+        return false;
+    }
+    Execute(job);
+    return true;
+}
+
+bool JobSystem::RunLowPriorityJob()
+{
+    Job job;
+    if(!PopLowPriorityJob(job))
+    {
+        return false;
+    }
+    Execute(job);
+    return true;
+}
+
+void JobSystem::Execute(Job& job)
+{
+    _queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+
+    const bool lowPriority = job.priority == Priority::Low;
+    lowPriorityDepth += lowPriority ? 1u : 0u;
+    job.function();
+    lowPriorityDepth -= lowPriority ? 1u : 0u;
+    _jobsRun.fetch_add(1, std::memory_order_relaxed);
+    _lowPriorityJobsRun.fetch_add(lowPriority ? 1u : 0u, std::memory_order_relaxed);
+
+    if(job.counter)
+    {
+        // Release, so whoever sees the counter reach zero also sees everything the job wrote.
+        job.counter->_count.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+bool JobSystem::PopJob(uint32_t queueIndex, Job& job)
+{
+    // Newest first, its data is most likely still in cache.
+    Queue& queue = *_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.jobs.empty())
+    {
+        return false;
+    }
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::StealJob(uint32_t thiefIndex, Job& job)
+{
+    // Oldest first, those tend to be the big ones that still split into more jobs.
+    // Start at a different queue per thief so they don't all pile onto the same one.
+    const uint32_t queueCount = static_cast<uint32_t>(_queues.size());
+    for(uint32_t i = 1; i < queueCount; ++i)
+    {
+        Queue& queue = *_queues[(thiefIndex + i) % queueCount];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if(!lock.owns_lock() || queue.jobs.empty())
+        {
+            continue;
+        }
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        _jobsStolen.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::PopLowPriorityJob(Job& job)
+{
+    // Oldest first, in the order they were requested.
+    std::lock_guard<std::mutex> lock(_lowPriorityQueue.mutex);
+    if(_lowPriorityQueue.jobs.empty())
+    {
+        return false;
+    }
+    job = std::move(_lowPriorityQueue.jobs.front());
+    _lowPriorityQueue.jobs.pop_front();
+    return true;
+}
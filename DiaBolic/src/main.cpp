@@ -27,9 +27,14 @@ int main()
 
 		g_app->Update();
 		g_sample->Update();
+		// Hands the frame to the render thread, which draws it while the next one is simulated.
 		g_renderer->Update(static_cast<float>(deltaTime.count() * 1e-9), static_cast<GLFWwindow*>(g_app->GetWindow()));
-		g_renderer->Render();
 	}
 
+	// Before the statics they use go away, the renderer's threads are still running.
+	g_sample.reset();
+	g_renderer.reset();
+	g_app.reset();
+
 	return 0;
 }
\ No newline at end of file
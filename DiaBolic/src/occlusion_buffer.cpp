@@ -0,0 +1,266 @@
+#include "occlusion_buffer.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr float FAR_DEPTH = 1.0f;
+    constexpr float MIN_CLIP_W = 1e-4f;
+    constexpr float MIN_TRIANGLE_AREA = 1e-6f;
+
+    // Clip space to pixel coordinates with y pointing down, z becomes depth.
+    XMFLOAT3 ToScreen(const XMFLOAT4& clip)
+    {
+        const float invW = 1.0f / clip.w;
+        return XMFLOAT3(
+            (clip.x * invW * 0.5f + 0.5f) * Culling::OcclusionBuffer::WIDTH,
+            (0.5f - clip.y * invW * 0.5f) * Culling::OcclusionBuffer::HEIGHT,
+            clip.z * invW);
+    }
+
+    // Edge function A * x + B * y + C, positive on the inner side of a counter clockwise (in pixel space) edge.
+    struct Edge
+    {
+        float a, b, c;
+
+        Edge(const XMFLOAT3& from, const XMFLOAT3& to)
+        {
+            a = from.y - to.y;
+            b = to.x - from.x;
+            c = -(a * from.x + b * from.y);
+        }
+    };
+}
+
+Culling::OcclusionBuffer::OcclusionBuffer()
+{
+    _depth.resize(WIDTH * HEIGHT);
+    Clear();
+}
+
+void Culling::OcclusionBuffer::Clear()
+{
+    std::fill(_depth.begin(), _depth.end(), FAR_DEPTH);
+    _tileMaxDepth.fill(FAR_DEPTH);
+    _triangleCount = 0;
+}
+
+void Culling::OcclusionBuffer::RasterizeOccluder(const std::vector<XMFLOAT3>& positions, const std::vector<uint16_t>& indices,
+                                                 const XMMATRIX& worldViewProjection)
+{
+    _clipVertices.resize(positions.size());
+    for(size_t i = 0; i < positions.size(); ++i)
+    {
+        XMStoreFloat4(&_clipVertices[i], XMVector3Transform(XMLoadFloat3(&positions[i]), worldViewProjection));
+    }
+
+    for(size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const XMFLOAT4& c0 = _clipVertices[indices[i + 0]];
+        const XMFLOAT4& c1 = _clipVertices[indices[i + 1]];
+        const XMFLOAT4& c2 = _clipVertices[indices[i + 2]];
+
+        // No clipping, a triangle that reaches past the near plane just doesn't occlude.
+        if(c0.w < MIN_CLIP_W || c1.w < MIN_CLIP_W || c2.w < MIN_CLIP_W || c0.z < 0.0f || c1.z < 0.0f || c2.z < 0.0f)
+        {
+            continue;
+        }
+
+        RasterizeTriangle(ToScreen(c0), ToScreen(c1), ToScreen(c2));
+    }
+}
+
+void Culling::OcclusionBuffer::RasterizeTriangle(const XMFLOAT3& v0, const XMFLOAT3& first, const XMFLOAT3& second)
+{
+    // Twice the signed area.
+    float area = (first.x - v0.x) * (second.y - v0.y) - (first.y - v0.y) * (second.x - v0.x);
+    if(std::abs(area) < MIN_TRIANGLE_AREA)
+    {
+        return;
+    }
+
+    // Both windings occlude, flip clockwise triangles so the edge functions are positive inside.
+    const bool flip = area < 0.0f;
+    const XMFLOAT3& v1 = flip ? second : first;
+    const XMFLOAT3& v2 = flip ? first : second;
+    area = std::abs(area);
+
+    // Pixels whose center lies inside the bounding box.
+    const float minX = std::min({ v0.x, v1.x, v2.x }), maxX = std::max({ v0.x, v1.x, v2.x });
+    const float minY = std::min({ v0.y, v1.y, v2.y }), maxY = std::max({ v0.y, v1.y, v2.y });
+    const int x0 = std::max(0, static_cast<int>(std::ceil(std::max(minX, -1.0f) - 0.5f)));
+    const int x1 = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(std::min(maxX, static_cast<float>(WIDTH + 1)) - 0.5f)));
+    const int y0 = std::max(0, static_cast<int>(std::ceil(std::max(minY, -1.0f) - 0.5f)));
+    const int y1 = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(std::min(maxY, static_cast<float>(HEIGHT + 1)) - 0.5f)));
+    if(x0 > x1 || y0 > y1)
+    {
+        return;
+    }
+
+    _triangleCount++;
+
+    // Edge i is opposite vertex i, so edge i divided by the area is the barycentric weight of vertex i.
+    const Edge e0(v1, v2);
+    const Edge e1(v2, v0);
+    const Edge e2(v0, v1);
+
+    // z / w is linear in screen space. Write the farthest depth a pixel reaches, which never exceeds the farthest vertex.
+    const float invArea = 1.0f / area;
+    const float zx = (e0.a * v0.z + e1.a * v1.z + e2.a * v2.z) * invArea;
+    const float zy = (e0.b * v0.z + e1.b * v1.z + e2.b * v2.z) * invArea;
+    const float zc = (e0.c * v0.z + e1.c * v1.z + e2.c * v2.z) * invArea + 0.5f * (std::abs(zx) + std::abs(zy));
+    const float zMax = std::max({ v0.z, v1.z, v2.z });
+
+#if defined(_M_X64) || defined(__SSE2__)
+    const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 a0 = _mm_set1_ps(e0.a), a1 = _mm_set1_ps(e1.a), a2 = _mm_set1_ps(e2.a);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 depthX = _mm_set1_ps(zx);
+    const __m128 depthMax = _mm_set1_ps(zMax);
+
+    // Blocks of 4 start at a multiple of 4, WIDTH is one too so a block never crosses a row.
+    const int xStart = x0 & ~3;
+    for(int y = y0; y <= y1; ++y)
+    {
+        const float py = static_cast<float>(y) + 0.5f;
+        const __m128 row0 = _mm_set1_ps(e0.b * py + e0.c);
+        const __m128 row1 = _mm_set1_ps(e1.b * py + e1.c);
+        const __m128 row2 = _mm_set1_ps(e2.b * py + e2.c);
+        const __m128 rowDepth = _mm_set1_ps(zy * py + zc);
+        float* depthRow = _depth.data() + static_cast<size_t>(y) * WIDTH;
+
+        for(int x = xStart; x <= x1; x += 4)
+        {
+            const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), pixelOffsets);
+            const __m128 inside = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero),
+                           _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero));
+            if(_mm_movemask_ps(inside) == 0)
+            {
+                continue;
+            }
+
+            const __m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthX, px), rowDepth), depthMax);
+            const __m128 old = _mm_loadu_ps(depthRow + x);
+            const __m128 nearest = _mm_min_ps(old, depth);
+            _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for(int y = y0; y <= y1; ++y)
+    {
+        const float py = static_cast<float>(y) + 0.5f;
+        float* depthRow = _depth.data() + static_cast<size_t>(y) * WIDTH;
+
+        for(int x = x0; x <= x1; ++x)
+        {
+            const float px = static_cast<float>(x) + 0.5f;
+            if(e0.a * px + (e0.b * py + e0.c) < 0.0f ||
+               e1.a * px + (e1.b * py + e1.c) < 0.0f ||
+               e2.a * px + (e2.b * py + e2.c) < 0.0f)
+            {
+                continue;
+            }
+
+            const float depth = std::min(zx * px + (zy * py + zc), zMax);
+            depthRow[x] = std::min(depthRow[x], depth);
+        }
+    }
+#endif
+}
+
+void Culling::OcclusionBuffer::Finalize()
+{
+    for(uint32_t ty = 0; ty < TILES_Y; ++ty)
+    {
+        for(uint32_t tx = 0; tx < TILES_X; ++tx)
+        {
+            float maxDepth = 0.0f;
+            for(uint32_t y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; ++y)
+            {
+                const float* depthRow = _depth.data() + static_cast<size_t>(y) * WIDTH + tx * TILE_SIZE;
+                for(uint32_t x = 0; x < TILE_SIZE; ++x)
+                {
+                    maxDepth = std::max(maxDepth, depthRow[x]);
+                }
+            }
+            _tileMaxDepth[ty * TILES_X + tx] = maxDepth;
+        }
+    }
+}
+
+bool Culling::OcclusionBuffer::IsVisible(const Bounds& bounds, const XMMATRIX& viewProjection) const
+{
+    float minX = FLT_MAX, maxX = -FLT_MAX;
+    float minY = FLT_MAX, maxY = -FLT_MAX;
+    float nearestDepth = FLT_MAX;
+
+    for(uint32_t i = 0; i < 8; ++i)
+    {
+        const XMFLOAT3 corner(
+            bounds.center.x + ((i & 1) ? bounds.extents.x : -bounds.extents.x),
+            bounds.center.y + ((i & 2) ? bounds.extents.y : -bounds.extents.y),
+            bounds.center.z + ((i & 4) ? bounds.extents.z : -bounds.extents.z));
+
+        XMFLOAT4 clip;
+        XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), viewProjection));
+
+        // Boxes reaching past the near plane are always kept.
+        if(clip.w < MIN_CLIP_W || clip.z < 0.0f)
+        {
+            return true;
+        }
+
+        const XMFLOAT3 screen = ToScreen(clip);
+        minX = std::min(minX, screen.x); maxX = std::max(maxX, screen.x);
+        minY = std::min(minY, screen.y); maxY = std::max(maxY, screen.y);
+        nearestDepth = std::min(nearestDepth, screen.z);
+    }
+
+    // Every pixel the screen rectangle touches.
+    const int x0 = std::max(0, static_cast<int>(std::floor(std::max(minX, -1.0f))));
+    const int x1 = std::min(static_cast<int>(WIDTH) - 1, static_cast<int>(std::floor(std::min(maxX, static_cast<float>(WIDTH)))));
+    const int y0 = std::max(0, static_cast<int>(std::floor(std::max(minY, -1.0f))));
+    const int y1 = std::min(static_cast<int>(HEIGHT) - 1, static_cast<int>(std::floor(std::min(maxY, static_cast<float>(HEIGHT)))));
+    if(x0 > x1 || y0 > y1)
+    {
+        // Off screen, that is the frustum test's call to make.
+        return true;
+    }
+
+    for(int ty = y0 / static_cast<int>(TILE_SIZE); ty <= y1 / static_cast<int>(TILE_SIZE); ++ty)
+    {
+        for(int tx = x0 / static_cast<int>(TILE_SIZE); tx <= x1 / static_cast<int>(TILE_SIZE); ++tx)
+        {
+            // Every occluder in this tile is nearer than the box.
+            if(_tileMaxDepth[ty * TILES_X + tx] < nearestDepth)
+            {
+                continue;
+            }
+
+            const int tileX0 = std::max(x0, tx * static_cast<int>(TILE_SIZE));
+            const int tileX1 = std::min(x1, (tx + 1) * static_cast<int>(TILE_SIZE) - 1);
+            const int tileY0 = std::max(y0, ty * static_cast<int>(TILE_SIZE));
+            const int tileY1 = std::min(y1, (ty + 1) * static_cast<int>(TILE_SIZE) - 1);
+            for(int y = tileY0; y <= tileY1; ++y)
+            {
+                const float* depthRow = _depth.data() + static_cast<size_t>(y) * WIDTH;
+                for(int x = tileX0; x <= tileX1; ++x)
+                {
+                    if(depthRow[x] >= nearestDepth)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
@@ -32,4 +32,9 @@
 
 // program specific
 #define FRAME_COUNT 2
-#define MAX_CBV_SRV_UAV_COUNT 256
\ No newline at end of file
+#define MAX_CBV_SRV_UAV_COUNT 256
+#define UPLOAD_HEAP_SIZE_PER_FRAME (4u * 1024u * 1024u)
+#define GEOMETRY_BUFFER_VERTEX_CAPACITY (2u * 1024u * 1024u)
+#define GEOMETRY_BUFFER_INDEX_CAPACITY (8u * 1024u * 1024u)
+#define RESIDENCY_BUDGET (512ull * 1024u * 1024u)
+#define RESIDENCY_RESTORE_BYTES_PER_FRAME (64ull * 1024u * 1024u)
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "pipeline_cache.hpp"
+
+#include "utility/dx12_helpers.hpp"
+#include "utility/hash.hpp"
+#include "utility/log.hpp"
+#include "utility/pipeline_hash.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+using namespace Microsoft::WRL;
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Next to the compiled shaders, both are only valid for this machine.
+    const fs::path LIBRARY_PATH = "shader_cache/pipeline_library.bin";
+
+    // Private data of the root signatures created here, the hash of their serialized blob.
+    constexpr GUID ROOT_SIGNATURE_HASH_GUID = { 0x6f1c2b3a, 0x9d4e, 0x4a57, { 0x8b, 0x21, 0x4c, 0x0e, 0x7d, 0x95, 0x3a, 0x12 } };
+}
+
+PipelineCache::PipelineCache(const ComPtr<ID3D12Device2>& device) :
+    _device(device)
+{
+    OpenLibrary();
+}
+
+ComPtr<ID3D12RootSignature> PipelineCache::CreateRootSignature(const void* serialized, size_t size)
+{
+    ComPtr<ID3D12RootSignature> rootSignature{};
+    Util::ThrowIfFailed(_device->CreateRootSignature(0, serialized, size, IID_PPV_ARGS(&rootSignature)));
+
+    // Stored on the object, a pointer could belong to another root signature once this one is released.
+    const uint64_t hash = Util::HashBytes(serialized, size);
+    Util::ThrowIfFailed(rootSignature->SetPrivateData(ROOT_SIGNATURE_HASH_GUID, sizeof(hash), &hash));
+    return rootSignature;
+}
+
+ComPtr<ID3D12PipelineState> PipelineCache::GetGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    uint64_t rootSignatureHash = 0;
+    UINT rootSignatureHashSize = sizeof(rootSignatureHash);
+    const HRESULT hashResult = desc.pRootSignature->GetPrivateData(ROOT_SIGNATURE_HASH_GUID, &rootSignatureHashSize, &rootSignatureHash);
+    assert(SUCCEEDED(hashResult) && "Root signature wasn't created through the pipeline cache.");
+    (void)hashResult;
+
+    const uint64_t key = Util::HashGraphicsPipelineDesc(desc, rootSignatureHash);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(ComPtr<ID3D12PipelineState> pipeline = _pipelines.Acquire(key))
+        {
+            _stats.memoryHits++;
+            return pipeline;
+        }
+    }
+
+    const std::wstring name = std::format(L"{:016x}", key);
+    ComPtr<ID3D12PipelineState> pipelineState{};
+    bool loaded = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loaded = _library && SUCCEEDED(_library->LoadGraphicsPipeline(name.c_str(), &desc, IID_PPV_ARGS(&pipelineState)));
+    }
+
+    // Compiling takes long, don't hold up other threads meanwhile.
+    if(!loaded)
+    {
+        Util::ThrowIfFailed(_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Another thread may have created the same pipeline in the meantime, everyone gets the first one.
+    bool inserted = false;
+    ComPtr<ID3D12PipelineState> pipeline = _pipelines.Insert(key, pipelineState, inserted);
+    if(inserted && !loaded && _library)
+    {
+        // A pipeline that was released and created again is in the library already.
+        const HRESULT result = _library->StorePipeline(name.c_str(), pipelineState.Get());
+        if(SUCCEEDED(result))
+        {
+            _libraryChanged = true;
+        }
+        else if(result != DXGI_ERROR_ALREADY_EXISTS)
+        {
+            dblog::error("[PIPELINE_CACHE] Failed to add pipeline {:016x} to the library.", key);
+        }
+    }
+
+    if(loaded)
+    {
+        _stats.libraryHits++;
+    }
+    else
+    {
+        _stats.compiles++;
+    }
+    dblog::info("[PIPELINE_CACHE] {} pipeline {:016x} in {:.2f} ms.", loaded ? "Loaded" : "Compiled", key,
+        std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+    return pipeline;
+}
+
+void PipelineCache::ReleaseGraphicsPipeline(ID3D12PipelineState* pipelineState)
+{
+    if(!pipelineState)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pipelines.Release(pipelineState);
+}
+
+void PipelineCache::Save()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(!_library || !_libraryChanged)
+    {
+        return;
+    }
+
+    std::vector<uint8_t> data(_library->GetSerializedSize());
+    if(FAILED(_library->Serialize(data.data(), data.size())))
+    {
+        dblog::error("[PIPELINE_CACHE] Failed to serialize the pipeline library.");
+        return;
+    }
+
+    std::error_code error;
+    fs::create_directories(LIBRARY_PATH.parent_path(), error);
+
+    // Write to a temporary file first so a crash never leaves a half written library behind.
+    fs::path temporaryPath = LIBRARY_PATH;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if(!file)
+        {
+            dblog::error("[PIPELINE_CACHE] Failed to write {}.", temporaryPath.string());
+            return;
+        }
+    }
+
+    fs::rename(temporaryPath, LIBRARY_PATH, error);
+    if(error)
+    {
+        dblog::error("[PIPELINE_CACHE] Failed to move {} into place: {}", LIBRARY_PATH.string(), error.message());
+        return;
+    }
+
+    _libraryChanged = false;
+    dblog::info("[PIPELINE_CACHE] Saved {} bytes of pipelines.", data.size());
+}
+
+PipelineCache::Stats PipelineCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats stats = _stats;
+    stats.pipelineCount = static_cast<uint32_t>(_pipelines.GetCount());
+    return stats;
+}
+
+void PipelineCache::OpenLibrary()
+{
+    {
+        std::ifstream file(LIBRARY_PATH, std::ios::binary);
+        if(file)
+        {
+            _libraryData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+    }
+
+    if(!_libraryData.empty())
+    {
+        // Fails after a driver update or on another adapter, the pipelines are just compiled again.
+        const HRESULT result = _device->CreatePipelineLibrary(_libraryData.data(), _libraryData.size(), IID_PPV_ARGS(&_library));
+        if(SUCCEEDED(result))
+        {
+            dblog::info("[PIPELINE_CACHE] Loaded a {} byte pipeline library.", _libraryData.size());
+            return;
+        }
+        dblog::info("[PIPELINE_CACHE] Discarding the pipeline library on disk ({:#x}).", static_cast<uint32_t>(result));
+        _libraryData.clear();
+    }
+
+    if(FAILED(_device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&_library))))
+    {
+        dblog::info("[PIPELINE_CACHE] Pipeline libraries are not supported, pipelines are only shared in memory.");
+        _library.Reset();
+    }
+}
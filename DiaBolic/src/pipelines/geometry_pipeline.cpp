@@ -8,49 +8,424 @@
 #include "renderer.hpp"
 #include "camera.hpp"
 #include "descriptor_heap.hpp"
+#include "upload_heap.hpp"
+#include "geometry_buffer.hpp"
 #include "utility/shader_compiler.hpp"
+#include "shader_hot_reload.hpp"
+#include "pipeline_cache.hpp"
+#include "job_system.hpp"
+#include "utility/log.hpp"
+#include "utility/root_constants.hpp"
+#include "utility/shader_registry.hpp"
+
+#include <bit>
+#include <chrono>
+#include <format>
 
 using namespace Util;
 using namespace Microsoft::WRL;
 
+namespace
+{
+    // RenderResources as C++ sees it, checked against each shader's reflection.
+    const std::array RENDER_RESOURCES_FIELDS = {
+        ROOT_CONSTANT_FIELD(RenderResources, instanceBufferIndex),
+        ROOT_CONSTANT_FIELD(RenderResources, instanceOffset),
+        ROOT_CONSTANT_FIELD(RenderResources, vertexOffset),
+        ROOT_CONSTANT_FIELD(RenderResources, positionBufferIndex),
+        ROOT_CONSTANT_FIELD(RenderResources, normalBufferIndex),
+        ROOT_CONSTANT_FIELD(RenderResources, uvBufferIndex),
+        ROOT_CONSTANT_FIELD(RenderResources, textureIndex),
+        ROOT_CONSTANT_FIELD(RenderResources, alphaCutoff),
+    };
+}
+
 GeometryPipeline::GeometryPipeline(Renderer& renderer, std::shared_ptr<Camera>& camera)
     : _renderer(renderer)
     , _camera(camera)
+    , _shaderPermutations(ShaderRegistry::GetProgram(ShaderRegistry::Program::Geometry).shaderPath,
+                          ShaderRegistry::GetProgram(ShaderRegistry::Program::Geometry).features)
 {
-    CreatePipeline();
+    _pipelineStates.resize(_shaderPermutations.GetVariantCount());
+    _rootConstantCounts = std::vector<std::atomic<uint32_t>>(_shaderPermutations.GetVariantCount());
+    _pendingPipelines.resize(_shaderPermutations.GetVariantCount());
+    _drawVariants.resize(_shaderPermutations.GetVariantCount());
+
+    // Everything else falls back to these, so they should exist before the first frame. If one doesn't build its draws
+    // are skipped until the shader is fixed.
+    for(const uint32_t variant : { FALLBACK_VARIANT, ALPHA_TESTED_FALLBACK_VARIANT })
+    {
+        ComPtr<ID3D12PipelineState> pipelineState{};
+        try
+        {
+            pipelineState = BuildPipelineState(variant);
+        }
+        catch(...)
+        {
+            dblog::error("[GEOMETRY_PIPELINE] Failed to build the {} variant, draws that need it are skipped.", _shaderPermutations.Describe(variant));
+        }
+        _pendingPipelines[variant].requested = true;
+        ApplyPipeline(variant, std::move(pipelineState));
+    }
+
     InitializeAssets();
 }
 
 GeometryPipeline::~GeometryPipeline()
 {
+    // Builds in flight use this pipeline's members.
+    for(PendingPipeline& pending : _pendingPipelines)
+    {
+        if(pending.pipelineState.valid())
+        {
+            pending.pipelineState.wait();
+        }
+    }
+}
+
+void GeometryPipeline::BuildFramePacket(FramePacket& packet)
+{
+    FramePacket::CullStats& stats = packet.cullStats;
+    stats = {};
+
+    // Cull and collect this frame's draws.
+    const auto cullStart = std::chrono::high_resolution_clock::now();
+    const XMMATRIX viewProjection = XMMatrixMultiply(_camera->view, _camera->projection);
+    const Culling::Frustum frustum = Culling::ExtractFrustum(viewProjection);
+    _scene.CullFrustum(frustum);
+    stats.objectCount = static_cast<uint32_t>(_scene.GetRenderableCount());
+    stats.frustumVisibleCount = static_cast<uint32_t>(_scene.GetVisibleCount());
+    stats.bvhNodesVisited = _scene.GetBvhStats().nodesVisited;
+    stats.transformsScanned = _scene.GetTransformStats().nodesScanned;
+    stats.transformsTouched = _scene.GetTransformStats().nodesTouched;
+    const auto occlusionStart = std::chrono::high_resolution_clock::now();
+
+    if(_useOcclusionCulling)
+    {
+        _occlusionBuffer.Clear();
+        stats.occluderCount = _scene.RasterizeOccluders(_occlusionBuffer, viewProjection);
+        _occlusionBuffer.Finalize();
+        stats.occluderTriangleCount = _occlusionBuffer.GetTriangleCount();
+        stats.occludedCount = _scene.CullOccluded(_occlusionBuffer, viewProjection);
+    }
+    const auto occlusionEnd = std::chrono::high_resolution_clock::now();
+
+    packet.drawList.Clear();
+    _scene.CollectDraws(packet.drawList, _camera->view);
+    stats.visibleCount = static_cast<uint32_t>(packet.drawList.GetCount());
+
+    const auto cullEnd = std::chrono::high_resolution_clock::now();
+    stats.occlusionMilliseconds = std::chrono::duration<float, std::milli>(occlusionEnd - occlusionStart).count();
+    stats.cullMilliseconds = std::chrono::duration<float, std::milli>(cullEnd - cullStart).count() - stats.occlusionMilliseconds;
 
+    packet.indirectDraws = _useIndirectDraws;
+    packet.sceneStats = _scene.GetStats();
 }
 
-void GeometryPipeline::PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList)
+void GeometryPipeline::PopulateCommandlist(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const FramePacket& packet)
 {
+    _drawStats = {};
+
+    ApplyFinishedPipelines();
+    RequestPipelines(packet.drawList);
+
     // Set necessary stuff.
-    commandList->SetPipelineState(_pipelineState.Get());
     commandList->SetGraphicsRootSignature(_renderer.GetBindlessRootSignature().Get());
+    commandList->SetGraphicsRootConstantBufferView(1, _renderer.GetViewResourcesAddress());
 
-    // Start recording.
+    // Start recording. Every mesh's indices are in the geometry buffer, one index buffer serves all draws.
     commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList->IASetIndexBuffer(&_renderer.GetGeometryBuffer().GetIndexBufferView());
+    _drawStats.indexBufferChanges++;
+
+    if(packet.indirectDraws)
+    {
+        RecordIndirectDraws(commandList, packet.drawList);
+    }
+    else
+    {
+        RecordDraws(commandList, packet.drawList);
+    }
+
+    // Without sorting every draw would set its pipeline, and without the geometry buffer its index buffer.
+    _drawStats.stateChangesAvoided = _drawStats.drawCount > 0 ? 2 * _drawStats.drawCount - _drawStats.pipelineChanges - _drawStats.indexBufferChanges : 0;
+}
+
+void GeometryPipeline::RecordDraws(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const DrawList& drawList)
+{
+    // Walk the sorted draws, only touching state that differs from the previous draw.
+    // Consecutive packets with the same pipeline, material and mesh become one instanced draw.
+    const ID3D12PipelineState* currentPipeline = nullptr;
+    for(size_t first = 0; first < drawList.GetCount();)
+    {
+        const DrawPacket& packet = drawList.GetSorted(first);
+        const uint32_t instanceCount = drawList.GetInstanceCount(first);
+
+        const uint32_t variant = _drawVariants[packet.pipeline];
+        if(variant == NO_VARIANT)
+        {
+            _drawStats.skippedDraws++;
+            first += instanceCount;
+            continue;
+        }
+
+        ID3D12PipelineState* pipeline = _pipelineStates[variant].Get();
+        if(pipeline != currentPipeline)
+        {
+            commandList->SetPipelineState(pipeline);
+            currentPipeline = pipeline;
+            _drawStats.pipelineChanges++;
+        }
+
+        const RenderResources rs = WriteInstances(drawList, first, instanceCount);
+        const uint32_t rootConstantCount = _rootConstantCounts[variant];
+        if(rootConstantCount > 0)
+        {
+            commandList->SetGraphicsRoot32BitConstants(0, rootConstantCount, &rs, 0);
+        }
+        _drawStats.rootConstantDwords += rootConstantCount;
+
+        commandList->DrawIndexedInstanced(packet.mesh->GetIndexCount(), instanceCount, packet.mesh->GetFirstIndex(), 0, 0);
+        _drawStats.drawCount++;
+        _drawStats.fallbackDraws += variant != packet.pipeline ? 1u : 0u;
+        _drawStats.instanceCount += instanceCount;
+
+        first += instanceCount;
+    }
+}
 
-    // Render models
-    for(auto& model : _models)
+void GeometryPipeline::RecordIndirectDraws(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const DrawList& drawList)
+{
+    // Pack the draws of each pipeline into an argument buffer in the upload heap and execute them in one go.
+    UploadHeap& uploadHeap = _renderer.GetUploadHeap();
+
+    for(size_t first = 0; first < drawList.GetCount();)
     {
-        model.Draw(commandList, _camera);
+        const uint32_t pipelineIndex = drawList.GetSorted(first).pipeline;
+        const uint32_t variant = _drawVariants[pipelineIndex];
+        if(variant == NO_VARIANT)
+        {
+            while(first < drawList.GetCount() && drawList.GetSorted(first).pipeline == pipelineIndex)
+            {
+                const uint32_t instanceCount = drawList.GetInstanceCount(first);
+                _drawStats.skippedDraws++;
+                first += instanceCount;
+            }
+            continue;
+        }
+
+        const IndirectCommand& command = GetIndirectCommand(_rootConstantCounts[variant]);
+        const uint32_t stride = command.layout.byteStride;
+
+        uint32_t commandCount = 0;
+        _indirectArguments.clear();
+        while(first < drawList.GetCount() && drawList.GetSorted(first).pipeline == pipelineIndex)
+        {
+            const DrawPacket& packet = drawList.GetSorted(first);
+            const uint32_t instanceCount = drawList.GetInstanceCount(first);
+
+            const RenderResources rs = WriteInstances(drawList, first, instanceCount);
+            const IndirectDraw::DrawIndexedArguments drawArguments = {
+                .indexCountPerInstance = packet.mesh->GetIndexCount(),
+                .instanceCount = instanceCount,
+                .startIndexLocation = packet.mesh->GetFirstIndex(),
+                .baseVertexLocation = 0,
+                .startInstanceLocation = 0u,
+            };
+
+            _indirectArguments.resize(static_cast<size_t>(commandCount + 1) * stride);
+            IndirectDraw::PackCommand(command.layout, _indirectArguments.data() + static_cast<size_t>(commandCount) * stride,
+                &rs, drawArguments);
+            commandCount++;
+
+            _drawStats.drawCount++;
+            _drawStats.fallbackDraws += variant != pipelineIndex ? 1u : 0u;
+            _drawStats.instanceCount += instanceCount;
+            _drawStats.rootConstantDwords += command.layout.rootConstantCount;
+
+            first += instanceCount;
+        }
+
+        const UploadAllocation arguments = uploadHeap.Allocate(static_cast<uint32_t>(_indirectArguments.size()), sizeof(uint32_t));
+        uploadHeap.Write(arguments, _indirectArguments.data(), _indirectArguments.size());
+
+        commandList->SetPipelineState(_pipelineStates[variant].Get());
+        _drawStats.pipelineChanges++;
+
+        commandList->ExecuteIndirect(command.signature.Get(), commandCount, uploadHeap.GetResource(), arguments.offset, nullptr, 0);
+        _drawStats.indirectExecutions++;
     }
 }
 
+RenderResources GeometryPipeline::WriteInstances(const DrawList& drawList, size_t first, uint32_t instanceCount)
+{
+    UploadHeap& uploadHeap = _renderer.GetUploadHeap();
+    const GeometryBuffer& geometryBuffer = _renderer.GetGeometryBuffer();
+    const DrawPacket& packet = drawList.GetSorted(first);
+
+    // Write the instance transforms, VSmain picks them up by SV_InstanceID.
+    const UploadAllocation instances = uploadHeap.Allocate(instanceCount * sizeof(XMFLOAT4X4), 16);
+    for(uint32_t i = 0; i < instanceCount; ++i)
+    {
+        uploadHeap.Write(instances, &drawList.GetSorted(first + i).transform, sizeof(XMFLOAT4X4), i * sizeof(XMFLOAT4X4));
+    }
+
+    RenderResources rs;
+    rs.instanceBufferIndex = uploadHeap.GetSrvIndex();
+    rs.instanceOffset = instances.offset;
+    rs.vertexOffset = packet.mesh->GetVertexOffset();
+    rs.positionBufferIndex = geometryBuffer.GetPositionSrvIndex();
+    rs.normalBufferIndex = geometryBuffer.GetNormalSrvIndex();
+    rs.uvBufferIndex = geometryBuffer.GetUVSrvIndex();
+    if(packet.material->baseColorTexture)
+    {
+        rs.textureIndex = packet.material->baseColorTexture->srvIndex;
+    }
+    rs.alphaCutoff = packet.material->alphaCutoff;
+
+    return rs;
+}
+
 void GeometryPipeline::Update(float deltaTime)
 {
-    
+    _scene.Update();
+}
+
+void GeometryPipeline::RequestPipelines(const DrawList& drawList)
+{
+    // Draws are sorted by pipeline, so every variant in use is found by skipping to the next one.
+    bool usedFallback = false;
+    for(size_t first = 0; first < drawList.GetCount();)
+    {
+        const uint32_t variant = drawList.GetSorted(first).pipeline;
+        while(first < drawList.GetCount() && drawList.GetSorted(first).pipeline == variant)
+        {
+            first++;
+        }
+
+        if(_pipelineStates[variant])
+        {
+            _drawVariants[variant] = variant;
+            continue;
+        }
+
+        _drawVariants[variant] = FindStandIn(variant);
+        usedFallback = true;
+
+        // Not retried after a failed build, the shader watcher rebuilds it once the shader is fixed.
+        PendingPipeline& pending = _pendingPipelines[variant];
+        if(!pending.requested)
+        {
+            pending.requested = true;
+            pending.requestTime = std::chrono::high_resolution_clock::now();
+            pending.pipelineState = JobSystem::Get().Async([this, variant]() { return BuildPipelineState(variant); }, JobSystem::Priority::Low);
+        }
+    }
+
+    for(const PendingPipeline& pending : _pendingPipelines)
+    {
+        _drawStats.pendingPipelines += pending.pipelineState.valid() ? 1u : 0u;
+    }
+    _fallbackFrames += usedFallback ? 1u : 0u;
+    _drawStats.fallbackFrames = _fallbackFrames;
+}
+
+uint32_t GeometryPipeline::FindStandIn(uint32_t variant) const
+{
+    // A variant with a feature the material lacks could read data it doesn't have, one that doesn't clip would draw
+    // cutouts solid.
+    const uint32_t required = (variant & MaterialFeature::ALPHA_TESTED) != 0 ? CUTOUT_FEATURES : 0u;
+    uint32_t standIn = NO_VARIANT;
+    for(uint32_t candidate = 0; candidate < _pipelineStates.size(); ++candidate)
+    {
+        if(!_pipelineStates[candidate] || (candidate & ~variant) != 0 || (required & ~candidate) != 0)
+        {
+            continue;
+        }
+        if(standIn == NO_VARIANT || std::popcount(candidate) > std::popcount(standIn))
+        {
+            standIn = candidate;
+        }
+    }
+    return standIn;
 }
 
-void GeometryPipeline::CreatePipeline()
+void GeometryPipeline::ApplyFinishedPipelines()
 {
-    const auto& vertexShaderBlob = ShaderCompiler::Compile(ShaderTypes::Vertex, L"assets/shaders/cube_spin.hlsl", L"VSmain").shaderBlob;
-    const auto& pixelShaderBlob = ShaderCompiler::Compile(ShaderTypes::Pixel, L"assets/shaders/cube_spin.hlsl", L"PSmain").shaderBlob;
+    for(uint32_t variant = 0; variant < _pendingPipelines.size(); ++variant)
+    {
+        PendingPipeline& pending = _pendingPipelines[variant];
+        if(!pending.pipelineState.valid() || pending.pipelineState.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            continue;
+        }
+
+        ComPtr<ID3D12PipelineState> pipelineState{};
+        try
+        {
+            pipelineState = pending.pipelineState.get();
+            dblog::info("[GEOMETRY_PIPELINE] Built the {} variant in the background, ready {:.2f} ms after its first draw.", _shaderPermutations.Describe(variant),
+                std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - pending.requestTime).count());
+        }
+        catch(...)
+        {
+            dblog::error("[GEOMETRY_PIPELINE] Failed to build the {} variant, its draws keep using a stand-in.", _shaderPermutations.Describe(variant));
+        }
+        ApplyPipeline(variant, std::move(pipelineState));
+    }
+}
+
+void GeometryPipeline::ApplyPipeline(uint32_t variant, ComPtr<ID3D12PipelineState> pipelineState)
+{
+    // Only fills empty slots. Built states are replaced by hot reload, which keeps the previous one when a rebuild fails.
+    assert(!_pipelineStates[variant] && "Variant was built twice.");
+    _pipelineStates[variant] = std::move(pipelineState);
+    // Also for failed builds, so fixing the shader brings the variant in.
+    _renderer.GetShaderHotReload().Register({ _shaderPermutations.GetShaderPath() }, _pipelineStates[variant],
+        [this, variant]() { return BuildPipelineState(variant); });
+}
+
+ComPtr<ID3D12PipelineState> GeometryPipeline::BuildPipelineState(uint32_t variant)
+{
+    // Request both stages before waiting on either, so they compile side by side.
+    auto vertexShaderFuture = _shaderPermutations.CompileAsync(ShaderTypes::Vertex, L"VSmain", variant);
+    auto pixelShaderFuture = _shaderPermutations.CompileAsync(ShaderTypes::Pixel, L"PSmain", variant);
+    const Shader vertexShader = JobSystem::Get().Wait(vertexShaderFuture);
+    const Shader pixelShader = JobSystem::Get().Wait(pixelShaderFuture);
+    const auto& vertexShaderBlob = vertexShader.shaderBlob;
+    const auto& pixelShaderBlob = pixelShader.shaderBlob;
+
+    // Compile errors are logged by the compiler and leave an empty blob.
+    if(!vertexShaderBlob || !pixelShaderBlob || vertexShaderBlob->GetBufferSize() == 0 || pixelShaderBlob->GetBufferSize() == 0)
+    {
+        throw std::exception();
+    }
+
+    // Both stages see the same root constants, push enough for the one that reads the most.
+    uint32_t rootConstantCount = 0;
+    for(const auto& [shader, entryPoint] : { std::pair{ &vertexShader, "VSmain" }, std::pair{ &pixelShader, "PSmain" } })
+    {
+        const std::string shaderName = std::format("{} {}", _shaderPermutations.Describe(variant), entryPoint);
+        const ComPtr<ID3D12ShaderReflection> reflection = ShaderCompiler::CreateReflection(*shader);
+        if(!reflection)
+        {
+            dblog::error("[GEOMETRY_PIPELINE] {} has no reflection data.", shaderName);
+            throw std::exception();
+        }
+
+        const std::vector<RootConstants::Field> fields = RootConstants::Reflect(reflection.Get(), 0);
+        if(!RootConstants::Validate(fields, RENDER_RESOURCES_FIELDS, shaderName))
+        {
+            throw std::exception();
+        }
+        rootConstantCount = std::max(rootConstantCount, RootConstants::GetUsedDwordCount(fields));
+    }
+
+    // Only ever grows: after a hot reload the old pipeline state keeps drawing until the next frame boundary.
+    if(rootConstantCount > _rootConstantCounts[variant])
+    {
+        _rootConstantCounts[variant] = rootConstantCount;
+    }
 
     // Setup blend descriptions.
     constexpr D3D12_RENDER_TARGET_BLEND_DESC renderTargetBlendDesc = {
@@ -106,7 +481,20 @@ void GeometryPipeline::CreatePipeline()
         psoDesc.RTVFormats[i] = DXGI_FORMAT_R8G8B8A8_UNORM;
     }
 
-    ThrowIfFailed(_renderer.GetDevice()->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&_pipelineState)));
+    return _renderer.GetPipelineCache().GetGraphicsPipeline(psoDesc);
+}
+
+const GeometryPipeline::IndirectCommand& GeometryPipeline::GetIndirectCommand(uint32_t rootConstantCount)
+{
+    // The constant count is baked into the command signature, so there is one per count in use.
+    IndirectCommand& command = _indirectCommands[rootConstantCount];
+    if(!command.signature)
+    {
+        // A command signature can't set zero constants, push one that goes unread.
+        command.layout = IndirectDraw::MakeLayout(0, std::max(rootConstantCount, 1u));
+        command.signature = IndirectDraw::CreateCommandSignature(_renderer.GetDevice(), _renderer.GetBindlessRootSignature(), command.layout);
+    }
+    return command;
 }
 
 void GeometryPipeline::InitializeAssets()
@@ -115,4 +503,9 @@ void GeometryPipeline::InitializeAssets()
     //_models.emplace_back(Model(_renderer, "Helmet/DamagedHelmet.gltf"));
     _models.emplace_back(Model(_renderer, "ABeautifulGame/ABeautifulGame.gltf"));
     //_models.emplace_back(Model(_renderer, "Lantern/Lantern.gltf"));
+
+    for(const auto& model : _models)
+    {
+        _scene.Instantiate(model);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "render_graph.hpp"
+
+#include "utility/dx12_helpers.hpp"
+
+#include <algorithm>
+#include <format>
+
+using Util::RenderGraphCompiler;
+
+namespace
+{
+    // The compiler keeps states in plain integers.
+    static_assert(RenderGraphCompiler::STATE_COMMON == D3D12_RESOURCE_STATE_COMMON);
+    static_assert(RenderGraphCompiler::STATE_VERTEX_AND_CONSTANT_BUFFER == D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+    static_assert(RenderGraphCompiler::STATE_INDEX_BUFFER == D3D12_RESOURCE_STATE_INDEX_BUFFER);
+    static_assert(RenderGraphCompiler::STATE_RENDER_TARGET == D3D12_RESOURCE_STATE_RENDER_TARGET);
+    static_assert(RenderGraphCompiler::STATE_UNORDERED_ACCESS == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    static_assert(RenderGraphCompiler::STATE_DEPTH_WRITE == D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    static_assert(RenderGraphCompiler::STATE_DEPTH_READ == D3D12_RESOURCE_STATE_DEPTH_READ);
+    static_assert(RenderGraphCompiler::STATE_NON_PIXEL_SHADER_RESOURCE == D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    static_assert(RenderGraphCompiler::STATE_PIXEL_SHADER_RESOURCE == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    static_assert(RenderGraphCompiler::STATE_STREAM_OUT == D3D12_RESOURCE_STATE_STREAM_OUT);
+    static_assert(RenderGraphCompiler::STATE_INDIRECT_ARGUMENT == D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    static_assert(RenderGraphCompiler::STATE_COPY_DEST == D3D12_RESOURCE_STATE_COPY_DEST);
+    static_assert(RenderGraphCompiler::STATE_COPY_SOURCE == D3D12_RESOURCE_STATE_COPY_SOURCE);
+    static_assert(RenderGraphCompiler::STATE_RESOLVE_DEST == D3D12_RESOURCE_STATE_RESOLVE_DEST);
+    static_assert(RenderGraphCompiler::STATE_RESOLVE_SOURCE == D3D12_RESOURCE_STATE_RESOLVE_SOURCE);
+    static_assert(RenderGraphCompiler::STATE_GENERIC_READ == D3D12_RESOURCE_STATE_GENERIC_READ);
+    static_assert(RenderGraphCompiler::DEFAULT_HEAP_ALIGNMENT == D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+    constexpr D3D12_HEAP_FLAGS HEAP_CLASS_FLAGS[] = {
+        D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES, // RenderTargets
+        D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES, // Textures
+    };
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    std::string DescribeStates(RenderGraphCompiler::States states)
+    {
+        constexpr std::pair<D3D12_RESOURCE_STATES, const char*> STATE_NAMES[] = {
+            { D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, "VERTEX_AND_CONSTANT_BUFFER" },
+            { D3D12_RESOURCE_STATE_INDEX_BUFFER, "INDEX_BUFFER" },
+            { D3D12_RESOURCE_STATE_RENDER_TARGET, "RENDER_TARGET" },
+            { D3D12_RESOURCE_STATE_UNORDERED_ACCESS, "UNORDERED_ACCESS" },
+            { D3D12_RESOURCE_STATE_DEPTH_WRITE, "DEPTH_WRITE" },
+            { D3D12_RESOURCE_STATE_DEPTH_READ, "DEPTH_READ" },
+            { D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, "NON_PIXEL_SHADER_RESOURCE" },
+            { D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, "PIXEL_SHADER_RESOURCE" },
+            { D3D12_RESOURCE_STATE_STREAM_OUT, "STREAM_OUT" },
+            { D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, "INDIRECT_ARGUMENT" },
+            { D3D12_RESOURCE_STATE_COPY_DEST, "COPY_DEST" },
+            { D3D12_RESOURCE_STATE_COPY_SOURCE, "COPY_SOURCE" },
+            { D3D12_RESOURCE_STATE_RESOLVE_DEST, "RESOLVE_DEST" },
+            { D3D12_RESOURCE_STATE_RESOLVE_SOURCE, "RESOLVE_SOURCE" },
+        };
+
+        if(states == D3D12_RESOURCE_STATE_COMMON)
+        {
+            return "COMMON/PRESENT";
+        }
+
+        std::string description;
+        for(const auto& [state, name] : STATE_NAMES)
+        {
+            if((states & state) == state)
+            {
+                description += (description.empty() ? "" : "|") + std::string(name);
+            }
+        }
+        return description;
+    }
+}
+
+RenderGraph::ResourceId RenderGraph::ImportResource(std::string name, D3D12_RESOURCE_STATES initialState, D3D12_RESOURCE_STATES finalState)
+{
+    _resources.emplace_back();
+    return _compiler.ImportResource(std::move(name), initialState, finalState);
+}
+
+RenderGraph::ResourceId RenderGraph::CreateTexture(std::string name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clearValue)
+{
+    assert(desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER && "Transient resources have to be textures.");
+
+    Resource resource{};
+    resource.desc = desc;
+    if(clearValue)
+    {
+        resource.clearValue = *clearValue;
+        resource.hasClearValue = true;
+    }
+    _resources.push_back(std::move(resource));
+
+    const bool renderTarget = (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+    return _compiler.CreateTexture(std::move(name), renderTarget);
+}
+
+RenderGraph::PassId RenderGraph::AddPass(std::string name, uint32_t commandList)
+{
+    return _compiler.AddPass(std::move(name), commandList);
+}
+
+void RenderGraph::Read(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state)
+{
+    _compiler.Read(pass, resource, state);
+}
+
+void RenderGraph::Write(PassId pass, ResourceId resource, D3D12_RESOURCE_STATES state)
+{
+    _compiler.Write(pass, resource, state);
+}
+
+void RenderGraph::Compile(const AllocationInfoFunction& getAllocationInfo)
+{
+    _compiler.Compile([&](ResourceId resource) {
+        const D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = getAllocationInfo(_resources[resource].desc);
+        return RenderGraphCompiler::Allocation{ .size = allocationInfo.SizeInBytes, .alignment = allocationInfo.Alignment };
+    });
+}
+
+void RenderGraph::CreateTransientResources(ID3D12Device* device)
+{
+    _heaps.clear();
+    for(const RenderGraphCompiler::Heap& heap : _compiler.GetHeaps())
+    {
+        const CD3DX12_HEAP_DESC heapDesc(heap.size, D3D12_HEAP_TYPE_DEFAULT, heap.alignment, HEAP_CLASS_FLAGS[static_cast<uint32_t>(heap.heapClass)]);
+        Util::ThrowIfFailed(device->CreateHeap(&heapDesc, IID_PPV_ARGS(&_heaps.emplace_back())));
+        _heaps.back()->SetName(L"Render Graph Heap");
+    }
+
+    for(ResourceId id = 0; id < _resources.size(); ++id)
+    {
+        if(!_compiler.IsTransient(id) || !_compiler.IsUsed(id))
+        {
+            continue;
+        }
+
+        Resource& resource = _resources[id];
+        const RenderGraphCompiler::Placement placement = _compiler.GetPlacement(id);
+        Util::ThrowIfFailed(device->CreatePlacedResource(
+            _heaps[placement.heap].Get(),
+            placement.offset,
+            &resource.desc,
+            static_cast<D3D12_RESOURCE_STATES>(_compiler.GetInitialState(id)),
+            resource.hasClearValue ? &resource.clearValue : nullptr,
+            IID_PPV_ARGS(&resource.transientResource)));
+        const std::string& name = _compiler.GetName(id);
+        resource.transientResource->SetName(std::wstring(name.begin(), name.end()).c_str());
+    }
+}
+
+void RenderGraph::SetImportedResource(ResourceId resource, ID3D12Resource* d3dResource)
+{
+    assert(!_compiler.IsTransient(resource) && "Only imported resources can be set.");
+    _resources[resource].importedResource = d3dResource;
+}
+
+ID3D12Resource* RenderGraph::GetResource(ResourceId resource) const
+{
+    return _compiler.IsTransient(resource) ? _resources[resource].transientResource.Get() : _resources[resource].importedResource;
+}
+
+void RenderGraph::RecordBarriers(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, uint32_t pass) const
+{
+    using Barrier = RenderGraphCompiler::Barrier;
+    constexpr D3D12_RESOURCE_BARRIER_FLAGS SPLIT_FLAGS[] = {
+        D3D12_RESOURCE_BARRIER_FLAG_NONE, // None
+        D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY, // Begin
+        D3D12_RESOURCE_BARRIER_FLAG_END_ONLY, // End
+    };
+
+    const std::vector<Barrier>& barriers = _compiler.GetBarriers(pass);
+    if(!barriers.empty())
+    {
+        std::vector<D3D12_RESOURCE_BARRIER> d3dBarriers;
+        d3dBarriers.reserve(barriers.size());
+        for(const Barrier& barrier : barriers)
+        {
+            ID3D12Resource* resource = GetResource(barrier.resource);
+            switch(barrier.type)
+            {
+            case Barrier::Type::Transition:
+                d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, static_cast<D3D12_RESOURCE_STATES>(barrier.before),
+                    static_cast<D3D12_RESOURCE_STATES>(barrier.after), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                    SPLIT_FLAGS[static_cast<uint32_t>(barrier.split)]));
+                break;
+            case Barrier::Type::Aliasing:
+                // Any texture that shared the memory before.
+                d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, resource));
+                break;
+            case Barrier::Type::Uav:
+                d3dBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+                break;
+            }
+        }
+        commandList->ResourceBarrier(static_cast<UINT>(d3dBarriers.size()), d3dBarriers.data());
+    }
+
+    if(pass < GetPassCount())
+    {
+        for(const ResourceId resource : _compiler.GetDiscards(pass))
+        {
+            commandList->DiscardResource(GetResource(resource), nullptr);
+        }
+    }
+}
+
+std::string RenderGraph::Dump() const
+{
+    using Barrier = RenderGraphCompiler::Barrier;
+    const auto describeBarriers = [this](std::string& dump, uint32_t pass) {
+        for(const Barrier& barrier : _compiler.GetBarriers(pass))
+        {
+            const std::string& name = _compiler.GetName(barrier.resource);
+            switch(barrier.type)
+            {
+            case Barrier::Type::Transition:
+            {
+                const char* split = barrier.split == Barrier::Split::Begin ? " (begin)" : barrier.split == Barrier::Split::End ? " (end)" : "";
+                dump += std::format("    transition {}: {} -> {}{}\n", name, DescribeStates(barrier.before), DescribeStates(barrier.after), split);
+                break;
+            }
+            case Barrier::Type::Aliasing:
+                dump += std::format("    aliasing {}\n", name);
+                break;
+            case Barrier::Type::Uav:
+                dump += std::format("    uav {}\n", name);
+                break;
+            }
+        }
+        if(pass < GetPassCount())
+        {
+            for(const ResourceId resource : _compiler.GetDiscards(pass))
+            {
+                dump += std::format("    discard {}\n", _compiler.GetName(resource));
+            }
+        }
+    };
+
+    std::string dump;
+    for(uint32_t pass = 0; pass < GetPassCount(); ++pass)
+    {
+        dump += std::format("Pass {} '{}' in list {}\n", pass, _compiler.GetPassName(pass), _compiler.GetCommandList(pass));
+        describeBarriers(dump, pass);
+        for(const RenderGraphCompiler::Access& access : _compiler.GetAccesses(pass))
+        {
+            dump += std::format("    {} {} as {}\n", access.write ? "writes" : "reads", _compiler.GetName(access.resource), DescribeStates(access.state));
+        }
+    }
+    dump += "End of frame\n";
+    describeBarriers(dump, GetPassCount());
+
+    for(ResourceId resource = 0; resource < _compiler.GetResourceCount(); ++resource)
+    {
+        if(!_compiler.IsTransient(resource))
+        {
+            continue;
+        }
+        if(!_compiler.IsUsed(resource))
+        {
+            dump += std::format("Transient {}: unused\n", _compiler.GetName(resource));
+            continue;
+        }
+        const RenderGraphCompiler::Placement placement = _compiler.GetPlacement(resource);
+        dump += std::format("Transient {}: heap {} at {} ({} bytes)\n", _compiler.GetName(resource), placement.heap, placement.offset, placement.size);
+    }
+
+    const Stats& stats = _compiler.GetStats();
+    dump += std::format("{} passes, {} transitions ({} split), {} aliasing and {} UAV barriers in {} ResourceBarrier calls instead of {}.\n",
+        stats.passCount, stats.transitionCount, stats.splitTransitionCount, stats.aliasingBarrierCount, stats.uavBarrierCount,
+        stats.barrierCalls, stats.unbatchedBarrierCalls);
+    dump += std::format("{} transient textures in {} bytes of {} heaps instead of {} bytes, {} bytes saved.\n",
+        stats.transientCount, stats.heapBytes, _compiler.GetHeaps().size(), stats.transientBytes, stats.transientBytes - stats.heapBytes);
+    return dump;
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO RenderGraph::EstimateAllocationInfo(const D3D12_RESOURCE_DESC& desc)
+{
+    const uint64_t alignment = desc.SampleDesc.Count > 1 ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    const uint64_t bitsPerPixel = DirectX::BitsPerPixel(desc.Format);
+    const uint16_t mipLevels = std::max<uint16_t>(desc.MipLevels, 1u);
+    const uint64_t layers = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1u : desc.DepthOrArraySize;
+
+    uint64_t size = 0;
+    for(uint16_t mip = 0; mip < mipLevels; ++mip)
+    {
+        const uint64_t width = std::max<uint64_t>(desc.Width >> mip, 1u);
+        const uint64_t height = std::max<uint64_t>(desc.Height >> mip, 1u);
+        const uint64_t depth = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? std::max<uint64_t>(desc.DepthOrArraySize >> mip, 1u) : 1u;
+        size += (width * height * depth * bitsPerPixel + 7) / 8;
+    }
+    size *= layers * std::max(desc.SampleDesc.Count, 1u);
+
+    return D3D12_RESOURCE_ALLOCATION_INFO{ .SizeInBytes = AlignUp(size, alignment), .Alignment = alignment };
+}
@@ -8,14 +8,25 @@
 
 #include "utility/dx12_helpers.hpp"
 #include "utility/resource_util.hpp"
+#include "utility/log.hpp"
+#include "utility/shader_pack.hpp"
 #include "glfw_app.hpp"
 #include "descriptor_heap.hpp"
 #include "command_queue.hpp"
 #include "camera.hpp"
+#include "upload_heap.hpp"
+#include "gpu_allocator.hpp"
+#include "geometry_buffer.hpp"
+#include "residency_manager.hpp"
+#include "shader_hot_reload.hpp"
+#include "pipeline_cache.hpp"
+#include "job_system.hpp"
+#include "frame_packet.hpp"
 
 #include "pipelines/geometry_pipeline.hpp"
 #include "pipelines/ui_pipeline.hpp"
 
+#include <chrono>
 
 Renderer::Renderer(std::shared_ptr<Application> app) :
 	_app(app),
@@ -34,34 +45,141 @@ Renderer::Renderer(std::shared_ptr<Application> app) :
     InitializeCommandQueues();
     InitializeDescriptorHeaps();
     InitializeSwapchainResources();
-    CreateDepthTarget();
+    _pipelineCache = std::make_unique<PipelineCache>(_device);
     CreateBindlessRootSignature();
 
+    _uploadHeap = std::make_unique<UploadHeap>(*this, UPLOAD_HEAP_SIZE_PER_FRAME);
+    _gpuAllocator = std::make_unique<GpuAllocator>(_device);
+    _geometryBuffer = std::make_unique<GeometryBuffer>(*this, GEOMETRY_BUFFER_VERTEX_CAPACITY, GEOMETRY_BUFFER_INDEX_CAPACITY);
+    _residencyManager = std::make_unique<ResidencyManager>(*this, RESIDENCY_BUDGET);
+    _residencyManager->AddPinned(_geometryBuffer->GetStats().bytes);
+    _shaderHotReload = std::make_unique<ShaderHotReload>(*this);
+
+    // Before any pipeline compiles its shaders.
+    Util::ShaderPack::Open();
+
     // Create pipelines
     _geometryPipeline = std::make_unique<GeometryPipeline>(*this, _camera);
     _uiPipeline = std::make_unique<UIPipeline>(*this);
+
+    CreateRenderGraph();
+
+    for(auto& framePacket : _framePackets)
+    {
+        framePacket = std::make_unique<FramePacket>();
+    }
+    _simulationPacket = std::make_unique<FramePacket>();
+    // Last, everything above is used by the render thread.
+    _renderThread = std::jthread([this](std::stop_token stopToken) { RenderLoop(stopToken); });
 }
 
 Renderer::~Renderer()
 {
+    // Stop the render thread first, it uses everything below. A frame it is drawing is finished first.
+    _renderThread.request_stop();
+    _renderThread.join();
+
+    // Then the shader watcher, a rebuild in progress still uses the device and the pipelines.
+    _shaderHotReload.reset();
+    _pipelineCache->Save();
+
+    // Restores still loading use the copy queue and the textures.
+    _residencyManager->FinishRestores();
+
     // Ensure that the GPU is no longer referencing resources that are about to be
     // cleaned up by the destructor.
     Flush();
+
+    // The pipelines own the meshes, which hand their geometry back through DeferRelease. With the GPU idle everything
+    // deferred can go, before the queue and the geometry buffer are destroyed.
+    _uiPipeline.reset();
+    _geometryPipeline.reset();
+    for(std::function<void()>& release : _releasesThisFrame)
+    {
+        release();
+    }
+    _releasesThisFrame.clear();
+    while(!_deferredReleases.empty())
+    {
+        _deferredReleases.front().release();
+        _deferredReleases.pop();
+    }
 }
 
 void Renderer::Update(float deltaTime, GLFWwindow* window)
+{
+    const auto simulationStart = std::chrono::high_resolution_clock::now();
+
+    const CameraInput cameraInput = ReadCameraInput(window);
+
+    // Toggle between direct and ExecuteIndirect draws.
+    const bool indirectKeyDown = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    if (indirectKeyDown && !_indirectKeyDown)
+    {
+        _geometryPipeline->SetIndirectDraws(!_geometryPipeline->GetIndirectDraws());
+        dblog::info("[RENDERER] Indirect draws {}.", _geometryPipeline->GetIndirectDraws() ? "enabled" : "disabled");
+    }
+    _indirectKeyDown = indirectKeyDown;
+
+    // Toggle software occlusion culling.
+    const bool occlusionKeyDown = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKeyDown && !_occlusionKeyDown)
+    {
+        _geometryPipeline->SetOcclusionCulling(!_geometryPipeline->GetOcclusionCulling());
+        dblog::info("[RENDERER] Occlusion culling {}.", _geometryPipeline->GetOcclusionCulling() ? "enabled" : "disabled");
+    }
+    _occlusionKeyDown = occlusionKeyDown;
+
+    // Snapshot what the render thread needs, the simulation is free to move on once the packet is submitted.
+    FramePacket& packet = *_simulationPacket;
+    packet.frameNumber = _frameNumber++;
+    packet.deltaTime = deltaTime;
+
+    _simulationGraph.Clear();
+    const TaskGraph::TaskId camera = _simulationGraph.AddTask("Camera", [&]() {
+        UpdateCamera(cameraInput, deltaTime, packet);
+    });
+    const TaskGraph::TaskId transforms = _simulationGraph.AddTask("Transforms", [&]() {
+        _geometryPipeline->Update(deltaTime);
+    });
+    const TaskGraph::TaskId cull = _simulationGraph.AddTask("Cull", [&]() {
+        _geometryPipeline->BuildFramePacket(packet);
+    }, { camera, transforms });
+    _simulationGraph.AddTask("Sort", [&]() {
+        packet.drawList.Sort();
+    }, { cull });
+    _simulationGraph.Execute();
+
+    packet.simulationGraphStats = _simulationGraph.GetStats();
+    packet.simulationMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - simulationStart).count();
+    SubmitFramePacket();
+}
+
+Renderer::CameraInput Renderer::ReadCameraInput(GLFWwindow* window) const
+{
+    CameraInput input;
+    glfwGetCursorPos(window, &input.cursorPosX, &input.cursorPosY);
+    input.rotate = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    input.fast = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+    input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.back = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    input.down = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS;
+    input.up = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    return input;
+}
+
+void Renderer::UpdateCamera(const CameraInput& input, float deltaTime, FramePacket& packet)
 {
     // TODO: move camera logic to different class
 
     /// calculate new rotation with inputs
-    double cursorPosX, cursorPosY;
-    glfwGetCursorPos(window, &cursorPosX, &cursorPosY);
-
-    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
+    if (input.rotate)
     {
         // Update yaw and pitch
-        _camera->yaw += (cursorPosX - _previousMousePos.x) * 0.1f;
-        _camera->pitch += (cursorPosY - _previousMousePos.y) * 0.1f;
+        _camera->yaw += (input.cursorPosX - _previousMousePos.x) * 0.1f;
+        _camera->pitch += (input.cursorPosY - _previousMousePos.y) * 0.1f;
 
         if (_camera->yaw > 360.0f) 
             _camera->yaw -= 360.0f;
@@ -87,31 +205,31 @@ void Renderer::Update(float deltaTime, GLFWwindow* window)
     /// calculate new translation with inputs
     XMVECTOR vel = XMVectorSet(0.f, 0.f, 0.f, 0.f);
     FLOAT acceleration = 10.0f;
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+    if (input.fast)
     {
         acceleration = 20.0f;
     }
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (input.forward)
     {
         vel += front * acceleration;
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (input.back)
     {
         vel += front * -acceleration;
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (input.left)
     {
         vel += right * -acceleration;
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (input.right)
     {
         vel += right * acceleration;
     }
-    if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
+    if (input.down)
     {
         vel += up * -acceleration;
     }
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+    if (input.up)
     {
         vel += up * acceleration;
     }
@@ -124,38 +242,116 @@ void Renderer::Update(float deltaTime, GLFWwindow* window)
     _camera->view = XMMatrixLookAtLH(_camera->position, _camera->position + _camera->front, _camera->up);
     _camera->model = rotation;
 
-    _previousMousePos = XMFLOAT2(cursorPosX, cursorPosY);
+    _previousMousePos = XMFLOAT2(input.cursorPosX, input.cursorPosY);
 
-    // Update pipelines
-    _geometryPipeline->Update(deltaTime);
+    XMStoreFloat4x4(&packet.view, _camera->view);
+    XMStoreFloat4x4(&packet.projection, _camera->projection);
+    XMStoreFloat3(&packet.cameraPosition, _camera->position);
 }
 
-void Renderer::Render()
+void Renderer::SubmitFramePacket()
 {
-    auto commandList = _directCommandQueue->GetCommandList();
+    {
+        std::unique_lock<std::mutex> lock(_packetMutex);
+        // At most one packet waits for the render thread, so the simulation never runs more than a frame ahead.
+        _packetCondition.wait(lock, [this] { return _submittedPacket == NO_PACKET; });
+        const uint32_t packetIndex = _renderingPacket == 0 ? 1 : 0;
+        // The packet it replaces was drawn already, the simulation fills it next.
+        std::swap(_framePackets[packetIndex], _simulationPacket);
+        _submittedPacket = packetIndex;
+    }
+    _packetCondition.notify_all();
+}
 
-    // Set heaps for bindless.
-    SetDescriptorHeaps(commandList);
+void Renderer::RenderLoop(std::stop_token stopToken)
+{
+    while(true)
+    {
+        uint32_t packetIndex;
+        {
+            std::unique_lock<std::mutex> lock(_packetMutex);
+            if(!_packetCondition.wait(lock, stopToken, [this] { return _submittedPacket != NO_PACKET; }))
+            {
+                return;
+            }
+            packetIndex = _renderingPacket = _submittedPacket;
+            _submittedPacket = NO_PACKET;
+        }
+        // The main thread can start filling the other packet.
+        _packetCondition.notify_all();
 
-    // Clear targets.
-    auto rtvHandle = _rtvHeap->GetDescriptorHandleFromIndex(_renderTargetIndex[_frameIndex]);
-    auto dsvHandle = _dsvHeap->GetDescriptorHandleFromIndex(_depthTargetIndex);
-    Util::TransitionResource(commandList, _renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    commandList->ClearRenderTargetView(rtvHandle.cpuDescriptorHandle, clearColor, 0, nullptr);
-    commandList->ClearDepthStencilView(dsvHandle.cpuDescriptorHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+        Render(*_framePackets[packetIndex]);
 
-    // Record command lists.
-    commandList->OMSetRenderTargets(1, &rtvHandle.cpuDescriptorHandle, FALSE, &dsvHandle.cpuDescriptorHandle);
-    commandList->RSSetViewports(1, &_viewport);
-    commandList->RSSetScissorRects(1, &_scissorRect);
-    _geometryPipeline->PopulateCommandlist(commandList);
+        {
+            std::lock_guard<std::mutex> lock(_packetMutex);
+            _renderingPacket = NO_PACKET;
+        }
+    }
+}
 
-    // Sync up resource(s) (might need this in between some stages later)
-    Util::TransitionResource(commandList, _renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+RenderGraph::PassId Renderer::AddRenderPass(std::string name, RecordFunction record)
+{
+    // Every pass records into a command list of its own.
+    const RenderGraph::PassId pass = _renderGraph.AddPass(name, static_cast<uint32_t>(_renderPasses.size()));
+    _renderPasses.push_back(RenderPass{ std::move(name), std::move(record) });
+    return pass;
+}
 
-    // Execute commandlist.
-    uint64_t fenceValue = _directCommandQueue->ExecuteCommandList(commandList);
-    _fenceValues[_frameIndex] = fenceValue;
+void Renderer::Render(const FramePacket& packet)
+{
+    const auto recordStart = std::chrono::high_resolution_clock::now();
+
+    // Frame boundary, nothing is recording so pipelines rebuilt in the background can be swapped in.
+    _shaderHotReload->ApplyPendingReloads();
+    ReleaseCompletedObjects();
+    // Before anything records, evicted textures this frame draws with are loaded again.
+    _residencyManager->Update(packet);
+
+    // The fence of this frame has been waited on at the end of the previous Render(), so its upload memory is free again.
+    _uploadHeap->BeginFrame(_frameIndex);
+    UpdateViewResources(packet);
+
+    // The queue's pools aren't thread safe, so every list is taken here. They're executed in this order: the passes in
+    // the order they were added, then the barriers ending the frame.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>> commandLists;
+    for(size_t i = 0; i < _renderPasses.size() + 1; ++i)
+    {
+        commandLists.push_back(_directCommandQueue->GetCommandList());
+    }
+    _renderGraph.SetImportedResource(_backBuffer, _renderTargets[_frameIndex].Get());
+
+    // Passes record at the same time, each into its own list starting with the barriers the render graph put before it.
+    _renderTasks.Clear();
+    std::vector<TaskGraph::TaskId> recordTasks;
+    for(uint32_t pass = 0; pass < _renderPasses.size(); ++pass)
+    {
+        recordTasks.push_back(_renderTasks.AddTask(_renderPasses[pass].name, [this, pass, commandList = commandLists[pass], &packet]() {
+            _renderGraph.RecordBarriers(commandList, pass);
+            BeginPass(commandList);
+            _renderPasses[pass].record(commandList, packet);
+            _uploadHeap->FenceWrites();
+        }));
+    }
+
+    _renderTasks.AddTask("Submit", [&]() {
+        _renderGraph.RecordBarriers(commandLists.back(), _renderGraph.GetPassCount());
+
+        // Execute commandlists.
+        _uploadHeap->EndFrame();
+        uint64_t fenceValue = _directCommandQueue->ExecuteCommandLists(commandLists);
+        _fenceValues[_frameIndex] = fenceValue;
+
+        std::lock_guard<std::mutex> lock(_releaseMutex);
+        for(std::function<void()>& release : _releasesThisFrame)
+        {
+            _deferredReleases.push(DeferredRelease{ fenceValue, std::move(release) });
+        }
+        _releasesThisFrame.clear();
+    }, recordTasks);
+
+    _renderTasks.Execute();
+
+    _recordMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
 
     // Present the frame.
     Util::ThrowIfFailed(_swapChain->Present(1, 0));
@@ -163,6 +359,47 @@ void Renderer::Render()
     // Wait for new back buffer to be done.
     _frameIndex = _swapChain->GetCurrentBackBufferIndex();
     _directCommandQueue->WaitForFenceValue(_fenceValues[_frameIndex]);
+
+    _statsTimer += packet.deltaTime;
+    if (_statsTimer >= 1.0f)
+    {
+        LogStats(packet);
+        _statsTimer = 0.0f;
+    }
+}
+
+void Renderer::BeginPass(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList) const
+{
+    // Set heaps for bindless.
+    SetDescriptorHeaps(commandList);
+
+    auto rtvHandle = _rtvHeap->GetDescriptorHandleFromIndex(_renderTargetIndex[_frameIndex]);
+    auto dsvHandle = _dsvHeap->GetDescriptorHandleFromIndex(_depthTargetIndex);
+    commandList->OMSetRenderTargets(1, &rtvHandle.cpuDescriptorHandle, FALSE, &dsvHandle.cpuDescriptorHandle);
+    commandList->RSSetViewports(1, &_viewport);
+    commandList->RSSetScissorRects(1, &_scissorRect);
+}
+
+void Renderer::DeferRelease(Microsoft::WRL::ComPtr<IUnknown> object)
+{
+    // The reference goes with the function.
+    DeferRelease([object = std::move(object)]() {});
+}
+
+void Renderer::DeferRelease(std::function<void()> release)
+{
+    // Tagged with this frame's fence once it is submitted, so it outlives anything recorded before or after this call.
+    std::lock_guard<std::mutex> lock(_releaseMutex);
+    _releasesThisFrame.push_back(std::move(release));
+}
+
+void Renderer::ReleaseCompletedObjects()
+{
+    while(!_deferredReleases.empty() && _directCommandQueue->IsFenceComplete(_deferredReleases.front().fenceValue))
+    {
+        _deferredReleases.front().release();
+        _deferredReleases.pop();
+    }
 }
 
 void Renderer::Flush()
@@ -171,6 +408,80 @@ void Renderer::Flush()
     _copyCommandQueue->Flush();
 }
 
+void Renderer::UpdateViewResources(const FramePacket& packet)
+{
+    ViewResources viewResources;
+    viewResources.CameraVP = XMMatrixMultiply(XMLoadFloat4x4(&packet.view), XMLoadFloat4x4(&packet.projection));
+    viewResources.cameraPosition = packet.cameraPosition;
+
+    _viewResourcesAddress = _uploadHeap->Push(viewResources).gpuAddress;
+}
+
+void Renderer::LogStats(const FramePacket& packet) const
+{
+    const UploadHeap::Stats& uploadStats = _uploadHeap->GetLastFrameStats();
+    dblog::info("[UPLOAD_HEAP] {} allocations, {} bytes allocated, {} bytes written of {} per frame.",
+        uploadStats.allocationCount, uploadStats.bytesAllocated, uploadStats.bytesWritten, _uploadHeap->GetFrameSize());
+
+    for(uint32_t pool = 0; pool < static_cast<uint32_t>(GpuAllocator::Pool::Count); ++pool)
+    {
+        const GpuAllocator::PoolStats poolStats = _gpuAllocator->GetStats(static_cast<GpuAllocator::Pool>(pool));
+        if(poolStats.heapCount == 0)
+        {
+            continue;
+        }
+        // Waste is lost to alignment, committed resources would have rounded every allocation up to 64KB.
+        const Util::TlsfAllocator::Stats& memory = poolStats.memory;
+        dblog::info("[GPU_ALLOCATOR] {} pool: {} allocations, {} of {} bytes used in {} heaps, {} bytes wasted, {} bytes as committed resources, {} free blocks, {:.1f}% fragmented.",
+            GpuAllocator::GetPoolName(static_cast<GpuAllocator::Pool>(pool)), memory.allocationCount, memory.usedBytes, memory.size, poolStats.heapCount,
+            memory.usedBytes - memory.requestedBytes, poolStats.committedBytes, memory.freeBlockCount, 100.0f * memory.Fragmentation());
+    }
+
+    const GeometryBuffer::Stats geometryStats = _geometryBuffer->GetStats();
+    dblog::info("[GEOMETRY_BUFFER] {} meshes, {} of {} vertices and {} of {} indices used, {} bytes, {:.1f}% of free vertices fragmented.",
+        geometryStats.meshCount, geometryStats.vertices.usedBytes, geometryStats.vertices.size, geometryStats.indices.usedBytes, geometryStats.indices.size,
+        geometryStats.bytes, 100.0f * geometryStats.vertices.Fragmentation());
+
+    const ResidencyManager::Stats residencyStats = _residencyManager->GetStats();
+    const Util::ResidencyPolicy::Stats& residency = residencyStats.policy;
+    dblog::info("[RESIDENCY] {} of {} bytes budget resident ({} pinned) in {} resources, {} bytes evicted in {} resources, {} waiting to be restored.",
+        residency.residentBytes, residency.budget, residency.pinnedBytes, residency.residentCount, residency.evictedBytes, residency.evictedCount,
+        residency.waitingCount);
+    dblog::info("[RESIDENCY] {} restores loading.", residencyStats.loadingRestores);
+    dblog::info("[RESIDENCY] {} evictions and {} restores since startup, {} frames over budget. The process uses {} of {} bytes of video memory.",
+        residency.evictions, residency.restores, residency.overBudgetFrames, residencyStats.localUsage, residencyStats.localBudget);
+
+    const JobSystem::Stats jobStats = JobSystem::Get().GetStats();
+    dblog::info("[JOB_SYSTEM] {} jobs run since startup, {} of them stolen and {} low priority, on {} workers.",
+        jobStats.jobsRun, jobStats.jobsStolen, jobStats.lowPriorityJobsRun, JobSystem::Get().GetWorkerCount());
+
+    const GeometryPipeline::DrawStats& drawStats = _geometryPipeline->GetDrawStats();
+    dblog::info("[GEOMETRY_PIPELINE] {} draws for {} instances in {} indirect executions, {} pipeline changes, {} index buffer changes, {} state changes avoided, {} root constant dwords.",
+        drawStats.drawCount, drawStats.instanceCount, drawStats.indirectExecutions, drawStats.pipelineChanges, drawStats.indexBufferChanges, drawStats.stateChangesAvoided,
+        drawStats.rootConstantDwords);
+    dblog::info("[GEOMETRY_PIPELINE] {} draws on a stand-in pipeline, {} skipped, {} pipelines compiling, {} frames used a stand-in since startup.",
+        drawStats.fallbackDraws, drawStats.skippedDraws, drawStats.pendingPipelines, drawStats.fallbackFrames);
+    const Scene::Stats& sceneStats = packet.sceneStats;
+    dblog::info("[SCENE] {} entities in {} slots, {} bytes of components ({} per entity), updated in {:.3f} ms.",
+        sceneStats.entityCount, sceneStats.slotCount, sceneStats.memoryBytes, sceneStats.bytesPerEntity, sceneStats.updateMilliseconds);
+    const FramePacket::CullStats& cullStats = packet.cullStats;
+    dblog::info("[TRANSFORMS] {} world matrices recomputed, {} nodes scanned.", cullStats.transformsTouched, cullStats.transformsScanned);
+    dblog::info("[CULLING] {} of {} objects in the frustum, {} BVH nodes visited, culled and collected in {:.3f} ms.",
+        cullStats.frustumVisibleCount, cullStats.objectCount, cullStats.bvhNodesVisited, cullStats.cullMilliseconds);
+    const float occludedPercentage = cullStats.frustumVisibleCount > 0 ? 100.0f * cullStats.occludedCount / cullStats.frustumVisibleCount : 0.0f;
+    dblog::info("[OCCLUSION] {} objects ({:.1f}%) occluded by {} occluders ({} triangles), {} drawn, took {:.3f} ms.",
+        cullStats.occludedCount, occludedPercentage, cullStats.occluderCount, cullStats.occluderTriangleCount, cullStats.visibleCount, cullStats.occlusionMilliseconds);
+    const TaskGraph::Stats& simulationStats = packet.simulationGraphStats;
+    dblog::info("[TASK_GRAPH] Simulation: {} tasks, {:.3f} ms of work in {:.3f} ms, critical path {} ({:.3f} ms).",
+        simulationStats.taskCount, simulationStats.workMilliseconds, simulationStats.milliseconds, simulationStats.criticalPath, simulationStats.criticalPathMilliseconds);
+    const TaskGraph::Stats& renderStats = _renderTasks.GetStats();
+    dblog::info("[TASK_GRAPH] Render: {} tasks, {:.3f} ms of work in {:.3f} ms, critical path {} ({:.3f} ms).",
+        renderStats.taskCount, renderStats.workMilliseconds, renderStats.milliseconds, renderStats.criticalPath, renderStats.criticalPathMilliseconds);
+    // The two overlap, so a frame takes about as long as the slower of them.
+    dblog::info("[FRAME] Frame {} simulated in {:.3f} ms on the main thread, recorded and submitted in {:.3f} ms on the render thread.",
+        packet.frameNumber, packet.simulationMilliseconds, _recordMilliseconds);
+}
+
 void Renderer::SetDescriptorHeaps(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList) const
 {
     const std::array<ID3D12DescriptorHeap* const, 2u> shaderVisibleDescriptorHeaps = {
@@ -301,26 +612,42 @@ void Renderer::CreateRenderTargets()
     }
 }
 
-void Renderer::CreateDepthTarget()
+void Renderer::CreateRenderGraph()
 {
-    // Flush any GPU commands that might be referencing the depth buffer.
-    Flush();
+    // The swap chain hands out a different one every frame, it's set before recording.
+    _backBuffer = _renderGraph.ImportResource("Back Buffer", D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_PRESENT);
 
     D3D12_CLEAR_VALUE optimizedClearValue = {};
     optimizedClearValue.Format = DXGI_FORMAT_D32_FLOAT;
     optimizedClearValue.DepthStencil = { 1.0f, 0 };
-
-    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
-    CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, _width, _height,
+    const CD3DX12_RESOURCE_DESC depthDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, _width, _height,
         1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-    Util::ThrowIfFailed(_device->CreateCommittedResource(
-        &heapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &optimizedClearValue,
-        IID_PPV_ARGS(&_depthTarget)
-    ));
+    _depthBuffer = _renderGraph.CreateTexture("Depth Target", depthDesc, &optimizedClearValue);
+
+    // Executed in this order, adding a pass is adding it here with the resources it uses.
+    const RenderGraph::PassId clear = AddRenderPass("Clear", [this](const auto& commandList, const FramePacket&) {
+        auto rtvHandle = _rtvHeap->GetDescriptorHandleFromIndex(_renderTargetIndex[_frameIndex]);
+        auto dsvHandle = _dsvHeap->GetDescriptorHandleFromIndex(_depthTargetIndex);
+        commandList->ClearRenderTargetView(rtvHandle.cpuDescriptorHandle, clearColor, 0, nullptr);
+        commandList->ClearDepthStencilView(dsvHandle.cpuDescriptorHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+    });
+    _renderGraph.Write(clear, _backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    _renderGraph.Write(clear, _depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+    const RenderGraph::PassId geometry = AddRenderPass("Geometry", [this](const auto& commandList, const FramePacket& packet) {
+        _geometryPipeline->PopulateCommandlist(commandList, packet);
+    });
+    _renderGraph.Write(geometry, _backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    _renderGraph.Write(geometry, _depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
+
+    const RenderGraph::PassId ui = AddRenderPass("UI", [this](const auto& commandList, const FramePacket&) {
+        _uiPipeline->PopulateCommandlist(commandList);
+    });
+    _renderGraph.Write(ui, _backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    _renderGraph.Compile([this](const D3D12_RESOURCE_DESC& desc) { return _device->GetResourceAllocationInfo(0, 1, &desc); });
+    _renderGraph.CreateTransientResources(_device.Get());
+    dblog::info("[RENDER_GRAPH] Compiled the frame:\n{}", _renderGraph.Dump());
 
     const D3D12_DEPTH_STENCIL_VIEW_DESC dsv = {
         .Format = DXGI_FORMAT_D32_FLOAT,
@@ -331,8 +658,7 @@ void Renderer::CreateDepthTarget()
         }
     };
 
-    _depthTargetIndex = CreateDsv(dsv, _depthTarget);
-    _depthTarget->SetName(L"Depth Target");
+    _depthTargetIndex = CreateDsv(dsv, _renderGraph.GetResource(_depthBuffer));
 }
 
 void Renderer::CreateBindlessRootSignature()
@@ -342,8 +668,9 @@ void Renderer::CreateBindlessRootSignature()
         D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED |
         D3D12_ROOT_SIGNATURE_FLAG_SAMPLER_HEAP_DIRECTLY_INDEXED;
 
-    CD3DX12_ROOT_PARAMETER rootParameters[1];
+    CD3DX12_ROOT_PARAMETER rootParameters[2];
     rootParameters[0].InitAsConstants(64, 0, 0, D3D12_SHADER_VISIBILITY_ALL);
+    rootParameters[1].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_ALL); // per-view data in the upload heap
 
     CD3DX12_STATIC_SAMPLER_DESC defaultSampler;
     defaultSampler.Init(0);
@@ -354,43 +681,66 @@ void Renderer::CreateBindlessRootSignature()
     Microsoft::WRL::ComPtr<ID3DBlob> signature;
     Microsoft::WRL::ComPtr<ID3DBlob> error;
     Util::ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
-    Util::ThrowIfFailed(_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&_bindlessRootSignature)));
+    _bindlessRootSignature = _pipelineCache->CreateRootSignature(signature->GetBufferPointer(), signature->GetBufferSize());
 }
 
 
+uint32_t Renderer::AllocateSrvIndex() const
+{
+    std::lock_guard<std::mutex> lock(_srvMutex);
+    if(!_retiredSrvIndices.empty())
+    {
+        const uint32_t srvIndex = _retiredSrvIndices.back();
+        _retiredSrvIndices.pop_back();
+        return srvIndex;
+    }
+
+    const uint32_t srvIndex = _srvHeap->GetCurrentDescriptorIndex();
+    _srvHeap->OffsetCurrentHandle();
+    return srvIndex;
+}
+
 uint32_t Renderer::CreateCbv(const D3D12_CONSTANT_BUFFER_VIEW_DESC& cbvCreationDesc) const
 {
-    const uint32_t cbvIndex = _srvHeap->GetCurrentDescriptorIndex();
+    const uint32_t cbvIndex = AllocateSrvIndex();
 
     _device->CreateConstantBufferView(&cbvCreationDesc,
-                                       _srvHeap->GetCurrentDescriptorHandle().cpuDescriptorHandle);
-
-    _srvHeap->OffsetCurrentHandle();
+                                       _srvHeap->GetDescriptorHandleFromIndex(cbvIndex).cpuDescriptorHandle);
 
     return cbvIndex;
 }
 
 uint32_t Renderer::CreateSrv(const D3D12_SHADER_RESOURCE_VIEW_DESC& srvCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const
 {
-    const uint32_t srvIndex = _srvHeap->GetCurrentDescriptorIndex();
+    const uint32_t srvIndex = AllocateSrvIndex();
 
     _device->CreateShaderResourceView(resource.Get(), &srvCreationDesc,
-                                       _srvHeap->GetCurrentDescriptorHandle().cpuDescriptorHandle);
-
-    _srvHeap->OffsetCurrentHandle();
+                                       _srvHeap->GetDescriptorHandleFromIndex(srvIndex).cpuDescriptorHandle);
 
     return srvIndex;
 }
 
+void Renderer::RetireSrv(uint32_t srvIndex)
+{
+    DeferRelease([this, srvIndex]() {
+        std::lock_guard<std::mutex> lock(_srvMutex);
+        _retiredSrvIndices.push_back(srvIndex);
+    });
+}
+
+void Renderer::UpdateSrv(uint32_t srvIndex, const D3D12_SHADER_RESOURCE_VIEW_DESC& srvCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const
+{
+    _device->CreateShaderResourceView(resource.Get(), &srvCreationDesc,
+                                       _srvHeap->GetDescriptorHandleFromIndex(srvIndex).cpuDescriptorHandle);
+}
+
 uint32_t Renderer::CreateUav(const D3D12_UNORDERED_ACCESS_VIEW_DESC& uavCreationDesc, const Microsoft::WRL::ComPtr<ID3D12Resource>& resource) const
 {
-    const uint32_t uavIndex = _srvHeap->GetCurrentDescriptorIndex();
+    const uint32_t uavIndex = AllocateSrvIndex();
 
     _device->CreateUnorderedAccessView(
         resource.Get(), nullptr, &uavCreationDesc,
-        _srvHeap->GetCurrentDescriptorHandle().cpuDescriptorHandle);
-
-    _srvHeap->OffsetCurrentHandle();
+        _srvHeap->GetDescriptorHandleFromIndex(uavIndex).cpuDescriptorHandle);
 
     return uavIndex;
 }
@@ -0,0 +1,206 @@
+#include "residency_manager.hpp"
+
+#include "utility/dx12_helpers.hpp"
+#include "utility/log.hpp"
+#include "utility/resource_util.hpp"
+
+#include "renderer.hpp"
+#include "resources.hpp"
+#include "command_queue.hpp"
+#include "gpu_allocator.hpp"
+#include "frame_packet.hpp"
+#include "job_system.hpp"
+
+using namespace Microsoft::WRL;
+
+ResidencyManager::ResidencyManager(Renderer& renderer, uint64_t budget) :
+    _renderer(renderer),
+    // A frame's textures can be evicted once the GPU is done with it, FRAME_COUNT frames later.
+    _policy(budget, FRAME_COUNT, RESIDENCY_RESTORE_BYTES_PER_FRAME)
+{
+    // The adapter the device was created on, for its memory budget.
+    ComPtr<IDXGIFactory4> factory;
+    Util::ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
+    Util::ThrowIfFailed(factory->EnumAdapterByLuid(renderer.GetDevice()->GetAdapterLuid(), IID_PPV_ARGS(&_adapter)));
+
+    SetBudget(budget);
+}
+
+ResidencyManager::~ResidencyManager()
+{
+    assert(_pendingRestores.empty() && "FinishRestores() has to run while the copy queue is alive.");
+    const Util::ResidencyPolicy::Stats stats = _policy.GetStats();
+    dblog::info("[RESIDENCY] {} evictions and {} restores since startup.", stats.evictions, stats.restores);
+}
+
+void ResidencyManager::Track(Texture& texture)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    texture.residencyId = _policy.Add(texture.allocation.size);
+    if(texture.residencyId >= _textures.size())
+    {
+        _textures.resize(texture.residencyId + 1, nullptr);
+    }
+    _textures[texture.residencyId] = &texture;
+}
+
+void ResidencyManager::Untrack(Texture& texture)
+{
+    if(texture.residencyId == Util::ResidencyPolicy::NO_RESOURCE)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.Remove(texture.residencyId);
+    _textures[texture.residencyId] = nullptr;
+    texture.residencyId = Util::ResidencyPolicy::NO_RESOURCE;
+
+    // The job doesn't touch the texture, what it loads is freed once the copy is done.
+    for(const std::unique_ptr<PendingRestore>& restore : _pendingRestores)
+    {
+        if(restore->texture == &texture)
+        {
+            restore->texture = nullptr;
+        }
+    }
+}
+
+void ResidencyManager::AddPinned(uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const Util::ResidencyPolicy::ResourceId resource = _policy.Add(size, true);
+    if(resource >= _textures.size())
+    {
+        _textures.resize(resource + 1, nullptr);
+    }
+}
+
+void ResidencyManager::Update(const FramePacket& packet)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.BeginFrame();
+
+    // The base color texture is the only one the shaders sample so far, the others are evicted once over budget.
+    for(size_t i = 0; i < packet.drawList.GetCount(); ++i)
+    {
+        const Texture* texture = packet.drawList.GetSorted(i).material->baseColorTexture.get();
+        if(texture && texture->residencyId != Util::ResidencyPolicy::NO_RESOURCE)
+        {
+            _policy.MarkUsed(texture->residencyId);
+        }
+    }
+
+    const Util::ResidencyPolicy::Decisions& decisions = _policy.Update();
+
+    // The GPU is done with everything evicted, its memory can go to the restores right away. A restore still loading
+    // is thrown away once its copy is done.
+    for(const Util::ResidencyPolicy::ResourceId resource : decisions.evict)
+    {
+        for(const std::unique_ptr<PendingRestore>& restore : _pendingRestores)
+        {
+            if(restore->resource == resource)
+            {
+                restore->texture = nullptr;
+            }
+        }
+        _textures[resource]->Evict(_renderer);
+    }
+
+    // The copy queue is only used from the render thread once it runs, the jobs get a list each to record into.
+    for(const Util::ResidencyPolicy::ResourceId resource : decisions.restore)
+    {
+        auto restore = std::make_unique<PendingRestore>();
+        restore->texture = _textures[resource];
+        restore->resource = resource;
+        restore->commandList = _renderer.GetCopyCommandQueue().GetCommandList();
+        restore->load = JobSystem::Get().Async([pending = restore.get(), &allocator = _renderer.GetGpuAllocator(),
+            path = Util::StringTowString(restore->texture->path)]() {
+            DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+            Util::LoadTextureFromFile(allocator, pending->commandList, pending->allocation, pending->intermediate, path, format);
+        }, JobSystem::Priority::Low);
+        _pendingRestores.push_back(std::move(restore));
+    }
+
+    ProcessRestores(false);
+}
+
+void ResidencyManager::FinishRestores()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ProcessRestores(true);
+}
+
+void ResidencyManager::ProcessRestores(bool wait)
+{
+    CommandQueue& copyQueue = _renderer.GetCopyCommandQueue();
+    GpuAllocator& allocator = _renderer.GetGpuAllocator();
+
+    std::erase_if(_pendingRestores, [&](const std::unique_ptr<PendingRestore>& restore) {
+        if(restore->fenceValue == 0)
+        {
+            if(!wait && restore->load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                return false;
+            }
+
+            try
+            {
+                JobSystem::Get().Wait(restore->load);
+            }
+            catch(const std::exception&)
+            {
+                // Whatever got recorded still runs, it is freed like a restore that was thrown away.
+                dblog::error("[RESIDENCY] Failed to restore {}, it stays a null view.", restore->texture ? restore->texture->path : "an untracked texture");
+                restore->texture = nullptr;
+            }
+            restore->fenceValue = copyQueue.ExecuteCommandList(restore->commandList);
+            restore->commandList.Reset();
+        }
+
+        if(wait)
+        {
+            copyQueue.WaitForFenceValue(restore->fenceValue);
+        }
+        else if(!copyQueue.IsFenceComplete(restore->fenceValue))
+        {
+            return false;
+        }
+
+        allocator.Free(restore->intermediate);
+        if(restore->texture && restore->allocation.IsValid())
+        {
+            restore->texture->Restore(_renderer, std::move(restore->allocation));
+        }
+        else
+        {
+            allocator.Free(restore->allocation);
+        }
+        return true;
+    });
+}
+
+void ResidencyManager::SetBudget(uint64_t budget)
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO info{};
+    Util::ThrowIfFailed(_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info));
+
+    // Some drivers don't report a budget.
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy.SetBudget(info.Budget > 0 ? std::min(budget, info.Budget) : budget);
+    dblog::info("[RESIDENCY] Budget of {} bytes, the adapter gives us {} bytes.", _policy.GetBudget(), info.Budget);
+}
+
+ResidencyManager::Stats ResidencyManager::GetStats() const
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO info{};
+    Util::ThrowIfFailed(_adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Stats{
+        .policy = _policy.GetStats(),
+        .localBudget = info.Budget,
+        .localUsage = info.CurrentUsage,
+        .loadingRestores = static_cast<uint32_t>(_pendingRestores.size()),
+    };
+}
@@ -6,55 +6,45 @@
 
 #include "command_queue.hpp"
 #include "renderer.hpp"
+#include "residency_manager.hpp"
 #include "camera.hpp"
 
+#include <assimp/GltfMaterial.h>
+
+#include <atomic>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 
-using namespace Util;
-using namespace Microsoft::WRL;
-
-Model::Model(Renderer& renderer, const std::string& fileName)
+namespace
 {
-    LoadModel(renderer, fileName);
-}
+    std::atomic<uint32_t> nextMeshId{0};
+    std::atomic<uint32_t> nextMaterialId{0};
 
-void Model::Draw(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const std::shared_ptr<Camera> camera)
-{
-    _rootNode->Draw(commandList, camera);
-}
+    // Meshes above this many triangles cost more to rasterize than they save as occluders.
+    constexpr size_t MAX_OCCLUDER_TRIANGLES = 2048;
 
-void Node::Draw(const Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2>& commandList, const std::shared_ptr<Camera> camera)
-{
-    if(_mesh)
+    D3D12_SHADER_RESOURCE_VIEW_DESC TextureSrvDesc(DXGI_FORMAT format)
     {
-        commandList->IASetIndexBuffer(&_mesh->GetIndexBufferView());
-
-        RenderResources rs;
-        rs.MVP = _transform;
-        rs.CameraVP = XMMatrixMultiply(camera->view, camera->projection);
-        rs.positionBufferIndex = _mesh->GetPositionBufferSRVIndex();
-        rs.normalBufferIndex = _mesh->GetNormalBufferSRVIndex();
-        rs.uvBufferIndex = _mesh->GetUVBufferSRVIndex();
-        if(_material->baseColorTexture)
-        {
-            rs.textureIndex = _material->baseColorTexture->srvIndex;
-            rs.useTexture = true;
-        }
-        else
-        {
-            rs.useTexture = false;
-        }
-        commandList->SetGraphicsRoot32BitConstants(0, 64, &rs, 0);
-
-        commandList->DrawIndexedInstanced(_mesh->GetIndexCount(), 1, 0, 0, 0);
+        return D3D12_SHADER_RESOURCE_VIEW_DESC{
+            .Format = format,
+            .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+            .Texture2D = {
+                .MostDetailedMip = 0u,
+                .MipLevels = 1u,
+                .PlaneSlice = 0u,
+              },
+        };
     }
+}
 
-    for(auto child : _children)
-    {
-        child->Draw(commandList, camera);
-    }
+using namespace Util;
+using namespace Microsoft::WRL;
+
+Model::Model(Renderer& renderer, const std::string& fileName)
+{
+    LoadModel(renderer, fileName);
 }
 
 void Model::LoadModel(Renderer& renderer, const std::string& fileName)
@@ -87,37 +77,35 @@ void Model::LoadModel(Renderer& renderer, const std::string& fileName)
     }
 
     // Recursively go over nodes to set-up hierarchy
-    ProcessNode(renderer, *scene, *scene->mRootNode, nullptr);
+    ProcessNode(renderer, *scene, *scene->mRootNode, NO_PARENT);
 }
 
-void Model::ProcessNode(Renderer& renderer, const aiScene& scene, aiNode& node, std::shared_ptr<Node> parentNode)
+void Model::ProcessNode(Renderer& renderer, const aiScene& scene, aiNode& node, uint32_t parentIndex)
 {
-    auto newNode = std::make_shared<Node>();
-    newNode->SetTransform(aiMatrix4x4ToXMMATRIX(node.mTransformation));
-
-    // Set hierarchy
-    if(parentNode != nullptr)
-    {
-        newNode->SetParent(parentNode);
-        parentNode->AddChild(newNode);
-    }
-    else // is our model's root node
+    // Depth first, so every node is added after its parent.
+    const uint32_t nodeIndex = static_cast<uint32_t>(_nodes.size());
+    Node& newNode = _nodes.emplace_back();
+    XMStoreFloat4x4(&newNode.transform, aiMatrix4x4ToXMMATRIX(node.mTransformation));
+    newNode.parent = parentIndex;
+
+    // process meshes and their materials, extra meshes become children without a transform of their own
+    for(uint32_t i = 0; i < node.mNumMeshes; ++i)
     {
-        _rootNode = newNode;
-    }
-
-    // process meshes and its materials
-    if(node.mNumMeshes > 0)
-    {
-        auto mesh = _meshes[node.mMeshes[0]];
-        newNode->SetMesh(mesh);
-        newNode->SetMaterial(_materials[mesh->GetMaterialIndex()]);
+        const auto& mesh = _meshes[node.mMeshes[i]];
+        Node& meshNode = i == 0 ? _nodes[nodeIndex] : _nodes.emplace_back();
+        if(i > 0)
+        {
+            XMStoreFloat4x4(&meshNode.transform, XMMatrixIdentity());
+            meshNode.parent = nodeIndex;
+        }
+        meshNode.mesh = mesh.get();
+        meshNode.material = _materials[mesh->GetMaterialIndex()].get();
     }
 
     // continue recursive node loading process
     for(uint32_t i = 0; i < node.mNumChildren; ++i)
     {
-        ProcessNode(renderer, scene, *node.mChildren[i], newNode);
+        ProcessNode(renderer, scene, *node.mChildren[i], nodeIndex);
     }
 }
 
@@ -210,6 +198,7 @@ void Model::ProcessMaterial(Renderer& renderer, aiMaterial& material)
 {
     // Load material when not found
     auto mat = std::make_shared<Material>();
+    mat->id = nextMaterialId++;
     
     // TODO: Better material loading when implementing PBR
     mat->baseColorTexture = LoadMaterialTexture(renderer, material, aiTextureType_DIFFUSE);
@@ -218,131 +207,113 @@ void Model::ProcessMaterial(Renderer& renderer, aiMaterial& material)
     mat->normalTexture = LoadMaterialTexture(renderer, material, aiTextureType_NORMALS);
     mat->occlusionTexture = LoadMaterialTexture(renderer, material, aiTextureType_AMBIENT_OCCLUSION);
 
+    aiString alphaMode;
+    if(material.Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == AI_SUCCESS && std::string(alphaMode.C_Str()) == "MASK")
+    {
+        mat->alphaTested = true;
+        material.Get(AI_MATKEY_GLTF_ALPHACUTOFF, mat->alphaCutoff);
+    }
+
+    // The alpha test reads the base color texture's alpha.
+    if(mat->baseColorTexture)
+    {
+        mat->shaderFeatures |= MaterialFeature::TEXTURED;
+        if(mat->alphaTested)
+        {
+            mat->shaderFeatures |= MaterialFeature::ALPHA_TESTED;
+        }
+    }
+
     _materials.push_back(std::move(mat));
 }
 
 Mesh::Mesh(Renderer& renderer, std::vector<XMFLOAT3> positions, std::vector<XMFLOAT3> normals, std::vector<XMFLOAT2> uvs, std::vector<uint16_t> indices, unsigned int materialIndex)
 {
     auto commandList = renderer.GetCopyCommandQueue().GetCommandList();
+    _renderer = &renderer;
 
-    ComPtr<ID3D12Resource> positionIntermediateBuffer;
-    ComPtr<ID3D12Resource> normalsIntermediateBuffer;
-    ComPtr<ID3D12Resource> uvIntermediateBuffer;
-    ComPtr<ID3D12Resource> indexIntermediateBuffer;
-
-    _vertexCount = static_cast<uint32_t>(positions.size());
-    _indexCount = static_cast<uint32_t>(indices.size());
+    _id = nextMeshId++;
+    _bounds = Culling::ComputeBounds(positions);
     _materialIndex = materialIndex;
 
-    // Initialize buffers
-    if(!positions.empty())
-    {
-        LoadBufferResource(renderer.GetDevice(), commandList,
-            &_positionBuffer.resource, &positionIntermediateBuffer,
-            _vertexCount, sizeof(XMFLOAT3), positions.data());
-        _positionBuffer.resource->SetName(L"Positions");
-
-        const D3D12_SHADER_RESOURCE_VIEW_DESC positionDesc = {
-            .Format = DXGI_FORMAT_UNKNOWN,
-            .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
-            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-            .Buffer = {
-                .FirstElement = 0u,
-                .NumElements = static_cast<UINT>(_vertexCount),
-                .StructureByteStride = static_cast<UINT>(sizeof(XMFLOAT3)),
-            },
-        };
-        _positionBuffer.srvIndex = renderer.CreateSrv(positionDesc, _positionBuffer.resource);
-    }
-
-    if(!normals.empty())
-    {
-        LoadBufferResource(renderer.GetDevice(), commandList,
-            &_normalBuffer.resource, &normalsIntermediateBuffer,
-            _vertexCount, sizeof(XMFLOAT3), normals.data());
-        _normalBuffer.resource->SetName(L"Normals");
-
-        const D3D12_SHADER_RESOURCE_VIEW_DESC normalsDesc = {
-            .Format = DXGI_FORMAT_UNKNOWN,
-            .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
-            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-            .Buffer = {
-                .FirstElement = 0u,
-                .NumElements = static_cast<UINT>(_vertexCount),
-                .StructureByteStride = static_cast<UINT>(sizeof(XMFLOAT3)),
-            },
-        };
-        _normalBuffer.srvIndex = renderer.CreateSrv(normalsDesc, _normalBuffer.resource);
-    }
-
-    if(!uvs.empty())
+    if(indices.size() / 3 <= MAX_OCCLUDER_TRIANGLES)
     {
-        LoadBufferResource(renderer.GetDevice(), commandList,
-            &_uvBuffer.resource, &uvIntermediateBuffer,
-            _vertexCount, sizeof(XMFLOAT2), uvs.data());
-        _uvBuffer.resource->SetName(L"UVs");
-
-        const D3D12_SHADER_RESOURCE_VIEW_DESC uvDesc = {
-            .Format = DXGI_FORMAT_UNKNOWN,
-            .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
-            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-            .Buffer = {
-                .FirstElement = 0u,
-                .NumElements = static_cast<UINT>(_vertexCount),
-                .StructureByteStride = static_cast<UINT>(sizeof(XMFLOAT2)),
-            },
-        };
-        _uvBuffer.srvIndex = renderer.CreateSrv(uvDesc, _uvBuffer.resource);
+        _occluderPositions = positions;
+        _occluderIndices = indices;
     }
 
-    if(!indices.empty())
-    {
-        LoadBufferResource(renderer.GetDevice(), commandList,
-            &_indexBuffer.resource, &indexIntermediateBuffer,
-            _indexCount, sizeof(uint16_t), indices.data());
-        _indexBuffer.resource->SetName(L"Indices");
-
-        _indexBufferView = {
-            .BufferLocation = _indexBuffer.resource->GetGPUVirtualAddress(),
-            .SizeInBytes = static_cast<UINT>(_indexCount * sizeof(uint16_t)),
-            .Format = DXGI_FORMAT_R16_UINT,
-        };
-    }
+    // Upload into the shared geometry buffer.
+    GpuAllocation intermediateBuffer;
+    _geometry = renderer.GetGeometryBuffer().Upload(commandList, positions, normals, uvs, indices, intermediateBuffer);
 
     // Execute list
     uint64_t fenceValue = renderer.GetCopyCommandQueue().ExecuteCommandList(commandList);
     renderer.GetCopyCommandQueue().WaitForFenceValue(fenceValue);
+
+    renderer.GetGpuAllocator().Free(intermediateBuffer);
 }
 
-Texture::Texture(Renderer& renderer, std::string path)
+Mesh::~Mesh()
+{
+    // Draw packets of frames still in flight point at this mesh, its ranges can only be reused once the GPU is done.
+    _renderer->DeferRelease([&geometryBuffer = _renderer->GetGeometryBuffer(), geometry = _geometry]() mutable {
+        geometryBuffer.Free(geometry);
+    });
+}
+
+Texture::Texture(Renderer& renderer, std::string path) :
+    path(path)
 {
     auto commandList = renderer.GetCopyCommandQueue().GetCommandList();
 
     std::string fileName = std::filesystem::path(path).filename().string();
 
-    ComPtr<ID3D12Resource> intermediateBuffer;
-    DXGI_FORMAT format{};
-    LoadTextureFromFile(renderer.GetDevice(), commandList,
-        &resource, &intermediateBuffer,
+    allocator = &renderer.GetGpuAllocator();
+
+    GpuAllocation intermediateBuffer;
+    LoadTextureFromFile(*allocator, commandList,
+        allocation, intermediateBuffer,
         Util::StringTowString(path), format);
-    resource->SetName(Util::StringTowString(fileName).c_str());
+    allocation.resource->SetName(Util::StringTowString(fileName).c_str());
     name = fileName;
 
-    const D3D12_SHADER_RESOURCE_VIEW_DESC textureDesc = {
-        .Format = format,
-        .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
-        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-        .Texture2D = {
-            .MostDetailedMip = 0u,
-            .MipLevels = 1u,
-            .PlaneSlice = 0u,
-          },
-    };
-    srvIndex = renderer.CreateSrv(textureDesc, resource);
+    srvIndex = renderer.CreateSrv(TextureSrvDesc(format), allocation.resource);
 
     // Execute list
     uint64_t fenceValue = renderer.GetCopyCommandQueue().ExecuteCommandList(commandList);
     renderer.GetCopyCommandQueue().WaitForFenceValue(fenceValue);
+
+    allocator->Free(intermediateBuffer);
+
+    residencyManager = &renderer.GetResidencyManager();
+    residencyManager->Track(*this);
+}
+
+Texture::~Texture()
+{
+    if(residencyManager)
+    {
+        residencyManager->Untrack(*this);
+    }
+    if(allocator)
+    {
+        allocator->Free(allocation);
+    }
+}
+
+void Texture::Evict(Renderer& renderer)
+{
+    renderer.UpdateSrv(srvIndex, TextureSrvDesc(format), nullptr);
+    allocator->Free(allocation);
+}
+
+void Texture::Restore(Renderer& renderer, GpuAllocation loaded)
+{
+    allocation = std::move(loaded);
+    allocation.resource->SetName(Util::StringTowString(name).c_str());
+
+    renderer.RetireSrv(srvIndex);
+    srvIndex = renderer.CreateSrv(TextureSrvDesc(format), allocation.resource);
 }
 
 Texture::Texture(Renderer& renderer, aiTexture textureData)
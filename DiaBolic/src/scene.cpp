@@ -0,0 +1,294 @@
+#include "scene.hpp"
+
+#include "resources.hpp"
+#include "draw_list.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace
+{
+    // Below this many renderables a flat SIMD test over every box beats walking the tree.
+    constexpr size_t BVH_CULLING_THRESHOLD = 4096;
+
+    constexpr uint32_t MAX_OCCLUDERS = 32;
+    // Squared bounds radius over squared distance, roughly how much of the screen an occluder has to cover.
+    constexpr float MIN_OCCLUDER_SCREEN_SIZE = 0.01f;
+
+    // Slots per job when transforming bounds, smaller ranges stay on the calling thread.
+    constexpr size_t BOUNDS_GRAIN_SIZE = 1024;
+}
+
+Scene::Entity Scene::Create(const XMMATRIX& local, Entity parent, const Mesh* mesh, const Material* material)
+{
+    uint32_t parentSlot = TransformHierarchy::NO_PARENT;
+    if(parent != Entity{})
+    {
+        assert(IsAlive(parent) && "Parent entity was destroyed.");
+        parentSlot = _handles[parent.index].slot;
+    }
+
+    // The first free slot after the parent keeps the hierarchy sorted, without one the new slot goes at the end.
+    // Instantiating a model where a destroyed one was fills its slots again in the same order.
+    const auto freeSlot = parentSlot == TransformHierarchy::NO_PARENT ? _freeSlots.begin() : _freeSlots.upper_bound(parentSlot);
+    uint32_t slot;
+    if(freeSlot != _freeSlots.end())
+    {
+        slot = *freeSlot;
+        _freeSlots.erase(freeSlot);
+
+        _transforms.Reuse(slot, local, parentSlot);
+        _meshes[slot] = mesh;
+        _materials[slot] = material;
+    }
+    else
+    {
+        slot = _transforms.Add(local, parentSlot);
+        _meshes.push_back(mesh);
+        _materials.push_back(material);
+        _bvhProxies.push_back(Bvh::INVALID_INDEX);
+        _worldBounds.Add(Culling::Bounds{});
+        _handleOfSlot.push_back(INVALID_INDEX);
+    }
+
+    uint32_t handleIndex;
+    if(!_freeHandles.empty())
+    {
+        handleIndex = _freeHandles.back();
+        _freeHandles.pop_back();
+    }
+    else
+    {
+        handleIndex = static_cast<uint32_t>(_handles.size());
+        _handles.emplace_back();
+    }
+    _handles[handleIndex].slot = slot;
+    _handleOfSlot[slot] = handleIndex;
+
+    if(mesh != nullptr)
+    {
+        _renderableCount++;
+    }
+    _stats.entityCount++;
+
+    return Entity{ handleIndex, _handles[handleIndex].generation };
+}
+
+void Scene::Destroy(Entity entity)
+{
+    if(!IsAlive(entity))
+    {
+        return;
+    }
+
+    // Descendants always sit after their ancestors, so one forward scan finds the whole subtree: a live slot whose
+    // parent is dead has to belong to it, since earlier destroys took their subtrees with them.
+    const uint32_t firstSlot = _handles[entity.index].slot;
+    for(uint32_t slot = firstSlot; slot < _handleOfSlot.size(); ++slot)
+    {
+        const uint32_t parent = _transforms.GetParent(slot);
+        const bool inSubtree = slot == firstSlot || (parent != TransformHierarchy::NO_PARENT && _handleOfSlot[parent] == INVALID_INDEX);
+        if(_handleOfSlot[slot] == INVALID_INDEX || !inSubtree)
+        {
+            continue;
+        }
+
+        if(_bvhProxies[slot] != Bvh::INVALID_INDEX)
+        {
+            _bvh.Remove(_bvhProxies[slot]);
+            _bvhProxies[slot] = Bvh::INVALID_INDEX;
+        }
+        if(_meshes[slot] != nullptr)
+        {
+            _renderableCount--;
+        }
+        _meshes[slot] = nullptr;
+        _materials[slot] = nullptr;
+
+        Handle& handle = _handles[_handleOfSlot[slot]];
+        handle.slot = INVALID_INDEX;
+        handle.generation++;
+        _freeHandles.push_back(_handleOfSlot[slot]);
+        _handleOfSlot[slot] = INVALID_INDEX;
+        _freeSlots.insert(slot);
+        _stats.entityCount--;
+    }
+
+    std::erase_if(_visible, [&](uint32_t slot) { return _meshes[slot] == nullptr; });
+}
+
+bool Scene::IsAlive(Entity entity) const
+{
+    return entity.index < _handles.size() && _handles[entity.index].generation == entity.generation && _handles[entity.index].slot != INVALID_INDEX;
+}
+
+Scene::Entity Scene::Instantiate(const Model& model, Entity parent)
+{
+    const std::vector<Model::Node>& nodes = model.GetNodes();
+    if(nodes.empty())
+    {
+        return Entity{};
+    }
+
+    std::vector<Entity> entities(nodes.size());
+    for(size_t i = 0; i < nodes.size(); ++i)
+    {
+        const Model::Node& node = nodes[i];
+        const Entity nodeParent = node.parent == Model::NO_PARENT ? parent : entities[node.parent];
+        entities[i] = Create(XMLoadFloat4x4(&node.transform), nodeParent, node.mesh, node.material);
+    }
+
+    return entities[0];
+}
+
+void Scene::SetLocalTransform(Entity entity, const XMMATRIX& local)
+{
+    assert(IsAlive(entity) && "Entity was destroyed.");
+    _transforms.SetLocal(_handles[entity.index].slot, local);
+}
+
+const XMFLOAT4X4& Scene::GetWorldTransform(Entity entity) const
+{
+    assert(IsAlive(entity) && "Entity was destroyed.");
+    return _transforms.GetWorld(_handles[entity.index].slot);
+}
+
+void Scene::Update()
+{
+    const auto updateStart = std::chrono::high_resolution_clock::now();
+
+    if(_transforms.UpdateWorld())
+    {
+        for(const TransformHierarchy::Range& range : _transforms.GetChangedRanges())
+        {
+            UpdateWorldBounds(range.first, range.count);
+        }
+    }
+    _bvh.Maintain();
+
+    _stats.slotCount = static_cast<uint32_t>(_handleOfSlot.size());
+    _stats.bvhBytes = _bvh.GetMemoryUsage();
+    _stats.memoryBytes = _transforms.GetMemoryUsage() + _worldBounds.GetMemoryUsage() + _stats.bvhBytes +
+        _meshes.capacity() * sizeof(const Mesh*) + _materials.capacity() * sizeof(const Material*) +
+        (_bvhProxies.capacity() + _handleOfSlot.capacity() + _freeHandles.capacity()) * sizeof(uint32_t) +
+        _handles.capacity() * sizeof(Handle);
+    _stats.bytesPerEntity = _stats.memoryBytes / std::max(_stats.entityCount, 1u);
+    _stats.updateMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - updateStart).count();
+}
+
+void Scene::UpdateWorldBounds(uint32_t firstSlot, uint32_t slotCount)
+{
+    // Every slot's bounds are transformed independently, only the BVH has to be updated from one thread.
+    JobSystem::Get().ParallelFor(slotCount, BOUNDS_GRAIN_SIZE, [&](size_t begin, size_t end) {
+        for(uint32_t slot = firstSlot + static_cast<uint32_t>(begin); slot < firstSlot + end; ++slot)
+        {
+            if(_meshes[slot] != nullptr)
+            {
+                _worldBounds.Set(slot, Culling::TransformBounds(_meshes[slot]->GetBounds(), XMLoadFloat4x4(&_transforms.GetWorld(slot))));
+            }
+        }
+    });
+
+    uint32_t insertCount = 0;
+    for(uint32_t slot = firstSlot; slot < firstSlot + slotCount; ++slot)
+    {
+        if(_meshes[slot] == nullptr)
+        {
+            continue;
+        }
+
+        const Culling::Bounds bounds = _worldBounds.Get(slot);
+
+        if(_bvhProxies[slot] == Bvh::INVALID_INDEX)
+        {
+            _bvhProxies[slot] = _bvh.Insert(bounds, slot);
+            insertCount++;
+        }
+        else
+        {
+            _bvh.Update(_bvhProxies[slot], bounds);
+        }
+    }
+
+    // Incremental insertion gives a decent tree, a top-down build gives a better one after a big batch like a new model.
+    if(insertCount > _bvh.GetStats().proxyCount / 2)
+    {
+        _bvh.Rebuild();
+    }
+}
+
+void Scene::CullFrustum(const Culling::Frustum& frustum)
+{
+    if(_renderableCount >= BVH_CULLING_THRESHOLD)
+    {
+        _bvh.Query(frustum, _visible);
+    }
+    else
+    {
+        // The flat test also sees slots without a mesh.
+        Culling::CullFrustum(frustum, _worldBounds, _visible);
+        std::erase_if(_visible, [&](uint32_t slot) { return _meshes[slot] == nullptr; });
+    }
+}
+
+uint32_t Scene::RasterizeOccluders(Culling::OcclusionBuffer& occlusionBuffer, const XMMATRIX& viewProjection)
+{
+    // Rank the visible occluders by their rough screen size.
+    _occluderCandidates.clear();
+    for(const uint32_t slot : _visible)
+    {
+        if(!_meshes[slot]->IsOccluder())
+        {
+            continue;
+        }
+
+        const Culling::Bounds bounds = _worldBounds.Get(slot);
+        const float distance = XMVectorGetW(XMVector3Transform(XMLoadFloat3(&bounds.center), viewProjection));
+        const float radiusSquared = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&bounds.extents)));
+        const float screenSize = radiusSquared / std::max(distance * distance, 1e-4f);
+        if(screenSize >= MIN_OCCLUDER_SCREEN_SIZE)
+        {
+            _occluderCandidates.emplace_back(screenSize, slot);
+        }
+    }
+
+    const size_t occluderCount = std::min<size_t>(_occluderCandidates.size(), MAX_OCCLUDERS);
+    std::partial_sort(_occluderCandidates.begin(), _occluderCandidates.begin() + occluderCount, _occluderCandidates.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    for(size_t i = 0; i < occluderCount; ++i)
+    {
+        const uint32_t slot = _occluderCandidates[i].second;
+        occlusionBuffer.RasterizeOccluder(_meshes[slot]->GetOccluderPositions(), _meshes[slot]->GetOccluderIndices(),
+            XMMatrixMultiply(XMLoadFloat4x4(&_transforms.GetWorld(slot)), viewProjection));
+    }
+
+    return static_cast<uint32_t>(occluderCount);
+}
+
+uint32_t Scene::CullOccluded(const Culling::OcclusionBuffer& occlusionBuffer, const XMMATRIX& viewProjection)
+{
+    const size_t visibleCount = _visible.size();
+    std::erase_if(_visible, [&](uint32_t slot) { return !occlusionBuffer.IsVisible(_worldBounds.Get(slot), viewProjection); });
+    return static_cast<uint32_t>(visibleCount - _visible.size());
+}
+
+void Scene::CollectDraws(DrawList& drawList, const XMMATRIX& view) const
+{
+    for(const uint32_t slot : _visible)
+    {
+        DrawPacket packet;
+        packet.mesh = _meshes[slot];
+        packet.material = _materials[slot];
+        packet.pipeline = packet.material->shaderFeatures;
+        packet.transform = _transforms.GetWorld(slot);
+
+        // View space depth of the bounds center, good enough for sorting.
+        const Culling::Bounds bounds = _worldBounds.Get(slot);
+        const float viewDepth = XMVectorGetZ(XMVector3Transform(XMLoadFloat3(&bounds.center), view));
+        drawList.Add(packet, viewDepth);
+    }
+}
@@ -0,0 +1,181 @@
+#include "shader_hot_reload.hpp"
+
+#include "pipeline_cache.hpp"
+#include "renderer.hpp"
+#include "utility/log.hpp"
+#include "utility/shader_cache.hpp"
+#include "utility/shader_compiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+using namespace Microsoft::WRL;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr auto POLL_INTERVAL = std::chrono::milliseconds(250);
+    // Editors often save in more than one write, wait for them to finish before compiling.
+    constexpr auto SETTLE_TIME = std::chrono::milliseconds(50);
+
+    std::string DescribePipeline(const std::vector<std::wstring>& shaderPaths)
+    {
+        std::string description;
+        for(const std::wstring& shaderPath : shaderPaths)
+        {
+            description += (description.empty() ? "" : ", ") + Util::wStringToString(shaderPath);
+        }
+        return description;
+    }
+}
+
+ShaderHotReload::ShaderHotReload(Renderer& renderer) :
+    _renderer(renderer),
+    _directory(fs::weakly_canonical(Util::ShaderCompiler::GetShaderDirectory()))
+{
+    // Everything on disk now is what the pipelines get built from, only later writes count as changes.
+    ScanForChanges();
+
+    _watcher = std::jthread([this](std::stop_token stopToken) { WatchLoop(stopToken); });
+    dblog::info("[HOT_RELOAD] Watching {} shader files in {}.", _writeTimes.size(), _directory.string());
+}
+
+ShaderHotReload::~ShaderHotReload() = default;
+
+void ShaderHotReload::Register(std::vector<std::wstring> shaderPaths, ComPtr<ID3D12PipelineState>& target, BuildFunction build)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pipelines.push_back(Pipeline{ std::move(shaderPaths), &target, std::move(build) });
+    UpdateDependencies(_pipelines.size() - 1);
+}
+
+void ShaderHotReload::ApplyPendingReloads()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(Reload& reload : _pendingReloads)
+    {
+        // Frames in flight may still use the old state, the cache can forget it right away.
+        ComPtr<ID3D12PipelineState>& target = *_pipelines[reload.pipeline].target;
+        _renderer.GetPipelineCache().ReleaseGraphicsPipeline(target.Get());
+        _renderer.DeferRelease(target);
+        target = std::move(reload.pipelineState);
+    }
+    _pendingReloads.clear();
+}
+
+void ShaderHotReload::WatchLoop(std::stop_token stopToken)
+{
+    const auto sleep = [&](auto duration) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wakeUp.wait_for(lock, stopToken, duration, [] { return false; });
+        return !stopToken.stop_requested();
+    };
+
+    while(sleep(POLL_INTERVAL))
+    {
+        std::vector<fs::path> changedFiles = ScanForChanges();
+        if(changedFiles.empty())
+        {
+            continue;
+        }
+
+        const auto detectedTime = std::chrono::high_resolution_clock::now();
+        if(!sleep(SETTLE_TIME))
+        {
+            return;
+        }
+        const std::vector<fs::path> settledFiles = ScanForChanges();
+        changedFiles.insert(changedFiles.end(), settledFiles.begin(), settledFiles.end());
+
+        std::set<size_t> affectedPipelines;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for(const fs::path& file : changedFiles)
+            {
+                if(const auto dependents = _dependents.find(file); dependents != _dependents.end())
+                {
+                    affectedPipelines.insert(dependents->second.begin(), dependents->second.end());
+                }
+            }
+        }
+
+        for(const size_t pipeline : affectedPipelines)
+        {
+            BuildFunction build;
+            std::string description;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                build = _pipelines[pipeline].build;
+                description = DescribePipeline(_pipelines[pipeline].shaderPaths);
+            }
+
+            ComPtr<ID3D12PipelineState> pipelineState{};
+            try
+            {
+                pipelineState = build();
+            }
+            catch(...)
+            {
+                dblog::error("[HOT_RELOAD] Failed to rebuild the pipeline for {}, keeping the old one.", description);
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            // The edit may have added or removed includes.
+            UpdateDependencies(pipeline);
+            if(pipelineState)
+            {
+                _pendingReloads.push_back(Reload{ pipeline, std::move(pipelineState) });
+                dblog::info("[HOT_RELOAD] Rebuilt the pipeline for {} in {:.2f} ms after the change.", description,
+                    std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - detectedTime).count());
+            }
+        }
+    }
+}
+
+std::vector<fs::path> ShaderHotReload::ScanForChanges()
+{
+    std::vector<fs::path> changedFiles;
+
+    // Files can disappear halfway through a save, so errors just skip the file until the next scan.
+    std::error_code error;
+    for(auto entry = fs::recursive_directory_iterator(_directory, error); !error && entry != fs::recursive_directory_iterator(); entry.increment(error))
+    {
+        const bool isFile = entry->is_regular_file(error);
+        const fs::file_time_type writeTime = isFile ? entry->last_write_time(error) : fs::file_time_type{};
+        if(!isFile || error)
+        {
+            error.clear();
+            continue;
+        }
+
+        const auto [known, inserted] = _writeTimes.try_emplace(entry->path(), writeTime);
+        if(inserted || known->second != writeTime)
+        {
+            known->second = writeTime;
+            changedFiles.push_back(entry->path());
+        }
+    }
+
+    return changedFiles;
+}
+
+void ShaderHotReload::UpdateDependencies(size_t pipeline)
+{
+    for(auto& [file, dependents] : _dependents)
+    {
+        std::erase(dependents, pipeline);
+    }
+
+    for(const std::wstring& shaderPath : _pipelines[pipeline].shaderPaths)
+    {
+        for(const fs::path& file : Util::ShaderCache::GetSourceFiles(shaderPath, Util::ShaderCompiler::GetShaderDirectory()))
+        {
+            std::vector<size_t>& dependents = _dependents[file];
+            if(std::find(dependents.begin(), dependents.end(), pipeline) == dependents.end())
+            {
+                dependents.push_back(pipeline);
+            }
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#include "task_graph.hpp"
+
+namespace
+{
+    float ToMilliseconds(std::chrono::high_resolution_clock::duration duration)
+    {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(std::string name, std::function<void()> function, std::initializer_list<TaskId> dependencies)
+{
+    return AddTask(std::move(name), std::move(function), std::vector<TaskId>(dependencies));
+}
+
+TaskGraph::TaskId TaskGraph::AddTask(std::string name, std::function<void()> function, const std::vector<TaskId>& dependencies)
+{
+    const TaskId id = static_cast<TaskId>(_tasks.size());
+
+    auto task = std::make_unique<Task>();
+    task->name = std::move(name);
+    task->function = std::move(function);
+    task->dependencies = dependencies;
+    for(const TaskId dependency : dependencies)
+    {
+        assert(dependency < id && "Tasks can only depend on tasks added before them.");
+        _tasks[dependency]->dependents.push_back(id);
+    }
+
+    _tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::Execute()
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    _exception = nullptr;
+
+    for(auto& task : _tasks)
+    {
+        task->remainingDependencies.store(static_cast<uint32_t>(task->dependencies.size()), std::memory_order_relaxed);
+        task->failed.store(false, std::memory_order_relaxed);
+    }
+
+    // Everything else is started by the last of its dependencies to finish.
+    JobSystem& jobSystem = JobSystem::Get();
+    for(TaskId id = 0; id < _tasks.size(); ++id)
+    {
+        if(_tasks[id]->dependencies.empty())
+        {
+            jobSystem.Run([this, id]() { RunTask(id); }, &_counter);
+        }
+    }
+    jobSystem.Wait(_counter);
+
+    MeasureCriticalPath(start, std::chrono::high_resolution_clock::now());
+
+    if(_exception)
+    {
+        std::rethrow_exception(_exception);
+    }
+}
+
+void TaskGraph::Clear()
+{
+    _tasks.clear();
+}
+
+void TaskGraph::RunTask(TaskId id)
+{
+    // The first dependent a task makes ready runs right after it on the same thread, saving a trip through the queues.
+    while(id != NO_TASK)
+    {
+        Task& task = *_tasks[id];
+
+        task.start = std::chrono::high_resolution_clock::now();
+        if(!task.failed.load(std::memory_order_relaxed))
+        {
+            try
+            {
+                task.function();
+            }
+            catch(...)
+            {
+                task.failed.store(true, std::memory_order_relaxed);
+
+                std::lock_guard<std::mutex> lock(_exceptionMutex);
+                if(!_exception)
+                {
+                    _exception = std::current_exception();
+                }
+            }
+        }
+        task.end = std::chrono::high_resolution_clock::now();
+
+        const bool failed = task.failed.load(std::memory_order_relaxed);
+        TaskId next = NO_TASK;
+        for(const TaskId dependentId : task.dependents)
+        {
+            Task& dependent = *_tasks[dependentId];
+            if(failed)
+            {
+                dependent.failed.store(true, std::memory_order_relaxed);
+            }
+
+            if(dependent.remainingDependencies.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            {
+                continue;
+            }
+
+            if(next == NO_TASK)
+            {
+                next = dependentId;
+            }
+            else
+            {
+                JobSystem::Get().Run([this, dependentId]() { RunTask(dependentId); }, &_counter);
+            }
+        }
+        id = next;
+    }
+}
+
+void TaskGraph::MeasureCriticalPath(std::chrono::high_resolution_clock::time_point start, std::chrono::high_resolution_clock::time_point end)
+{
+    _stats = {};
+    _stats.taskCount = static_cast<uint32_t>(_tasks.size());
+    _stats.milliseconds = ToMilliseconds(end - start);
+
+    // Dependencies always come first, so one pass in order finds the longest chain ending in every task.
+    std::vector<float> pathMilliseconds(_tasks.size(), 0.0f);
+    std::vector<TaskId> previous(_tasks.size(), NO_TASK);
+    TaskId last = NO_TASK;
+    for(TaskId id = 0; id < _tasks.size(); ++id)
+    {
+        const Task& task = *_tasks[id];
+        const float milliseconds = ToMilliseconds(task.end - task.start);
+        _stats.workMilliseconds += milliseconds;
+
+        for(const TaskId dependency : task.dependencies)
+        {
+            if(previous[id] == NO_TASK || pathMilliseconds[dependency] > pathMilliseconds[previous[id]])
+            {
+                previous[id] = dependency;
+            }
+        }
+        pathMilliseconds[id] = milliseconds + (previous[id] != NO_TASK ? pathMilliseconds[previous[id]] : 0.0f);
+
+        if(last == NO_TASK || pathMilliseconds[id] > pathMilliseconds[last])
+        {
+            last = id;
+        }
+    }
+
+    if(last == NO_TASK)
+    {
+        return;
+    }
+
+    _stats.criticalPathMilliseconds = pathMilliseconds[last];
+    std::vector<TaskId> path;
+    for(TaskId id = last; id != NO_TASK; id = previous[id])
+    {
+        path.push_back(id);
+    }
+    for(auto id = path.rbegin(); id != path.rend(); ++id)
+    {
+        _stats.criticalPath += (_stats.criticalPath.empty() ? "" : " -> ") + _tasks[*id]->name;
+    }
+}
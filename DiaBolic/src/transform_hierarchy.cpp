@@ -0,0 +1,121 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+void TransformHierarchy::Clear()
+{
+    _parents.clear();
+    _local.clear();
+    _world.clear();
+    _dirty.clear();
+    _firstDirty = NO_PARENT;
+    _changedRanges.clear();
+    _stats = {};
+}
+
+void TransformHierarchy::Reserve(size_t count)
+{
+    _parents.reserve(count);
+    _local.reserve(count);
+    _world.reserve(count);
+    _dirty.reserve(count);
+}
+
+uint32_t TransformHierarchy::Add(const XMMATRIX& local, uint32_t parent)
+{
+    const uint32_t index = static_cast<uint32_t>(_parents.size());
+    assert((parent == NO_PARENT || parent < index) && "Parents have to be added before their children.");
+
+    _parents.push_back(parent);
+    _local.emplace_back();
+    _world.emplace_back();
+    _dirty.push_back(0);
+    XMStoreFloat4x4(&_local.back(), local);
+    MarkDirty(index);
+
+    return index;
+}
+
+void TransformHierarchy::Reuse(uint32_t index, const XMMATRIX& local, uint32_t parent)
+{
+    assert((parent == NO_PARENT || parent < index) && "Parents have to come before their children.");
+
+    _parents[index] = parent;
+    XMStoreFloat4x4(&_local[index], local);
+    MarkDirty(index);
+}
+
+void TransformHierarchy::SetLocal(uint32_t index, const XMMATRIX& local)
+{
+    XMStoreFloat4x4(&_local[index], local);
+    MarkDirty(index);
+}
+
+void TransformHierarchy::MarkDirty(uint32_t index)
+{
+    _dirty[index] = 1;
+    _firstDirty = std::min(_firstDirty, index);
+}
+
+bool TransformHierarchy::UpdateWorld()
+{
+    _changedRanges.clear();
+    _stats = {};
+    if(_firstDirty == NO_PARENT)
+    {
+        return false;
+    }
+
+    // A node is dirty when it or its parent is, and a parent's world matrix is final by the time its children are reached.
+    const uint32_t count = static_cast<uint32_t>(_parents.size());
+    for(uint32_t i = _firstDirty; i < count; ++i)
+    {
+        const uint32_t parent = _parents[i];
+        if(parent != NO_PARENT && _dirty[parent])
+        {
+            _dirty[i] = 1;
+        }
+        if(!_dirty[i])
+        {
+            continue;
+        }
+
+        const XMMATRIX local = XMLoadFloat4x4(&_local[i]);
+        if(parent == NO_PARENT)
+        {
+            XMStoreFloat4x4(&_world[i], local);
+        }
+        else
+        {
+            XMStoreFloat4x4(&_world[i], XMMatrixMultiply(local, XMLoadFloat4x4(&_world[parent])));
+        }
+
+        if(!_changedRanges.empty() && _changedRanges.back().first + _changedRanges.back().count == i)
+        {
+            _changedRanges.back().count++;
+        }
+        else
+        {
+            _changedRanges.push_back({ i, 1 });
+        }
+        _stats.nodesTouched++;
+    }
+    _stats.nodesScanned = count - _firstDirty;
+
+    // Flags stay set during the pass so children can see them, clear them afterwards.
+    for(const Range& range : _changedRanges)
+    {
+        std::fill_n(_dirty.begin() + range.first, range.count, uint8_t(0));
+    }
+    _firstDirty = NO_PARENT;
+
+    return true;
+}
+
+size_t TransformHierarchy::GetMemoryUsage() const
+{
+    return _parents.capacity() * sizeof(uint32_t) + (_local.capacity() + _world.capacity()) * sizeof(XMFLOAT4X4) +
+        _dirty.capacity() * sizeof(uint8_t) + _changedRanges.capacity() * sizeof(Range);
+}
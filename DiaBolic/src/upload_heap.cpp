@@ -0,0 +1,159 @@
+#include "upload_heap.hpp"
+
+#include "utility/dx12_helpers.hpp"
+#include "utility/log.hpp"
+
+#include "renderer.hpp"
+
+#include <immintrin.h>
+
+using namespace Util;
+
+namespace
+{
+    // Non-temporal copy, skips the cache so the write-combined upload memory is written in full lines.
+    void StreamCopy(void* destination, const void* source, size_t size)
+    {
+        uint8_t* dst = static_cast<uint8_t*>(destination);
+        const uint8_t* src = static_cast<const uint8_t*>(source);
+
+        // Align the destination, streaming stores need 16 byte alignment.
+        while(size > 0 && (reinterpret_cast<uintptr_t>(dst) & 15) != 0)
+        {
+            *dst++ = *src++;
+            --size;
+        }
+
+        for(; size >= 64; size -= 64, dst += 64, src += 64)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 0);
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 1);
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 2);
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src) + 3);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 0, a);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 1, b);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 2, c);
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst) + 3, d);
+        }
+
+        for(; size >= 16; size -= 16, dst += 16, src += 16)
+        {
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        }
+
+        if(size > 0)
+        {
+            std::memcpy(dst, src, size);
+        }
+    }
+}
+
+UploadHeap::UploadHeap(Renderer& renderer, uint32_t frameSize)
+{
+    // Keep every partition start 64KB aligned so all placement alignments hold within a partition.
+    constexpr uint32_t partitionAlignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    _frameSize = (frameSize + partitionAlignment - 1) & ~(partitionAlignment - 1);
+
+    const uint64_t bufferSize = static_cast<uint64_t>(_frameSize) * FRAME_COUNT;
+
+    CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
+    ThrowIfFailed(renderer.GetDevice()->CreateCommittedResource(
+        &heapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &resourceDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&_resource)));
+    _resource->SetName(L"Upload Heap");
+
+    // Upload heaps can stay mapped for their whole lifetime.
+    const CD3DX12_RANGE readRange(0, 0);
+    ThrowIfFailed(_resource->Map(0, &readRange, reinterpret_cast<void**>(&_mappedData)));
+    _gpuAddress = _resource->GetGPUVirtualAddress();
+
+    const D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {
+        .Format = DXGI_FORMAT_R32_TYPELESS,
+        .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
+        .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+        .Buffer = {
+            .FirstElement = 0u,
+            .NumElements = static_cast<UINT>(bufferSize / sizeof(uint32_t)),
+            .StructureByteStride = 0u,
+            .Flags = D3D12_BUFFER_SRV_FLAG_RAW,
+        },
+    };
+    _srvIndex = renderer.CreateSrv(srvDesc, _resource);
+}
+
+UploadHeap::~UploadHeap()
+{
+    if(_resource)
+    {
+        _resource->Unmap(0, nullptr);
+    }
+}
+
+void UploadHeap::BeginFrame(uint32_t frameIndex)
+{
+    _frameStart = frameIndex * _frameSize;
+    _currentOffset.store(0, std::memory_order_relaxed);
+    _bytesAllocated.store(0, std::memory_order_relaxed);
+    _bytesWritten.store(0, std::memory_order_relaxed);
+    _allocationCount.store(0, std::memory_order_relaxed);
+}
+
+void UploadHeap::EndFrame()
+{
+    // Streaming stores are weakly ordered, make them visible before the GPU reads them.
+    _mm_sfence();
+
+    _lastFrameStats = Stats{
+        .bytesAllocated = _bytesAllocated.load(std::memory_order_relaxed),
+        .bytesWritten = _bytesWritten.load(std::memory_order_relaxed),
+        .allocationCount = _allocationCount.load(std::memory_order_relaxed),
+    };
+}
+
+void UploadHeap::FenceWrites() const
+{
+    _mm_sfence();
+}
+
+UploadAllocation UploadHeap::Allocate(uint32_t size, uint32_t alignment)
+{
+    assert((alignment & (alignment - 1)) == 0 && "Alignment has to be a power of two.");
+
+    // Bump the offset without a lock, another thread may have moved it in the meantime.
+    uint32_t currentOffset = _currentOffset.load(std::memory_order_relaxed);
+    uint32_t alignedOffset;
+    do
+    {
+        alignedOffset = (currentOffset + alignment - 1) & ~(alignment - 1);
+        if(alignedOffset + size > _frameSize)
+        {
+            dblog::error("[UPLOAD_HEAP] Out of memory, requested {} bytes with {} of {} bytes in use.", size, currentOffset, _frameSize);
+            throw std::bad_alloc();
+        }
+    }
+    while(!_currentOffset.compare_exchange_weak(currentOffset, alignedOffset + size, std::memory_order_relaxed));
+
+    _bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    _allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    const uint32_t bufferOffset = _frameStart + alignedOffset;
+    return UploadAllocation{
+        .cpuAddress = _mappedData + bufferOffset,
+        .gpuAddress = _gpuAddress + bufferOffset,
+        .offset = bufferOffset,
+        .size = size,
+    };
+}
+
+void UploadHeap::Write(const UploadAllocation& allocation, const void* data, size_t size, uint32_t byteOffset)
+{
+    assert(byteOffset + size <= allocation.size && "Write exceeds allocation.");
+
+    StreamCopy(static_cast<uint8_t*>(allocation.cpuAddress) + byteOffset, data, size);
+    _bytesWritten.fetch_add(size, std::memory_order_relaxed);
+}
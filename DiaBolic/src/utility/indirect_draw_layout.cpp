@@ -0,0 +1,36 @@
+#include "utility/indirect_draw_layout.hpp"
+
+namespace
+{
+    constexpr uint32_t AlignUp(uint32_t value, uint32_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+IndirectDraw::Layout IndirectDraw::MakeLayout(uint32_t rootParameterIndex, uint32_t rootConstantCount)
+{
+    Layout layout;
+    layout.rootParameterIndex = rootParameterIndex;
+    layout.rootConstantCount = rootConstantCount;
+
+    // Arguments are tightly packed in signature order, the GPU only requires 4 byte alignment.
+    layout.constantsOffset = 0;
+    layout.drawArgumentsOffset = layout.constantsOffset + rootConstantCount * sizeof(uint32_t);
+    layout.byteStride = AlignUp(layout.drawArgumentsOffset + sizeof(DrawIndexedArguments), sizeof(uint32_t));
+
+    return layout;
+}
+
+void IndirectDraw::PackCommand(const Layout& layout, uint8_t* destination, const void* rootConstants, const DrawIndexedArguments& drawArguments)
+{
+    // Copy instead of casting, the destination is only 4 byte aligned.
+    std::memcpy(destination + layout.constantsOffset, rootConstants, layout.rootConstantCount * sizeof(uint32_t));
+    std::memcpy(destination + layout.drawArgumentsOffset, &drawArguments, sizeof(DrawIndexedArguments));
+
+    const uint32_t end = layout.drawArgumentsOffset + sizeof(DrawIndexedArguments);
+    if(layout.byteStride > end)
+    {
+        std::memset(destination + end, 0, layout.byteStride - end);
+    }
+}
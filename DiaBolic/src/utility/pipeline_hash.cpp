@@ -0,0 +1,121 @@
+#include "utility/pipeline_hash.hpp"
+
+#include "utility/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    uint64_t HashName(const char* name, uint64_t hash)
+    {
+        const size_t length = name ? std::strlen(name) : 0u;
+        hash = Util::HashValue(length, hash);
+        return Util::HashBytes(name, length, hash);
+    }
+
+    uint64_t HashRenderTargetBlend(const D3D12_RENDER_TARGET_BLEND_DESC& blend, uint64_t hash)
+    {
+        hash = Util::HashValue(blend.BlendEnable, hash);
+        hash = Util::HashValue(blend.LogicOpEnable, hash);
+        hash = Util::HashValue(blend.SrcBlend, hash);
+        hash = Util::HashValue(blend.DestBlend, hash);
+        hash = Util::HashValue(blend.BlendOp, hash);
+        hash = Util::HashValue(blend.SrcBlendAlpha, hash);
+        hash = Util::HashValue(blend.DestBlendAlpha, hash);
+        hash = Util::HashValue(blend.BlendOpAlpha, hash);
+        hash = Util::HashValue(blend.LogicOp, hash);
+        return Util::HashValue(blend.RenderTargetWriteMask, hash);
+    }
+
+    uint64_t HashStencilOp(const D3D12_DEPTH_STENCILOP_DESC& stencilOp, uint64_t hash)
+    {
+        hash = Util::HashValue(stencilOp.StencilFailOp, hash);
+        hash = Util::HashValue(stencilOp.StencilDepthFailOp, hash);
+        hash = Util::HashValue(stencilOp.StencilPassOp, hash);
+        return Util::HashValue(stencilOp.StencilFunc, hash);
+    }
+}
+
+namespace Util
+{
+    uint64_t HashShaderBytecode(const D3D12_SHADER_BYTECODE& bytecode, uint64_t hash)
+    {
+        const size_t size = bytecode.pShaderBytecode ? bytecode.BytecodeLength : 0u;
+        hash = HashValue(size, hash);
+        return HashBytes(bytecode.pShaderBytecode, size, hash);
+    }
+
+    uint64_t HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureHash)
+    {
+        uint64_t hash = HashValue(rootSignatureHash);
+
+        hash = HashShaderBytecode(desc.VS, hash);
+        hash = HashShaderBytecode(desc.PS, hash);
+        hash = HashShaderBytecode(desc.DS, hash);
+        hash = HashShaderBytecode(desc.HS, hash);
+        hash = HashShaderBytecode(desc.GS, hash);
+
+        const D3D12_STREAM_OUTPUT_DESC& streamOutput = desc.StreamOutput;
+        hash = HashValue(streamOutput.NumEntries, hash);
+        for(UINT i = 0; i < streamOutput.NumEntries; ++i)
+        {
+            const D3D12_SO_DECLARATION_ENTRY& entry = streamOutput.pSODeclaration[i];
+            hash = HashValue(entry.Stream, hash);
+            hash = HashName(entry.SemanticName, hash);
+            hash = HashValue(entry.SemanticIndex, hash);
+            hash = HashValue(entry.StartComponent, hash);
+            hash = HashValue(entry.ComponentCount, hash);
+            hash = HashValue(entry.OutputSlot, hash);
+        }
+        hash = HashValue(streamOutput.NumStrides, hash);
+        hash = HashBytes(streamOutput.pBufferStrides, streamOutput.pBufferStrides ? streamOutput.NumStrides * sizeof(UINT) : 0u, hash);
+        hash = HashValue(streamOutput.RasterizedStream, hash);
+
+        // Without independent blending only the first target's state is used.
+        const UINT blendTargetCount = desc.BlendState.IndependentBlendEnable ? desc.NumRenderTargets : std::min(desc.NumRenderTargets, 1u);
+        hash = HashValue(desc.BlendState.AlphaToCoverageEnable, hash);
+        hash = HashValue(desc.BlendState.IndependentBlendEnable, hash);
+        for(UINT i = 0; i < blendTargetCount; ++i)
+        {
+            hash = HashRenderTargetBlend(desc.BlendState.RenderTarget[i], hash);
+        }
+        hash = HashValue(desc.SampleMask, hash);
+
+        // Only 4 byte members, so no padding to skip.
+        hash = HashValue(desc.RasterizerState, hash);
+
+        const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+        hash = HashValue(depthStencil.DepthEnable, hash);
+        hash = HashValue(depthStencil.DepthWriteMask, hash);
+        hash = HashValue(depthStencil.DepthFunc, hash);
+        hash = HashValue(depthStencil.StencilEnable, hash);
+        hash = HashValue(depthStencil.StencilReadMask, hash);
+        hash = HashValue(depthStencil.StencilWriteMask, hash);
+        hash = HashStencilOp(depthStencil.FrontFace, hash);
+        hash = HashStencilOp(depthStencil.BackFace, hash);
+
+        hash = HashValue(desc.InputLayout.NumElements, hash);
+        for(UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+        {
+            const D3D12_INPUT_ELEMENT_DESC& element = desc.InputLayout.pInputElementDescs[i];
+            hash = HashName(element.SemanticName, hash);
+            hash = HashValue(element.SemanticIndex, hash);
+            hash = HashValue(element.Format, hash);
+            hash = HashValue(element.InputSlot, hash);
+            hash = HashValue(element.AlignedByteOffset, hash);
+            hash = HashValue(element.InputSlotClass, hash);
+            hash = HashValue(element.InstanceDataStepRate, hash);
+        }
+
+        hash = HashValue(desc.IBStripCutValue, hash);
+        hash = HashValue(desc.PrimitiveTopologyType, hash);
+        hash = HashValue(desc.NumRenderTargets, hash);
+        hash = HashBytes(desc.RTVFormats, desc.NumRenderTargets * sizeof(DXGI_FORMAT), hash);
+        hash = HashValue(desc.DSVFormat, hash);
+        hash = HashValue(desc.SampleDesc.Count, hash);
+        hash = HashValue(desc.SampleDesc.Quality, hash);
+        hash = HashValue(desc.NodeMask, hash);
+        return HashValue(desc.Flags, hash);
+    }
+}
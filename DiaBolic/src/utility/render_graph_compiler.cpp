@@ -0,0 +1,317 @@
+#include "utility/render_graph_compiler.hpp"
+
+#include <algorithm>
+
+using RenderGraphCompiler = Util::RenderGraphCompiler;
+
+namespace
+{
+    constexpr RenderGraphCompiler::States READ_STATES = RenderGraphCompiler::STATE_GENERIC_READ | RenderGraphCompiler::STATE_DEPTH_READ |
+        RenderGraphCompiler::STATE_RESOLVE_SOURCE;
+    // DiscardResource needs the texture in one of these.
+    constexpr RenderGraphCompiler::States DISCARD_STATES = RenderGraphCompiler::STATE_RENDER_TARGET | RenderGraphCompiler::STATE_DEPTH_WRITE;
+
+    struct Segment
+    {
+        uint32_t firstPass;
+        uint32_t lastPass;
+        RenderGraphCompiler::States state;
+        bool write;
+    };
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+RenderGraphCompiler::ResourceId RenderGraphCompiler::ImportResource(std::string name, States initialState, States finalState)
+{
+    Resource resource{};
+    resource.name = std::move(name);
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+    _resources.push_back(std::move(resource));
+    return static_cast<ResourceId>(_resources.size() - 1);
+}
+
+RenderGraphCompiler::ResourceId RenderGraphCompiler::CreateTexture(std::string name, bool renderTarget)
+{
+    Resource resource{};
+    resource.name = std::move(name);
+    resource.transient = true;
+    resource.renderTarget = renderTarget;
+    _resources.push_back(std::move(resource));
+    return static_cast<ResourceId>(_resources.size() - 1);
+}
+
+RenderGraphCompiler::PassId RenderGraphCompiler::AddPass(std::string name, uint32_t commandList)
+{
+    assert((_passes.empty() || _passes.back().commandList == commandList ||
+        std::none_of(_passes.begin(), _passes.end(), [&](const Pass& pass) { return pass.commandList == commandList; })) &&
+        "Passes recording into one command list have to be added one after the other.");
+
+    _passes.push_back(Pass{ std::move(name), commandList, {} });
+    return static_cast<PassId>(_passes.size() - 1);
+}
+
+void RenderGraphCompiler::Read(PassId pass, ResourceId resource, States state)
+{
+    assert((state & ~READ_STATES) == 0 && "Not a read state.");
+    AddAccess(pass, resource, state, false);
+}
+
+void RenderGraphCompiler::Write(PassId pass, ResourceId resource, States state)
+{
+    AddAccess(pass, resource, state, true);
+}
+
+void RenderGraphCompiler::AddAccess(PassId pass, ResourceId resource, States state, bool write)
+{
+    assert(pass < _passes.size() && resource < _resources.size() && "Unknown pass or resource.");
+
+    for(Access& access : _passes[pass].accesses)
+    {
+        if(access.resource == resource)
+        {
+            // Reads combine, but a resource can only be in one state while a pass writes it.
+            assert((access.state == state || (!access.write && !write)) && "A pass writing a resource can only use it in that one state.");
+            access.state |= state;
+            access.write |= write;
+            return;
+        }
+    }
+    _passes[pass].accesses.push_back(Access{ resource, state, write });
+}
+
+void RenderGraphCompiler::Compile(const AllocationFunction& getAllocation)
+{
+    _barriers.assign(_passes.size() + 1, {});
+    _discards.assign(_passes.size(), {});
+    _heaps.clear();
+    _stats = {};
+    _stats.passCount = static_cast<uint32_t>(_passes.size());
+
+    // Lifetimes first, placing the transients depends on them and the barriers on which transients share memory.
+    for(Resource& resource : _resources)
+    {
+        resource.firstPass = NO_PASS;
+        resource.lastPass = NO_PASS;
+        resource.aliased = false;
+    }
+    for(uint32_t pass = 0; pass < _passes.size(); ++pass)
+    {
+        for(const Access& access : _passes[pass].accesses)
+        {
+            Resource& resource = _resources[access.resource];
+            if(resource.firstPass == NO_PASS)
+            {
+                resource.firstPass = pass;
+                assert((!resource.transient || access.write) && "Transient textures have to be written before they are read.");
+            }
+            resource.lastPass = pass;
+        }
+    }
+
+    PlaceTransients(getAllocation);
+
+    for(ResourceId resource = 0; resource < _resources.size(); ++resource)
+    {
+        CompileBarriers(resource);
+    }
+
+    for(const std::vector<Barrier>& barriers : _barriers)
+    {
+        _stats.barrierCalls += barriers.empty() ? 0u : 1u;
+        _stats.unbatchedBarrierCalls += static_cast<uint32_t>(barriers.size());
+    }
+}
+
+RenderGraphCompiler::Placement RenderGraphCompiler::GetPlacement(ResourceId resource) const
+{
+    const Resource& transient = _resources[resource];
+    assert(transient.transient && "Only transient textures are placed.");
+    return Placement{ .heap = transient.heap, .offset = transient.offset, .size = transient.size };
+}
+
+void RenderGraphCompiler::PlaceTransients(const AllocationFunction& getAllocation)
+{
+    std::vector<ResourceId> transients;
+    for(ResourceId id = 0; id < _resources.size(); ++id)
+    {
+        Resource& resource = _resources[id];
+        if(!resource.transient || resource.firstPass == NO_PASS)
+        {
+            continue;
+        }
+
+        const Allocation allocation = getAllocation(id);
+        assert(allocation.alignment > 0 && (allocation.alignment & (allocation.alignment - 1)) == 0 && "Alignments have to be powers of two.");
+        resource.size = allocation.size;
+        resource.offset = 0;
+
+        const HeapClass heapClass = resource.renderTarget ? HeapClass::RenderTargets : HeapClass::Textures;
+        auto heap = std::find_if(_heaps.begin(), _heaps.end(), [&](const Heap& candidate) { return candidate.heapClass == heapClass; });
+        if(heap == _heaps.end())
+        {
+            heap = _heaps.insert(_heaps.end(), Heap{ .heapClass = heapClass });
+        }
+        resource.heap = static_cast<uint32_t>(heap - _heaps.begin());
+        heap->alignment = std::max(heap->alignment, allocation.alignment);
+
+        transients.push_back(id);
+        _stats.transientCount++;
+        _stats.transientBytes += resource.size;
+    }
+
+    // Largest first packs tighter. Every texture goes at the lowest offset that doesn't overlap the textures already
+    // placed in its heap that are alive at the same time.
+    std::stable_sort(transients.begin(), transients.end(), [&](ResourceId a, ResourceId b) { return _resources[a].size > _resources[b].size; });
+
+    std::vector<ResourceId> placed;
+    std::vector<const Resource*> conflicts;
+    for(const ResourceId id : transients)
+    {
+        Resource& resource = _resources[id];
+        Heap& heap = _heaps[resource.heap];
+
+        conflicts.clear();
+        for(const ResourceId other : placed)
+        {
+            const Resource& otherResource = _resources[other];
+            if(otherResource.heap == resource.heap && otherResource.firstPass <= resource.lastPass && resource.firstPass <= otherResource.lastPass)
+            {
+                conflicts.push_back(&otherResource);
+            }
+        }
+        std::sort(conflicts.begin(), conflicts.end(), [](const Resource* a, const Resource* b) { return a->offset < b->offset; });
+
+        uint64_t offset = 0;
+        for(const Resource* conflict : conflicts)
+        {
+            if(AlignUp(offset, heap.alignment) + resource.size <= conflict->offset)
+            {
+                break;
+            }
+            offset = std::max(offset, conflict->offset + conflict->size);
+        }
+        resource.offset = AlignUp(offset, heap.alignment);
+        heap.size = std::max(heap.size, resource.offset + resource.size);
+        placed.push_back(id);
+    }
+
+    // Sharing any memory at all means every frame hands it from one texture to the other.
+    for(size_t i = 0; i < placed.size(); ++i)
+    {
+        for(size_t j = i + 1; j < placed.size(); ++j)
+        {
+            Resource& a = _resources[placed[i]];
+            Resource& b = _resources[placed[j]];
+            if(a.heap == b.heap && a.offset < b.offset + b.size && b.offset < a.offset + a.size)
+            {
+                a.aliased = true;
+                b.aliased = true;
+            }
+        }
+    }
+
+    for(const Heap& heap : _heaps)
+    {
+        _stats.heapBytes += heap.size;
+    }
+}
+
+void RenderGraphCompiler::CompileBarriers(ResourceId id)
+{
+    Resource& resource = _resources[id];
+    if(resource.firstPass == NO_PASS)
+    {
+        // Still handed back the way it is expected.
+        if(!resource.transient && resource.initialState != resource.finalState)
+        {
+            AddTransition(id, resource.initialState, resource.finalState, GetPassCount(), GetPassCount());
+        }
+        return;
+    }
+
+    // Consecutive reads become one segment in their combined state, so there are no transitions between readers.
+    std::vector<Segment> segments;
+    for(uint32_t pass = resource.firstPass; pass <= resource.lastPass; ++pass)
+    {
+        for(const Access& access : _passes[pass].accesses)
+        {
+            if(access.resource != id)
+            {
+                continue;
+            }
+
+            if(!segments.empty() && !access.write && !segments.back().write)
+            {
+                segments.back().state |= access.state;
+                segments.back().lastPass = pass;
+            }
+            else
+            {
+                segments.push_back(Segment{ pass, pass, access.state, access.write });
+            }
+        }
+    }
+
+    uint32_t earliestPass = 0;
+    if(resource.transient)
+    {
+        // Every frame starts where the previous one left it, so that's the state it's created in. The memory may belong
+        // to another texture until the first pass, going to the first state can't start any earlier.
+        resource.initialState = segments.back().state;
+        earliestPass = resource.firstPass;
+
+        if(resource.aliased)
+        {
+            _barriers[resource.firstPass].push_back(Barrier{ .type = Barrier::Type::Aliasing, .resource = id });
+            _stats.aliasingBarrierCount++;
+            if(resource.renderTarget && (segments.front().state & DISCARD_STATES) != 0)
+            {
+                _discards[resource.firstPass].push_back(id);
+            }
+        }
+    }
+
+    States state = resource.initialState;
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        const Segment& segment = segments[i];
+        if(segment.state != state)
+        {
+            AddTransition(id, state, segment.state, earliestPass, segment.firstPass);
+        }
+        else if(i > 0 && segment.write && segments[i - 1].write && (segment.state & STATE_UNORDERED_ACCESS) != 0)
+        {
+            // Writes in the same state are only ordered for render targets and depth.
+            _barriers[segment.firstPass].push_back(Barrier{ .type = Barrier::Type::Uav, .resource = id });
+            _stats.uavBarrierCount++;
+        }
+        state = segment.state;
+        earliestPass = segment.lastPass + 1;
+    }
+
+    if(!resource.transient && state != resource.finalState)
+    {
+        AddTransition(id, state, resource.finalState, earliestPass, GetPassCount());
+    }
+}
+
+void RenderGraphCompiler::AddTransition(ResourceId resource, States before, States after, uint32_t earliestPass, uint32_t pass)
+{
+    Barrier barrier{ .type = Barrier::Type::Transition, .resource = resource, .before = before, .after = after };
+    // A split transition has to begin and end in the same command list. The frame's last barriers have a list of their own.
+    if(earliestPass < pass && pass < GetPassCount() && _passes[earliestPass].commandList == _passes[pass].commandList)
+    {
+        // No pass uses it in between, the GPU can start right after the last use and only has to finish by the next.
+        barrier.split = Barrier::Split::Begin;
+        _barriers[earliestPass].push_back(barrier);
+        barrier.split = Barrier::Split::End;
+        _stats.splitTransitionCount++;
+    }
+    _barriers[pass].push_back(barrier);
+    _stats.transitionCount++;
+}
@@ -0,0 +1,286 @@
+#include "utility/residency_policy.hpp"
+
+#include <algorithm>
+
+Util::ResidencyPolicy::ResidencyPolicy(uint64_t budget, uint32_t framesInFlight, uint64_t restoreBytesPerFrame) :
+    _budget(budget),
+    _framesInFlight(framesInFlight),
+    _restoreBytesPerFrame(restoreBytesPerFrame)
+{
+    assert(framesInFlight > 0 && "A restored resource would be evicted again before it is drawn.");
+}
+
+Util::ResidencyPolicy::ResourceId Util::ResidencyPolicy::Add(uint64_t size, bool pinned)
+{
+    ResourceId resource;
+    if(!_freeIds.empty())
+    {
+        resource = _freeIds.back();
+        _freeIds.pop_back();
+    }
+    else
+    {
+        resource = static_cast<ResourceId>(_entries.size());
+        _entries.emplace_back();
+    }
+
+    Entry& entry = _entries[resource];
+    entry = Entry{ .size = size, .lastUsed = _frame, .alive = true, .resident = true, .pinned = pinned };
+    _residentBytes += size;
+    ++_residentCount;
+    if(pinned)
+    {
+        _pinnedBytes += size;
+    }
+    else
+    {
+        PushFront(resource);
+    }
+    return resource;
+}
+
+void Util::ResidencyPolicy::Remove(ResourceId resource)
+{
+    Entry& entry = _entries[resource];
+    assert(entry.alive && "Resource removed twice.");
+
+    if(entry.resident)
+    {
+        _residentBytes -= entry.size;
+        --_residentCount;
+        if(entry.pinned)
+        {
+            _pinnedBytes -= entry.size;
+        }
+        else
+        {
+            Unlink(resource);
+        }
+    }
+    else
+    {
+        _evictedBytes -= entry.size;
+        --_evictedCount;
+    }
+
+    if(entry.waiting)
+    {
+        _waiting.erase(std::find(_waiting.begin(), _waiting.end(), resource));
+    }
+
+    entry = Entry{};
+    _freeIds.push_back(resource);
+}
+
+void Util::ResidencyPolicy::MarkUsed(ResourceId resource)
+{
+    Entry& entry = _entries[resource];
+    assert(entry.alive && "Resource isn't tracked.");
+
+    entry.lastUsed = _frame;
+    if(entry.pinned)
+    {
+        return;
+    }
+
+    if(entry.resident)
+    {
+        if(_mostRecent != resource)
+        {
+            Unlink(resource);
+            PushFront(resource);
+        }
+    }
+    else if(!entry.waiting)
+    {
+        entry.waiting = true;
+        _waiting.push_back(resource);
+    }
+}
+
+const Util::ResidencyPolicy::Decisions& Util::ResidencyPolicy::Update()
+{
+    _decisions.evict.clear();
+    _decisions.restore.clear();
+
+    // Most recently wanted first, something that waited for a few frames may not be drawn anymore.
+    std::stable_sort(_waiting.begin(), _waiting.end(), [this](ResourceId a, ResourceId b) {
+        return _entries[a].lastUsed > _entries[b].lastUsed;
+    });
+
+    uint64_t restoreBytes = 0;
+    size_t restoreCount = 0;
+    for(; restoreCount < _waiting.size(); ++restoreCount)
+    {
+        const ResourceId resource = _waiting[restoreCount];
+        Entry& entry = _entries[resource];
+        if(restoreCount > 0 && restoreBytes + entry.size > _restoreBytesPerFrame)
+        {
+            break;
+        }
+        restoreBytes += entry.size;
+
+        // Counts as used now, so it isn't evicted again before it is drawn.
+        entry.waiting = false;
+        entry.resident = true;
+        entry.lastUsed = _frame;
+        PushFront(resource);
+
+        _evictedBytes -= entry.size;
+        --_evictedCount;
+        _residentBytes += entry.size;
+        ++_residentCount;
+        ++_restores;
+        _decisions.restore.push_back(resource);
+    }
+    _waiting.erase(_waiting.begin(), _waiting.begin() + restoreCount);
+
+    // The list is ordered by last use, once its back is in flight everything in front of it is too.
+    while(_residentBytes > _budget && _leastRecent != NO_RESOURCE && _entries[_leastRecent].lastUsed + _framesInFlight <= _frame)
+    {
+        const ResourceId resource = _leastRecent;
+        Entry& entry = _entries[resource];
+        Unlink(resource);
+        entry.resident = false;
+
+        _residentBytes -= entry.size;
+        --_residentCount;
+        _evictedBytes += entry.size;
+        ++_evictedCount;
+        ++_evictions;
+        _decisions.evict.push_back(resource);
+    }
+
+    if(_residentBytes > _budget)
+    {
+        ++_overBudgetFrames;
+    }
+
+    return _decisions;
+}
+
+bool Util::ResidencyPolicy::IsResident(ResourceId resource) const
+{
+    return _entries[resource].resident;
+}
+
+Util::ResidencyPolicy::Stats Util::ResidencyPolicy::GetStats() const
+{
+    return Stats{
+        .budget = _budget,
+        .residentBytes = _residentBytes,
+        .pinnedBytes = _pinnedBytes,
+        .evictedBytes = _evictedBytes,
+        .residentCount = _residentCount,
+        .evictedCount = _evictedCount,
+        .waitingCount = static_cast<uint32_t>(_waiting.size()),
+        .evictions = _evictions,
+        .restores = _restores,
+        .overBudgetFrames = _overBudgetFrames,
+    };
+}
+
+bool Util::ResidencyPolicy::Validate() const
+{
+    // The list runs from the most to the least recently used, linked both ways.
+    uint32_t listed = 0;
+    ResourceId previous = NO_RESOURCE;
+    for(ResourceId resource = _mostRecent; resource != NO_RESOURCE; resource = _entries[resource].next)
+    {
+        const Entry& entry = _entries[resource];
+        if(!entry.alive || !entry.resident || entry.pinned || entry.waiting || entry.previous != previous)
+        {
+            return false;
+        }
+        if(previous != NO_RESOURCE && _entries[previous].lastUsed < entry.lastUsed)
+        {
+            return false;
+        }
+        if(++listed > _entries.size())
+        {
+            return false;
+        }
+        previous = resource;
+    }
+    if(previous != _leastRecent)
+    {
+        return false;
+    }
+
+    uint64_t residentBytes = 0;
+    uint64_t pinnedBytes = 0;
+    uint64_t evictedBytes = 0;
+    uint32_t residentCount = 0;
+    uint32_t evictedCount = 0;
+    uint32_t pinnedCount = 0;
+    uint32_t unlisted = 0;
+    uint32_t waitingCount = 0;
+    for(const Entry& entry : _entries)
+    {
+        if(!entry.alive)
+        {
+            ++unlisted;
+            continue;
+        }
+        if(entry.lastUsed > _frame || (entry.waiting && entry.resident))
+        {
+            return false;
+        }
+        if(entry.resident)
+        {
+            residentBytes += entry.size;
+            pinnedBytes += entry.pinned ? entry.size : 0;
+            pinnedCount += entry.pinned ? 1 : 0;
+            ++residentCount;
+        }
+        else
+        {
+            evictedBytes += entry.size;
+            ++evictedCount;
+        }
+        waitingCount += entry.waiting ? 1 : 0;
+    }
+
+    return unlisted == _freeIds.size() && waitingCount == _waiting.size() && residentBytes == _residentBytes &&
+        pinnedBytes == _pinnedBytes && evictedBytes == _evictedBytes && residentCount == _residentCount &&
+        evictedCount == _evictedCount && listed + pinnedCount == residentCount;
+}
+
+void Util::ResidencyPolicy::PushFront(ResourceId resource)
+{
+    Entry& entry = _entries[resource];
+    entry.previous = NO_RESOURCE;
+    entry.next = _mostRecent;
+    if(_mostRecent != NO_RESOURCE)
+    {
+        _entries[_mostRecent].previous = resource;
+    }
+    else
+    {
+        _leastRecent = resource;
+    }
+    _mostRecent = resource;
+}
+
+void Util::ResidencyPolicy::Unlink(ResourceId resource)
+{
+    Entry& entry = _entries[resource];
+    if(entry.previous != NO_RESOURCE)
+    {
+        _entries[entry.previous].next = entry.next;
+    }
+    else
+    {
+        _mostRecent = entry.next;
+    }
+    if(entry.next != NO_RESOURCE)
+    {
+        _entries[entry.next].previous = entry.previous;
+    }
+    else
+    {
+        _leastRecent = entry.previous;
+    }
+    entry.previous = NO_RESOURCE;
+    entry.next = NO_RESOURCE;
+}
@@ -2,8 +2,10 @@
 
 #include "utility/dx12_helpers.hpp"
 #include "utility/log.hpp"
+#include "gpu_allocator.hpp"
 
 #include <filesystem>
+#include <numeric>
 
 namespace fs = std::filesystem;
 
@@ -66,55 +68,33 @@ void Util::CreateCube(
 }
 
 void Util::LoadBufferResource(
-    Microsoft::WRL::ComPtr<ID3D12Device> device,
+    GpuAllocator& allocator,
 	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
-	ID3D12Resource** pDestinationResource,
-	ID3D12Resource** pIntermediateResource,
+	GpuAllocation& destination,
+	GpuAllocation& intermediate,
 	size_t numElements, size_t elementSize,
-	const void* bufferData, D3D12_RESOURCE_FLAGS flags)
+	const void* bufferData)
 {
     size_t bufferSize = numElements * elementSize;
 
-    {   // Create a committed resource for the GPU resource in a default heap.
-        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_DEFAULT);
-        CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize, flags);
-        ThrowIfFailed(device->CreateCommittedResource(
-            &heapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &resourceDesc,
-            D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(pDestinationResource)));
-    }
+    // Structured buffer views start at a whole element, so align to the element size as well.
+    destination = allocator.AllocateBuffer(bufferSize, std::lcm(GpuAllocator::BUFFER_ALIGNMENT, static_cast<uint64_t>(elementSize)));
 
-    // Create an committed resource for the upload.
+    // The intermediate is persistently mapped, write it directly.
     if (bufferData)
     {
-        CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
-        CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(bufferSize);
-        ThrowIfFailed(device->CreateCommittedResource(
-            &heapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &resourceDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(pIntermediateResource)));
-
-        D3D12_SUBRESOURCE_DATA subresourceData = {};
-        subresourceData.pData = bufferData;
-        subresourceData.RowPitch = bufferSize;
-        subresourceData.SlicePitch = subresourceData.RowPitch;
-
-        UpdateSubresources(commandList.Get(),
-            *pDestinationResource, *pIntermediateResource,
-            0, 0, 1, &subresourceData);
+        intermediate = allocator.AllocateBuffer(bufferSize, GpuAllocator::BUFFER_ALIGNMENT, D3D12_HEAP_TYPE_UPLOAD);
+        std::memcpy(intermediate.cpuAddress, bufferData, bufferSize);
+
+        commandList->CopyBufferRegion(destination.resource.Get(), destination.offset,
+            intermediate.resource.Get(), intermediate.offset, bufferSize);
     }
 }
 
 void Util::LoadTextureFromFile(
-    Microsoft::WRL::ComPtr<ID3D12Device> device,
+    GpuAllocator& allocator,
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList2> commandList,
-    ID3D12Resource** pDestinationResource, ID3D12Resource** pIntermediateResource,
+    GpuAllocation& destination, GpuAllocation& intermediate,
     const std::wstring& fileName, DXGI_FORMAT& format)
 {
     fs::path filePath(fileName);
@@ -187,14 +167,7 @@ void Util::LoadTextureFromFile(
     }
     format = metadata.format;
     
-    CD3DX12_HEAP_PROPERTIES textureHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    ThrowIfFailed(device->CreateCommittedResource(
-        &textureHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &textureDesc,
-        D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(pDestinationResource)));
+    destination = allocator.CreateTexture(textureDesc, D3D12_RESOURCE_STATE_COMMON);
 
     std::vector<D3D12_SUBRESOURCE_DATA> subresources(scratchImage.GetImageCount());
     const DirectX::Image* pImages = scratchImage.GetImages();
@@ -206,23 +179,15 @@ void Util::LoadTextureFromFile(
         subresource.pData = pImages[i].pixels;
     }
 
-    if (pDestinationResource)
+    if (destination.IsValid())
     {
-        TransitionResource(commandList, *pDestinationResource, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-
-        UINT64 requiredSize = GetRequiredIntermediateSize(*pDestinationResource, 0, static_cast<uint32_t>(subresources.size()));
-
-        D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(requiredSize);
-        CD3DX12_HEAP_PROPERTIES bufferHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-        ThrowIfFailed(device->CreateCommittedResource(
-            &bufferHeapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &bufferDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(pIntermediateResource)
-        ));
-        UpdateSubresources(commandList.Get(), *pDestinationResource, *pIntermediateResource, 0, 0, static_cast<UINT>(subresources.size()), subresources.data());
+        TransitionResource(commandList, destination.resource, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+
+        UINT64 requiredSize = GetRequiredIntermediateSize(destination.resource.Get(), 0, static_cast<uint32_t>(subresources.size()));
+
+        intermediate = allocator.AllocateBuffer(requiredSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, D3D12_HEAP_TYPE_UPLOAD);
+        UpdateSubresources(commandList.Get(), destination.resource.Get(), intermediate.resource.Get(), intermediate.offset,
+            0, static_cast<UINT>(subresources.size()), subresources.data());
     }
 }
 
@@ -0,0 +1,147 @@
+#include "utility/root_constants.hpp"
+
+#include "utility/dx12_helpers.hpp"
+#include "utility/log.hpp"
+
+#include <algorithm>
+#include <d3d12shader.h>
+
+namespace Util
+{
+    namespace RootConstants
+    {
+        std::vector<Field> Reflect(ID3D12ShaderReflection* reflection, uint32_t registerIndex)
+        {
+            std::vector<Field> fields;
+
+            D3D12_SHADER_DESC shaderDesc{};
+            ThrowIfFailed(reflection->GetDesc(&shaderDesc));
+            for(UINT resource = 0; resource < shaderDesc.BoundResources; ++resource)
+            {
+                D3D12_SHADER_INPUT_BIND_DESC bindDesc{};
+                ThrowIfFailed(reflection->GetResourceBindingDesc(resource, &bindDesc));
+                if(bindDesc.Type != D3D_SIT_CBUFFER || bindDesc.BindPoint != registerIndex || bindDesc.Space != 0)
+                {
+                    continue;
+                }
+
+                ID3D12ShaderReflectionConstantBuffer* constantBuffer = reflection->GetConstantBufferByName(bindDesc.Name);
+                D3D12_SHADER_BUFFER_DESC bufferDesc{};
+                ThrowIfFailed(constantBuffer->GetDesc(&bufferDesc));
+
+                // ConstantBuffer<T> shows up as a single variable of struct type T.
+                ID3D12ShaderReflectionType* structType = nullptr;
+                uint32_t structSize = 0;
+                bool structUsed = false;
+                if(bufferDesc.Variables == 1)
+                {
+                    ID3D12ShaderReflectionVariable* variable = constantBuffer->GetVariableByIndex(0);
+                    D3D12_SHADER_VARIABLE_DESC variableDesc{};
+                    D3D12_SHADER_TYPE_DESC typeDesc{};
+                    ThrowIfFailed(variable->GetDesc(&variableDesc));
+                    ThrowIfFailed(variable->GetType()->GetDesc(&typeDesc));
+                    if(typeDesc.Class == D3D_SVC_STRUCT)
+                    {
+                        structType = variable->GetType();
+                        structSize = variableDesc.Size;
+                        structUsed = (variableDesc.uFlags & D3D_SVF_USED) != 0;
+                    }
+                }
+
+                if(structType)
+                {
+                    // Reflection only tracks use of the whole struct, treat every member as read when it is.
+                    D3D12_SHADER_TYPE_DESC structDesc{};
+                    ThrowIfFailed(structType->GetDesc(&structDesc));
+                    for(UINT member = 0; member < structDesc.Members; ++member)
+                    {
+                        D3D12_SHADER_TYPE_DESC memberDesc{};
+                        ThrowIfFailed(structType->GetMemberTypeByIndex(member)->GetDesc(&memberDesc));
+                        fields.push_back(Field{
+                            .name = structType->GetMemberTypeName(member),
+                            .offset = memberDesc.Offset,
+                            .used = structUsed,
+                        });
+                    }
+
+                    // Counting components gets arrays, matrices, nested structs and 16 bit types wrong, a member reaches
+                    // up to the next one instead and the last one up to the end of the struct. Padding HLSL puts in front
+                    // of a member counts towards the one before it, so shared structs spell their padding out.
+                    for(size_t member = 0; member < fields.size(); ++member)
+                    {
+                        const uint32_t end = member + 1 < fields.size() ? fields[member + 1].offset : structSize;
+                        fields[member].size = end - fields[member].offset;
+                    }
+                }
+                else
+                {
+                    for(UINT index = 0; index < bufferDesc.Variables; ++index)
+                    {
+                        D3D12_SHADER_VARIABLE_DESC variableDesc{};
+                        ThrowIfFailed(constantBuffer->GetVariableByIndex(index)->GetDesc(&variableDesc));
+                        fields.push_back(Field{
+                            .name = variableDesc.Name,
+                            .offset = variableDesc.StartOffset,
+                            .size = variableDesc.Size,
+                            .used = (variableDesc.uFlags & D3D_SVF_USED) != 0,
+                        });
+                    }
+                }
+                break;
+            }
+
+            return fields;
+        }
+
+        bool Validate(std::span<const Field> shaderFields, std::span<const Field> cpuFields, std::string_view shaderName)
+        {
+            // Shaders that don't bind the struct can't disagree with it.
+            if(shaderFields.empty())
+            {
+                return true;
+            }
+
+            bool valid = true;
+            for(const Field& shaderField : shaderFields)
+            {
+                const auto cpuField = std::find_if(cpuFields.begin(), cpuFields.end(), [&](const Field& field) { return field.name == shaderField.name; });
+                if(cpuField == cpuFields.end())
+                {
+                    dblog::error("[ROOT_CONSTANTS] {}: {} is missing on the C++ side.", shaderName, shaderField.name);
+                    valid = false;
+                }
+                else if(cpuField->offset != shaderField.offset || cpuField->size != shaderField.size)
+                {
+                    dblog::error("[ROOT_CONSTANTS] {}: {} is at {} with {} bytes in HLSL, but at {} with {} bytes in C++.", shaderName,
+                        shaderField.name, shaderField.offset, shaderField.size, cpuField->offset, cpuField->size);
+                    valid = false;
+                }
+            }
+
+            for(const Field& cpuField : cpuFields)
+            {
+                const auto shaderField = std::find_if(shaderFields.begin(), shaderFields.end(), [&](const Field& field) { return field.name == cpuField.name; });
+                if(shaderField == shaderFields.end())
+                {
+                    dblog::error("[ROOT_CONSTANTS] {}: {} is missing on the HLSL side.", shaderName, cpuField.name);
+                    valid = false;
+                }
+            }
+
+            return valid;
+        }
+
+        uint32_t GetUsedDwordCount(std::span<const Field> shaderFields)
+        {
+            uint32_t end = 0;
+            for(const Field& field : shaderFields)
+            {
+                if(field.used)
+                {
+                    end = std::max(end, field.offset + field.size);
+                }
+            }
+            return (end + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+        }
+    }
+}
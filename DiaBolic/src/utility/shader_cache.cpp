@@ -0,0 +1,242 @@
+#include "utility/shader_cache.hpp"
+
+#include "utility/hash.hpp"
+#include "utility/log.hpp"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t CACHE_MAGIC = 0x43534244; // "DBSC"
+    // Bump when the file layout or the way keys are computed changes.
+    constexpr uint32_t CACHE_VERSION = 3;
+
+    const fs::path CACHE_DIRECTORY = "shader_cache";
+
+    struct CacheHeader
+    {
+        uint32_t magic = CACHE_MAGIC;
+        uint32_t version = CACHE_VERSION;
+        uint64_t key = 0;
+        uint64_t shaderSize = 0;
+        uint64_t rootSignatureSize = 0;
+        uint64_t reflectionSize = 0;
+    };
+
+    bool ReadFile(const fs::path& path, std::string& contents)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if(!file)
+        {
+            return false;
+        }
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Pulls the file name out of an #include "file" or #include <file> line.
+    bool ParseInclude(const std::string& line, std::string& fileName)
+    {
+        size_t position = line.find_first_not_of(" \t");
+        if(position == std::string::npos || line[position] != '#')
+        {
+            return false;
+        }
+        position = line.find_first_not_of(" \t", position + 1);
+        if(position == std::string::npos || line.compare(position, 7, "include") != 0)
+        {
+            return false;
+        }
+
+        const size_t open = line.find_first_of("\"<", position + 7);
+        if(open == std::string::npos)
+        {
+            return false;
+        }
+        const size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if(close == std::string::npos)
+        {
+            return false;
+        }
+
+        fileName = line.substr(open + 1, close - open - 1);
+        return true;
+    }
+
+    // Visits a file and, depth first, every file it includes. Each file is visited once, like #pragma once would.
+    // source is null for files that couldn't be read.
+    void VisitSourceTree(const fs::path& path, const fs::path& includeDirectory, std::set<fs::path>& visited,
+                         const std::function<void(const fs::path&, const std::string*)>& visit)
+    {
+        const fs::path canonicalPath = fs::weakly_canonical(path);
+        if(!visited.insert(canonicalPath).second)
+        {
+            return;
+        }
+
+        std::string source;
+        if(!ReadFile(canonicalPath, source))
+        {
+            visit(canonicalPath, nullptr);
+            return;
+        }
+        visit(canonicalPath, &source);
+
+        size_t lineStart = 0;
+        while(lineStart < source.size())
+        {
+            size_t lineEnd = source.find('\n', lineStart);
+            if(lineEnd == std::string::npos)
+            {
+                lineEnd = source.size();
+            }
+
+            std::string fileName;
+            if(ParseInclude(source.substr(lineStart, lineEnd - lineStart), fileName))
+            {
+                // Same lookup order as DXC: next to the including file first, then the -I directory.
+                fs::path includePath = canonicalPath.parent_path() / fileName;
+                if(!fs::exists(includePath))
+                {
+                    includePath = includeDirectory / fileName;
+                }
+                VisitSourceTree(includePath, includeDirectory, visited, visit);
+            }
+
+            lineStart = lineEnd + 1;
+        }
+    }
+
+    fs::path GetEntryPath(uint64_t key)
+    {
+        return CACHE_DIRECTORY / std::format("{:016x}.bin", key);
+    }
+}
+
+namespace Util
+{
+    namespace ShaderCache
+    {
+    uint64_t ComputeKey(const std::wstring_view shaderPath, const std::wstring_view includeDirectory,
+                        const std::vector<LPCWSTR>& compilationArguments, const bool extractRootSignature,
+                        const uint64_t compilerVersion)
+    {
+        uint64_t hash = HashValue(CACHE_VERSION);
+        hash = HashValue(compilerVersion, hash);
+
+        std::set<fs::path> visited;
+        VisitSourceTree(fs::path(shaderPath), fs::path(includeDirectory), visited, [&](const fs::path& path, const std::string* source) {
+            if(!source)
+            {
+                // DXC will report the missing file, just make sure the key differs from when it exists.
+                hash = HashString(L"<missing>", HashString(path.wstring(), hash));
+                return;
+            }
+            hash = HashString(path.filename().wstring(), hash);
+            hash = HashValue(source->size(), hash);
+            hash = HashBytes(source->data(), source->size(), hash);
+        });
+
+        // Entry point, target profile and flags are all part of the arguments.
+        for(const LPCWSTR argument : compilationArguments)
+        {
+            hash = HashString(argument, hash);
+        }
+        hash = HashValue(extractRootSignature, hash);
+
+        return hash;
+    }
+
+    std::vector<fs::path> GetSourceFiles(const std::wstring_view shaderPath, const std::wstring_view includeDirectory)
+    {
+        std::vector<fs::path> files;
+        std::set<fs::path> visited;
+        VisitSourceTree(fs::path(shaderPath), fs::path(includeDirectory), visited, [&](const fs::path& path, const std::string*) {
+            files.push_back(path);
+        });
+        return files;
+    }
+
+    bool Load(uint64_t key, Entry& entry)
+    {
+        std::ifstream file(GetEntryPath(key), std::ios::binary);
+        if(!file)
+        {
+            return false;
+        }
+
+        CacheHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if(!file || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key)
+        {
+            dblog::info("[SHADER_CACHE] Ignoring stale or corrupt entry {}.", GetEntryPath(key).string());
+            return false;
+        }
+
+        entry.shader.resize(header.shaderSize);
+        entry.rootSignature.resize(header.rootSignatureSize);
+        entry.reflection.resize(header.reflectionSize);
+        file.read(reinterpret_cast<char*>(entry.shader.data()), header.shaderSize);
+        file.read(reinterpret_cast<char*>(entry.rootSignature.data()), header.rootSignatureSize);
+        file.read(reinterpret_cast<char*>(entry.reflection.data()), header.reflectionSize);
+        if(!file)
+        {
+            dblog::info("[SHADER_CACHE] Ignoring truncated entry {}.", GetEntryPath(key).string());
+            return false;
+        }
+
+        return true;
+    }
+
+    void Store(uint64_t key, const void* shader, size_t shaderSize, const void* rootSignature, size_t rootSignatureSize,
+               const void* reflection, size_t reflectionSize)
+    {
+        std::error_code error;
+        fs::create_directories(CACHE_DIRECTORY, error);
+
+        // Write to a temporary file first so a crash never leaves a half written entry behind.
+        // Shaders compile on several threads, so every thread gets its own temporary file.
+        const fs::path path = GetEntryPath(key);
+        fs::path temporaryPath = path;
+        temporaryPath += std::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            const CacheHeader header = {
+                .key = key,
+                .shaderSize = shaderSize,
+                .rootSignatureSize = rootSignatureSize,
+                .reflectionSize = reflectionSize,
+            };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(static_cast<const char*>(shader), shaderSize);
+            if(rootSignatureSize > 0)
+            {
+                file.write(static_cast<const char*>(rootSignature), rootSignatureSize);
+            }
+            if(reflectionSize > 0)
+            {
+                file.write(static_cast<const char*>(reflection), reflectionSize);
+            }
+            if(!file)
+            {
+                dblog::error("[SHADER_CACHE] Failed to write {}.", temporaryPath.string());
+                return;
+            }
+        }
+
+        fs::rename(temporaryPath, path, error);
+        if(error)
+        {
+            dblog::error("[SHADER_CACHE] Failed to move {} into place: {}", path.string(), error.message());
+        }
+    }
+    }
+}
@@ -1,7 +1,15 @@
 #include "utility/shader_compiler.hpp"
 
+#include "job_system.hpp"
 #include "utility/dx12_helpers.hpp"
+#include "utility/hash.hpp"
 #include "utility/log.hpp"
+#include "utility/shader_cache.hpp"
+#include "utility/shader_pack.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 using namespace Microsoft::WRL;
 
@@ -9,55 +17,49 @@ namespace Util
 {
     namespace ShaderCompiler
     {
-        // Responsible for the actual compilation of shaders.
-    ComPtr<IDxcCompiler3> compiler{};
+    const std::wstring shaderDirectory = L"assets/shaders";
 
-    // Used to create include handle and provides interfaces for loading shader to blob, etc.
-    ComPtr<IDxcUtils> utils{};
-    ComPtr<IDxcIncludeHandler> includeHandler{};
+    // DXC objects are not thread safe, so every thread that compiles gets its own.
+    struct DxcContext
+    {
+        // Responsible for the actual compilation of shaders.
+        ComPtr<IDxcCompiler3> compiler{};
 
-    std::wstring shaderDirectory{};
+        // Used to create include handle and provides interfaces for loading shader to blob, etc.
+        ComPtr<IDxcUtils> utils{};
+        ComPtr<IDxcIncludeHandler> includeHandler{};
+    };
+    thread_local DxcContext dxcContext{};
 
-    Shader Compile(const ShaderTypes& shaderType, const std::wstring_view shaderPath,
-                   const std::wstring_view entryPoint, const bool extractRootSignature)
+    const wchar_t* GetTargetProfile(const ShaderTypes shaderType)
     {
-        Shader shader{};
-
-        if (!utils)
+        switch (shaderType)
         {
-            ThrowIfFailed(::DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils)));
-            ThrowIfFailed(::DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler)));
-            ThrowIfFailed(utils->CreateDefaultIncludeHandler(&includeHandler));
-
-            shaderDirectory = L"assets/shaders";
+        case ShaderTypes::Vertex: {
+            return L"vs_6_6";
         }
+        break;
 
-        // Setup compilation arguments.
-        const std::wstring targetProfile = [=]() {
-            switch (shaderType)
-            {
-            case ShaderTypes::Vertex: {
-                return L"vs_6_6";
-            }
-            break;
-
-            case ShaderTypes::Pixel: {
-                return L"ps_6_6";
-            }
-            break;
+        case ShaderTypes::Pixel: {
+            return L"ps_6_6";
+        }
+        break;
 
-            case ShaderTypes::Compute: {
-                return L"cs_6_6";
-            }
-            break;
+        case ShaderTypes::Compute: {
+            return L"cs_6_6";
+        }
+        break;
 
-            default: {
-                return L"";
-            }
-            break;
-            }
-        }();
+        default: {
+            return L"";
+        }
+        break;
+        }
+    }
 
+    // Only points into the arguments and static strings, keep entryPoint and defines alive while the result is used.
+    std::vector<LPCWSTR> BuildArguments(const wchar_t* targetProfile, const std::wstring_view entryPoint, const std::vector<std::wstring>& defines)
+    {
         std::vector<LPCWSTR> compilationArguments;
 
         // -E for the entry point (eg. 'main')
@@ -66,12 +68,19 @@ namespace Util
 
         // -T for the target profile (eg. 'ps_6_6')
         compilationArguments.push_back(L"-T");
-        compilationArguments.push_back(targetProfile.c_str());
+        compilationArguments.push_back(targetProfile);
 
         // -I for the target include directory
         compilationArguments.push_back(L"-I");
         compilationArguments.push_back(shaderDirectory.c_str());
 
+        // -D for every define (eg. 'TEXTURED=1')
+        for (const std::wstring& define : defines)
+        {
+            compilationArguments.push_back(L"-D");
+            compilationArguments.push_back(define.c_str());
+        }
+
         // Strip reflection data and pdbs (see later)
         compilationArguments.push_back(L"-Qstrip_debug");
         compilationArguments.push_back(L"-Qstrip_reflect");
@@ -86,6 +95,220 @@ namespace Util
             compilationArguments.push_back(DXC_ARG_OPTIMIZATION_LEVEL3);
 #endif
 
+        return compilationArguments;
+    }
+
+    Shader CreateShader(const ShaderCache::Entry& entry, const bool extractRootSignature)
+    {
+        Shader shader{};
+        const auto& utils = dxcContext.utils;
+
+        ComPtr<IDxcBlobEncoding> shaderBlob{};
+        ThrowIfFailed(utils->CreateBlob(entry.shader.data(), static_cast<UINT32>(entry.shader.size()), DXC_CP_ACP, &shaderBlob));
+        shader.shaderBlob = shaderBlob;
+
+        if (extractRootSignature && !entry.rootSignature.empty())
+        {
+            ComPtr<IDxcBlobEncoding> rootSignatureBlob{};
+            ThrowIfFailed(utils->CreateBlob(entry.rootSignature.data(), static_cast<UINT32>(entry.rootSignature.size()), DXC_CP_ACP, &rootSignatureBlob));
+            shader.rootSignatureBlob = rootSignatureBlob;
+        }
+
+        if (!entry.reflection.empty())
+        {
+            ComPtr<IDxcBlobEncoding> reflectionBlob{};
+            ThrowIfFailed(utils->CreateBlob(entry.reflection.data(), static_cast<UINT32>(entry.reflection.size()), DXC_CP_ACP, &reflectionBlob));
+            shader.reflectionBlob = reflectionBlob;
+        }
+
+        return shader;
+    }
+
+    std::future<Shader> CompileAsync(const ShaderTypes shaderType, std::wstring shaderPath, std::wstring entryPoint, const bool extractRootSignature,
+                                     std::vector<std::wstring> defines)
+    {
+        return JobSystem::Get().Async(
+            [shaderType, shaderPath = std::move(shaderPath), entryPoint = std::move(entryPoint), extractRootSignature, defines = std::move(defines)]() {
+                return Compile(shaderType, shaderPath, entryPoint, extractRootSignature, defines);
+            }, JobSystem::Priority::Low);
+    }
+
+    const std::wstring& GetShaderDirectory()
+    {
+        return shaderDirectory;
+    }
+
+    ComPtr<ID3D12ShaderReflection> CreateReflection(const Shader& shader)
+    {
+        if (!shader.reflectionBlob)
+        {
+            return nullptr;
+        }
+
+        auto& utils = dxcContext.utils;
+        if (!utils)
+        {
+            ThrowIfFailed(::DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils)));
+        }
+
+        const DxcBuffer reflectionBuffer = {
+            .Ptr = shader.reflectionBlob->GetBufferPointer(),
+            .Size = shader.reflectionBlob->GetBufferSize(),
+            .Encoding = 0u,
+        };
+
+        ComPtr<ID3D12ShaderReflection> reflection{};
+        ThrowIfFailed(utils->CreateReflection(&reflectionBuffer, IID_PPV_ARGS(&reflection)));
+        return reflection;
+    }
+
+    // Asks DXC itself, which means creating a compiler. Only for DLLs without a version resource.
+    uint64_t QueryCompilerVersion()
+    {
+        ComPtr<IDxcCompiler3> compiler{};
+        ThrowIfFailed(::DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler)));
+
+        ComPtr<IDxcVersionInfo> versionInfo{};
+        ThrowIfFailed(compiler.As(&versionInfo));
+        UINT32 major = 0;
+        UINT32 minor = 0;
+        ThrowIfFailed(versionInfo->GetVersion(&major, &minor));
+        uint64_t hash = HashValue(major);
+        hash = HashValue(minor, hash);
+
+        // Builds of the same release differ by their commit, older DXC builds don't report it.
+        ComPtr<IDxcVersionInfo2> commitInfo{};
+        UINT32 commitCount = 0;
+        char* commitHash = nullptr;
+        if (SUCCEEDED(compiler.As(&commitInfo)) && SUCCEEDED(commitInfo->GetCommitInfo(&commitCount, &commitHash)) && commitHash)
+        {
+            hash = HashValue(commitCount, hash);
+            hash = HashBytes(commitHash, std::strlen(commitHash), hash);
+            dblog::info("[SHADER_COMPILER] DXC {}.{}, commit {} ({}).", major, minor, commitCount, commitHash);
+            ::CoTaskMemFree(commitHash);
+        }
+        else
+        {
+            dblog::info("[SHADER_COMPILER] DXC {}.{}.", major, minor);
+        }
+
+        return hash;
+    }
+
+    // Reads the version resource of the loaded dxcompiler.dll, false when it has none.
+    bool ReadCompilerFileVersion(uint64_t& hash)
+    {
+        const HMODULE module = ::GetModuleHandleW(L"dxcompiler.dll");
+        if (!module)
+        {
+            return false;
+        }
+        std::wstring path(MAX_PATH, L'\0');
+        path.resize(::GetModuleFileNameW(module, path.data(), static_cast<DWORD>(path.size())));
+
+        DWORD handle = 0;
+        const DWORD size = ::GetFileVersionInfoSizeW(path.c_str(), &handle);
+        std::vector<uint8_t> versionInfo(size);
+        VS_FIXEDFILEINFO* fileInfo = nullptr;
+        UINT length = 0;
+        if (size == 0 || !::GetFileVersionInfoW(path.c_str(), 0, size, versionInfo.data()) ||
+            !::VerQueryValueW(versionInfo.data(), L"\\", reinterpret_cast<void**>(&fileInfo), &length) || !fileInfo)
+        {
+            return false;
+        }
+        hash = HashValue(fileInfo->dwFileVersionMS);
+        hash = HashValue(fileInfo->dwFileVersionLS, hash);
+
+        // The version string of a DXC build carries its commit, eg. "1.8.2405.17 (416fab6b5)".
+        struct Translation
+        {
+            WORD language;
+            WORD codePage;
+        };
+        Translation* translation = nullptr;
+        std::wstring fileVersion;
+        if (::VerQueryValueW(versionInfo.data(), L"\\VarFileInfo\\Translation", reinterpret_cast<void**>(&translation), &length) &&
+            length >= sizeof(Translation))
+        {
+            wchar_t subBlock[64];
+            std::swprintf(subBlock, std::size(subBlock), L"\\StringFileInfo\\%04x%04x\\FileVersion", translation->language, translation->codePage);
+            wchar_t* value = nullptr;
+            if (::VerQueryValueW(versionInfo.data(), subBlock, reinterpret_cast<void**>(&value), &length) && value)
+            {
+                fileVersion = value;
+                hash = HashString(fileVersion, hash);
+            }
+        }
+
+        dblog::info("[SHADER_COMPILER] {} {}.{}.{}.{} {}.", wStringToString(path), HIWORD(fileInfo->dwFileVersionMS), LOWORD(fileInfo->dwFileVersionMS),
+            HIWORD(fileInfo->dwFileVersionLS), LOWORD(fileInfo->dwFileVersionLS), wStringToString(fileVersion));
+        return true;
+    }
+
+    uint64_t GetCompilerVersion()
+    {
+        static const uint64_t compilerVersion = []() {
+            uint64_t hash = 0;
+            return ReadCompilerFileVersion(hash) ? hash : QueryCompilerVersion();
+        }();
+        return compilerVersion;
+    }
+
+    PackKeys GetPackKeys(const ShaderTypes shaderType, const std::wstring_view shaderPath, const std::wstring_view entryPoint,
+                         const bool extractRootSignature, const std::vector<std::wstring>& defines)
+    {
+        const std::vector<LPCWSTR> compilationArguments = BuildArguments(GetTargetProfile(shaderType), entryPoint, defines);
+        return PackKeys{
+            .key = ShaderPack::ComputeKey(shaderPath, compilationArguments, extractRootSignature, GetCompilerVersion()),
+            .sourceKey = ShaderCache::ComputeKey(shaderPath, shaderDirectory, compilationArguments, extractRootSignature, GetCompilerVersion()),
+        };
+    }
+
+    Shader Compile(const ShaderTypes& shaderType, const std::wstring_view shaderPath,
+                   const std::wstring_view entryPoint, const bool extractRootSignature, const std::vector<std::wstring>& defines)
+    {
+        Shader shader{};
+
+        const auto compileStart = std::chrono::high_resolution_clock::now();
+
+        auto& [compiler, utils, includeHandler] = dxcContext;
+        if (!utils)
+        {
+            ThrowIfFailed(::DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&utils)));
+        }
+
+        const std::vector<LPCWSTR> compilationArguments = BuildArguments(GetTargetProfile(shaderType), entryPoint, defines);
+
+        // Baked shaders are only used while they match the source on disk, an edited shader falls through to the cache
+        // and DXC. A build that ships without shader sources has nothing to compare against, so the pack is trusted.
+        const uint64_t compilerVersion = GetCompilerVersion();
+        const uint64_t cacheKey = ShaderCache::ComputeKey(shaderPath, shaderDirectory, compilationArguments, extractRootSignature, compilerVersion);
+        ShaderCache::Entry entry{};
+        uint64_t bakedSourceKey = 0;
+        if (ShaderPack::Find(ShaderPack::ComputeKey(shaderPath, compilationArguments, extractRootSignature, compilerVersion), bakedSourceKey, entry) &&
+            (bakedSourceKey == cacheKey || !std::filesystem::exists(shaderPath)))
+        {
+            shader = CreateShader(entry, extractRootSignature);
+            dblog::info("[SHADER_PACK] Hit for {} ({}) in {:.2f} ms.", wStringToString(shaderPath), wStringToString(entryPoint),
+                std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - compileStart).count());
+            return shader;
+        }
+
+        // Cache hits skip the compiler entirely.
+        if (ShaderCache::Load(cacheKey, entry))
+        {
+            shader = CreateShader(entry, extractRootSignature);
+            dblog::info("[SHADER_CACHE] Hit for {} ({}) in {:.2f} ms.", wStringToString(shaderPath), wStringToString(entryPoint),
+                std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - compileStart).count());
+            return shader;
+        }
+
+        if (!compiler)
+        {
+            ThrowIfFailed(::DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler)));
+            ThrowIfFailed(utils->CreateDefaultIncludeHandler(&includeHandler));
+        }
+
         // Load the shader source file to a blob.
         ComPtr<IDxcBlobEncoding> sourceBlob{nullptr};
         ThrowIfFailed(utils->LoadFile(shaderPath.data(), nullptr, &sourceBlob));
@@ -123,6 +346,27 @@ namespace Util
             shader.rootSignatureBlob = rootSignatureBlob;
         }
 
+        // -Qstrip_reflect keeps reflection out of the shader object, DXC hands it out separately.
+        ComPtr<IDxcBlob> reflectionBlob{nullptr};
+        if (compiledShaderBuffer->HasOutput(DXC_OUT_REFLECTION))
+        {
+            ThrowIfFailed(compiledShaderBuffer->GetOutput(DXC_OUT_REFLECTION, IID_PPV_ARGS(&reflectionBlob), nullptr));
+            shader.reflectionBlob = reflectionBlob;
+        }
+
+        // Failed compilations are never cached, so fixing the shader is enough to retry.
+        HRESULT status{};
+        ThrowIfFailed(compiledShaderBuffer->GetStatus(&status));
+        if (SUCCEEDED(status) && compiledShaderBlob)
+        {
+            ShaderCache::Store(cacheKey, compiledShaderBlob->GetBufferPointer(), compiledShaderBlob->GetBufferSize(),
+                rootSignatureBlob ? rootSignatureBlob->GetBufferPointer() : nullptr, rootSignatureBlob ? rootSignatureBlob->GetBufferSize() : 0u,
+                reflectionBlob ? reflectionBlob->GetBufferPointer() : nullptr, reflectionBlob ? reflectionBlob->GetBufferSize() : 0u);
+        }
+
+        dblog::info("[SHADER_CACHE] Miss for {} ({}), compiled in {:.2f} ms.", wStringToString(shaderPath), wStringToString(entryPoint),
+            std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - compileStart).count());
+
         return shader;
     }
     }
@@ -0,0 +1,232 @@
+#include "utility/shader_pack.hpp"
+
+#include "utility/hash.hpp"
+#include "utility/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr uint32_t PACK_MAGIC = 0x50534244; // "DBSP"
+    // Bump when the file layout or the way keys are computed changes.
+    constexpr uint32_t PACK_VERSION = 2;
+
+    const fs::path PACK_FILE_NAME = "shader_pack.bin";
+
+    struct PackHeader
+    {
+        uint32_t magic = PACK_MAGIC;
+        uint32_t version = PACK_VERSION;
+        uint64_t count = 0;
+    };
+
+    // Sorted by key. The shader, root signature and reflection blobs follow each other from offset on.
+    struct PackEntry
+    {
+        uint64_t key = 0;
+        uint64_t sourceKey = 0;
+        uint64_t offset = 0;
+        uint64_t shaderSize = 0;
+        uint64_t rootSignatureSize = 0;
+        uint64_t reflectionSize = 0;
+    };
+
+    // Either points into the embedded resource, which lives as long as the executable, or into fileData.
+    const uint8_t* packData = nullptr;
+    size_t packSize = 0;
+    std::vector<uint8_t> fileData;
+
+    const PackEntry* entries = nullptr;
+    size_t entryCount = 0;
+
+    fs::path GetExecutableDirectory()
+    {
+        std::wstring path(MAX_PATH, L'\0');
+        const DWORD length = ::GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size()));
+        path.resize(length);
+        return fs::path(path).parent_path();
+    }
+
+    bool Validate()
+    {
+        PackHeader header{};
+        if(packSize < sizeof(header))
+        {
+            return false;
+        }
+        std::memcpy(&header, packData, sizeof(header));
+        if(header.magic != PACK_MAGIC || header.version != PACK_VERSION || header.count > (packSize - sizeof(header)) / sizeof(PackEntry))
+        {
+            return false;
+        }
+
+        entries = reinterpret_cast<const PackEntry*>(packData + sizeof(header));
+        entryCount = static_cast<size_t>(header.count);
+        for(size_t i = 0; i < entryCount; ++i)
+        {
+            const PackEntry& entry = entries[i];
+            const uint64_t blobSize = entry.shaderSize + entry.rootSignatureSize + entry.reflectionSize;
+            if(entry.offset > packSize || blobSize > packSize - entry.offset || (i > 0 && entries[i - 1].key >= entry.key))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+namespace Util
+{
+    namespace ShaderPack
+    {
+    uint64_t ComputeKey(const std::wstring_view shaderPath, const std::vector<LPCWSTR>& compilationArguments, const bool extractRootSignature,
+                        const uint64_t compilerVersion)
+    {
+        uint64_t hash = HashValue(PACK_VERSION);
+        hash = HashValue(compilerVersion, hash);
+        hash = HashString(shaderPath, hash);
+        for(const LPCWSTR argument : compilationArguments)
+        {
+            hash = HashString(argument, hash);
+        }
+        return HashValue(extractRootSignature, hash);
+    }
+
+    bool Open()
+    {
+        const auto openStart = std::chrono::high_resolution_clock::now();
+
+        std::string source;
+#ifdef DIABOLIC_EMBED_SHADERS
+        const HRSRC resource = ::FindResourceW(nullptr, L"SHADER_PACK", RT_RCDATA);
+        const HGLOBAL loadedResource = resource ? ::LoadResource(nullptr, resource) : nullptr;
+        if(loadedResource)
+        {
+            packData = static_cast<const uint8_t*>(::LockResource(loadedResource));
+            packSize = ::SizeofResource(nullptr, resource);
+            source = "the executable";
+        }
+#endif
+
+        if(!packData)
+        {
+            const fs::path packPath = GetExecutableDirectory() / PACK_FILE_NAME;
+            std::ifstream file(packPath, std::ios::binary);
+            if(!file)
+            {
+                dblog::info("[SHADER_PACK] No shader pack, all shaders are compiled at runtime.");
+                return false;
+            }
+            fileData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            packData = fileData.data();
+            packSize = fileData.size();
+            source = packPath.string();
+        }
+
+        if(!Validate())
+        {
+            dblog::error("[SHADER_PACK] Ignoring the stale or corrupt shader pack in {}.", source);
+            packData = nullptr;
+            packSize = 0;
+            fileData = {};
+            entries = nullptr;
+            entryCount = 0;
+            return false;
+        }
+
+        dblog::info("[SHADER_PACK] Opened {} shaders from {} in {:.2f} ms.", entryCount, source,
+            std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - openStart).count());
+        return true;
+    }
+
+    bool Find(uint64_t key, uint64_t& sourceKey, ShaderCache::Entry& entry)
+    {
+        const PackEntry* end = entries + entryCount;
+        const PackEntry* found = std::lower_bound(entries, end, key, [](const PackEntry& packEntry, uint64_t value) { return packEntry.key < value; });
+        if(found == end || found->key != key)
+        {
+            return false;
+        }
+
+        const uint8_t* blob = packData + found->offset;
+        entry.shader.assign(blob, blob + found->shaderSize);
+        blob += found->shaderSize;
+        entry.rootSignature.assign(blob, blob + found->rootSignatureSize);
+        blob += found->rootSignatureSize;
+        entry.reflection.assign(blob, blob + found->reflectionSize);
+
+        sourceKey = found->sourceKey;
+        return true;
+    }
+
+    bool Write(const fs::path& path, const std::vector<PackedShader>& shaders)
+    {
+        std::vector<const PackedShader*> sorted;
+        sorted.reserve(shaders.size());
+        for(const PackedShader& shader : shaders)
+        {
+            sorted.push_back(&shader);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const PackedShader* a, const PackedShader* b) { return a->key < b->key; });
+
+        const PackHeader header{ .count = sorted.size() };
+        std::vector<PackEntry> packEntries;
+        packEntries.reserve(sorted.size());
+        uint64_t offset = sizeof(header) + sorted.size() * sizeof(PackEntry);
+        for(const PackedShader* shader : sorted)
+        {
+            const PackEntry packEntry{
+                .key = shader->key,
+                .sourceKey = shader->sourceKey,
+                .offset = offset,
+                .shaderSize = shader->entry.shader.size(),
+                .rootSignatureSize = shader->entry.rootSignature.size(),
+                .reflectionSize = shader->entry.reflection.size(),
+            };
+            packEntries.push_back(packEntry);
+            offset += packEntry.shaderSize + packEntry.rootSignatureSize + packEntry.reflectionSize;
+        }
+
+        std::error_code error;
+        if(path.has_parent_path())
+        {
+            fs::create_directories(path.parent_path(), error);
+        }
+
+        // Write to a temporary file first so a failed bake never leaves a half written pack behind.
+        fs::path temporaryPath = path;
+        temporaryPath += ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(packEntries.data()), packEntries.size() * sizeof(PackEntry));
+            for(const PackedShader* shader : sorted)
+            {
+                file.write(reinterpret_cast<const char*>(shader->entry.shader.data()), shader->entry.shader.size());
+                file.write(reinterpret_cast<const char*>(shader->entry.rootSignature.data()), shader->entry.rootSignature.size());
+                file.write(reinterpret_cast<const char*>(shader->entry.reflection.data()), shader->entry.reflection.size());
+            }
+            if(!file)
+            {
+                dblog::error("[SHADER_PACK] Failed to write {}.", temporaryPath.string());
+                return false;
+            }
+        }
+
+        fs::rename(temporaryPath, path, error);
+        if(error)
+        {
+            dblog::error("[SHADER_PACK] Failed to move {} into place: {}", path.string(), error.message());
+            return false;
+        }
+
+        dblog::info("[SHADER_PACK] Wrote {} shaders, {} bytes, to {}.", sorted.size(), offset, path.string());
+        return true;
+    }
+    }
+}
@@ -0,0 +1,44 @@
+#include "utility/shader_permutations.hpp"
+
+#include "utility/log.hpp"
+
+namespace Util
+{
+    ShaderPermutations::ShaderPermutations(std::wstring shaderPath, std::vector<std::wstring> features) :
+        _shaderPath(std::move(shaderPath)),
+        _features(std::move(features))
+    {
+        assert(_features.size() <= MAX_FEATURES && "Too many shader features for the variant mask.");
+    }
+
+    std::future<Shader> ShaderPermutations::CompileAsync(const ShaderTypes shaderType, std::wstring entryPoint, uint32_t variant) const
+    {
+        return ShaderCompiler::CompileAsync(shaderType, _shaderPath, std::move(entryPoint), false, GetDefines(variant));
+    }
+
+    std::vector<std::wstring> ShaderPermutations::GetDefines(uint32_t variant) const
+    {
+        assert(variant < GetVariantCount() && "Variant uses undeclared features.");
+
+        std::vector<std::wstring> defines;
+        defines.reserve(_features.size());
+        for(size_t i = 0; i < _features.size(); ++i)
+        {
+            defines.push_back(_features[i] + ((variant & (1u << i)) ? L"=1" : L"=0"));
+        }
+        return defines;
+    }
+
+    std::string ShaderPermutations::Describe(uint32_t variant) const
+    {
+        std::string description;
+        for(size_t i = 0; i < _features.size(); ++i)
+        {
+            if(variant & (1u << i))
+            {
+                description += (description.empty() ? "" : "|") + wStringToString(_features[i]);
+            }
+        }
+        return description.empty() ? "BASE" : description;
+    }
+}
@@ -0,0 +1,26 @@
+#include "utility/shader_registry.hpp"
+
+namespace Util
+{
+    namespace ShaderRegistry
+    {
+    namespace
+    {
+        const ProgramDesc PROGRAMS[] = {
+            // Features in MaterialFeature bit order.
+            ProgramDesc{
+                .shaderPath = L"assets/shaders/cube_spin.hlsl",
+                .features = { L"TEXTURED", L"ALPHA_TESTED" },
+                .stages = { Stage{ ShaderTypes::Vertex, L"VSmain" }, Stage{ ShaderTypes::Pixel, L"PSmain" } },
+            },
+        };
+        static_assert(std::size(PROGRAMS) == static_cast<size_t>(Program::Count), "Every program needs a description.");
+    }
+
+    const ProgramDesc& GetProgram(Program program)
+    {
+        assert(program < Program::Count && "Not a shader program.");
+        return PROGRAMS[static_cast<size_t>(program)];
+    }
+    }
+}
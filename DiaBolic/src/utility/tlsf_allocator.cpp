@@ -0,0 +1,353 @@
+#include "utility/tlsf_allocator.hpp"
+
+#include <bit>
+
+namespace
+{
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+Util::TlsfAllocator::TlsfAllocator(uint64_t size, uint64_t granularity) :
+    _size(size),
+    _granularity(granularity),
+    _granularityShift(static_cast<uint32_t>(std::countr_zero(granularity)))
+{
+    assert(std::has_single_bit(granularity) && "The granularity has to be a power of two.");
+    assert(size >= granularity && size % granularity == 0 && "The size has to be a multiple of the granularity.");
+
+    for(auto& bins : _freeLists)
+    {
+        bins.fill(NO_BLOCK);
+    }
+
+    const uint32_t block = NewBlock();
+    _blocks[block].size = size;
+    InsertFree(block);
+}
+
+Util::TlsfAllocator::Allocation Util::TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    assert(size > 0 && "Allocations can't be empty.");
+    alignment = std::max(alignment, _granularity);
+    assert(alignment % _granularity == 0 && "The alignment has to be a multiple of the granularity.");
+
+    const uint64_t alignedSize = AlignUp(size, _granularity);
+    const uint32_t found = FindFreeBlock(alignedSize, alignment);
+    if(found == NO_BLOCK)
+    {
+        return {};
+    }
+    RemoveFree(found);
+
+    // The block's neighbours are in use, so the padding and the remainder never have a free neighbour to merge with.
+    uint32_t block = found;
+    const uint64_t padding = AlignUp(_blocks[found].offset, alignment) - _blocks[found].offset;
+    if(padding > 0)
+    {
+        block = Split(found, padding);
+        InsertFree(found);
+    }
+    if(_blocks[block].size > alignedSize)
+    {
+        InsertFree(Split(block, alignedSize));
+    }
+
+    _usedBytes += alignedSize;
+    _requestedBytes += size;
+    ++_allocationCount;
+    return Allocation{ .offset = _blocks[block].offset, .size = size, .block = block };
+}
+
+void Util::TlsfAllocator::Free(const Allocation& allocation)
+{
+    assert(allocation.IsValid() && !_blocks[allocation.block].free && "Block is not allocated.");
+
+    uint32_t block = allocation.block;
+    _usedBytes -= _blocks[block].size;
+    _requestedBytes -= allocation.size;
+    --_allocationCount;
+
+    const uint32_t previous = _blocks[block].previousPhysical;
+    if(previous != NO_BLOCK && _blocks[previous].free)
+    {
+        RemoveFree(previous);
+        Merge(previous, block);
+        block = previous;
+    }
+
+    const uint32_t next = _blocks[block].nextPhysical;
+    if(next != NO_BLOCK && _blocks[next].free)
+    {
+        RemoveFree(next);
+        Merge(block, next);
+    }
+
+    InsertFree(block);
+}
+
+Util::TlsfAllocator::Stats Util::TlsfAllocator::GetStats() const
+{
+    Stats stats{
+        .size = _size,
+        .usedBytes = _usedBytes,
+        .requestedBytes = _requestedBytes,
+        .freeBytes = _size - _usedBytes,
+        .allocationCount = _allocationCount,
+        .freeBlockCount = _freeBlockCount,
+    };
+
+    // The largest block is in the highest bin that has any, that bin's blocks only differ in size within one step.
+    if(_firstLevelBitmap != 0)
+    {
+        const uint32_t firstLevel = 63 - std::countl_zero(_firstLevelBitmap);
+        const uint32_t secondLevel = 31 - std::countl_zero(_secondLevelBitmaps[firstLevel]);
+        for(uint32_t block = _freeLists[firstLevel][secondLevel]; block != NO_BLOCK; block = _blocks[block].nextFree)
+        {
+            stats.largestFreeBlock = std::max(stats.largestFreeBlock, _blocks[block].size);
+        }
+    }
+    return stats;
+}
+
+bool Util::TlsfAllocator::Validate() const
+{
+    uint64_t offset = 0;
+    uint64_t usedBytes = 0;
+    uint32_t allocationCount = 0;
+    uint32_t freeBlockCount = 0;
+    uint32_t previous = NO_BLOCK;
+    for(uint32_t block = 0; block != NO_BLOCK; block = _blocks[block].nextPhysical)
+    {
+        const Block& current = _blocks[block];
+        if(current.offset != offset || current.size == 0 || current.size % _granularity != 0 || current.previousPhysical != previous)
+        {
+            return false;
+        }
+        // Two free neighbours should have been merged.
+        if(current.free && previous != NO_BLOCK && _blocks[previous].free)
+        {
+            return false;
+        }
+
+        if(current.free)
+        {
+            ++freeBlockCount;
+        }
+        else
+        {
+            usedBytes += current.size;
+            ++allocationCount;
+        }
+        offset += current.size;
+        previous = block;
+    }
+    if(offset != _size || usedBytes != _usedBytes || allocationCount != _allocationCount || freeBlockCount != _freeBlockCount)
+    {
+        return false;
+    }
+
+    uint32_t binnedBlockCount = 0;
+    for(uint32_t firstLevel = 0; firstLevel < FIRST_LEVEL_COUNT; ++firstLevel)
+    {
+        const bool firstLevelSet = (_firstLevelBitmap >> firstLevel) & 1;
+        if(firstLevelSet != (_secondLevelBitmaps[firstLevel] != 0))
+        {
+            return false;
+        }
+
+        for(uint32_t secondLevel = 0; secondLevel < SECOND_LEVEL_COUNT; ++secondLevel)
+        {
+            const uint32_t first = _freeLists[firstLevel][secondLevel];
+            if(((_secondLevelBitmaps[firstLevel] >> secondLevel) & 1) != (first != NO_BLOCK))
+            {
+                return false;
+            }
+
+            uint32_t previousFree = NO_BLOCK;
+            for(uint32_t block = first; block != NO_BLOCK; block = _blocks[block].nextFree)
+            {
+                const Block& current = _blocks[block];
+                const Bin bin = GetBin(current.size);
+                if(!current.free || current.previousFree != previousFree || bin.firstLevel != firstLevel || bin.secondLevel != secondLevel)
+                {
+                    return false;
+                }
+                ++binnedBlockCount;
+                previousFree = block;
+            }
+        }
+    }
+    return binnedBlockCount == _freeBlockCount;
+}
+
+Util::TlsfAllocator::Bin Util::TlsfAllocator::GetBin(uint64_t size) const
+{
+    const uint64_t granules = size >> _granularityShift;
+    if(granules < SECOND_LEVEL_COUNT)
+    {
+        return Bin{ 0, static_cast<uint32_t>(granules) };
+    }
+
+    const uint32_t highestBit = 63 - std::countl_zero(granules);
+    return Bin{
+        highestBit - SECOND_LEVEL_BITS + 1,
+        static_cast<uint32_t>(granules >> (highestBit - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT,
+    };
+}
+
+Util::TlsfAllocator::Bin Util::TlsfAllocator::GetSearchBin(uint64_t size) const
+{
+    // Round up to where the next bin starts, the bin size falls in can also hold smaller blocks.
+    uint64_t granules = (size + _granularity - 1) >> _granularityShift;
+    if(granules >= SECOND_LEVEL_COUNT)
+    {
+        const uint32_t highestBit = 63 - std::countl_zero(granules);
+        granules += (1ull << (highestBit - SECOND_LEVEL_BITS)) - 1;
+    }
+    return GetBin(granules << _granularityShift);
+}
+
+uint32_t Util::TlsfAllocator::FindFreeBlock(uint64_t size, uint64_t alignment) const
+{
+    if(size > _size)
+    {
+        return NO_BLOCK;
+    }
+
+    // Every block from the search bin up fits, wherever it starts. Take a bigger bin of the same first level, otherwise
+    // the smallest bin of a bigger first level.
+    const uint64_t paddedSize = size + alignment - _granularity;
+    if(paddedSize <= _size)
+    {
+        Bin bin = GetSearchBin(paddedSize);
+        uint32_t secondLevelMap = _secondLevelBitmaps[bin.firstLevel] & (~0u << bin.secondLevel);
+        if(secondLevelMap == 0)
+        {
+            const uint64_t firstLevelMap = _firstLevelBitmap & (~0ull << (bin.firstLevel + 1));
+            bin.firstLevel = static_cast<uint32_t>(std::countr_zero(firstLevelMap));
+            secondLevelMap = firstLevelMap != 0 ? _secondLevelBitmaps[bin.firstLevel] : 0;
+        }
+        if(secondLevelMap != 0)
+        {
+            bin.secondLevel = static_cast<uint32_t>(std::countr_zero(secondLevelMap));
+            return _freeLists[bin.firstLevel][bin.secondLevel];
+        }
+    }
+
+    // Blocks in the bin size itself falls in may still fit. An allocation taking up the whole range only fits this way.
+    const Bin bin = GetBin(size);
+    for(uint32_t block = _freeLists[bin.firstLevel][bin.secondLevel]; block != NO_BLOCK; block = _blocks[block].nextFree)
+    {
+        const uint64_t padding = AlignUp(_blocks[block].offset, alignment) - _blocks[block].offset;
+        if(padding + size <= _blocks[block].size)
+        {
+            return block;
+        }
+    }
+    return NO_BLOCK;
+}
+
+void Util::TlsfAllocator::InsertFree(uint32_t block)
+{
+    const Bin bin = GetBin(_blocks[block].size);
+    uint32_t& first = _freeLists[bin.firstLevel][bin.secondLevel];
+
+    _blocks[block].free = true;
+    _blocks[block].previousFree = NO_BLOCK;
+    _blocks[block].nextFree = first;
+    if(first != NO_BLOCK)
+    {
+        _blocks[first].previousFree = block;
+    }
+    first = block;
+
+    _firstLevelBitmap |= 1ull << bin.firstLevel;
+    _secondLevelBitmaps[bin.firstLevel] |= 1u << bin.secondLevel;
+    ++_freeBlockCount;
+}
+
+void Util::TlsfAllocator::RemoveFree(uint32_t block)
+{
+    Block& removed = _blocks[block];
+    const Bin bin = GetBin(removed.size);
+
+    if(removed.previousFree != NO_BLOCK)
+    {
+        _blocks[removed.previousFree].nextFree = removed.nextFree;
+    }
+    else
+    {
+        _freeLists[bin.firstLevel][bin.secondLevel] = removed.nextFree;
+    }
+    if(removed.nextFree != NO_BLOCK)
+    {
+        _blocks[removed.nextFree].previousFree = removed.previousFree;
+    }
+
+    if(_freeLists[bin.firstLevel][bin.secondLevel] == NO_BLOCK)
+    {
+        _secondLevelBitmaps[bin.firstLevel] &= ~(1u << bin.secondLevel);
+        if(_secondLevelBitmaps[bin.firstLevel] == 0)
+        {
+            _firstLevelBitmap &= ~(1ull << bin.firstLevel);
+        }
+    }
+
+    removed.free = false;
+    removed.previousFree = NO_BLOCK;
+    removed.nextFree = NO_BLOCK;
+    --_freeBlockCount;
+}
+
+uint32_t Util::TlsfAllocator::Split(uint32_t block, uint64_t frontSize)
+{
+    // Can grow _blocks, so no references across this.
+    const uint32_t back = NewBlock();
+    Block& front = _blocks[block];
+    Block& backBlock = _blocks[back];
+
+    backBlock.offset = front.offset + frontSize;
+    backBlock.size = front.size - frontSize;
+    backBlock.previousPhysical = block;
+    backBlock.nextPhysical = front.nextPhysical;
+    if(front.nextPhysical != NO_BLOCK)
+    {
+        _blocks[front.nextPhysical].previousPhysical = back;
+    }
+
+    front.size = frontSize;
+    front.nextPhysical = back;
+    return back;
+}
+
+void Util::TlsfAllocator::Merge(uint32_t block, uint32_t next)
+{
+    Block& merged = _blocks[block];
+    const Block& removed = _blocks[next];
+
+    merged.size += removed.size;
+    merged.nextPhysical = removed.nextPhysical;
+    if(removed.nextPhysical != NO_BLOCK)
+    {
+        _blocks[removed.nextPhysical].previousPhysical = block;
+    }
+
+    _blocks[next] = Block{};
+    _unusedBlocks.push_back(next);
+}
+
+uint32_t Util::TlsfAllocator::NewBlock()
+{
+    if(!_unusedBlocks.empty())
+    {
+        const uint32_t block = _unusedBlocks.back();
+        _unusedBlocks.pop_back();
+        return block;
+    }
+
+    _blocks.emplace_back();
+    return static_cast<uint32_t>(_blocks.size() - 1);
+}
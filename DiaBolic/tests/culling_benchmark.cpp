@@ -0,0 +1,104 @@
+#include "test_common.hpp"
+
+#include "culling.hpp"
+#include "bvh.hpp"
+
+#include <random>
+
+using namespace DirectX;
+
+// Frustum culling of random scenes three ways: a box at a time as it was done before the flat SoA arrays, the SIMD
+// CullFrustum over them, and a BVH query. All three have to agree on what is visible. The timings show what the SIMD
+// path gains and from how many objects on the BVH wins, which is what Scene's BVH_CULLING_THRESHOLD is based on.
+namespace
+{
+    std::vector<Culling::Bounds> RandomScene(size_t count, std::mt19937& random)
+    {
+        // Objects spread through a cube around the camera, about a tenth of them end up in the frustum.
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> extent(0.5f, 4.0f);
+
+        std::vector<Culling::Bounds> scene(count);
+        for(Culling::Bounds& bounds : scene)
+        {
+            bounds.center = XMFLOAT3(position(random), position(random), position(random));
+            bounds.extents = XMFLOAT3(extent(random), extent(random), extent(random));
+        }
+        return scene;
+    }
+
+    Culling::Frustum CameraFrustum()
+    {
+        const XMMATRIX view = XMMatrixTranslation(0.0f, 0.0f, 0.0f);
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 600.0f);
+        return Culling::ExtractFrustum(XMMatrixMultiply(view, projection));
+    }
+
+    // One box and one plane at a time, like the node walk did before the objects were flattened.
+    void CullOneByOne(const Culling::Frustum& frustum, const std::vector<Culling::Bounds>& scene, std::vector<uint32_t>& visible)
+    {
+        visible.clear();
+        for(uint32_t i = 0; i < scene.size(); ++i)
+        {
+            const Culling::Bounds& bounds = scene[i];
+            bool inside = true;
+            for(const XMFLOAT4& plane : frustum.planes)
+            {
+                const float distance = bounds.center.x * plane.x + bounds.center.y * plane.y + bounds.center.z * plane.z + plane.w;
+                const float radius = bounds.extents.x * std::abs(plane.x) + bounds.extents.y * std::abs(plane.y) + bounds.extents.z * std::abs(plane.z);
+                if(distance + radius < 0.0f)
+                {
+                    inside = false;
+                    break;
+                }
+            }
+            if(inside)
+            {
+                visible.push_back(i);
+            }
+        }
+    }
+}
+
+int main()
+{
+    const std::vector<size_t> counts = Test::IsQuick()
+        ? std::vector<size_t>{ 1000, 20000 }
+        : std::vector<size_t>{ 1000, 4096, 16384, 65536, 262144, 1048576 };
+    const uint32_t repetitions = Test::IsQuick() ? 2 : 20;
+
+    std::mt19937 random(42);
+    const Culling::Frustum frustum = CameraFrustum();
+
+    std::printf("%10s %10s %14s %14s %14s %10s %10s\n", "objects", "visible", "one by one ms", "SIMD ms", "BVH ms", "SIMD gain", "BVH gain");
+    for(const size_t count : counts)
+    {
+        const std::vector<Culling::Bounds> scene = RandomScene(count, random);
+
+        Culling::BoundsSoA bounds;
+        bounds.Reserve(count);
+        Bvh bvh;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            bounds.Add(scene[i]);
+            (void)bvh.Insert(scene[i], i);
+        }
+        bvh.Rebuild();
+
+        std::vector<uint32_t> reference, simd, hierarchy;
+        const double oneByOneMs = Test::MeasureMilliseconds(repetitions, [&]() { CullOneByOne(frustum, scene, reference); });
+        const double simdMs = Test::MeasureMilliseconds(repetitions, [&]() { Culling::CullFrustum(frustum, bounds, simd); });
+        const double bvhMs = Test::MeasureMilliseconds(repetitions, [&]() { hierarchy.clear(); bvh.Query(frustum, hierarchy); });
+
+        // The BVH accepts whole subtrees without testing them, so it reports in its own order.
+        std::sort(hierarchy.begin(), hierarchy.end());
+        CHECK(simd == reference);
+        CHECK(hierarchy == reference);
+        CHECK(!reference.empty() && reference.size() < count);
+
+        std::printf("%10zu %10zu %14.3f %14.3f %14.3f %9.2fx %9.2fx\n", count, reference.size(), oneByOneMs, simdMs, bvhMs,
+            oneByOneMs / simdMs, simdMs / bvhMs);
+    }
+
+    return Test::Finish();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "culling.hpp"
+
+// Stands in for the renderer's resources.hpp, which needs assimp and a device, with just what Scene and DrawList use
+// of the assets. Tests build the meshes and models themselves.
+
+class Mesh
+{
+public:
+    Mesh(uint32_t id, const Culling::Bounds& bounds) : _bounds(bounds), _id(id) {}
+
+    uint32_t GetId() const { return _id; }
+    Culling::Bounds const& GetBounds() const { return _bounds; }
+
+    bool IsOccluder() const { return !_occluderIndices.empty(); }
+    std::vector<DirectX::XMFLOAT3> const& GetOccluderPositions() const { return _occluderPositions; }
+    std::vector<uint16_t> const& GetOccluderIndices() const { return _occluderIndices; }
+
+private:
+    Culling::Bounds _bounds{};
+    std::vector<DirectX::XMFLOAT3> _occluderPositions;
+    std::vector<uint16_t> _occluderIndices;
+    uint32_t _id = 0;
+};
+
+struct Material
+{
+    uint32_t id = 0;
+    uint32_t shaderFeatures = 0;
+};
+
+class Model
+{
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    struct Node
+    {
+        DirectX::XMFLOAT4X4 transform;
+        uint32_t parent = NO_PARENT;
+        const Mesh* mesh = nullptr;
+        const Material* material = nullptr;
+    };
+
+    explicit Model(std::vector<Node> nodes) : _nodes(std::move(nodes)) {}
+
+    const std::vector<Node>& GetNodes() const { return _nodes; }
+
+private:
+    std::vector<Node> _nodes;
+};
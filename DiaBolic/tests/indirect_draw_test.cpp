@@ -0,0 +1,143 @@
+#include "test_common.hpp"
+
+#include "utility/indirect_draw_layout.hpp"
+
+#include <random>
+
+// Argument buffer layouts for every root constant count the root signature allows, then commands packed back to back
+// into a dirty buffer and read back: constants first, draw arguments right after, nothing left over between commands.
+namespace
+{
+    using IndirectDraw::DrawIndexedArguments;
+    using IndirectDraw::Layout;
+
+    // A root signature holds at most 64 DWORDs, the root constants have to fit in there.
+    constexpr uint32_t MAX_ROOT_CONSTANTS = 64;
+    constexpr uint32_t DRAW_ARGUMENTS_SIZE = 5 * sizeof(uint32_t);
+
+    DrawIndexedArguments RandomDrawArguments(std::mt19937& random)
+    {
+        return DrawIndexedArguments{
+            .indexCountPerInstance = static_cast<uint32_t>(random()),
+            .instanceCount = static_cast<uint32_t>(random()),
+            .startIndexLocation = static_cast<uint32_t>(random()),
+            .baseVertexLocation = static_cast<int32_t>(random()),
+            .startInstanceLocation = static_cast<uint32_t>(random()),
+        };
+    }
+
+    bool SameDrawArguments(const DrawIndexedArguments& a, const DrawIndexedArguments& b)
+    {
+        return a.indexCountPerInstance == b.indexCountPerInstance && a.instanceCount == b.instanceCount && a.startIndexLocation == b.startIndexLocation &&
+            a.baseVertexLocation == b.baseVertexLocation && a.startInstanceLocation == b.startInstanceLocation;
+    }
+
+    void TestLayouts()
+    {
+        CHECK(sizeof(DrawIndexedArguments) == DRAW_ARGUMENTS_SIZE);
+
+        for(uint32_t count = 1; count <= MAX_ROOT_CONSTANTS; ++count)
+        {
+            const Layout layout = IndirectDraw::MakeLayout(3, count);
+            CHECK(layout.rootParameterIndex == 3 && layout.rootConstantCount == count);
+
+            // Signature order, tightly packed.
+            CHECK(layout.constantsOffset == 0);
+            CHECK(layout.drawArgumentsOffset == count * sizeof(uint32_t));
+            CHECK(layout.drawArgumentsOffset % sizeof(uint32_t) == 0);
+
+            // Room for everything, 4 byte aligned and no more padding than that needs.
+            const uint32_t end = layout.drawArgumentsOffset + DRAW_ARGUMENTS_SIZE;
+            CHECK(layout.byteStride >= end && layout.byteStride - end < sizeof(uint32_t));
+            CHECK(layout.byteStride % sizeof(uint32_t) == 0);
+        }
+    }
+
+    void TestOneConstant()
+    {
+        // What the geometry pipeline falls back to when a root signature has no constants.
+        const Layout layout = IndirectDraw::MakeLayout(0, 1);
+        CHECK(layout.constantsOffset == 0 && layout.drawArgumentsOffset == 4 && layout.byteStride == 24);
+
+        const uint32_t constant = 0xdeadbeef;
+        const DrawIndexedArguments drawArguments = { .indexCountPerInstance = 36, .instanceCount = 2, .startIndexLocation = 120, .baseVertexLocation = -8, .startInstanceLocation = 0 };
+        std::vector<uint8_t> buffer(layout.byteStride + 1, 0xcd);
+        IndirectDraw::PackCommand(layout, buffer.data(), &constant, drawArguments);
+
+        uint32_t packedConstant = 0;
+        DrawIndexedArguments packedArguments;
+        std::memcpy(&packedConstant, buffer.data(), sizeof(packedConstant));
+        std::memcpy(&packedArguments, buffer.data() + 4, sizeof(packedArguments));
+        CHECK(packedConstant == constant);
+        CHECK(SameDrawArguments(packedArguments, drawArguments));
+
+        // Nothing written past the stride.
+        CHECK(buffer.back() == 0xcd);
+    }
+
+    void TestPackedCommands()
+    {
+        std::mt19937 random(29);
+        const uint32_t commandCount = Test::IsQuick() ? 16 : 64;
+        bool valid = true;
+        for(uint32_t count = 1; count <= MAX_ROOT_CONSTANTS; ++count)
+        {
+            const Layout layout = IndirectDraw::MakeLayout(0, count);
+
+            // Packed at the buffer's start and at odd 4 byte offsets, like the pipeline's argument buffer.
+            for(const size_t base : { size_t(0), size_t(4), size_t(12) })
+            {
+                std::vector<uint8_t> buffer(base + static_cast<size_t>(commandCount) * layout.byteStride + 16, 0xcd);
+                std::vector<std::vector<uint32_t>> constants(commandCount);
+                std::vector<DrawIndexedArguments> drawArguments(commandCount);
+                for(uint32_t i = 0; i < commandCount; ++i)
+                {
+                    constants[i].resize(count);
+                    for(uint32_t& constant : constants[i])
+                    {
+                        constant = static_cast<uint32_t>(random());
+                    }
+                    drawArguments[i] = RandomDrawArguments(random);
+                    IndirectDraw::PackCommand(layout, buffer.data() + base + static_cast<size_t>(i) * layout.byteStride, constants[i].data(), drawArguments[i]);
+                }
+
+                for(uint32_t i = 0; i < commandCount; ++i)
+                {
+                    const uint8_t* command = buffer.data() + base + static_cast<size_t>(i) * layout.byteStride;
+                    std::vector<uint32_t> packedConstants(count);
+                    DrawIndexedArguments packedArguments;
+                    std::memcpy(packedConstants.data(), command + layout.constantsOffset, count * sizeof(uint32_t));
+                    std::memcpy(&packedArguments, command + layout.drawArgumentsOffset, sizeof(packedArguments));
+                    valid &= packedConstants == constants[i];
+                    valid &= SameDrawArguments(packedArguments, drawArguments[i]);
+
+                    // Whatever lies between this command's arguments and the next command is zeroed.
+                    for(uint32_t offset = layout.drawArgumentsOffset + DRAW_ARGUMENTS_SIZE; offset < layout.byteStride; ++offset)
+                    {
+                        valid &= command[offset] == 0;
+                    }
+                }
+
+                // The bytes around the commands are untouched.
+                for(size_t offset = 0; offset < base; ++offset)
+                {
+                    valid &= buffer[offset] == 0xcd;
+                }
+                for(size_t offset = base + static_cast<size_t>(commandCount) * layout.byteStride; offset < buffer.size(); ++offset)
+                {
+                    valid &= buffer[offset] == 0xcd;
+                }
+            }
+        }
+        CHECK(valid);
+    }
+}
+
+int main()
+{
+    TestLayouts();
+    TestOneConstant();
+    TestPackedCommands();
+
+    return Test::Finish();
+}
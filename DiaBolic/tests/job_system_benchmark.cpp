@@ -0,0 +1,96 @@
+#include "test_common.hpp"
+
+#include "job_system.hpp"
+
+#include <cmath>
+#include <utility>
+
+// How ParallelFor scales over a serial loop with the grain size, and what a job costs on its own: empty jobs through
+// Run and a counter, and nested Async/Wait. The worker count is fixed by the machine, it is printed with the results.
+namespace
+{
+    // Enough arithmetic per element that memory bandwidth doesn't decide the result.
+    float Work(size_t index)
+    {
+        float value = static_cast<float>(index);
+        for(uint32_t i = 0; i < 64; ++i)
+        {
+            value = std::sqrt(value * 1.0001f + 1.0f);
+        }
+        return value;
+    }
+
+    uint64_t Fibonacci(uint32_t n)
+    {
+        if(n < 2)
+        {
+            return n;
+        }
+        std::future<uint64_t> a = JobSystem::Get().Async([n]() { return Fibonacci(n - 1); });
+        std::future<uint64_t> b = JobSystem::Get().Async([n]() { return Fibonacci(n - 2); });
+        return JobSystem::Get().Wait(a) + JobSystem::Get().Wait(b);
+    }
+}
+
+int main()
+{
+    JobSystem& jobSystem = JobSystem::Get();
+    const uint32_t repetitions = Test::IsQuick() ? 2 : 10;
+    const size_t count = Test::IsQuick() ? 1 << 16 : 1 << 22;
+    std::printf("%u workers and the calling thread.\n", jobSystem.GetWorkerCount());
+
+    std::vector<float> serial(count);
+    const double serialMs = Test::MeasureMilliseconds(repetitions, [&]() {
+        for(size_t i = 0; i < count; ++i)
+        {
+            serial[i] = Work(i);
+        }
+    });
+
+    std::printf("%10s %10s %12s %10s\n", "elements", "grain", "ms", "speedup");
+    std::printf("%10zu %10s %12.3f %10.2f\n", count, "serial", serialMs, 1.0);
+    for(const size_t grainSize : { size_t(64), size_t(1024), size_t(16384), count / (jobSystem.GetWorkerCount() + 1) + 1 })
+    {
+        std::vector<float> parallel(count);
+        const double parallelMs = Test::MeasureMilliseconds(repetitions, [&]() {
+            jobSystem.ParallelFor(count, grainSize, [&](size_t begin, size_t end) {
+                for(size_t i = begin; i < end; ++i)
+                {
+                    parallel[i] = Work(i);
+                }
+            });
+        });
+        CHECK(parallel == serial);
+        std::printf("%10zu %10zu %12.3f %10.2f\n", count, grainSize, parallelMs, serialMs / parallelMs);
+    }
+
+    // Overhead per job, with nothing to do in them.
+    const uint32_t jobCount = Test::IsQuick() ? 10000 : 1000000;
+    std::atomic<uint32_t> ran = 0;
+    const double runMs = Test::MeasureMilliseconds(repetitions, [&]() {
+        JobSystem::Counter counter;
+        for(uint32_t i = 0; i < jobCount; ++i)
+        {
+            jobSystem.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        }
+        jobSystem.Wait(counter);
+    });
+    CHECK(ran == jobCount * repetitions);
+
+    const uint32_t depth = Test::IsQuick() ? 16 : 24;
+    uint64_t result = 0;
+    const double asyncMs = Test::MeasureMilliseconds(repetitions, [&]() { result = Fibonacci(depth); });
+    CHECK(result == (Test::IsQuick() ? 987u : 46368u));
+    // Fibonacci(n) makes 2 * F(n + 1) - 1 calls, all but the first are jobs.
+    uint64_t previous = 0, next = 1;
+    for(uint32_t i = 0; i < depth + 1; ++i)
+    {
+        next = std::exchange(previous, next) + next;
+    }
+    const double asyncJobs = 2.0 * static_cast<double>(previous) - 2.0;
+
+    std::printf("Empty jobs: %.1f ns each through Run, %.1f ns each through nested Async/Wait.\n",
+        runMs * 1e6 / jobCount, asyncMs * 1e6 / asyncJobs);
+
+    return Test::Finish();
+}
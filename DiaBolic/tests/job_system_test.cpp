@@ -0,0 +1,172 @@
+#include "test_common.hpp"
+
+#include "job_system.hpp"
+
+#include <random>
+
+// ParallelFor coverage, nested Async/Wait trees much deeper than there are workers, and the low priority queue: waits
+// outside a low priority job must leave it alone, waits inside one must help with it or nested builds would deadlock.
+namespace
+{
+    void TestParallelFor()
+    {
+        JobSystem& jobSystem = JobSystem::Get();
+        std::mt19937 random(1);
+
+        const uint32_t rounds = Test::IsQuick() ? 50 : 500;
+        for(uint32_t round = 0; round < rounds; ++round)
+        {
+            const size_t count = round < 4 ? round : std::uniform_int_distribution<size_t>(0, 20000)(random);
+            const size_t grainSize = std::uniform_int_distribution<size_t>(0, 300)(random);
+
+            std::vector<std::atomic<uint32_t>> visits(count);
+            std::atomic<bool> validChunks = true;
+            jobSystem.ParallelFor(count, grainSize, [&](size_t begin, size_t end) {
+                if(begin >= end || end > count || end - begin > std::max<size_t>(grainSize, 1))
+                {
+                    validChunks = false;
+                }
+                for(size_t i = begin; i < end; ++i)
+                {
+                    visits[i].fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+
+            CHECK(validChunks);
+            bool once = true;
+            for(const std::atomic<uint32_t>& visit : visits)
+            {
+                once &= visit.load() == 1;
+            }
+            CHECK(once);
+        }
+    }
+
+    // Every job starts two more and waits on them, so far more jobs wait than there are threads.
+    uint64_t Fibonacci(uint32_t n)
+    {
+        if(n < 2)
+        {
+            return n;
+        }
+        std::future<uint64_t> a = JobSystem::Get().Async([n]() { return Fibonacci(n - 1); });
+        std::future<uint64_t> b = JobSystem::Get().Async([n]() { return Fibonacci(n - 2); });
+        return JobSystem::Get().Wait(a) + JobSystem::Get().Wait(b);
+    }
+
+    void TestNestedAsync()
+    {
+        CHECK(Fibonacci(Test::IsQuick() ? 16 : 22) == (Test::IsQuick() ? 987u : 17711u));
+
+        // Counters shared by jobs that run jobs themselves.
+        JobSystem& jobSystem = JobSystem::Get();
+        std::atomic<uint32_t> leaves = 0;
+        JobSystem::Counter outer;
+        for(uint32_t i = 0; i < 64; ++i)
+        {
+            jobSystem.Run([&]() {
+                JobSystem::Counter inner;
+                for(uint32_t j = 0; j < 64; ++j)
+                {
+                    JobSystem::Get().Run([&]() { leaves.fetch_add(1, std::memory_order_relaxed); }, &inner);
+                }
+                JobSystem::Get().Wait(inner);
+            }, &outer);
+        }
+        jobSystem.Wait(outer);
+        CHECK(outer.IsDone());
+        CHECK(leaves == 64 * 64);
+
+        // Exceptions reach whoever waits.
+        std::future<int> failing = jobSystem.Async([]() -> int { throw std::runtime_error("expected"); });
+        bool thrown = false;
+        try
+        {
+            (void)jobSystem.Wait(failing);
+        }
+        catch(const std::runtime_error&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+
+    void TestLowPriority()
+    {
+        JobSystem& jobSystem = JobSystem::Get();
+        const uint64_t lowRunBefore = jobSystem.GetStats().lowPriorityJobsRun;
+
+        // Keep every worker busy so nobody but this thread could run the low priority job.
+        std::atomic<uint32_t> blockedWorkers = 0;
+        std::atomic<bool> release = false;
+        JobSystem::Counter blockers;
+        for(uint32_t i = 0; i < jobSystem.GetWorkerCount(); ++i)
+        {
+            jobSystem.Run([&]() {
+                blockedWorkers++;
+                while(!release)
+                {
+                    std::this_thread::yield();
+                }
+            }, &blockers);
+        }
+        while(blockedWorkers < jobSystem.GetWorkerCount())
+        {
+            std::this_thread::yield();
+        }
+
+        std::thread::id lowThread{};
+        JobSystem::Counter low;
+        jobSystem.Run([&]() { lowThread = std::this_thread::get_id(); }, &low, JobSystem::Priority::Low);
+
+        // A frame critical wait with nothing but the low priority job queued leaves it alone, a worker picks it up once
+        // it is free.
+        std::jthread releaser([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            release = true;
+        });
+        jobSystem.Wait(blockers);
+        jobSystem.Wait(low);
+        CHECK(lowThread != std::thread::id{} && lowThread != std::this_thread::get_id());
+
+        // Low priority jobs that wait on low priority jobs, more of them than there are workers. Without helping out
+        // inside a low priority job every worker would end up waiting.
+        std::atomic<uint32_t> children = 0;
+        std::vector<std::future<uint32_t>> builds;
+        const uint32_t buildCount = 4 * jobSystem.GetWorkerCount() + 4;
+        for(uint32_t i = 0; i < buildCount; ++i)
+        {
+            builds.push_back(jobSystem.Async([&children]() {
+                std::vector<std::future<uint32_t>> compiles;
+                for(uint32_t j = 0; j < 4; ++j)
+                {
+                    compiles.push_back(JobSystem::Get().Async([&children, j]() { children++; return j; }, JobSystem::Priority::Low));
+                }
+                uint32_t sum = 0;
+                for(std::future<uint32_t>& compile : compiles)
+                {
+                    sum += JobSystem::Get().Wait(compile);
+                }
+                return sum;
+            }, JobSystem::Priority::Low));
+        }
+        bool sums = true;
+        for(std::future<uint32_t>& build : builds)
+        {
+            sums &= jobSystem.Wait(build) == 0 + 1 + 2 + 3;
+        }
+        CHECK(sums);
+        CHECK(children == 4 * buildCount);
+        // Futures are ready before the job is counted, only the one waited on through a counter is surely in.
+        CHECK(jobSystem.GetStats().lowPriorityJobsRun > lowRunBefore);
+    }
+}
+
+int main()
+{
+    TestParallelFor();
+    TestNestedAsync();
+    TestLowPriority();
+
+    return Test::Finish();
+}
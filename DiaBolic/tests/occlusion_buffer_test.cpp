@@ -0,0 +1,167 @@
+#include "test_common.hpp"
+
+#include "occlusion_buffer.hpp"
+
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+// The software depth rasterizer against a plain reference: which pixels random triangles cover, that the depth they
+// write is conservative, and what IsVisible() makes of boxes in front of, behind and around an occluder.
+namespace
+{
+    using Culling::OcclusionBuffer;
+
+    // With an identity transform the positions are clip space already, w = 1.
+    const XMMATRIX IDENTITY = XMMatrixIdentity();
+
+    XMFLOAT2 PixelToNdc(float x, float y)
+    {
+        return XMFLOAT2(x / OcclusionBuffer::WIDTH * 2.0f - 1.0f, 1.0f - y / OcclusionBuffer::HEIGHT * 2.0f);
+    }
+
+    // Barycentric weights of a point in the triangle, in NDC.
+    XMFLOAT3 Barycentrics(const XMFLOAT2& p, const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2)
+    {
+        const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        const float w0 = ((v1.x - p.x) * (v2.y - p.y) - (v1.y - p.y) * (v2.x - p.x)) / area;
+        const float w1 = ((v2.x - p.x) * (v0.y - p.y) - (v2.y - p.y) * (v0.x - p.x)) / area;
+        return XMFLOAT3(w0, w1, 1.0f - w0 - w1);
+    }
+
+    void TestEmpty()
+    {
+        OcclusionBuffer buffer;
+        buffer.Finalize();
+        CHECK(buffer.GetDepth(0, 0) == 1.0f && buffer.GetDepth(OcclusionBuffer::WIDTH - 1, OcclusionBuffer::HEIGHT - 1) == 1.0f);
+
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 2.0f, 0.1f, 100.0f);
+        CHECK(buffer.IsVisible(Culling::Bounds{ .center = XMFLOAT3(0.0f, 0.0f, 50.0f), .extents = XMFLOAT3(1.0f, 1.0f, 1.0f) }, projection));
+    }
+
+    // Pixels clearly inside must be covered and clearly outside must not be, the ones on an edge can go either way.
+    void TestCoverage()
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> position(-1.2f, 1.2f);
+        std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+        const float edgeTolerance = 1e-3f;
+
+        const uint32_t triangles = Test::IsQuick() ? 200 : 5000;
+        for(uint32_t t = 0; t < triangles; ++t)
+        {
+            const std::vector<XMFLOAT3> positions = {
+                XMFLOAT3(position(random), position(random), depth(random)),
+                XMFLOAT3(position(random), position(random), depth(random)),
+                XMFLOAT3(position(random), position(random), depth(random)),
+            };
+            const float area = (positions[1].x - positions[0].x) * (positions[2].y - positions[0].y) -
+                (positions[1].y - positions[0].y) * (positions[2].x - positions[0].x);
+            if(std::abs(area) < 1e-3f)
+            {
+                continue;
+            }
+
+            OcclusionBuffer buffer;
+            buffer.RasterizeOccluder(positions, { 0, 1, 2 }, IDENTITY);
+            const float zMax = std::max({ positions[0].z, positions[1].z, positions[2].z });
+
+            for(uint32_t y = 0; y < OcclusionBuffer::HEIGHT; ++y)
+            {
+                for(uint32_t x = 0; x < OcclusionBuffer::WIDTH; ++x)
+                {
+                    const XMFLOAT3 weights = Barycentrics(PixelToNdc(x + 0.5f, y + 0.5f), positions[0], positions[1], positions[2]);
+                    const float nearestWeight = std::min({ weights.x, weights.y, weights.z });
+                    const float written = buffer.GetDepth(x, y);
+
+                    if(nearestWeight < -edgeTolerance)
+                    {
+                        CHECK(written == 1.0f);
+                    }
+                    else if(nearestWeight > edgeTolerance)
+                    {
+                        // The farthest depth inside the pixel, never nearer than at its center or farther than the
+                        // farthest vertex.
+                        const float center = weights.x * positions[0].z + weights.y * positions[1].z + weights.z * positions[2].z;
+                        CHECK(written >= center - 1e-4f);
+                        CHECK(written <= zMax + 1e-6f);
+                    }
+                }
+            }
+        }
+    }
+
+    // Both windings write the same pixels.
+    void TestWinding()
+    {
+        const std::vector<XMFLOAT3> positions = { XMFLOAT3(-0.5f, -0.5f, 0.5f), XMFLOAT3(0.5f, -0.5f, 0.5f), XMFLOAT3(0.0f, 0.5f, 0.5f) };
+        OcclusionBuffer clockwise, counterClockwise;
+        clockwise.RasterizeOccluder(positions, { 0, 2, 1 }, IDENTITY);
+        counterClockwise.RasterizeOccluder(positions, { 0, 1, 2 }, IDENTITY);
+
+        CHECK(clockwise.GetTriangleCount() == 1 && counterClockwise.GetTriangleCount() == 1);
+        bool same = true;
+        for(uint32_t y = 0; y < OcclusionBuffer::HEIGHT; ++y)
+        {
+            for(uint32_t x = 0; x < OcclusionBuffer::WIDTH; ++x)
+            {
+                same &= clockwise.GetDepth(x, y) == counterClockwise.GetDepth(x, y);
+            }
+        }
+        CHECK(same);
+        CHECK(clockwise.GetDepth(OcclusionBuffer::WIDTH / 2, OcclusionBuffer::HEIGHT / 2) < 1.0f);
+    }
+
+    // Nothing is clipped, triangles reaching behind the near plane are dropped.
+    void TestNearPlane()
+    {
+        OcclusionBuffer buffer;
+        buffer.RasterizeOccluder({ XMFLOAT3(-0.5f, -0.5f, -0.1f), XMFLOAT3(0.5f, -0.5f, 0.5f), XMFLOAT3(0.0f, 0.5f, 0.5f) }, { 0, 1, 2 }, IDENTITY);
+        CHECK(buffer.GetTriangleCount() == 0);
+        CHECK(buffer.GetDepth(OcclusionBuffer::WIDTH / 2, OcclusionBuffer::HEIGHT / 2) == 1.0f);
+    }
+
+    // A square wall facing the camera, which sits at the origin looking down +z.
+    void TestWall()
+    {
+        const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 2.0f, 0.1f, 100.0f);
+        const auto wall = [&](float halfSize) {
+            OcclusionBuffer buffer;
+            buffer.RasterizeOccluder({
+                    XMFLOAT3(-halfSize, -halfSize, 10.0f), XMFLOAT3(halfSize, -halfSize, 10.0f),
+                    XMFLOAT3(halfSize, halfSize, 10.0f), XMFLOAT3(-halfSize, halfSize, 10.0f),
+                }, { 0, 1, 2, 0, 2, 3 }, projection);
+            buffer.Finalize();
+            return buffer;
+        };
+        const auto box = [](float x, float y, float z, float extent) {
+            return Culling::Bounds{ .center = XMFLOAT3(x, y, z), .extents = XMFLOAT3(extent, extent, extent) };
+        };
+
+        const OcclusionBuffer large = wall(100.0f);
+        CHECK(large.GetTriangleCount() == 2);
+        CHECK(!large.IsVisible(box(0.0f, 0.0f, 50.0f, 1.0f), projection));
+        CHECK(!large.IsVisible(box(5.0f, -3.0f, 20.0f, 4.0f), projection));
+        CHECK(large.IsVisible(box(0.0f, 0.0f, 5.0f, 1.0f), projection)); // in front
+        CHECK(large.IsVisible(box(0.0f, 0.0f, 10.0f, 1.0f), projection)); // through the wall
+        CHECK(large.IsVisible(box(0.0f, 0.0f, -5.0f, 1.0f), projection)); // behind the camera
+
+        // Only covers the middle of the screen, boxes that reach around it are visible.
+        const OcclusionBuffer small = wall(1.0f);
+        CHECK(!small.IsVisible(box(0.0f, 0.0f, 50.0f, 1.0f), projection));
+        CHECK(small.IsVisible(box(0.0f, 0.0f, 50.0f, 20.0f), projection));
+        CHECK(small.IsVisible(box(10.0f, 0.0f, 50.0f, 1.0f), projection));
+    }
+}
+
+int main()
+{
+    TestEmpty();
+    TestCoverage();
+    TestWinding();
+    TestNearPlane();
+    TestWall();
+
+    return Test::Finish();
+}
@@ -0,0 +1,354 @@
+#include "test_common.hpp"
+
+#include "utility/pipeline_hash.hpp"
+
+#include <functional>
+
+// Equal pipeline descriptions built from different memory, with different padding and different values in what the
+// description disables, hash the same. Changing any field that reaches the driver, or any byte of any shader, changes it.
+namespace
+{
+    // A description together with everything it points to, rebuilt from scratch every time.
+    struct Description
+    {
+        // VS, PS, DS, HS, GS
+        std::array<std::vector<uint8_t>, 5> shaders;
+        std::vector<std::string> inputSemantics;
+        std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements;
+        std::vector<std::string> streamOutputSemantics;
+        std::vector<D3D12_SO_DECLARATION_ENTRY> streamOutputEntries;
+        std::vector<UINT> streamOutputStrides;
+        uint64_t rootSignatureHash = 0;
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+
+        uint64_t Hash()
+        {
+            D3D12_SHADER_BYTECODE* stages[] = { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS };
+            for(size_t i = 0; i < shaders.size(); ++i)
+            {
+                stages[i]->pShaderBytecode = shaders[i].empty() ? nullptr : shaders[i].data();
+                stages[i]->BytecodeLength = shaders[i].size();
+            }
+            for(size_t i = 0; i < inputElements.size(); ++i)
+            {
+                inputElements[i].SemanticName = inputSemantics[i].c_str();
+            }
+            for(size_t i = 0; i < streamOutputEntries.size(); ++i)
+            {
+                streamOutputEntries[i].SemanticName = streamOutputSemantics[i].c_str();
+            }
+            desc.InputLayout = { inputElements.data(), static_cast<UINT>(inputElements.size()) };
+            desc.StreamOutput.pSODeclaration = streamOutputEntries.data();
+            desc.StreamOutput.NumEntries = static_cast<UINT>(streamOutputEntries.size());
+            desc.StreamOutput.pBufferStrides = streamOutputStrides.empty() ? nullptr : streamOutputStrides.data();
+            desc.StreamOutput.NumStrides = static_cast<UINT>(streamOutputStrides.size());
+            return Util::HashGraphicsPipelineDesc(desc, rootSignatureHash);
+        }
+    };
+
+    D3D12_INPUT_ELEMENT_DESC MakeInputElement(DXGI_FORMAT format, UINT slot, uint8_t fill)
+    {
+        D3D12_INPUT_ELEMENT_DESC element;
+        std::memset(&element, fill, sizeof(element));
+        element.SemanticIndex = 0;
+        element.Format = format;
+        element.InputSlot = slot;
+        element.AlignedByteOffset = 0;
+        element.InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+        element.InstanceDataStepRate = 0;
+        return element;
+    }
+
+    D3D12_RENDER_TARGET_BLEND_DESC MakeBlend(D3D12_BLEND source, D3D12_BLEND destination)
+    {
+        return D3D12_RENDER_TARGET_BLEND_DESC{ TRUE, FALSE, source, destination, D3D12_BLEND_OP_ADD, D3D12_BLEND_ONE, D3D12_BLEND_ZERO,
+                                               D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL };
+    }
+
+    // Every stage and every optional part is in use, so each can be changed. Bytes the hash has to ignore are set to fill.
+    Description MakeDescription(uint8_t fill)
+    {
+        Description description;
+        for(size_t i = 0; i < description.shaders.size(); ++i)
+        {
+            description.shaders[i].resize(64 + i * 16);
+            for(size_t j = 0; j < description.shaders[i].size(); ++j)
+            {
+                description.shaders[i][j] = static_cast<uint8_t>(i * 31 + j * 7);
+            }
+        }
+
+        description.inputSemantics = { "POSITION", "NORMAL", "TEXCOORD" };
+        description.inputElements = { MakeInputElement(DXGI_FORMAT_R32G32B32_FLOAT, 0, fill), MakeInputElement(DXGI_FORMAT_R32G32B32_FLOAT, 1, fill),
+                                      MakeInputElement(DXGI_FORMAT_R32G32_FLOAT, 2, fill) };
+
+        D3D12_SO_DECLARATION_ENTRY streamOutputEntry;
+        std::memset(&streamOutputEntry, fill, sizeof(streamOutputEntry));
+        streamOutputEntry.Stream = 0;
+        streamOutputEntry.SemanticIndex = 0;
+        streamOutputEntry.StartComponent = 0;
+        streamOutputEntry.ComponentCount = 4;
+        streamOutputEntry.OutputSlot = 0;
+        description.streamOutputSemantics = { "SV_POSITION" };
+        description.streamOutputEntries = { streamOutputEntry };
+        description.streamOutputStrides = { 16 };
+        description.rootSignatureHash = 0x0123456789abcdef;
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc = description.desc;
+        std::memset(&desc, fill, sizeof(desc));
+        desc.pRootSignature = nullptr;
+        desc.StreamOutput.RasterizedStream = 0;
+
+        desc.BlendState.AlphaToCoverageEnable = FALSE;
+        desc.BlendState.IndependentBlendEnable = TRUE;
+        desc.BlendState.RenderTarget[0] = MakeBlend(D3D12_BLEND_SRC_ALPHA, D3D12_BLEND_INV_SRC_ALPHA);
+        desc.BlendState.RenderTarget[1] = MakeBlend(D3D12_BLEND_ONE, D3D12_BLEND_ONE);
+        desc.SampleMask = 0xffffffff;
+
+        desc.RasterizerState = D3D12_RASTERIZER_DESC{ D3D12_FILL_MODE_SOLID, D3D12_CULL_MODE_BACK, FALSE, 0, 0.0f, 0.0f, TRUE, FALSE, FALSE, 0,
+                                                      D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF };
+
+        const D3D12_DEPTH_STENCILOP_DESC stencilOp = { D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_COMPARISON_FUNC_ALWAYS };
+        desc.DepthStencilState.DepthEnable = TRUE;
+        desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+        desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+        desc.DepthStencilState.StencilEnable = TRUE;
+        desc.DepthStencilState.StencilReadMask = 0xff;
+        desc.DepthStencilState.StencilWriteMask = 0xff;
+        desc.DepthStencilState.FrontFace = stencilOp;
+        desc.DepthStencilState.BackFace = stencilOp;
+
+        desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+        desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        desc.NumRenderTargets = 2;
+        desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.RTVFormats[1] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+        desc.SampleDesc = { 1, 0 };
+        desc.NodeMask = 0;
+        desc.CachedPSO = { nullptr, 0 };
+        desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+        return description;
+    }
+
+    struct Change
+    {
+        const char* name;
+        std::function<void(Description&)> apply;
+    };
+
+    void TestEquivalentDescriptions()
+    {
+        Description description = MakeDescription(0x00);
+        const uint64_t hash = description.Hash();
+
+        // Other memory, other padding and other values in the unused render target slots.
+        Description copy = MakeDescription(0xab);
+        CHECK(copy.Hash() == hash);
+
+        const std::vector<Change> ignored = {
+            { "root signature pointer", [](Description& d) { d.desc.pRootSignature = reinterpret_cast<ID3D12RootSignature*>(uintptr_t(0x1000)); } },
+            { "format past NumRenderTargets", [](Description& d) { d.desc.RTVFormats[2] = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; } },
+            { "blend past NumRenderTargets", [](Description& d) { d.desc.BlendState.RenderTarget[2].SrcBlend = D3D12_BLEND_ZERO; } },
+            { "cached PSO", [](Description& d) {
+                static const uint8_t blob[16] = {};
+                d.desc.CachedPSO = { blob, sizeof(blob) };
+            } },
+        };
+        for(const Change& change : ignored)
+        {
+            Description changed = MakeDescription(0x00);
+            change.apply(changed);
+            if(changed.Hash() != hash)
+            {
+                CHECK(!"Ignored change changed the hash");
+                std::fprintf(stderr, "  %s\n", change.name);
+            }
+        }
+
+        // Without independent blending only the first target's blend state counts.
+        Description shared = MakeDescription(0x00);
+        shared.desc.BlendState.IndependentBlendEnable = FALSE;
+        const uint64_t sharedHash = shared.Hash();
+        shared.desc.BlendState.RenderTarget[1].DestBlend = D3D12_BLEND_ZERO;
+        CHECK(shared.Hash() == sharedHash);
+        shared.desc.BlendState.RenderTarget[0].DestBlend = D3D12_BLEND_ZERO;
+        CHECK(shared.Hash() != sharedHash);
+    }
+
+    std::vector<Change> MakeShaderChanges()
+    {
+        static const char* const STAGES[] = { "VS", "PS", "DS", "HS", "GS" };
+        std::vector<Change> changes;
+        for(size_t stage = 0; stage < 5; ++stage)
+        {
+            changes.push_back({ STAGES[stage], [stage](Description& d) { d.shaders[stage].back() ^= 1; } });
+            changes.push_back({ STAGES[stage], [stage](Description& d) { d.shaders[stage][0] ^= 0x80; } });
+            changes.push_back({ STAGES[stage], [stage](Description& d) { d.shaders[stage].push_back(0); } });
+            changes.push_back({ STAGES[stage], [stage](Description& d) { d.shaders[stage].pop_back(); } });
+            changes.push_back({ STAGES[stage], [stage](Description& d) { d.shaders[stage].clear(); } });
+        }
+        // The same bytecode in another stage is another pipeline.
+        changes.push_back({ "VS and PS swapped", [](Description& d) { std::swap(d.shaders[0], d.shaders[1]); } });
+        return changes;
+    }
+
+    std::vector<Change> MakeBlendChanges(uint32_t target)
+    {
+        const auto blend = [target](Description& d) -> D3D12_RENDER_TARGET_BLEND_DESC& { return d.desc.BlendState.RenderTarget[target]; };
+        return {
+            { "BlendEnable", [=](Description& d) { blend(d).BlendEnable = FALSE; } },
+            { "LogicOpEnable", [=](Description& d) { blend(d).LogicOpEnable = TRUE; } },
+            { "SrcBlend", [=](Description& d) { blend(d).SrcBlend = D3D12_BLEND_ZERO; } },
+            { "DestBlend", [=](Description& d) { blend(d).DestBlend = D3D12_BLEND_SRC_ALPHA; } },
+            { "BlendOp", [=](Description& d) { blend(d).BlendOp = D3D12_BLEND_OP_SUBTRACT; } },
+            { "SrcBlendAlpha", [=](Description& d) { blend(d).SrcBlendAlpha = D3D12_BLEND_SRC_ALPHA; } },
+            { "DestBlendAlpha", [=](Description& d) { blend(d).DestBlendAlpha = D3D12_BLEND_ONE; } },
+            { "BlendOpAlpha", [=](Description& d) { blend(d).BlendOpAlpha = D3D12_BLEND_OP_MAX; } },
+            { "LogicOp", [=](Description& d) { blend(d).LogicOp = D3D12_LOGIC_OP_CLEAR; } },
+            { "RenderTargetWriteMask", [=](Description& d) { blend(d).RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_RED; } },
+        };
+    }
+
+    std::vector<Change> MakeStencilChanges(bool front)
+    {
+        const auto stencil = [front](Description& d) -> D3D12_DEPTH_STENCILOP_DESC& {
+            return front ? d.desc.DepthStencilState.FrontFace : d.desc.DepthStencilState.BackFace;
+        };
+        return {
+            { "StencilFailOp", [=](Description& d) { stencil(d).StencilFailOp = D3D12_STENCIL_OP_ZERO; } },
+            { "StencilDepthFailOp", [=](Description& d) { stencil(d).StencilDepthFailOp = D3D12_STENCIL_OP_ZERO; } },
+            { "StencilPassOp", [=](Description& d) { stencil(d).StencilPassOp = D3D12_STENCIL_OP_REPLACE; } },
+            { "StencilFunc", [=](Description& d) { stencil(d).StencilFunc = D3D12_COMPARISON_FUNC_EQUAL; } },
+        };
+    }
+
+    std::vector<Change> MakeFieldChanges()
+    {
+        std::vector<Change> changes = {
+            { "root signature", [](Description& d) { d.rootSignatureHash ^= 1; } },
+
+            { "SO Stream", [](Description& d) { d.streamOutputEntries[0].Stream = 1; } },
+            { "SO SemanticName", [](Description& d) { d.streamOutputSemantics[0] = "TEXCOORD"; } },
+            { "SO SemanticIndex", [](Description& d) { d.streamOutputEntries[0].SemanticIndex = 1; } },
+            { "SO StartComponent", [](Description& d) { d.streamOutputEntries[0].StartComponent = 1; } },
+            { "SO ComponentCount", [](Description& d) { d.streamOutputEntries[0].ComponentCount = 3; } },
+            { "SO OutputSlot", [](Description& d) { d.streamOutputEntries[0].OutputSlot = 1; } },
+            { "SO NumEntries", [](Description& d) {
+                d.streamOutputEntries.push_back(d.streamOutputEntries[0]);
+                d.streamOutputSemantics.push_back(d.streamOutputSemantics[0]);
+            } },
+            { "SO stride", [](Description& d) { d.streamOutputStrides[0] = 32; } },
+            { "SO NumStrides", [](Description& d) { d.streamOutputStrides.push_back(16); } },
+            { "SO RasterizedStream", [](Description& d) { d.desc.StreamOutput.RasterizedStream = 1; } },
+
+            { "AlphaToCoverageEnable", [](Description& d) { d.desc.BlendState.AlphaToCoverageEnable = TRUE; } },
+            { "IndependentBlendEnable", [](Description& d) { d.desc.BlendState.IndependentBlendEnable = FALSE; } },
+            { "SampleMask", [](Description& d) { d.desc.SampleMask = 0xfffffffe; } },
+
+            { "FillMode", [](Description& d) { d.desc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME; } },
+            { "CullMode", [](Description& d) { d.desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; } },
+            { "FrontCounterClockwise", [](Description& d) { d.desc.RasterizerState.FrontCounterClockwise = TRUE; } },
+            { "DepthBias", [](Description& d) { d.desc.RasterizerState.DepthBias = -1; } },
+            { "DepthBiasClamp", [](Description& d) { d.desc.RasterizerState.DepthBiasClamp = 0.5f; } },
+            { "SlopeScaledDepthBias", [](Description& d) { d.desc.RasterizerState.SlopeScaledDepthBias = 2.0f; } },
+            { "DepthClipEnable", [](Description& d) { d.desc.RasterizerState.DepthClipEnable = FALSE; } },
+            { "MultisampleEnable", [](Description& d) { d.desc.RasterizerState.MultisampleEnable = TRUE; } },
+            { "AntialiasedLineEnable", [](Description& d) { d.desc.RasterizerState.AntialiasedLineEnable = TRUE; } },
+            { "ForcedSampleCount", [](Description& d) { d.desc.RasterizerState.ForcedSampleCount = 4; } },
+            { "ConservativeRaster", [](Description& d) { d.desc.RasterizerState.ConservativeRaster = D3D12_CONSERVATIVE_RASTERIZATION_MODE_ON; } },
+
+            { "DepthEnable", [](Description& d) { d.desc.DepthStencilState.DepthEnable = FALSE; } },
+            { "DepthWriteMask", [](Description& d) { d.desc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO; } },
+            { "DepthFunc", [](Description& d) { d.desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER; } },
+            { "StencilEnable", [](Description& d) { d.desc.DepthStencilState.StencilEnable = FALSE; } },
+            { "StencilReadMask", [](Description& d) { d.desc.DepthStencilState.StencilReadMask = 0x0f; } },
+            { "StencilWriteMask", [](Description& d) { d.desc.DepthStencilState.StencilWriteMask = 0x0f; } },
+
+            { "input SemanticName", [](Description& d) { d.inputSemantics[1] = "TANGENT"; } },
+            { "input SemanticIndex", [](Description& d) { d.inputElements[1].SemanticIndex = 1; } },
+            { "input Format", [](Description& d) { d.inputElements[1].Format = DXGI_FORMAT_R32G32B32A32_FLOAT; } },
+            { "input InputSlot", [](Description& d) { d.inputElements[1].InputSlot = 3; } },
+            { "input AlignedByteOffset", [](Description& d) { d.inputElements[1].AlignedByteOffset = 12; } },
+            { "input InputSlotClass", [](Description& d) {
+                d.inputElements[1].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA;
+                d.inputElements[1].InstanceDataStepRate = 0;
+            } },
+            { "input InstanceDataStepRate", [](Description& d) { d.inputElements[1].InstanceDataStepRate = 1; } },
+            { "input NumElements", [](Description& d) {
+                d.inputElements.pop_back();
+                d.inputSemantics.pop_back();
+            } },
+            { "input order", [](Description& d) {
+                std::swap(d.inputElements[0], d.inputElements[2]);
+                std::swap(d.inputSemantics[0], d.inputSemantics[2]);
+            } },
+
+            { "IBStripCutValue", [](Description& d) { d.desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_0xFFFF; } },
+            { "PrimitiveTopologyType", [](Description& d) { d.desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE; } },
+            { "NumRenderTargets", [](Description& d) { d.desc.NumRenderTargets = 1; } },
+            { "RTVFormats[0]", [](Description& d) { d.desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; } },
+            { "RTVFormats[1]", [](Description& d) { d.desc.RTVFormats[1] = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; } },
+            { "DSVFormat", [](Description& d) { d.desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT; } },
+            { "SampleDesc.Count", [](Description& d) { d.desc.SampleDesc.Count = 4; } },
+            { "SampleDesc.Quality", [](Description& d) { d.desc.SampleDesc.Quality = 1; } },
+            { "NodeMask", [](Description& d) { d.desc.NodeMask = 1; } },
+            { "Flags", [](Description& d) { d.desc.Flags = D3D12_PIPELINE_STATE_FLAG_TOOL_DEBUG; } },
+        };
+
+        for(uint32_t target = 0; target < 2; ++target)
+        {
+            for(Change& change : MakeBlendChanges(target))
+            {
+                changes.push_back(std::move(change));
+            }
+        }
+        for(const bool front : { true, false })
+        {
+            for(Change& change : MakeStencilChanges(front))
+            {
+                changes.push_back(std::move(change));
+            }
+        }
+        return changes;
+    }
+
+    // Every change has to move the hash away from the original and from every other change.
+    void CheckChanges(const std::vector<Change>& changes)
+    {
+        Description original = MakeDescription(0x00);
+        std::vector<uint64_t> hashes = { original.Hash() };
+        for(const Change& change : changes)
+        {
+            Description changed = MakeDescription(0x00);
+            change.apply(changed);
+            const uint64_t hash = changed.Hash();
+            if(std::find(hashes.begin(), hashes.end(), hash) != hashes.end())
+            {
+                CHECK(!"Change didn't change the hash");
+                std::fprintf(stderr, "  %s\n", change.name);
+            }
+            hashes.push_back(hash);
+        }
+    }
+
+    void TestShaderChanges()
+    {
+        CheckChanges(MakeShaderChanges());
+    }
+
+    void TestFieldChanges()
+    {
+        CheckChanges(MakeFieldChanges());
+    }
+}
+
+int main()
+{
+    TestEquivalentDescriptions();
+    TestShaderChanges();
+    TestFieldChanges();
+
+    return Test::Finish();
+}
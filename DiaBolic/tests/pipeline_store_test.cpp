@@ -0,0 +1,144 @@
+#include "test_common.hpp"
+
+#include "utility/pipeline_store.hpp"
+
+#include <random>
+
+// Sharing, owners and replacement with shared_ptr standing in for the pipeline states, then random acquires, inserts
+// and releases checked against a count of owners per key. Validate() after every step.
+namespace
+{
+    using Store = Util::PipelineStore<std::shared_ptr<int>>;
+
+    void TestSharing()
+    {
+        Store store;
+        CHECK(store.Acquire(1) == nullptr);
+
+        bool inserted = false;
+        std::shared_ptr<int> first = store.Insert(1, std::make_shared<int>(1), inserted);
+        CHECK(inserted && store.GetOwners(1) == 1);
+        CHECK(store.Acquire(1) == first && store.GetOwners(1) == 2);
+
+        // Two threads compiled the same pipeline, both get the one stored first.
+        std::weak_ptr<int> loser;
+        {
+            std::shared_ptr<int> second = std::make_shared<int>(1);
+            loser = second;
+            CHECK(store.Insert(1, second, inserted) == first && !inserted);
+        }
+        CHECK(loser.expired());
+        CHECK(store.GetOwners(1) == 3 && store.GetCount() == 1);
+        CHECK(store.Validate());
+
+        // Kept while anyone owns it.
+        const std::weak_ptr<int> stored = first;
+        first.reset();
+        CHECK(!store.Release(stored.lock().get()));
+        CHECK(!store.Release(stored.lock().get()));
+        CHECK(!stored.expired());
+        CHECK(store.Release(stored.lock().get()));
+        CHECK(stored.expired());
+        CHECK(store.GetCount() == 0 && store.GetOwners(1) == 0 && store.Acquire(1) == nullptr);
+        CHECK(store.Validate());
+    }
+
+    void TestReplacement()
+    {
+        Store store;
+        bool inserted = false;
+        std::shared_ptr<int> pipeline = store.Insert(1, std::make_shared<int>(1), inserted);
+
+        // A reload that hashes the same, eg. an edited include the shader doesn't use: the new one is acquired before
+        // the old one is released, so it's never recreated.
+        std::shared_ptr<int> reloaded = store.Acquire(1);
+        CHECK(!store.Release(pipeline.get()));
+        CHECK(reloaded == pipeline && store.GetOwners(1) == 1);
+
+        // A real change stores the new pipeline and lets go of the old one.
+        const std::weak_ptr<int> old = reloaded;
+        pipeline.reset();
+        std::shared_ptr<int> changed = store.Insert(2, std::make_shared<int>(2), inserted);
+        CHECK(inserted);
+        CHECK(store.Release(reloaded.get()));
+        reloaded.reset();
+        CHECK(old.expired());
+        CHECK(store.GetCount() == 1 && store.GetOwners(2) == 1);
+
+        // Released and created again, the key is free to be stored under once more.
+        CHECK(store.Release(changed.get()));
+        changed = store.Insert(2, std::make_shared<int>(2), inserted);
+        CHECK(inserted && store.GetOwners(2) == 1);
+        CHECK(store.Validate());
+    }
+
+    void TestRandomOperations()
+    {
+        std::mt19937 random(39);
+        const uint32_t operations = Test::IsQuick() ? 20000 : 200000;
+        constexpr uint64_t KEY_COUNT = 32;
+
+        Store store;
+        std::vector<uint32_t> owners(KEY_COUNT, 0);
+        // One entry per owner, like the pipelines the renderer holds.
+        std::vector<std::shared_ptr<int>> held;
+        bool valid = true;
+        for(uint32_t i = 0; i < operations && valid; ++i)
+        {
+            const uint64_t key = random() % KEY_COUNT;
+            const uint32_t kind = random() % 3;
+            if(kind == 0 || held.empty())
+            {
+                // What GetGraphicsPipeline does: look up, else create and store.
+                std::shared_ptr<int> pipeline = store.Acquire(key);
+                if(!pipeline)
+                {
+                    bool inserted = false;
+                    pipeline = store.Insert(key, std::make_shared<int>(static_cast<int>(key)), inserted);
+                    valid &= inserted;
+                }
+                valid &= *pipeline == static_cast<int>(key);
+                owners[key]++;
+                held.push_back(std::move(pipeline));
+            }
+            else if(kind == 1)
+            {
+                // Another thread got there first.
+                bool inserted = false;
+                const std::shared_ptr<int> pipeline = store.Insert(key, std::make_shared<int>(static_cast<int>(key)), inserted);
+                valid &= inserted == (owners[key] == 0);
+                owners[key]++;
+                held.push_back(pipeline);
+            }
+            else
+            {
+                const size_t index = random() % held.size();
+                const uint64_t heldKey = static_cast<uint64_t>(*held[index]);
+                const bool last = store.Release(held[index].get());
+                owners[heldKey]--;
+                valid &= last == (owners[heldKey] == 0);
+                held[index] = std::move(held.back());
+                held.pop_back();
+            }
+
+            size_t storedCount = 0;
+            for(uint64_t k = 0; k < KEY_COUNT; ++k)
+            {
+                valid &= store.GetOwners(k) == owners[k];
+                storedCount += owners[k] > 0 ? 1 : 0;
+            }
+            valid &= store.GetCount() == storedCount;
+            valid &= store.Validate();
+        }
+        CHECK(valid);
+    }
+}
+
+int main()
+{
+    TestSharing();
+    TestReplacement();
+    TestRandomOperations();
+
+    return Test::Finish();
+}
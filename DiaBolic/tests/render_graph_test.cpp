@@ -0,0 +1,357 @@
+#include "test_common.hpp"
+
+#include "utility/render_graph_compiler.hpp"
+
+#include <random>
+
+// Barrier placement and transient aliasing on small graphs with known answers, then random graphs played back against
+// a simulated GPU: every access has to find the resource in its state, split transitions have to begin and end in one
+// command list, and transients alive at the same time must never share memory.
+namespace
+{
+    using Util::RenderGraphCompiler;
+    using Barrier = RenderGraphCompiler::Barrier;
+
+    constexpr RenderGraphCompiler::States RT = RenderGraphCompiler::STATE_RENDER_TARGET;
+    constexpr RenderGraphCompiler::States PSR = RenderGraphCompiler::STATE_PIXEL_SHADER_RESOURCE;
+    constexpr RenderGraphCompiler::States UAV = RenderGraphCompiler::STATE_UNORDERED_ACCESS;
+
+    constexpr uint64_t MB = 1024 * 1024;
+
+    RenderGraphCompiler::AllocationFunction FixedSize(uint64_t size)
+    {
+        return [size](RenderGraphCompiler::ResourceId) { return RenderGraphCompiler::Allocation{ .size = size }; };
+    }
+
+    uint32_t CountBarriers(const RenderGraphCompiler& graph, uint32_t pass, Barrier::Type type, Barrier::Split split = Barrier::Split::None)
+    {
+        uint32_t count = 0;
+        for(const Barrier& barrier : graph.GetBarriers(pass))
+        {
+            count += barrier.type == type && barrier.split == split ? 1u : 0u;
+        }
+        return count;
+    }
+
+    // Written in pass 0, read in pass 2, pass 1 leaves it alone. The transition to PSR can start after pass 0 but both
+    // halves have to be recorded into the same list.
+    void TestSplitTransitions()
+    {
+        struct Case
+        {
+            uint32_t lists[3];
+            uint32_t splits;
+        };
+        // The reader's list runs after the writer's, an idle pass in the reader's list can begin it as well.
+        for(const Case& test : { Case{ { 0, 0, 0 }, 1 }, Case{ { 0, 1, 2 }, 0 }, Case{ { 0, 0, 1 }, 0 }, Case{ { 0, 1, 1 }, 1 } })
+        {
+            RenderGraphCompiler graph;
+            const auto texture = graph.ImportResource("Texture", PSR, PSR);
+            const auto other = graph.ImportResource("Other", RT, RT);
+            const auto write = graph.AddPass("Write", test.lists[0]);
+            const auto idle = graph.AddPass("Idle", test.lists[1]);
+            const auto read = graph.AddPass("Read", test.lists[2]);
+            graph.Write(write, texture, RT);
+            graph.Write(idle, other, RT);
+            graph.Read(read, texture, PSR);
+            graph.Compile(FixedSize(MB));
+
+            const RenderGraphCompiler::Stats& stats = graph.GetStats();
+            CHECK(stats.transitionCount == 2);
+            CHECK(stats.splitTransitionCount == test.splits);
+            if(test.splits > 0)
+            {
+                CHECK(CountBarriers(graph, idle, Barrier::Type::Transition, Barrier::Split::Begin) == 1);
+                CHECK(CountBarriers(graph, read, Barrier::Type::Transition, Barrier::Split::End) == 1);
+            }
+            else
+            {
+                // One full transition right where it is needed.
+                CHECK(CountBarriers(graph, read, Barrier::Type::Transition) == 1);
+                CHECK(graph.GetBarriers(idle).empty());
+            }
+        }
+
+        // The end of the frame never splits, its barriers get a list of their own.
+        RenderGraphCompiler frame;
+        const auto backBuffer = frame.ImportResource("Back buffer", 0, 0);
+        const auto draw = frame.AddPass("Draw", 0);
+        frame.AddPass("Idle", 0);
+        frame.Write(draw, backBuffer, RT);
+        frame.Compile(FixedSize(MB));
+        CHECK(frame.GetStats().splitTransitionCount == 0);
+        CHECK(CountBarriers(frame, frame.GetPassCount(), Barrier::Type::Transition) == 1);
+
+        // Imported resources no pass uses still end the frame in their final state.
+        RenderGraphCompiler unused;
+        const auto texture = unused.ImportResource("Texture", PSR, RenderGraphCompiler::STATE_COMMON);
+        unused.AddPass("Empty", 0);
+        unused.Compile(FixedSize(MB));
+        CHECK(unused.GetBarriers(unused.GetPassCount()).size() == 1);
+        CHECK(unused.GetBarriers(unused.GetPassCount())[0].resource == texture);
+    }
+
+    void TestAliasing()
+    {
+        // A lives in passes 0-1, C in 1-2 and B in 2-3. A and B can share memory, C needs its own.
+        RenderGraphCompiler graph;
+        const auto a = graph.CreateTexture("A", true);
+        const auto b = graph.CreateTexture("B", true);
+        const auto c = graph.CreateTexture("C", true);
+        const auto unused = graph.CreateTexture("Unused", true);
+        const auto backBuffer = graph.ImportResource("Back buffer", 0, 0);
+        RenderGraphCompiler::PassId passes[4];
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            passes[i] = graph.AddPass("Pass " + std::to_string(i), i);
+        }
+        graph.Write(passes[0], a, RT);
+        graph.Read(passes[1], a, PSR);
+        graph.Write(passes[1], c, RT);
+        graph.Read(passes[2], c, PSR);
+        graph.Write(passes[2], b, RT);
+        graph.Read(passes[3], b, PSR);
+        graph.Write(passes[3], backBuffer, RT);
+        graph.Compile(FixedSize(MB));
+
+        const RenderGraphCompiler::Stats& stats = graph.GetStats();
+        CHECK(stats.transientCount == 3);
+        CHECK(stats.transientBytes == 3 * MB);
+        CHECK(stats.heapBytes == 2 * MB);
+        CHECK(graph.GetHeaps().size() == 1);
+        CHECK(!graph.IsUsed(unused));
+
+        const RenderGraphCompiler::Placement placementA = graph.GetPlacement(a);
+        const RenderGraphCompiler::Placement placementB = graph.GetPlacement(b);
+        const RenderGraphCompiler::Placement placementC = graph.GetPlacement(c);
+        CHECK(placementA.offset == placementB.offset);
+        CHECK(placementC.offset != placementA.offset);
+
+        // Only the two sharing memory need aliasing barriers, and discards as render targets.
+        CHECK(stats.aliasingBarrierCount == 2);
+        CHECK(CountBarriers(graph, passes[0], Barrier::Type::Aliasing) == 1);
+        CHECK(CountBarriers(graph, passes[2], Barrier::Type::Aliasing) == 1);
+        CHECK(CountBarriers(graph, passes[1], Barrier::Type::Aliasing) == 0);
+        CHECK(graph.GetDiscards(passes[0]) == std::vector<RenderGraphCompiler::ResourceId>{ a });
+        CHECK(graph.GetDiscards(passes[2]) == std::vector<RenderGraphCompiler::ResourceId>{ b });
+        CHECK(graph.GetDiscards(passes[1]).empty());
+
+        // Transients start every frame in the state the last one left them in, so nothing transitions at the end.
+        CHECK(graph.GetInitialState(a) == PSR);
+        CHECK(CountBarriers(graph, graph.GetPassCount(), Barrier::Type::Transition) == 1);
+        // One call per pass, and one for the back buffer at the end.
+        CHECK(stats.barrierCalls == 5);
+    }
+
+    void TestHeapClassesAndUav()
+    {
+        RenderGraphCompiler graph;
+        const auto target = graph.CreateTexture("Target", true);
+        const auto buffer = graph.CreateTexture("UAV texture", false);
+        const auto first = graph.AddPass("First", 0);
+        const auto second = graph.AddPass("Second", 0);
+        const auto third = graph.AddPass("Third", 0);
+        graph.Write(first, target, RT);
+        graph.Write(first, buffer, UAV);
+        graph.Write(second, buffer, UAV);
+        graph.Read(third, target, PSR);
+        graph.Read(third, buffer, PSR);
+        graph.Compile([](RenderGraphCompiler::ResourceId resource) {
+            return RenderGraphCompiler::Allocation{ .size = (resource + 1) * MB, .alignment = 4 * MB };
+        });
+
+        // Render targets can't share a heap with other textures.
+        CHECK(graph.GetHeaps().size() == 2);
+        CHECK(graph.GetPlacement(target).heap != graph.GetPlacement(buffer).heap);
+        for(const RenderGraphCompiler::Heap& heap : graph.GetHeaps())
+        {
+            CHECK(heap.alignment == 4 * MB);
+        }
+        CHECK(graph.GetStats().aliasingBarrierCount == 0);
+
+        // Back to back UAV writes need a UAV barrier between them, nothing else.
+        CHECK(graph.GetStats().uavBarrierCount == 1);
+        CHECK(CountBarriers(graph, second, Barrier::Type::Uav) == 1);
+        // The target is idle in the second pass and all three share a list, going to PSR splits.
+        CHECK(CountBarriers(graph, second, Barrier::Type::Transition, Barrier::Split::Begin) == 1);
+    }
+
+    // Random passes over random resources, then the frame replayed the way the GPU would run it.
+    void TestRandomGraphs()
+    {
+        constexpr RenderGraphCompiler::States READS[] = { PSR, RenderGraphCompiler::STATE_NON_PIXEL_SHADER_RESOURCE,
+            RenderGraphCompiler::STATE_COPY_SOURCE, RenderGraphCompiler::STATE_DEPTH_READ };
+        constexpr RenderGraphCompiler::States WRITES[] = { RT, UAV, RenderGraphCompiler::STATE_DEPTH_WRITE,
+            RenderGraphCompiler::STATE_COPY_DEST };
+
+        std::mt19937 random(47);
+        const uint32_t rounds = Test::IsQuick() ? 200 : 5000;
+        uint64_t splits = 0;
+        uint64_t savedBytes = 0;
+        for(uint32_t round = 0; round < rounds; ++round)
+        {
+            RenderGraphCompiler graph;
+            const uint32_t resourceCount = std::uniform_int_distribution<uint32_t>(1, 8)(random);
+            const uint32_t passCount = std::uniform_int_distribution<uint32_t>(1, 10)(random);
+            std::vector<RenderGraphCompiler::States> finalStates(resourceCount);
+            for(uint32_t i = 0; i < resourceCount; ++i)
+            {
+                if(random() % 2)
+                {
+                    const RenderGraphCompiler::States state = random() % 2 ? READS[random() % 4] : WRITES[random() % 4];
+                    finalStates[i] = random() % 2 ? state : RenderGraphCompiler::STATE_COMMON;
+                    graph.ImportResource("Imported", state, finalStates[i]);
+                }
+                else
+                {
+                    graph.CreateTexture("Transient", random() % 2);
+                }
+            }
+
+            uint32_t list = 0;
+            std::vector<bool> written(resourceCount);
+            for(uint32_t pass = 0; pass < passCount; ++pass)
+            {
+                list += random() % 3 == 0 ? 1 : 0;
+                graph.AddPass("Pass", list);
+                for(uint32_t i = 0; i < resourceCount; ++i)
+                {
+                    if(random() % 3 != 0)
+                    {
+                        continue;
+                    }
+                    // Transients are written first, writes stick to one state per pass.
+                    if(!written[i] && graph.IsTransient(i))
+                    {
+                        graph.Write(pass, i, WRITES[random() % 4]);
+                    }
+                    else if(random() % 2)
+                    {
+                        graph.Read(pass, i, READS[random() % 4]);
+                        if(random() % 4 == 0)
+                        {
+                            graph.Read(pass, i, READS[random() % 4]);
+                        }
+                    }
+                    else
+                    {
+                        graph.Write(pass, i, WRITES[random() % 4]);
+                    }
+                    written[i] = true;
+                }
+            }
+
+            std::vector<uint64_t> alignments(resourceCount);
+            for(uint64_t& alignment : alignments)
+            {
+                alignment = uint64_t(64 * 1024) << (random() % 7);
+            }
+            graph.Compile([&](RenderGraphCompiler::ResourceId resource) {
+                return RenderGraphCompiler::Allocation{ .size = 1 + random() % (8 * MB), .alignment = alignments[resource] };
+            });
+
+            // Replay. Split transitions stay pending between their halves, where nothing may use the resource.
+            std::vector<RenderGraphCompiler::States> states(resourceCount);
+            std::vector<bool> pending(resourceCount);
+            std::vector<uint32_t> pendingList(resourceCount);
+            for(uint32_t i = 0; i < resourceCount; ++i)
+            {
+                states[i] = graph.GetInitialState(i);
+            }
+            bool valid = true;
+            for(uint32_t pass = 0; pass <= passCount; ++pass)
+            {
+                for(const Barrier& barrier : graph.GetBarriers(pass))
+                {
+                    if(barrier.type != Barrier::Type::Transition)
+                    {
+                        valid &= !pending[barrier.resource];
+                        continue;
+                    }
+                    valid &= barrier.before == states[barrier.resource] && barrier.before != barrier.after;
+                    switch(barrier.split)
+                    {
+                    case Barrier::Split::Begin:
+                        valid &= !pending[barrier.resource] && pass < passCount;
+                        pending[barrier.resource] = true;
+                        pendingList[barrier.resource] = graph.GetCommandList(pass);
+                        break;
+                    case Barrier::Split::End:
+                        valid &= pending[barrier.resource] && pass < passCount && pendingList[barrier.resource] == graph.GetCommandList(pass);
+                        pending[barrier.resource] = false;
+                        states[barrier.resource] = barrier.after;
+                        break;
+                    case Barrier::Split::None:
+                        valid &= !pending[barrier.resource];
+                        states[barrier.resource] = barrier.after;
+                        break;
+                    }
+                }
+                if(pass == passCount)
+                {
+                    break;
+                }
+                for(const RenderGraphCompiler::Access& access : graph.GetAccesses(pass))
+                {
+                    valid &= !pending[access.resource] && (states[access.resource] & access.state) == access.state;
+                }
+            }
+            for(uint32_t i = 0; i < resourceCount; ++i)
+            {
+                valid &= !pending[i];
+                // Imported resources end where they were asked to, transients where the next frame expects them.
+                valid &= states[i] == (graph.IsTransient(i) ? graph.GetInitialState(i) : finalStates[i]);
+            }
+            CHECK(valid);
+
+            // Memory: aligned, inside the heap, and never shared while both are alive.
+            std::vector<uint32_t> firstPass(resourceCount, UINT32_MAX), lastPass(resourceCount);
+            for(uint32_t pass = 0; pass < passCount; ++pass)
+            {
+                for(const RenderGraphCompiler::Access& access : graph.GetAccesses(pass))
+                {
+                    firstPass[access.resource] = std::min(firstPass[access.resource], pass);
+                    lastPass[access.resource] = pass;
+                }
+            }
+            bool placed = true;
+            for(uint32_t i = 0; i < resourceCount; ++i)
+            {
+                if(!graph.IsTransient(i) || !graph.IsUsed(i))
+                {
+                    continue;
+                }
+                const RenderGraphCompiler::Placement a = graph.GetPlacement(i);
+                const RenderGraphCompiler::Heap& heap = graph.GetHeaps()[a.heap];
+                placed &= a.offset % alignments[i] == 0 && a.offset + a.size <= heap.size && heap.alignment >= alignments[i];
+                for(uint32_t j = i + 1; j < resourceCount; ++j)
+                {
+                    if(!graph.IsTransient(j) || !graph.IsUsed(j) || firstPass[i] > lastPass[j] || firstPass[j] > lastPass[i])
+                    {
+                        continue;
+                    }
+                    const RenderGraphCompiler::Placement b = graph.GetPlacement(j);
+                    placed &= a.heap != b.heap || a.offset + a.size <= b.offset || b.offset + b.size <= a.offset;
+                }
+            }
+            CHECK(placed);
+
+            const RenderGraphCompiler::Stats& stats = graph.GetStats();
+            splits += stats.splitTransitionCount;
+            savedBytes += stats.transientBytes > stats.heapBytes ? stats.transientBytes - stats.heapBytes : 0;
+        }
+        // Otherwise the replay above checked very little.
+        CHECK(splits > 0);
+        CHECK(savedBytes > 0);
+    }
+}
+
+int main()
+{
+    TestSplitTransitions();
+    TestAliasing();
+    TestHeapClassesAndUav();
+    TestRandomGraphs();
+
+    return Test::Finish();
+}
@@ -0,0 +1,200 @@
+#include "test_common.hpp"
+
+#include "utility/residency_policy.hpp"
+
+#include <random>
+
+// A small trace with known decisions, then random traces checked against a model of what the renderer may see: nothing
+// used by a frame in flight is evicted, only what was wanted while evicted is restored, and the budget only breaks when
+// everything left is in flight. Validate() after every frame.
+namespace
+{
+    using Util::ResidencyPolicy;
+
+    void TestLeastRecentlyUsed()
+    {
+        ResidencyPolicy policy(300, 2);
+        const ResidencyPolicy::ResourceId a = policy.Add(100);
+        const ResidencyPolicy::ResourceId b = policy.Add(100);
+        const ResidencyPolicy::ResourceId c = policy.Add(100);
+        policy.BeginFrame();
+        policy.MarkUsed(a);
+        policy.MarkUsed(b);
+        policy.MarkUsed(c);
+        CHECK(policy.Update().evict.empty());
+
+        // Over budget, but everything was used by a frame still in flight.
+        const ResidencyPolicy::ResourceId d = policy.Add(100);
+        policy.BeginFrame();
+        policy.MarkUsed(a);
+        policy.MarkUsed(d);
+        CHECK(policy.Update().evict.empty());
+        CHECK(policy.GetStats().overBudgetFrames == 1);
+
+        // b and c were last used two frames ago, b less recently.
+        policy.BeginFrame();
+        policy.MarkUsed(a);
+        policy.MarkUsed(d);
+        const ResidencyPolicy::Decisions& evicted = policy.Update();
+        CHECK(evicted.evict == std::vector<ResidencyPolicy::ResourceId>{ b });
+        CHECK(evicted.restore.empty());
+        CHECK(!policy.IsResident(b));
+
+        // Wanting b back pushes c out.
+        policy.BeginFrame();
+        policy.MarkUsed(b);
+        const ResidencyPolicy::Decisions& restored = policy.Update();
+        CHECK(restored.restore == std::vector<ResidencyPolicy::ResourceId>{ b });
+        CHECK(restored.evict == std::vector<ResidencyPolicy::ResourceId>{ c });
+        CHECK(policy.Validate());
+
+        const ResidencyPolicy::Stats stats = policy.GetStats();
+        CHECK(stats.evictions == 2 && stats.restores == 1);
+        CHECK(stats.residentBytes == 300 && stats.evictedBytes == 100);
+    }
+
+    void TestRestoreLimit()
+    {
+        // Restores stop at the byte limit, but one always goes through.
+        ResidencyPolicy policy(UINT64_MAX, 1, 150);
+        std::vector<ResidencyPolicy::ResourceId> resources;
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            resources.push_back(policy.Add(100));
+        }
+        resources.push_back(policy.Add(1000));
+
+        policy.SetBudget(0);
+        policy.BeginFrame();
+        CHECK(policy.Update().evict.size() == resources.size());
+        policy.SetBudget(UINT64_MAX);
+
+        policy.BeginFrame();
+        policy.MarkUsed(resources.back());
+        CHECK(policy.Update().restore.size() == 1);
+
+        policy.BeginFrame();
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            policy.MarkUsed(resources[i]);
+        }
+        CHECK(policy.Update().restore.size() == 1);
+        CHECK(policy.GetStats().waitingCount == 3);
+        policy.BeginFrame();
+        CHECK(policy.Update().restore.size() == 1);
+        CHECK(policy.Validate());
+    }
+
+    void TestRandomTraces()
+    {
+        std::mt19937 random(50);
+        const uint32_t runs = Test::IsQuick() ? 50 : 300;
+        uint64_t evictions = 0;
+        uint64_t restores = 0;
+        for(uint32_t run = 0; run < runs; ++run)
+        {
+            const uint64_t budget = 1 + random() % 5000;
+            const uint32_t framesInFlight = 1 + random() % 3;
+            const uint64_t restoreLimit = random() % 2 != 0 ? UINT64_MAX : 1 + random() % 2000;
+            ResidencyPolicy policy(budget, framesInFlight, restoreLimit);
+
+            // What the caller knows from the decisions alone.
+            struct Model
+            {
+                uint64_t size = 0;
+                uint64_t lastUsed = 0;
+                bool resident = true;
+                bool pinned = false;
+                bool wanted = false; // used while evicted
+            };
+            std::vector<Model> models;
+            std::vector<ResidencyPolicy::ResourceId> live;
+
+            bool valid = true;
+            for(uint32_t frame = 0; frame < 300 && valid; ++frame)
+            {
+                policy.BeginFrame();
+                const uint32_t operations = random() % 20;
+                for(uint32_t i = 0; i < operations; ++i)
+                {
+                    const uint32_t kind = random() % 10;
+                    if(kind < 2 || live.empty())
+                    {
+                        const uint64_t size = 1 + random() % 500;
+                        const bool pinned = random() % 10 == 0;
+                        const ResidencyPolicy::ResourceId resource = policy.Add(size, pinned);
+                        if(resource >= models.size())
+                        {
+                            models.resize(resource + 1);
+                        }
+                        models[resource] = Model{ .size = size, .lastUsed = policy.GetFrame(), .pinned = pinned };
+                        live.push_back(resource);
+                    }
+                    else if(kind < 3)
+                    {
+                        const size_t index = random() % live.size();
+                        policy.Remove(live[index]);
+                        live[index] = live.back();
+                        live.pop_back();
+                    }
+                    else
+                    {
+                        const ResidencyPolicy::ResourceId resource = live[random() % live.size()];
+                        policy.MarkUsed(resource);
+                        models[resource].lastUsed = policy.GetFrame();
+                        models[resource].wanted |= !models[resource].resident;
+                    }
+                }
+
+                const ResidencyPolicy::Decisions& decisions = policy.Update();
+                uint64_t restoreBytes = 0;
+                for(const ResidencyPolicy::ResourceId resource : decisions.restore)
+                {
+                    Model& model = models[resource];
+                    valid &= !model.resident && model.wanted;
+                    model.resident = true;
+                    model.wanted = false;
+                    model.lastUsed = policy.GetFrame();
+                    restoreBytes += model.size;
+                }
+                valid &= decisions.restore.size() <= 1 || restoreBytes <= restoreLimit;
+                for(const ResidencyPolicy::ResourceId resource : decisions.evict)
+                {
+                    Model& model = models[resource];
+                    // The GPU may still read anything a frame in flight used.
+                    valid &= model.resident && !model.pinned && model.lastUsed + framesInFlight <= policy.GetFrame();
+                    model.resident = false;
+                }
+
+                // Over budget only when nothing left could be evicted.
+                uint64_t residentBytes = 0;
+                bool evictable = false;
+                for(const ResidencyPolicy::ResourceId resource : live)
+                {
+                    const Model& model = models[resource];
+                    valid &= policy.IsResident(resource) == model.resident;
+                    residentBytes += model.resident ? model.size : 0;
+                    evictable |= model.resident && !model.pinned && model.lastUsed + framesInFlight <= policy.GetFrame();
+                }
+                valid &= residentBytes == policy.GetStats().residentBytes;
+                valid &= residentBytes <= budget || !evictable;
+                valid &= policy.Validate();
+
+                evictions += decisions.evict.size();
+                restores += decisions.restore.size();
+            }
+            CHECK(valid);
+        }
+        // Otherwise the traces checked very little.
+        CHECK(evictions > 0 && restores > 0);
+    }
+}
+
+int main()
+{
+    TestLeastRecentlyUsed();
+    TestRestoreLimit();
+    TestRandomTraces();
+
+    return Test::Finish();
+}
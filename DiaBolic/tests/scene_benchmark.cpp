@@ -0,0 +1,273 @@
+#include "test_common.hpp"
+
+#include "scene.hpp"
+#include "resources.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <new>
+#include <random>
+
+using namespace DirectX;
+
+// The node graph models used to keep against the Scene arrays that replaced it, on the same random hierarchies:
+// heap bytes per object, counted by replacing operator new, and the time to resolve every world transform once.
+// The graph is rebuilt here as it was, shared_ptr links both ways and a matrix per node.
+
+namespace
+{
+    std::atomic<size_t> liveBytes = 0;
+
+    void* AllocateCounted(size_t size, size_t alignment)
+    {
+        // The size sits right in front of the allocation, the offset to the start of the block in front of that.
+        const size_t header = std::max<size_t>(alignment, 2 * sizeof(size_t));
+#ifdef _WIN32
+        char* block = static_cast<char*>(_aligned_malloc(size + header, header));
+#else
+        char* block = static_cast<char*>(std::aligned_alloc(header, (size + 2 * header - 1) / header * header));
+#endif
+        if(!block)
+        {
+            throw std::bad_alloc();
+        }
+
+        size_t* info = reinterpret_cast<size_t*>(block + header) - 2;
+        info[0] = header;
+        info[1] = size;
+        liveBytes += size;
+        return block + header;
+    }
+
+    void FreeCounted(void* pointer)
+    {
+        if(!pointer)
+        {
+            return;
+        }
+
+        const size_t* info = static_cast<size_t*>(pointer) - 2;
+        liveBytes -= info[1];
+#ifdef _WIN32
+        _aligned_free(static_cast<char*>(pointer) - info[0]);
+#else
+        std::free(static_cast<char*>(pointer) - info[0]);
+#endif
+    }
+}
+
+void* operator new(size_t size) { return AllocateCounted(size, 0); }
+void* operator new[](size_t size) { return AllocateCounted(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return AllocateCounted(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return AllocateCounted(size, static_cast<size_t>(alignment)); }
+void operator delete(void* pointer) noexcept { FreeCounted(pointer); }
+void operator delete[](void* pointer) noexcept { FreeCounted(pointer); }
+void operator delete(void* pointer, size_t) noexcept { FreeCounted(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { FreeCounted(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { FreeCounted(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { FreeCounted(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { FreeCounted(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { FreeCounted(pointer); }
+
+namespace
+{
+    // Model's Node before the Scene.
+    class LegacyNode
+    {
+    public:
+        std::shared_ptr<Mesh> mesh = nullptr;
+        std::shared_ptr<Material> material = nullptr;
+        XMMATRIX transform = XMMatrixIdentity();
+        std::shared_ptr<LegacyNode> parent = nullptr;
+        std::vector<std::shared_ptr<LegacyNode>> children;
+    };
+
+    // Each model is a random tree, parents are random earlier nodes so they end up about log n deep.
+    struct Hierarchy
+    {
+        std::vector<XMFLOAT4X4> locals;
+        std::vector<uint32_t> parents; // UINT32_MAX for the roots of the models
+    };
+
+    constexpr uint32_t NODES_PER_MODEL = 256;
+
+    Hierarchy RandomHierarchy(size_t count, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+
+        Hierarchy hierarchy;
+        hierarchy.locals.resize(count);
+        hierarchy.parents.resize(count);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            XMStoreFloat4x4(&hierarchy.locals[i], XMMatrixMultiply(XMMatrixRotationY(angle(random)),
+                XMMatrixTranslation(offset(random), offset(random), offset(random))));
+
+            const uint32_t first = i / NODES_PER_MODEL * NODES_PER_MODEL;
+            hierarchy.parents[i] = i == first ? UINT32_MAX : std::uniform_int_distribution<uint32_t>(first, i - 1)(random);
+        }
+        return hierarchy;
+    }
+
+    // What drawing the graph did for every node, every frame.
+    void WalkLegacy(const LegacyNode& node, FXMMATRIX parentWorld, std::vector<XMFLOAT4X4>& worlds)
+    {
+        const XMMATRIX world = XMMatrixMultiply(node.transform, parentWorld);
+        if(node.mesh)
+        {
+            worlds.emplace_back();
+            XMStoreFloat4x4(&worlds.back(), world);
+        }
+        for(const std::shared_ptr<LegacyNode>& child : node.children)
+        {
+            WalkLegacy(*child, world, worlds);
+        }
+    }
+
+    XMMATRIX LegacyWorld(const LegacyNode& node)
+    {
+        return node.parent ? XMMatrixMultiply(node.transform, LegacyWorld(*node.parent)) : node.transform;
+    }
+
+    float MaxDifference(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+    {
+        float difference = 0.0f;
+        for(uint32_t row = 0; row < 4; ++row)
+        {
+            for(uint32_t column = 0; column < 4; ++column)
+            {
+                difference = std::max(difference, std::abs(a.m[row][column] - b.m[row][column]));
+            }
+        }
+        return difference;
+    }
+}
+
+int main()
+{
+    const std::vector<size_t> counts = Test::IsQuick()
+        ? std::vector<size_t>{ 1024, 16384 }
+        : std::vector<size_t>{ 1024, 16384, 65536, 262144, 1048576 };
+    const uint32_t repetitions = Test::IsQuick() ? 2 : 10;
+
+    std::mt19937 random(5);
+    const auto mesh = std::make_shared<Mesh>(0, Culling::Bounds{ .center = XMFLOAT3(0.0f, 0.0f, 0.0f), .extents = XMFLOAT3(1.0f, 1.0f, 1.0f) });
+    const auto material = std::make_shared<Material>();
+
+    // Both sides need the job system's workers, start them before counting.
+    (void)JobSystem::Get();
+
+    // The scene's bytes include the BVH, which the graph had no equivalent of. Moving every model recomputes all world
+    // matrices like the graph walk does, the transform arrays on their own are what replaced the walk. The whole scene
+    // also transforms the bounds and refits the BVH.
+    std::printf("%10s %12s %12s %12s %14s %14s %14s %14s\n", "objects", "graph B/obj", "scene B/obj", "BVH B/obj", "graph walk ms",
+        "arrays ms", "scene all ms", "scene none ms");
+    for(const size_t count : counts)
+    {
+        const Hierarchy hierarchy = RandomHierarchy(count, random);
+
+        // The graph. Parent links are strong, like they were, so the children have to be dropped to free it.
+        size_t bytesBefore = liveBytes;
+        std::vector<std::shared_ptr<LegacyNode>> roots;
+        std::vector<std::shared_ptr<LegacyNode>> nodes(count);
+        const size_t indexBytes = liveBytes - bytesBefore;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            nodes[i] = std::make_shared<LegacyNode>();
+            nodes[i]->transform = XMLoadFloat4x4(&hierarchy.locals[i]);
+            if(hierarchy.parents[i] == UINT32_MAX)
+            {
+                roots.push_back(nodes[i]);
+            }
+            else
+            {
+                nodes[i]->mesh = mesh;
+                nodes[i]->material = material;
+                nodes[i]->parent = nodes[hierarchy.parents[i]];
+                nodes[i]->parent->children.push_back(nodes[i]);
+            }
+        }
+        const size_t graphBytes = liveBytes - bytesBefore - indexBytes;
+
+        // The scene.
+        bytesBefore = liveBytes;
+        auto scene = std::make_unique<Scene>();
+        std::vector<Scene::Entity> entities(count);
+        const size_t entityBytes = liveBytes - bytesBefore;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const bool root = hierarchy.parents[i] == UINT32_MAX;
+            entities[i] = scene->Create(XMLoadFloat4x4(&hierarchy.locals[i]), root ? Scene::Entity{} : entities[hierarchy.parents[i]],
+                root ? nullptr : mesh.get(), root ? nullptr : material.get());
+        }
+        scene->Update();
+        const size_t sceneBytes = liveBytes - bytesBefore - entityBytes - sizeof(Scene);
+
+        // Scene's own count of its memory is what the heap says, give or take what the job system allocates and frees
+        // meanwhile.
+        const Scene::Stats& stats = scene->GetStats();
+        const size_t accountingError = std::max(stats.memoryBytes, sceneBytes) - std::min(stats.memoryBytes, sceneBytes);
+        CHECK(accountingError <= stats.memoryBytes / 20 + 4096);
+
+        // Every model moves and everything is recomputed, then a frame where nothing changed.
+        std::vector<XMFLOAT4X4> worlds;
+        worlds.reserve(count);
+        const double graphMs = Test::MeasureMilliseconds(repetitions, [&]() {
+            worlds.clear();
+            for(const std::shared_ptr<LegacyNode>& root : roots)
+            {
+                WalkLegacy(*root, XMMatrixIdentity(), worlds);
+            }
+        });
+        TransformHierarchy transforms;
+        transforms.Reserve(count);
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t parent = hierarchy.parents[i] == UINT32_MAX ? TransformHierarchy::NO_PARENT : hierarchy.parents[i];
+            (void)transforms.Add(XMLoadFloat4x4(&hierarchy.locals[i]), parent);
+        }
+        const double arraysMs = Test::MeasureMilliseconds(repetitions, [&]() {
+            for(uint32_t i = 0; i < count; i += NODES_PER_MODEL)
+            {
+                transforms.SetLocal(i, XMLoadFloat4x4(&hierarchy.locals[i]));
+            }
+            transforms.UpdateWorld();
+        });
+
+        float frame = 0.0f;
+        const double sceneAllMs = Test::MeasureMilliseconds(repetitions, [&]() {
+            frame += 1.0f;
+            for(uint32_t i = 0; i < count; i += NODES_PER_MODEL)
+            {
+                scene->SetLocalTransform(entities[i], XMMatrixMultiply(XMLoadFloat4x4(&hierarchy.locals[i]), XMMatrixTranslation(frame, 0.0f, 0.0f)));
+                nodes[i]->transform = XMMatrixMultiply(XMLoadFloat4x4(&hierarchy.locals[i]), XMMatrixTranslation(frame, 0.0f, 0.0f));
+            }
+            scene->Update();
+        });
+        const double sceneNoneMs = Test::MeasureMilliseconds(repetitions, [&]() { scene->Update(); });
+
+        // Both agree on the world transforms.
+        float difference = 0.0f;
+        for(uint32_t i = 0; i < count; i += 97)
+        {
+            XMFLOAT4X4 legacy;
+            XMStoreFloat4x4(&legacy, LegacyWorld(*nodes[i]));
+            difference = std::max(difference, MaxDifference(legacy, scene->GetWorldTransform(entities[i])));
+        }
+        CHECK(difference < 1e-2f);
+        CHECK(transforms.GetStats().nodesTouched == count);
+        CHECK(worlds.size() == scene->GetRenderableCount());
+
+        std::printf("%10zu %12.1f %12.1f %12.1f %14.3f %14.3f %14.3f %14.3f\n", count, static_cast<double>(graphBytes) / count,
+            static_cast<double>(sceneBytes) / count, static_cast<double>(stats.bvhBytes) / count, graphMs, arraysMs, sceneAllMs, sceneNoneMs);
+
+        for(const std::shared_ptr<LegacyNode>& node : nodes)
+        {
+            node->parent = nullptr;
+            node->children.clear();
+        }
+    }
+
+    return Test::Finish();
+}
@@ -0,0 +1,216 @@
+#include "test_common.hpp"
+
+#include "scene.hpp"
+#include "resources.hpp"
+
+#include <random>
+
+using namespace DirectX;
+
+// Entity handles, subtree destruction and reuse of the freed slots, checked against world transforms computed from
+// the model's nodes directly.
+namespace
+{
+    const Mesh MESH(0, Culling::Bounds{ .center = XMFLOAT3(0.0f, 0.0f, 0.0f), .extents = XMFLOAT3(1.0f, 1.0f, 1.0f) });
+    const Material MATERIAL{};
+
+    // Parents are random earlier nodes, the root has no mesh like most imported models.
+    Model RandomModel(uint32_t nodeCount, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+
+        std::vector<Model::Node> nodes(nodeCount);
+        for(uint32_t i = 0; i < nodeCount; ++i)
+        {
+            XMStoreFloat4x4(&nodes[i].transform, XMMatrixMultiply(XMMatrixRotationY(angle(random)),
+                XMMatrixTranslation(offset(random), offset(random), offset(random))));
+            nodes[i].parent = i == 0 ? Model::NO_PARENT : std::uniform_int_distribution<uint32_t>(0, i - 1)(random);
+            nodes[i].mesh = i == 0 ? nullptr : &MESH;
+            nodes[i].material = &MATERIAL;
+        }
+        return Model(std::move(nodes));
+    }
+
+    float MaxDifference(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+    {
+        float difference = 0.0f;
+        for(uint32_t row = 0; row < 4; ++row)
+        {
+            for(uint32_t column = 0; column < 4; ++column)
+            {
+                difference = std::max(difference, std::abs(a.m[row][column] - b.m[row][column]));
+            }
+        }
+        return difference;
+    }
+
+    // Created in node order like Instantiate does, so the first entity is the root.
+    struct Instance
+    {
+        const Model* model = nullptr;
+        XMFLOAT4X4 placement;
+        std::vector<Scene::Entity> entities;
+    };
+
+    Instance Place(Scene& scene, const Model& model, const XMMATRIX& placement, Scene::Entity parent = {})
+    {
+        Instance instance{};
+        instance.model = &model;
+        XMStoreFloat4x4(&instance.placement, placement);
+
+        // Instantiate only returns the root, create them the same way to keep every handle.
+        const std::vector<Model::Node>& nodes = model.GetNodes();
+        for(const Model::Node& node : nodes)
+        {
+            const Scene::Entity nodeParent = node.parent == Model::NO_PARENT ? parent : instance.entities[node.parent];
+            const XMMATRIX local = node.parent == Model::NO_PARENT
+                ? XMMatrixMultiply(XMLoadFloat4x4(&node.transform), placement)
+                : XMLoadFloat4x4(&node.transform);
+            instance.entities.push_back(scene.Create(local, nodeParent, node.mesh, node.material));
+        }
+        return instance;
+    }
+
+    void CheckWorldTransforms(const Scene& scene, const Instance& instance, const XMMATRIX& parentWorld)
+    {
+        const std::vector<Model::Node>& nodes = instance.model->GetNodes();
+        std::vector<XMFLOAT4X4> expected(nodes.size());
+        float difference = 0.0f;
+        for(size_t i = 0; i < nodes.size(); ++i)
+        {
+            const XMMATRIX parent = nodes[i].parent == Model::NO_PARENT
+                ? XMMatrixMultiply(XMLoadFloat4x4(&instance.placement), parentWorld)
+                : XMLoadFloat4x4(&expected[nodes[i].parent]);
+            XMStoreFloat4x4(&expected[i], XMMatrixMultiply(XMLoadFloat4x4(&nodes[i].transform), parent));
+            difference = std::max(difference, MaxDifference(expected[i], scene.GetWorldTransform(instance.entities[i])));
+        }
+        CHECK(difference < 1e-2f);
+    }
+
+    void TestSlotReuse()
+    {
+        std::mt19937 random(3);
+        const Model model = RandomModel(200, random);
+        const Model small = RandomModel(20, random);
+
+        Scene scene;
+        std::vector<Instance> instances;
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            instances.push_back(Place(scene, model, XMMatrixTranslation(100.0f * i, 0.0f, 0.0f)));
+        }
+        scene.Update();
+        CHECK(scene.GetStats().entityCount == 800 && scene.GetStats().slotCount == 800);
+        CHECK(scene.GetRenderableCount() == 4 * 199);
+
+        // Takes the whole subtree, and its handles go stale.
+        const Instance destroyed = instances[1];
+        scene.Destroy(destroyed.entities[0]);
+        instances.erase(instances.begin() + 1);
+        for(const Scene::Entity entity : destroyed.entities)
+        {
+            CHECK(!scene.IsAlive(entity));
+        }
+        scene.Update();
+        CHECK(scene.GetStats().entityCount == 600 && scene.GetStats().slotCount == 800);
+
+        // A model of the same shape fills the hole exactly, handles are reused with a new generation.
+        instances.push_back(Place(scene, model, XMMatrixTranslation(0.0f, 50.0f, 0.0f)));
+        scene.Update();
+        CHECK(scene.GetStats().entityCount == 800 && scene.GetStats().slotCount == 800);
+        for(const Scene::Entity entity : destroyed.entities)
+        {
+            CHECK(!scene.IsAlive(entity));
+        }
+        for(const Instance& instance : instances)
+        {
+            CheckWorldTransforms(scene, instance, XMMatrixIdentity());
+        }
+
+        // Parented under the last entity, the free slots are all in front of it and the scene grows.
+        const Scene::Entity lastEntity = instances.back().entities.back();
+        scene.Destroy(instances[0].entities[0]);
+        instances.erase(instances.begin());
+        const Instance child = Place(scene, small, XMMatrixTranslation(1.0f, 2.0f, 3.0f), lastEntity);
+        scene.Update();
+        CHECK(scene.GetStats().entityCount == 620);
+        CHECK(scene.GetStats().slotCount == 820);
+        CheckWorldTransforms(scene, child, XMLoadFloat4x4(&scene.GetWorldTransform(lastEntity)));
+
+        // Roots take the first free slots, the 200 freed ones are enough for 10 small models.
+        std::vector<Instance> smalls;
+        for(uint32_t i = 0; i < 10; ++i)
+        {
+            smalls.push_back(Place(scene, small, XMMatrixTranslation(0.0f, 0.0f, 10.0f * i)));
+        }
+        scene.Update();
+        CHECK(scene.GetStats().entityCount == 820 && scene.GetStats().slotCount == 820);
+        for(const Instance& instance : smalls)
+        {
+            CheckWorldTransforms(scene, instance, XMMatrixIdentity());
+        }
+
+        // Moving a root after reuse still reaches all of its descendants.
+        Instance& moved = instances.front();
+        XMStoreFloat4x4(&moved.placement, XMMatrixTranslation(-5.0f, 0.0f, 0.0f));
+        scene.SetLocalTransform(moved.entities[0], XMMatrixMultiply(XMLoadFloat4x4(&model.GetNodes()[0].transform), XMLoadFloat4x4(&moved.placement)));
+        scene.Update();
+        CheckWorldTransforms(scene, moved, XMMatrixIdentity());
+        CheckWorldTransforms(scene, child, XMLoadFloat4x4(&scene.GetWorldTransform(lastEntity)));
+    }
+
+    // Random creates and destroys, every surviving entity keeps the right world transform.
+    void TestChurn()
+    {
+        std::mt19937 random(11);
+        std::vector<Model> models;
+        for(uint32_t i = 0; i < 6; ++i)
+        {
+            models.push_back(RandomModel(std::uniform_int_distribution<uint32_t>(1, 60)(random), random));
+        }
+
+        Scene scene;
+        std::vector<Instance> instances;
+        uint32_t entityCount = 0;
+        const uint32_t steps = Test::IsQuick() ? 300 : 3000;
+        for(uint32_t step = 0; step < steps; ++step)
+        {
+            if(instances.empty() || random() % 3 != 0)
+            {
+                const Model& model = models[random() % models.size()];
+                instances.push_back(Place(scene, model, XMMatrixTranslation(static_cast<float>(step), 0.0f, 0.0f)));
+                entityCount += static_cast<uint32_t>(model.GetNodes().size());
+            }
+            else
+            {
+                const size_t index = random() % instances.size();
+                scene.Destroy(instances[index].entities[0]);
+                entityCount -= static_cast<uint32_t>(instances[index].entities.size());
+                instances.erase(instances.begin() + index);
+            }
+
+            if(step % 50 == 0)
+            {
+                scene.Update();
+                CHECK(scene.GetStats().entityCount == entityCount);
+                for(const Instance& instance : instances)
+                {
+                    CheckWorldTransforms(scene, instance, XMMatrixIdentity());
+                }
+            }
+        }
+
+        // Freed slots get filled again, the scene never grows much past what is alive.
+        scene.Update();
+        CHECK(scene.GetStats().slotCount < entityCount + 200);
+    }
+}
+
+int main()
+{
+    TestSlotReuse();
+    TestChurn();
+
+    return Test::Finish();
+}
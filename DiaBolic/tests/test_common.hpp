@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Like assert, but also in release builds and it carries on, so one run reports every failure.
+#define CHECK(condition) \
+    do \
+    { \
+        if(!(condition)) \
+        { \
+            ++Test::failures; \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while(false)
+
+namespace Test
+{
+    inline int failures = 0;
+
+    // Set by ctest, benchmarks only run their smallest inputs then.
+    inline bool IsQuick()
+    {
+        return std::getenv("DIABOLIC_QUICK") != nullptr;
+    }
+
+    // Best of repetitions, the others are disturbed by something else more often than not.
+    template<typename Function>
+    double MeasureMilliseconds(uint32_t repetitions, Function&& function)
+    {
+        double best = 1e30;
+        for(uint32_t i = 0; i < repetitions; ++i)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            function();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // Returned from main.
+    inline int Finish()
+    {
+        if(failures > 0)
+        {
+            std::fprintf(stderr, "%d checks failed.\n", failures);
+            return EXIT_FAILURE;
+        }
+        std::printf("All checks passed.\n");
+        return EXIT_SUCCESS;
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// What the tested sources expect from pch.h, without a device. D3D12 only comes in for its structs, when DirectX-Headers is there.
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <locale>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+#if __has_include(<DirectXMath.h>)
+#include <DirectXMath.h>
+#endif
+
+#if __has_include(<directx/d3d12.h>)
+#ifndef _WIN32
+#include <wsl/winadapter.h>
+#endif
+#include <directx/d3d12.h>
+#endif
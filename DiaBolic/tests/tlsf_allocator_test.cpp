@@ -0,0 +1,121 @@
+#include "test_common.hpp"
+
+#include "utility/tlsf_allocator.hpp"
+
+#include <random>
+
+// Random allocations and frees against TlsfAllocator::Validate(), with every live range checked for alignment and
+// overlap. Granularities, alignments that aren't powers of two and sizes up to the whole range are all mixed in.
+namespace
+{
+    using Util::TlsfAllocator;
+
+    void TestExactFit()
+    {
+        TlsfAllocator allocator(1024, 16);
+        const TlsfAllocator::Allocation all = allocator.Allocate(1024, 16);
+        CHECK(all.IsValid() && all.offset == 0);
+        CHECK(!allocator.Allocate(1, 16).IsValid());
+        allocator.Free(all);
+
+        // Freed neighbours merge back into one block.
+        TlsfAllocator::Allocation parts[4];
+        for(TlsfAllocator::Allocation& part : parts)
+        {
+            part = allocator.Allocate(256, 16);
+            CHECK(part.IsValid());
+        }
+        allocator.Free(parts[1]);
+        allocator.Free(parts[3]);
+        allocator.Free(parts[2]);
+        allocator.Free(parts[0]);
+        const TlsfAllocator::Stats stats = allocator.GetStats();
+        CHECK(allocator.Validate());
+        CHECK(stats.freeBlockCount == 1 && stats.largestFreeBlock == 1024 && stats.Fragmentation() == 0.0f);
+
+        // Alignments that aren't powers of two, like a 48 byte structured buffer stride.
+        const TlsfAllocator::Allocation padding = allocator.Allocate(16, 16);
+        const TlsfAllocator::Allocation strided = allocator.Allocate(100, 48);
+        CHECK(strided.IsValid() && strided.offset % 48 == 0 && strided.offset > 0);
+        allocator.Free(padding);
+        allocator.Free(strided);
+        CHECK(allocator.Validate() && allocator.IsEmpty());
+    }
+
+    void TestRandomOperations()
+    {
+        const uint32_t seeds = Test::IsQuick() ? 20 : 100;
+        const uint32_t operations = Test::IsQuick() ? 1000 : 3000;
+        uint64_t failedAllocations = 0;
+        for(uint32_t seed = 0; seed < seeds; ++seed)
+        {
+            std::mt19937_64 random(seed);
+            const uint64_t granularity = uint64_t(1) << (random() % 13);
+            const uint64_t size = granularity * (1 + random() % 5000);
+            TlsfAllocator allocator(size, granularity);
+
+            std::vector<TlsfAllocator::Allocation> live;
+            bool valid = true;
+            for(uint32_t i = 0; i < operations && valid; ++i)
+            {
+                if(live.empty() || random() % 3 != 0)
+                {
+                    // Mostly small, now and then anything up to the whole range.
+                    const uint64_t allocationSize = 1 + random() % (random() % 4 != 0 ? 4096 : size);
+                    const uint64_t alignment = granularity * (1 + random() % (random() % 2 != 0 ? 1 : 24));
+                    const TlsfAllocator::Allocation allocation = allocator.Allocate(allocationSize, alignment);
+                    if(!allocation.IsValid())
+                    {
+                        failedAllocations++;
+                        continue;
+                    }
+
+                    valid &= allocation.offset % alignment == 0 && allocation.offset + allocationSize <= size;
+                    valid &= allocation.size == allocationSize;
+                    for(const TlsfAllocator::Allocation& other : live)
+                    {
+                        valid &= allocation.offset >= other.offset + other.size || other.offset >= allocation.offset + allocationSize;
+                    }
+                    live.push_back(allocation);
+                }
+                else
+                {
+                    const size_t index = random() % live.size();
+                    allocator.Free(live[index]);
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+                valid &= allocator.Validate();
+            }
+            CHECK(valid);
+
+            uint64_t requestedBytes = 0;
+            for(const TlsfAllocator::Allocation& allocation : live)
+            {
+                requestedBytes += allocation.size;
+            }
+            CHECK(allocator.GetStats().requestedBytes == requestedBytes);
+            CHECK(allocator.GetStats().allocationCount == live.size());
+
+            // Once everything is freed it is one block again, and all of it can be handed out at once.
+            for(const TlsfAllocator::Allocation& allocation : live)
+            {
+                allocator.Free(allocation);
+            }
+            const TlsfAllocator::Stats stats = allocator.GetStats();
+            CHECK(allocator.Validate() && allocator.IsEmpty());
+            CHECK(stats.freeBlockCount == 1 && stats.largestFreeBlock == size && stats.usedBytes == 0 && stats.requestedBytes == 0);
+            CHECK(allocator.Allocate(size, granularity).IsValid());
+        }
+        // Full allocators are part of what's tested.
+        CHECK(failedAllocations > 0);
+    }
+}
+
+int main()
+{
+    TestExactFit();
+    TestRandomOperations();
+
+    return Test::Finish();
+}
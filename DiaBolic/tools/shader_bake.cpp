@@ -0,0 +1,107 @@
+// Compiles every shader in the shader registry, all variants and stages, and packs them into one archive so release
+// builds never run DXC. Run from the directory the shader paths are relative to:
+//   ShaderBake <output pack path>
+
+#include "job_system.hpp"
+#include "utility/log.hpp"
+#include "utility/shader_pack.hpp"
+#include "utility/shader_permutations.hpp"
+#include "utility/shader_registry.hpp"
+
+#include <chrono>
+#include <format>
+
+using namespace Util;
+
+namespace
+{
+    struct BakeJob
+    {
+        std::string description;
+        ShaderCompiler::PackKeys keys;
+        std::future<Shader> shader;
+    };
+
+    std::vector<uint8_t> ToBytes(const Microsoft::WRL::ComPtr<IDxcBlob>& blob)
+    {
+        if(!blob)
+        {
+            return {};
+        }
+        const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+        return std::vector<uint8_t>(data, data + blob->GetBufferSize());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc != 2)
+    {
+        dblog::error("[SHADER_BAKE] Usage: ShaderBake <output pack path>");
+        return 1;
+    }
+
+    const auto bakeStart = std::chrono::high_resolution_clock::now();
+
+    // Request everything up front, the job system works through it side by side.
+    std::vector<BakeJob> jobs;
+    for(size_t program = 0; program < static_cast<size_t>(ShaderRegistry::Program::Count); ++program)
+    {
+        const ShaderRegistry::ProgramDesc& desc = ShaderRegistry::GetProgram(static_cast<ShaderRegistry::Program>(program));
+        const ShaderPermutations permutations(desc.shaderPath, desc.features);
+        for(uint32_t variant = 0; variant < permutations.GetVariantCount(); ++variant)
+        {
+            for(const ShaderRegistry::Stage& stage : desc.stages)
+            {
+                jobs.push_back(BakeJob{
+                    .description = std::format("{} {} ({})", wStringToString(desc.shaderPath), wStringToString(stage.entryPoint), permutations.Describe(variant)),
+                    .keys = ShaderCompiler::GetPackKeys(stage.type, desc.shaderPath, stage.entryPoint, false, permutations.GetDefines(variant)),
+                    .shader = permutations.CompileAsync(stage.type, stage.entryPoint, variant),
+                });
+            }
+        }
+    }
+
+    std::vector<ShaderPack::PackedShader> packedShaders;
+    packedShaders.reserve(jobs.size());
+    bool failed = false;
+    for(BakeJob& job : jobs)
+    {
+        Shader shader{};
+        try
+        {
+            shader = JobSystem::Get().Wait(job.shader);
+        }
+        catch(...)
+        {
+        }
+
+        // Compile errors are logged by the compiler and leave an empty blob.
+        if(!shader.shaderBlob || shader.shaderBlob->GetBufferSize() == 0)
+        {
+            dblog::error("[SHADER_BAKE] Failed to compile {}.", job.description);
+            failed = true;
+            continue;
+        }
+
+        packedShaders.push_back(ShaderPack::PackedShader{
+            .key = job.keys.key,
+            .sourceKey = job.keys.sourceKey,
+            .entry = ShaderCache::Entry{
+                .shader = ToBytes(shader.shaderBlob),
+                .rootSignature = ToBytes(shader.rootSignatureBlob),
+                .reflection = ToBytes(shader.reflectionBlob),
+            },
+        });
+    }
+
+    // Never leave a partial pack behind, a missing shader would only show up at runtime.
+    if(failed || !ShaderPack::Write(argv[1], packedShaders))
+    {
+        return 1;
+    }
+
+    dblog::info("[SHADER_BAKE] Baked {} shaders in {:.2f} ms.", packedShaders.size(),
+        std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - bakeStart).count());
+    return 0;
+}
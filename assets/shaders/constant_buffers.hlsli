@@ -18,13 +18,20 @@
 
 #endif
 
-ConstantBufferStruct RenderResources
+ConstantBufferStruct ViewResources
 {
-    float4x4 MVP;
     float4x4 CameraVP;
+    float3 cameraPosition;
+};
+
+ConstantBufferStruct RenderResources
+{
+    uint instanceBufferIndex;
+    uint instanceOffset;
+    uint vertexOffset; // of the mesh in the geometry buffer, SV_VertexID doesn't include it
     uint positionBufferIndex;
     uint normalBufferIndex;
     uint uvBufferIndex;
     uint textureIndex;
-    bool useTexture;
+    float alphaCutoff;
 };
\ No newline at end of file
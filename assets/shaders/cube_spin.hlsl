@@ -1,5 +1,13 @@
 #include "constant_buffers.hlsli"
 
+// Permutation switches, always defined to 0 or 1 by Util::ShaderPermutations.
+#ifndef TEXTURED
+#define TEXTURED 0
+#endif
+#ifndef ALPHA_TESTED
+#define ALPHA_TESTED 0
+#endif
+
 struct VSOutput
 {
     float2 uv : TEXCOORD;
@@ -9,19 +17,36 @@ struct VSOutput
 };
 
 ConstantBuffer<RenderResources> renderResources : register(b0);
+ConstantBuffer<ViewResources> viewResources : register(b1);
+
+// Instance transforms are DirectX::XMFLOAT4X4s written by the CPU, loaded row by row.
+float4x4 LoadInstanceTransform(uint instanceID)
+{
+    ByteAddressBuffer instanceBuffer = ResourceDescriptorHeap[renderResources.instanceBufferIndex];
+    const uint offset = renderResources.instanceOffset + instanceID * 64;
 
-VSOutput VSmain(uint vertexID : SV_VertexID)
+    return float4x4(
+        instanceBuffer.Load<float4>(offset),
+        instanceBuffer.Load<float4>(offset + 16),
+        instanceBuffer.Load<float4>(offset + 32),
+        instanceBuffer.Load<float4>(offset + 48));
+}
+
+VSOutput VSmain(uint vertexID : SV_VertexID, uint instanceID : SV_InstanceID)
 {
     StructuredBuffer<float3> positionBuffer = ResourceDescriptorHeap[renderResources.positionBufferIndex];
     StructuredBuffer<float2> uvBuffer = ResourceDescriptorHeap[renderResources.uvBufferIndex];
     StructuredBuffer<float3> normalBuffer = ResourceDescriptorHeap[renderResources.normalBufferIndex];
 
+    // Every mesh shares these buffers, indices are relative to the mesh's first vertex.
+    const uint vertex = renderResources.vertexOffset + vertexID;
+
     VSOutput result;
-    float4 w_position = mul(renderResources.MVP, float4(positionBuffer[vertexID], 1.0f));
-    result.clip_position = mul(renderResources.CameraVP, w_position);
+    float4 w_position = mul(float4(positionBuffer[vertex], 1.0f), LoadInstanceTransform(instanceID));
+    result.clip_position = mul(viewResources.CameraVP, w_position);
     result.position = w_position.xyz;
-    result.normal = normalBuffer[vertexID]; // TODO: multiply with inverse transpose
-    result.uv = uvBuffer[vertexID];
+    result.normal = normalBuffer[vertex]; // TODO: multiply with inverse transpose
+    result.uv = uvBuffer[vertex];
 
     return result;
 }
@@ -30,10 +55,14 @@ SamplerState defaultSampler : register(s0);
 
 float4 PSmain(VSOutput PSinput) : SV_Target0
 {
-    if(renderResources.useTexture)
-    {
-        Texture2D<float4> albedoTexture = ResourceDescriptorHeap[renderResources.textureIndex];
-        return pow(albedoTexture.Sample(defaultSampler, PSinput.uv), 1.0 / 2.2);
-    }
+#if TEXTURED
+    Texture2D<float4> albedoTexture = ResourceDescriptorHeap[renderResources.textureIndex];
+    const float4 albedo = albedoTexture.Sample(defaultSampler, PSinput.uv);
+#if ALPHA_TESTED
+    clip(albedo.a - renderResources.alphaCutoff);
+#endif
+    return pow(albedo, 1.0 / 2.2);
+#else
     return float4(1.0f, 0.0f, 1.0f, 1.0f);
+#endif
 }
\ No newline at end of file